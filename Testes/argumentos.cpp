@@ -0,0 +1,42 @@
+🔢 r 🌊 q 🌊 xa 🌊 xb 🔢 ia 🔢 ib 🔢 ic 🧐 z 🔢 m[2:3] 🌊 w[2:2] 🌊 h
+👻 soma(🔢 a, 🌊 b, 🔢 c, 🔢 d, 🌊 e, 🔢 f, 🔢 g, 🔢 k, 🔢 l, 🌊 p) : 🔢 {
+    🔢 s 🌊 t
+    t = b + e + p
+    s = a + c + d + f + g + k + l
+    s = s * 10
+    🤔 (t > 4.1) {
+        s = s + 1
+    }
+    🦋 s
+}
+👻 media(🌊 a, 🌊 b) : 🌊 {
+    🌊 s
+    s = (a + b) / 2.0
+    🦋 s
+}
+👻 maior(🔢 a, 🔢 b) : 🧐 {
+    🧐 s
+    s = a > b
+    🦋 s
+}
+👻 enche(🔢 t[2:3], 🔢 v) : 🔢 {
+    🔢 i 🔢 j 🔢 loc[2:3]
+    🧬 (i = 0; i < 2; i = i + 1) {
+        🧬 (j = 0; j < 3; j = j + 1) {
+            loc[i:j] = v * i + j
+        }
+    }
+    🦋 loc
+}
+xa = 3.0
+xb = 4.5
+ia = 1
+ib = 7
+ic = 5
+r = soma(ia, xa, ib, ic, xb, ia, ib, ic, ib, xa)
+q = media(xa, xb)
+z = maior(r, ib)
+m = enche(m, ic)
+w[1:1] = -q
+w[0:1] = q - 1.0 / 3.0
+h = 3.5 - 1.5 * q
@@ -0,0 +1,44 @@
+🔢 total 🌊 media 🧐 par 🔢 m[2:3] 🔢 i 🔢 k
+👻 passo(🔢 x, 🌊 f, 🧐 b) : 🔢 {
+    🔢 y
+    y = x * 3 + 1
+    🤔 (b) {
+        y = y - 1
+    }
+    🦋 y
+}
+👻 acumula(🔢 n) : 🌊 {
+    🌊 s 🔢 j
+    s = 0.0
+    🧬 (j = 0; j < n; j = j + 1) {
+        s = s + 0.5
+        🤔 (s > 1000.0) {
+            s = s - 999.75
+        }
+    }
+    🦋 s
+}
+👻 enche(🔢 t[2:3], 🔢 v) : 🔢 {
+    🔢 i 🔢 j 🔢 r 🔢 loc[2:3]
+    🧬 (r = 0; r < 20000; r = r + 1) {
+        🧬 (i = 0; i < 2; i = i + 1) {
+            🧬 (j = 0; j < 3; j = j + 1) {
+                loc[i:j] = loc[i:j] + t[i:j] + v * i + j + r
+            }
+        }
+    }
+    🦋 loc
+}
+total = 0
+🧬 (i = 0; i < 300000; i = i + 1) {
+    par = i > 100
+    k = passo(i, media, par)
+    total = total + k
+    🤔 (total > 1000000) {
+        total = total - 1000000
+    }
+}
+media = acumula(total)
+m[0:0] = 1
+m[1:2] = 5
+m = enche(m, k)
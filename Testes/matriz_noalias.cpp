@@ -0,0 +1,31 @@
+🔢 refResult[4:4]
+🔢 matA[4:4]
+🔢 matB[4:4]
+🔢 matR[4:4]
+🔢 i
+🔢 j
+
+👻 multiplicaMatriz(🔒 🔢 mat[4:4], 🔢 matAA[4:4], 🔢 matBB[4:4]) : 🔢{
+    🔢 i
+    🔢 j
+    🔢 k
+
+    🧬 ( i = 0 ; i < 4; i = i + 1) {
+        🧬 ( j = 0 ; j < 4; j = j + 1) {
+            🧬 ( k = 0 ; k < 4; k = k + 1) {
+                mat[i:j] = mat[i:j] + matAA[i:k] * matBB[k:j]
+            }
+        }
+    }
+
+    🦋 mat
+}
+
+🧬 ( i = 0 ; i < 4; i = i + 1) {
+    🧬 ( j = 0 ; j < 4; j = j + 1) {
+        matA[i:j] = i * 4 + j + 1
+        matB[i:j] = j - i * 2
+    }
+}
+
+refResult = multiplicaMatriz(matR, matA, matB)
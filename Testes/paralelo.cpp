@@ -0,0 +1,41 @@
+🔢 a[64:64]
+🔢 b[64:64]
+🔢 c[64:64]
+🔢 d[64:64]
+🔢 i 🔢 j 🔢 k 🔢 n
+🔢 s 🔢 ultimo
+
+👻 multiplica(🔒 🔢 r[64:64], 🔢 x[64:64], 🔢 y[64:64]) : 🔢 {
+    🔢 i 🔢 j 🔢 k 🔢 s
+    🧵 (i = 0; i < 64; i = i + 1) {
+        🧬 (j = 0; j < 64; j = j + 1) {
+            s = 0
+            🧬 (k = 0; k < 64; k = k + 1) {
+                s = s + x[i:k] * y[k:j]
+            }
+            r[i:j] = s
+        }
+    }
+    🦋 r
+}
+
+n = 64
+🧵 (i = 0; i < n; i = i + 1) {
+    🧬 (j = 0; j < 64; j = j + 1) {
+        a[i:j] = i * 3 + j
+        b[i:j] = j - i * 2
+    }
+}
+
+🧵 (i = n - 1; i >= 0; i = i - 1) {
+    🧬 (j = 0; j < 64; j = j + 1) {
+        s = 0
+        🧬 (k = 0; k < 64; k = k + 1) {
+            s = s + a[i:k] * b[k:j]
+        }
+        c[i:j] = s
+    }
+    ultimo = c[i:n - 1]
+}
+
+d = multiplica(d, a, b)
@@ -0,0 +1,14 @@
+🔢 x 🔢 n 🔢 acc
+👻 fat(🔢 n, 🔢 acc) : 🔢 {
+    🔢 r 🔢 m 🔢 a
+    r = acc
+    🤔 (n > 1) {
+        m = n - 1
+        a = acc * n
+        r = fat(m, a)
+    }
+    🦋 r
+}
+n = 5
+acc = 1
+x = fat(n, acc)
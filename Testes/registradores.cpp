@@ -0,0 +1,93 @@
+🔢 r 🌊 q 🔢 n
+👻 dobro(🔢 x) : 🔢 {
+    🔢 y
+    y = x * 2
+    🦋 y
+}
+👻 metade(🌊 x) : 🌊 {
+    🌊 y
+    y = x / 2.0
+    🦋 y
+}
+👻 pressao(🔢 n) : 🔢 {
+    🔢 a 🔢 b 🔢 c 🔢 d 🔢 e 🔢 f 🔢 g 🔢 h 🔢 i 🔢 j 🔢 k 🔢 l 🔢 m 🔢 s 🔢 t
+    a = 1
+    b = 2
+    c = 3
+    d = 4
+    e = 5
+    f = 6
+    g = 7
+    h = 8
+    j = 9
+    k = 10
+    l = 11
+    m = 12
+    s = 0
+    🧬 (i = 0; i < n; i = i + 1) {
+        t = dobro(i)
+        s = s + a * t + b - c + d * e - f + g * h - j + k * l - m
+        a = b + 1
+        b = c + 2
+        c = d + 3
+        d = e + 4
+        e = f + 5
+        f = g + 6
+        g = h + 7
+        h = j + 8
+        j = k + 9
+        k = l + 10
+        l = m + 11
+        m = a + 12
+        🤔 (s > 100000) {
+            s = s - 100000
+        }
+    }
+    s = s + a + b + c + d + e + f + g + h + j + k + l + m
+    🦋 s
+}
+👻 reais(🔢 n) : 🌊 {
+    🌊 a 🌊 b 🌊 c 🌊 d 🌊 e 🌊 f 🌊 g 🌊 h 🌊 p 🌊 u 🌊 v 🌊 w 🌊 x 🌊 y 🌊 z 🌊 o 🌊 s 🔢 i
+    a = 1.5
+    b = 2.5
+    c = 3.5
+    d = 4.5
+    e = 5.5
+    f = 6.5
+    g = 7.5
+    h = 8.5
+    p = 9.5
+    u = 10.5
+    v = 11.5
+    w = 12.5
+    x = 13.5
+    y = 14.5
+    z = 15.5
+    o = 16.5
+    s = 0.0
+    🧬 (i = 0; i < n; i = i + 1) {
+        s = metade(s)
+        s = s + a * b - c + d * e - f + g * h - p + u * v - w + x * y - z + o
+        a = b
+        b = c
+        c = d
+        d = e
+        e = f
+        f = g
+        g = h
+        h = p
+        p = u
+        u = v
+        v = w
+        w = x
+        x = y
+        y = z
+        z = o
+        o = a
+    }
+    s = s + a + b + c + d + e + f + g + h + p + u + v + w + x + y + z + o
+    🦋 s
+}
+n = 50
+r = pressao(n)
+q = reais(n)
@@ -0,0 +1,16 @@
+🔢 a[4:4] 🔢 b[4:4] 🔢 s 🔢 i
+👻 produto(🔢 x[4:4], 🔢 y[4:4]) : 🔢 {
+    🔢 r 🔢 j 🔢 k
+    r = 0
+    🧬 (j = 0; j < 4; j = j + 1) {
+        🧬 (k = 0; k < 4; k = k + 1) {
+            x[j:k] = x[j:k] + y[j:k]
+            r = r + x[j:k]
+        }
+    }
+    🦋 r
+}
+🧬 (i = 0; i < 4; i = i + 1) {
+    b[i:i] = i + 1
+}
+s = produto(a, b)
@@ -0,0 +1,150 @@
+#include <map>
+#include "alias.h"
+using std::map;
+using std::vector;
+
+// parâmetros de uma função e arranjos a que cada parâmetro arranjo se refere
+struct Params
+{
+    vector<string> names;
+    map<string, set<string>> arrays;
+    set<string> noalias;
+};
+
+// chamada encontrada na árvore sintática
+struct Site
+{
+    string caller;
+    string callee;
+    vector<string> args;
+};
+
+static map<string, Params> funcs;
+
+// percorre as instruções registrando funções e chamadas
+static void Walk(Statement * s, const string & func, vector<Site> & sites)
+{
+    if (!s)
+        return;
+
+    switch (s->node_type)
+    {
+    case NodeType::SEQ:
+        Walk(((Seq*) s)->stmt, func, sites);
+        Walk(((Seq*) s)->stmts, func, sites);
+        break;
+    case NodeType::IF_STMT:
+        Walk(((If*) s)->stmt, func, sites);
+        break;
+    case NodeType::WHILE_STMT:
+        Walk(((While*) s)->stmt, func, sites);
+        break;
+    case NodeType::DOWHILE_STMT:
+        Walk(((DoWhile*) s)->stmt, func, sites);
+        break;
+    case NodeType::FOR_STMT:
+        Walk(((For*) s)->stmt, func, sites);
+        break;
+    case NodeType::PARFOR_STMT:
+        Walk(((ParallelFor*) s)->stmt, func, sites);
+        break;
+    case NodeType::FUNC_STMT:
+    {
+        Func * f = (Func*) s;
+        Params & p = funcs[f->funcName];
+        p.names = f->paramNames;
+        for (Symbol & l : f->locals)
+        {
+            bool param = false;
+            for (const string & name : f->paramNames)
+                param = param || name == l.var;
+            if (!param || l.valX == -1)
+                continue;
+
+            p.arrays[l.var];
+            if (l.noalias)
+                p.noalias.insert(l.var);
+        }
+        Walk(f->body, f->funcName, sites);
+        break;
+    }
+    case NodeType::FUNC_CALL:
+    {
+        FuncCall * c = (FuncCall*) s;
+        sites.push_back(Site{func, c->function, c->args});
+        break;
+    }
+    }
+}
+
+void AnalyzeAliases(Statement * ast)
+{
+    funcs.clear();
+    vector<Site> sites;
+    Walk(ast, "", sites);
+
+    // propaga os arranjos dos argumentos para os parâmetros até o ponto fixo,
+    // passando por parâmetros repassados de uma função para outra
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (Site & site : sites)
+        {
+            auto callee = funcs.find(site.callee);
+            if (callee == funcs.end())
+                continue;
+
+            Params & p = callee->second;
+            for (int k = 0; k < int(site.args.size()) && k < int(p.names.size()); ++k)
+            {
+                auto param = p.arrays.find(p.names[k]);
+                if (param == p.arrays.end())
+                    continue;
+
+                for (const string & array : PointsTo(site.caller, site.args[k]))
+                    changed = param->second.insert(array).second || changed;
+            }
+        }
+    }
+}
+
+void ShareAliases(const string & func, const string & outer)
+{
+    auto f = funcs.find(outer);
+    if (f != funcs.end())
+        funcs[func] = f->second;
+}
+
+set<string> PointsTo(const string & func, const string & array)
+{
+    auto f = funcs.find(func);
+    if (f != funcs.end())
+    {
+        auto param = f->second.arrays.find(array);
+        if (param != f->second.arrays.end())
+            return param->second;
+    }
+
+    // arranjos declarados são distintos entre si; nomes repetidos em escopos
+    // diferentes são tratados como o mesmo arranjo
+    return {array};
+}
+
+bool MayAlias(const string & func, const string & a, const string & b)
+{
+    if (a == b)
+        return true;
+
+    auto f = funcs.find(func);
+    if (f != funcs.end() && (f->second.noalias.count(a) || f->second.noalias.count(b)))
+        return false;
+
+    set<string> x = PointsTo(func, a);
+    for (const string & array : PointsTo(func, b))
+    {
+        if (x.count(array))
+            return true;
+    }
+    return false;
+}
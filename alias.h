@@ -0,0 +1,25 @@
+#ifndef COMPILER_ALIAS
+#define COMPILER_ALIAS
+
+#include <set>
+#include "ast.h"
+using std::set;
+
+// análise de apelidos entre arranjos: parâmetros arranjo são passados por
+// referência e podem se referir a qualquer arranjo recebido nas chamadas;
+// deve ser feita sobre a árvore sintática inteira antes da geração de código
+void AnalyzeAliases(Statement * ast);
+
+// a função extraída de um laço 🧵 recebe os arranjos da função envolvente
+// com os mesmos nomes, e portanto os mesmos apelidos
+void ShareAliases(const string & func, const string & outer);
+
+// arranjos declarados a que o nome pode se referir na função ("" para o
+// programa principal)
+set<string> PointsTo(const string & func, const string & array);
+
+// verifica se, na função, os arranjos a e b podem ocupar a mesma memória;
+// parâmetros marcados com 🔒 não compartilham memória com nenhum outro arranjo
+bool MayAlias(const string & func, const string & a, const string & b);
+
+#endif
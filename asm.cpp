@@ -0,0 +1,465 @@
+#include <cstring>
+#include <set>
+#include "asm.h"
+using std::endl;
+using std::set;
+
+// ----------
+// Formatting
+// ----------
+
+static const char * names64[] =
+{
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+
+static const char * names32[] =
+{
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"
+};
+
+static const char * names8[] =
+{
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+};
+
+static string RegName(int reg, int size)
+{
+    if (reg >= XMM0)
+        return "%xmm" + std::to_string(reg - XMM0);
+    if (size == 1)
+        return string("%") + names8[reg];
+    if (size == 4)
+        return string("%") + names32[reg];
+    return string("%") + names64[reg];
+}
+
+static const char * CondName(int cond)
+{
+    switch (cond)
+    {
+    case CC_B: return "b";
+    case CC_AE: return "ae";
+    case CC_E: return "e";
+    case CC_NE: return "ne";
+    case CC_BE: return "be";
+    case CC_A: return "a";
+    case CC_P: return "p";
+    case CC_NP: return "np";
+    case CC_L: return "l";
+    case CC_GE: return "ge";
+    case CC_LE: return "le";
+    }
+    return "g";
+}
+
+static string LabelName(const MFunction & f, int64_t label)
+{
+    return ".Lf" + std::to_string(f.chunk) + "_" + std::to_string(label);
+}
+
+// símbolos definidos fora do programa são chamados pela PLT
+static bool External(const string & symbol)
+{
+    return symbol.compare(0, 3, "fn_") != 0 && symbol.compare(0, 3, "tr_") != 0;
+}
+
+static string Operand(const MFunction & f, const MOperand & o, int size)
+{
+    switch (o.kind)
+    {
+    case MOperand::REG:
+        return RegName(o.reg, size);
+    case MOperand::IMM:
+        return "$" + std::to_string(o.imm);
+    case MOperand::LABEL:
+        return LabelName(f, o.imm);
+    case MOperand::SYMBOL:
+        return External(o.symbol) ? o.symbol + "@PLT" : o.symbol;
+    case MOperand::MEM:
+        break;
+    default:
+        return "";
+    }
+
+    if (!o.symbol.empty())
+        return o.symbol + (o.imm ? "+" + std::to_string(o.imm) : "") + "(%rip)";
+    string s = o.imm ? std::to_string(o.imm) : "";
+    s += "(" + RegName(o.reg, 8);
+    if (o.index != NOREG)
+        s += "," + RegName(o.index, 8) + "," + std::to_string(o.scale);
+    return s + ")";
+}
+
+static const char * Suffix(int size)
+{
+    return size == 1 ? "b" : size == 4 ? "l" : "q";
+}
+
+string Format(const MFunction & f, const MInstr & i)
+{
+    static const char * plain[] =
+    {
+        "", "mov", "movzb", "lea", "add", "sub", "imul", "and", "or", "xor",
+        "shl", "sar", "btc", "neg", "cmp", "cltd", "idiv", "set", "cmov",
+        "movsd", "movq", "addsd", "subsd", "mulsd", "divsd", "ucomisd",
+        "cvtsi2sd", "cvttsd2si", "movdqu", "paddd", "psubd", "addpd", "subpd",
+        "mulpd", "divpd", "punpckldq", "punpcklqdq", "push", "pop", "jmp", "j",
+        "call", "leave", "ret"
+    };
+
+    string dst = Operand(f, i.dst, i.size);
+    string src = Operand(f, i.src, i.size);
+    switch (i.op)
+    {
+    case M_LABEL:
+        return LabelName(f, i.dst.imm) + ":";
+    case M_MOVZX:
+        return "\tmovzbl\t" + Operand(f, i.src, 1) + ", " + dst;
+    case M_SHL:
+    case M_SAR:
+        if (i.src.IsReg())
+            src = "%cl";
+        break;
+    case M_CDQ:
+    case M_LEAVE:
+    case M_RET:
+        return string("\t") + plain[i.op];
+    case M_IDIV:
+    case M_NEG:
+    case M_PUSH:
+    case M_POP:
+        return string("\t") + plain[i.op] + Suffix(i.size) + "\t" + dst;
+    case M_SET:
+        return string("\tset") + CondName(i.cond) + "\t" + Operand(f, i.dst, 1);
+    case M_CMOV:
+        return string("\tcmov") + CondName(i.cond) + Suffix(i.size) + "\t" + src + ", " + dst;
+    case M_JMP:
+    case M_CALL:
+        return string("\t") + plain[i.op] + "\t" + dst;
+    case M_JCC:
+        return string("\tj") + CondName(i.cond) + "\t" + dst;
+    case M_MOVQ:
+        if (i.size == 4)
+            return "\tmovd\t" + Operand(f, i.src, 4) + ", " + Operand(f, i.dst, 4);
+        return "\tmovq\t" + Operand(f, i.src, 8) + ", " + Operand(f, i.dst, 8);
+    case M_CVTSI2SD:
+        return "\tcvtsi2sdl\t" + Operand(f, i.src, 4) + ", " + dst;
+    case M_CVTTSD2SI:
+        return "\tcvttsd2si\t" + src + ", " + Operand(f, i.dst, 4);
+    case M_MOVSD:
+    case M_ADDSD:
+    case M_SUBSD:
+    case M_MULSD:
+    case M_DIVSD:
+    case M_UCOMISD:
+    case M_MOVDQU:
+    case M_PADDD:
+    case M_PSUBD:
+    case M_ADDPD:
+    case M_SUBPD:
+    case M_MULPD:
+    case M_DIVPD:
+    case M_PUNPCKLDQ:
+    case M_PUNPCKLQDQ:
+        return string("\t") + plain[i.op] + "\t" + src + ", " + dst;
+    }
+    return string("\t") + plain[i.op] + Suffix(i.size) + "\t" + src + ", " + dst;
+}
+
+// ---------
+// Assembly
+// ---------
+
+// texto entre aspas para .string: caracteres fora do ASCII visível em octal
+static string Quote(const string & text)
+{
+    string s = "\"";
+    for (unsigned char ch : text)
+    {
+        if (ch == '"' || ch == '\\')
+            s += string("\\") + char(ch);
+        else if (ch < 32 || ch > 126)
+        {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\%03o", ch);
+            s += buffer;
+        }
+        else
+            s += char(ch);
+    }
+    return s + "\"";
+}
+
+static void Procedure(const MFunction & f, std::ostream & out)
+{
+    // apenas os rótulos usados por desvios são emitidos
+    set<int64_t> used;
+    for (const MInstr & i : f.code)
+    {
+        if (i.op != M_LABEL && i.dst.kind == MOperand::LABEL)
+            used.insert(i.dst.imm);
+    }
+
+    out << "\t.p2align 4" << endl;
+    out << f.name << ":" << endl;
+    for (const MInstr & i : f.code)
+    {
+        if (i.op == M_LABEL && !used.count(i.dst.imm))
+            continue;
+        out << Format(f, i) << endl;
+    }
+    out << endl;
+}
+
+// rotinas de apoio: erros de execução, laços 🧵 e exibição de arranjos; o
+// programa montado executa os laços 🧵 numa só chamada da ponte, com a
+// faixa inteira de iterações
+//  tr_print_array(elementos, linhas, colunas, banco)
+static const char * runtime = R"(	.p2align 4
+tr_bounds:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	movl	%edi, %esi
+	leaq	.Lmsg_bounds(%rip), %rdi
+	xorl	%eax, %eax
+	call	printf@PLT
+	movl	$1, %edi
+	call	exit@PLT
+
+	.p2align 4
+tr_divzero:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	leaq	.Lmsg_divzero(%rip), %rdi
+	xorl	%eax, %eax
+	call	printf@PLT
+	movl	$1, %edi
+	call	exit@PLT
+
+	.p2align 4
+tr_parallel:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	subq	$16, %rsp
+	movq	%rdi, %rax
+	movq	%rsi, %rdi
+	leaq	-8(%rbp), %rsi
+	call	*%rax
+	movl	-8(%rbp), %eax
+	leave
+	ret
+
+	.p2align 4
+tr_print_array:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	pushq	%r14
+	pushq	%r15
+	subq	$8, %rsp
+	movq	%rdi, %rbx
+	movl	%esi, %r12d
+	movl	%edx, %r13d
+	movl	%ecx, %r14d
+.Lpa_row:
+	testl	%r12d, %r12d
+	jz	.Lpa_done
+	movl	$9, %edi
+	call	putchar@PLT
+	xorl	%r15d, %r15d
+.Lpa_col:
+	cmpl	%r13d, %r15d
+	jge	.Lpa_eol
+	testl	%r15d, %r15d
+	jz	.Lpa_value
+	movl	$32, %edi
+	call	putchar@PLT
+.Lpa_value:
+	cmpl	$1, %r14d
+	je	.Lpa_float
+	cmpl	$2, %r14d
+	je	.Lpa_bool
+	leaq	.Lfmt_d(%rip), %rdi
+	movl	(%rbx), %esi
+	addq	$4, %rbx
+	xorl	%eax, %eax
+	call	printf@PLT
+	jmp	.Lpa_next
+.Lpa_float:
+	leaq	.Lfmt_g(%rip), %rdi
+	movsd	(%rbx), %xmm0
+	addq	$8, %rbx
+	movl	$1, %eax
+	call	printf@PLT
+	jmp	.Lpa_next
+.Lpa_bool:
+	leaq	.Lfmt_s(%rip), %rdi
+	leaq	.Ltrue(%rip), %rsi
+	leaq	.Lfalse(%rip), %rax
+	cmpb	$0, (%rbx)
+	cmove	%rax, %rsi
+	addq	$1, %rbx
+	xorl	%eax, %eax
+	call	printf@PLT
+.Lpa_next:
+	addl	$1, %r15d
+	jmp	.Lpa_col
+.Lpa_eol:
+	movl	$10, %edi
+	call	putchar@PLT
+	subl	$1, %r12d
+	jmp	.Lpa_row
+.Lpa_done:
+	leaq	-40(%rbp), %rsp
+	popq	%r15
+	popq	%r14
+	popq	%r13
+	popq	%r12
+	popq	%rbx
+	popq	%rbp
+	ret
+
+)";
+
+// main: executa o programa e exibe as variáveis globais declaradas (nomes
+// com '_' foram criados pelo compilador)
+static void Main(Module & m, std::ostream & out)
+{
+    out << "\t.globl\tmain" << endl;
+    out << "\t.p2align 4" << endl;
+    out << "main:" << endl;
+    out << "\tpushq\t%rbp" << endl;
+    out << "\tmovq\t%rsp, %rbp" << endl;
+    out << "\tcall\ttr_main" << endl;
+
+    for (int k = 0; k < int(m.vars.size()); ++k)
+    {
+        GlobalDecl & g = m.vars[k];
+        if (g.name.find('_') != string::npos)
+            continue;
+
+        string value = GlobalSymbol(g.bank, g.slot) + "(%rip)";
+        out << "\tleaq\t.Lname" << k << "(%rip), %rsi" << endl;
+        if (g.bank == BANK_INT)
+        {
+            out << "\tleaq\t.Lfmt_int(%rip), %rdi" << endl;
+            out << "\tmovl\t" << value << ", %edx" << endl;
+            out << "\txorl\t%eax, %eax" << endl;
+        }
+        else if (g.bank == BANK_FLOAT)
+        {
+            out << "\tleaq\t.Lfmt_float(%rip), %rdi" << endl;
+            out << "\tmovsd\t" << value << ", %xmm0" << endl;
+            out << "\tmovl\t$1, %eax" << endl;
+        }
+        else
+        {
+            out << "\tleaq\t.Lfmt_bool(%rip), %rdi" << endl;
+            out << "\tleaq\t.Ltrue(%rip), %rdx" << endl;
+            out << "\tleaq\t.Lfalse(%rip), %rax" << endl;
+            out << "\tcmpb\t$0, " << value << endl;
+            out << "\tcmove\t%rax, %rdx" << endl;
+            out << "\txorl\t%eax, %eax" << endl;
+        }
+        out << "\tcall\tprintf@PLT" << endl;
+    }
+
+    for (int k = 0; k < int(m.arrays.size()); ++k)
+    {
+        ArrayDecl & a = m.arrays[k];
+        if (a.name.find('_') != string::npos)
+            continue;
+
+        out << "\tleaq\t.Lfmt_array(%rip), %rdi" << endl;
+        out << "\tleaq\t.Larray" << k << "(%rip), %rsi" << endl;
+        out << "\txorl\t%eax, %eax" << endl;
+        out << "\tcall\tprintf@PLT" << endl;
+        out << "\tleaq\t" << GlobalSymbol(BANK_ARRAY, a.slot) << "(%rip), %rdi" << endl;
+        out << "\tmovl\t$" << a.rows << ", %esi" << endl;
+        out << "\tmovl\t$" << a.cols << ", %edx" << endl;
+        out << "\tmovl\t$" << a.bank << ", %ecx" << endl;
+        out << "\tcall\ttr_print_array" << endl;
+    }
+
+    out << "\txorl\t%eax, %eax" << endl;
+    out << "\tpopq\t%rbp" << endl;
+    out << "\tret" << endl;
+    out << endl;
+}
+
+static void Data(Module & m, std::ostream & out)
+{
+    out << "\t.data" << endl;
+    for (GlobalDecl & g : m.vars)
+    {
+        int bytes = ElementBytes(g.bank);
+        out << "\t.p2align " << (bytes == 8 ? 3 : bytes == 4 ? 2 : 0) << endl;
+        out << GlobalSymbol(g.bank, g.slot) << ":" << endl;
+        out << "\t.zero\t" << bytes << endl;
+    }
+
+    // arranjos em ordem de linhas, alinhados, precedidos pelo cabeçalho
+    for (ArrayDecl & a : m.arrays)
+    {
+        int count = a.rows * a.cols;
+        out << "\t.p2align 5" << endl;
+        out << "\t.zero\t" << ArrayAlign - ArrayHeader << endl;
+        out << "\t.long\t" << count << ", " << ElementBytes(a.bank) << endl;
+        out << GlobalSymbol(BANK_ARRAY, a.slot) << ":" << endl;
+        out << "\t.zero\t" << std::max(count * ElementBytes(a.bank), 1) << endl;
+    }
+    out << endl;
+
+    out << "\t.section\t.rodata" << endl;
+    out << "\t.p2align 3" << endl;
+    for (int c = 0; c < int(m.chunks.size()); ++c)
+    {
+        for (int k = 0; k < int(m.chunks[c].floats.size()); ++k)
+        {
+            uint64_t bits;
+            memcpy(&bits, &m.chunks[c].floats[k], sizeof(bits));
+            out << ConstSymbol(c, k) << ":" << endl;
+            out << "\t.quad\t" << bits << endl;
+        }
+    }
+    for (int k = 0; k < int(m.vars.size()); ++k)
+        out << ".Lname" << k << ":\t.string\t" << Quote(m.vars[k].name) << endl;
+    for (int k = 0; k < int(m.arrays.size()); ++k)
+        out << ".Larray" << k << ":\t.string\t" << Quote(m.arrays[k].name) << endl;
+
+    out << ".Lfmt_int:\t.string\t\"%s = %d\\n\"" << endl;
+    out << ".Lfmt_float:\t.string\t\"%s = %g\\n\"" << endl;
+    out << ".Lfmt_bool:\t.string\t\"%s = %s\\n\"" << endl;
+    out << ".Lfmt_array:\t.string\t\"%s =\\n\"" << endl;
+    out << ".Lfmt_d:\t.string\t\"%d\"" << endl;
+    out << ".Lfmt_g:\t.string\t\"%g\"" << endl;
+    out << ".Lfmt_s:\t.string\t\"%s\"" << endl;
+    out << ".Ltrue:\t.string\t\"true\"" << endl;
+    out << ".Lfalse:\t.string\t\"false\"" << endl;
+    out << ".Lmsg_bounds:\t.string\t" << Quote("Erro de execução: índice %d fora dos limites do arranjo\n") << endl;
+    out << ".Lmsg_divzero:\t.string\t" << Quote("Erro de execução: divisão por zero\n") << endl;
+    out << endl;
+    out << "\t.section\t.note.GNU-stack,\"\",@progbits" << endl;
+}
+
+void EmitAssembly(Program * p, std::ostream & out)
+{
+    Module module = Lower(p);
+
+    out << "\t.text" << endl;
+    for (int c = 0; c < int(module.chunks.size()); ++c)
+    {
+        Procedure(Select(module, c), out);
+        if (module.chunks[c].parallel)
+            Procedure(Bridge(module, c), out);
+    }
+    out << runtime;
+    Main(module, out);
+    Data(module, out);
+}
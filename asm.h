@@ -0,0 +1,16 @@
+#ifndef COMPILER_ASM
+#define COMPILER_ASM
+
+#include <iostream>
+#include "ir.h"
+#include "x86.h"
+
+// instrução de máquina na sintaxe AT&T do montador GNU
+string Format(const MFunction & f, const MInstr & i);
+
+// programa completo em assembly x86-64 (System V): um procedimento por
+// função, dados globais e um main que executa o programa e exibe o estado
+// final das variáveis, como a máquina virtual
+void EmitAssembly(Program * p, std::ostream & out);
+
+#endif
@@ -2,12 +2,19 @@
 #include <sstream>
 #include "ast.h"
 #include "error.h"
+#include "fusion.h"
 #include "gen.h"
-using std::cout;
-using std::endl;
+#include "ir.h"
+#include "nest.h"
+#include "options.h"
+#include "parallel.h"
+#include "scev.h"
+#include "vectorizer.h"
 using std::stringstream;
 
 extern Lexer *scanner;
+extern Program *program;
+extern Options options;
 
 // ----
 // Node
@@ -147,13 +154,15 @@ Identifier::Identifier(int etype, Token *t) :
 Access::Access(int etype, Token *t, Expression *i, Expression *e) : 
     Expression(NodeType::ACCESS, etype, t), 
     id(i), 
-    indexX(e) 
+    indexX(e),
+    indexY(nullptr),
+    stride(0)
 {
 
 }
 
-Access::Access(int etype, Token *t, Expression *i, Expression *e1, Expression *e2)
-    : Expression(NodeType::ACCESS, etype, t), id(i), indexX(e1), indexY(e2)
+Access::Access(int etype, Token *t, Expression *i, Expression *e1, Expression *e2, int s)
+    : Expression(NodeType::ACCESS, etype, t), id(i), indexX(e1), indexY(e2), stride(s)
 {
 
 }
@@ -273,10 +282,30 @@ Seq::Seq(Statement *s, Statement *ss) :
 
 void Seq::Gen()
 {
-    stmt->Gen();
+    // laços 🧬 adjacentes com o mesmo espaço de iterações são fundidos
+    Statement * first = stmt;
+    Statement * rest = stmts;
+    while (options.level >= 2 && first->node_type == NodeType::FOR_STMT && rest)
+    {
+        Statement * next = rest;
+        Statement * after = nullptr;
+        if (rest->node_type == NodeType::SEQ)
+        {
+            next = ((Seq*) rest)->stmt;
+            after = ((Seq*) rest)->stmts;
+        }
+
+        For * fused = (next->node_type == NodeType::FOR_STMT) ? Fuse((For*) first, (For*) next) : nullptr;
+        if (!fused)
+            break;
+        first = fused;
+        rest = after;
+    }
 
-    if (stmts)
-        stmts->Gen();
+    first->Gen();
+
+    if (rest)
+        rest->Gen();
 }
 
 // ------
@@ -303,7 +332,23 @@ void Assign::Gen()
 { 
     Expression * left = Lvalue(id);
     Expression * right = Rvalue(expr);
-    cout << '\t' << left->ToString() << " = " << right->ToString() << endl;
+
+    if (left->node_type == NodeType::ACCESS)
+    {
+        Access * acc = (Access*) left;
+        if (acc->indexY)
+        {
+            EmitStore(acc->id->ToString(), Operand(acc->indexX), Operand(acc->indexY), acc->stride, Operand(right));
+        }
+        else
+        {
+            EmitStore(acc->id->ToString(), Operand(acc->indexX), Operand(), 0, Operand(right));
+        }
+    }
+    else
+    {
+        EmitCopy(Operand(left), Operand(right));
+    }
 }
 
 // ----
@@ -329,10 +374,9 @@ If::If(Expression *e, Statement *s) :
 
 void If::Gen()
 {
-    Expression * n = Rvalue(expr);
-    cout << "\tifFalse " << n->ToString() << " goto L" << after << endl;
+    Jumping(expr, 0, after);
     stmt->Gen();
-    cout << 'L' << after << ':' << endl;
+    EmitLabel(after);
 }
 
 // -----
@@ -348,14 +392,23 @@ While::While(Expression *e, Statement *s) :
     after = NewLabel();
 }
 
+// laço rotacionado: o teste de entrada protege um laço testado no fim,
+// com um único desvio condicional por iteração
 void While::Gen()
 {
-    cout << 'L' << before << ':' << endl;
-    Expression * n = Rvalue(expr);
-    cout << "\tifFalse " << n->ToString() << " goto L" << after << endl;
+    // laços que apenas acumulam recorrências são trocados pelo valor final
+    Statement * closed = (options.level >= 2) ? ClosedForm(this) : nullptr;
+    if (closed)
+    {
+        closed->Gen();
+        return;
+    }
+
+    Jumping(expr, 0, after);
+    EmitLabel(before);
     stmt->Gen();
-    cout << "\tgoto L" << before << endl;
-    cout << 'L' << after << ':' << endl;     
+    Jumping(expr, before, 0);
+    EmitLabel(after);
 }
 
 // --------
@@ -373,10 +426,9 @@ DoWhile::DoWhile(Statement *s, Expression *e) :
 
 void DoWhile::Gen()
 {
-    cout << 'L' << before << ':' << endl;
+    EmitLabel(before);
     stmt->Gen();
-    Expression * n = Rvalue(expr);
-    cout << "\tifTrue " << n->ToString() << " goto L" << before << endl;
+    Jumping(expr, before, 0);
 }
 
 // --------
@@ -388,52 +440,186 @@ For::For(Assign *init, Expression *condition, Assign *increment, Statement *s) :
     for_init(init),
     for_condition(condition),
     for_increment(increment),
-    stmt(s)
+    stmt(s),
+    optimized(false),
+    blocks(false)
 {
     before = NewLabel();
     after = NewLabel();
 }
 
+// reconhece laços da forma 🧬 (i = a; i op b; i = i ± c) com constantes
+// inteiras e calcula o número de iterações simulando o contador
+bool For::Counted(CountedLoop & loop)
+{
+    Expression * id = for_init->id;
+    if (id->node_type != NodeType::IDENTIFIER || id->type != ExprType::INT
+        || for_init->expr->node_type != NodeType::CONSTANT)
+        return false;
+    string var = id->ToString();
+
+    if (for_condition->node_type != NodeType::REL)
+        return false;
+    Relational * cond = (Relational*) for_condition;
+    if (cond->expr1->node_type != NodeType::IDENTIFIER || cond->expr1->ToString() != var
+        || cond->expr2->node_type != NodeType::CONSTANT)
+        return false;
+
+    if (for_increment->id->ToString() != var || for_increment->expr->node_type != NodeType::ARI)
+        return false;
+    Arithmetic * inc = (Arithmetic*) for_increment->expr;
+    if ((inc->token->tag != '+' && inc->token->tag != '-')
+        || inc->expr1->node_type != NodeType::IDENTIFIER || inc->expr1->ToString() != var
+        || inc->expr2->node_type != NodeType::CONSTANT)
+        return false;
+
+    long long value = std::stoll(for_init->expr->ToString());
+    long long limit = std::stoll(cond->expr2->ToString());
+    long long step = std::stoll(inc->expr2->ToString());
+    if (inc->token->tag == '-')
+        step = -step;
+
+    auto test = [&](long long v)
+    {
+        switch (cond->token->tag)
+        {
+        case '<': return v < limit;
+        case '>': return v > limit;
+        case Tag::LTE: return v <= limit;
+        case Tag::GTE: return v >= limit;
+        case Tag::EQ: return v == limit;
+        case Tag::NEQ: return v != limit;
+        default: return false;
+        }
+    };
+
+    // laços longos demais (ou infinitos) não são considerados contados
+    const long long maximum = 1 << 20;
+    long long trips = 0;
+    for (long long v = value; test(v); v += step)
+    {
+        if (++trips > maximum)
+            return false;
+    }
+
+    loop.before = before;
+    loop.step = 0;
+    loop.after = after;
+    loop.var = var;
+    loop.init = value;
+    loop.inc = step;
+    loop.trips = trips;
+    return true;
+}
+
 void For::Gen(){
 
+    // laços que apenas acumulam recorrências são trocados pelo valor final
+    Statement * closed = (options.level >= 2) ? ClosedForm(this) : nullptr;
+    if (closed)
+    {
+        closed->Gen();
+        return;
+    }
+
+    // ninhos de laços são reordenados e divididos em blocos antes da geração
+    if (options.level >= 2 && !optimized)
+    {
+        Statement * nest = OptimizeNest(this, options.tile);
+        if (nest)
+        {
+            nest->Gen();
+            return;
+        }
+    }
+
+    // laços internos sobre elementos consecutivos usam operações vetoriais
+    if (options.level >= 2 && options.vectorWidth > 1 && Vectorize(this, options.vectorWidth, options.vectorReport))
+        return;
+
     for_init->Gen();
 
-    cout << 'L' << before << ':' << endl;
-    Expression * n = Rvalue(for_condition);
-    cout << "\tifFalse " << n->ToString() << " goto L" << after << endl;
+    // laço contado: a primeira iteração é certa e o teste de entrada é
+    // dispensado; os rótulos permitem ao otimizador desenrolar o laço
+    CountedLoop counted;
+    if (options.level >= 2 && Counted(counted))
+    {
+        if (counted.trips == 0)
+            return;
+
+        counted.step = NewLabel();
+        EmitLabel(before);
+        stmt->Gen();
+        EmitLabel(counted.step);
+        for_increment->Gen();
+        Jumping(for_condition, before, 0);
+        EmitLabel(after);
+        if (!blocks)
+            program->current->counted.push_back(counted);
+        return;
+    }
+
+    // laço rotacionado, como em While::Gen
+    Jumping(for_condition, 0, after);
+    EmitLabel(before);
     stmt->Gen();
-    Expression *inc_reg = Rvalue(for_increment->expr);  //Registrador que guarda o incremento
-    cout << "\t" << for_increment->id->ToString() << " = " <<  inc_reg->ToString() << endl;
-    cout << "\tgoto L" << before << endl;
-    cout << 'L' << after << ':' << endl;     
+    for_increment->Gen();
+    Jumping(for_condition, before, 0);
+    EmitLabel(after);
+}
+
+// -----------
+// ParallelFor
+// -----------
+
+ParallelFor::ParallelFor(Assign *init, Expression *condition, Assign *increment, Statement *s, bool t, int l) :
+    Statement(NodeType::PARFOR_STMT),
+    for_init(init),
+    for_condition(condition),
+    for_increment(increment),
+    stmt(s),
+    trusted(t),
+    line(l)
+{
+
+}
+
+void ParallelFor::Gen()
+{
+    Parallelize(this);
 }
 
 // --------
 // Func
 // --------
-Func::Func(std::string funcName, int returnType, std::vector<string> paramTypes, std::vector<string> paramNames, Statement *body, string ret) : 
+Func::Func(std::string funcName, int returnType, std::vector<string> paramTypes, std::vector<string> paramNames, std::vector<Symbol> locals, Statement *body, string ret) : 
     Statement(NodeType::FUNC_STMT),
     stmt(body),
     funcName(funcName), 
     returnType(returnType), 
     paramTypes(paramTypes), 
     paramNames(paramNames), 
+    locals(locals),
     body(body), 
     ret(ret)
 {
     after = NewLabel();
 }
 void Func::Gen(){
-    std::cout << funcName << ":" << endl;
-        // Declaração dos parâmetros
+    // o código da função é emitido à parte do código envolvente
+    Function * saved = program->Begin(funcName);
+    program->current->ret = ret;
+    program->current->params = paramNames;
+    program->current->locals = locals;
+
     // Corpo da função
     stmt->Gen();
-    cout << "\t" << "return" << " " << ret << endl;
-    cout << "\t" << endl;
+    EmitReturn(Operand(OPD_VAR, ExprType::VOID, ret));
+    program->End(saved);
 }
 //, std::vector<string> arguments
 FuncCall::FuncCall(string function, std::vector<string> arguments, std::string ret)
-    : Statement(NodeType::FUNC_STMT),
+    : Statement(NodeType::FUNC_CALL),
       function(function),
       args(arguments),
       ret(ret)
@@ -444,7 +630,7 @@ FuncCall::FuncCall(string function, std::vector<string> arguments, std::string r
 void FuncCall::Gen(){
         // Gera código intermediário para a chamada da função
     for (size_t i = 0; i < args.size(); ++i) {
-        cout << "\t" << "param " << args[i] << std::endl;
+        EmitParam(Operand(OPD_VAR, ExprType::VOID, args[i]));
     }
-    cout << "\t"<< ret << " = call " << function<< std::endl;
+    EmitCall(Operand(OPD_VAR, ExprType::VOID, ret), function);
 }
\ No newline at end of file
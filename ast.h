@@ -3,6 +3,9 @@
 #define COMPILER_AST
 #include <vector>
 #include "lexer.h"
+#include "symtable.h"
+
+struct CountedLoop;
 
 enum NodeType
 {
@@ -24,7 +27,8 @@ enum NodeType
     FOR_STMT,
     FUNC_STMT,
     TEMP,
-    FUNC_CALL
+    FUNC_CALL,
+    PARFOR_STMT
 };
 
 enum ExprType
@@ -87,8 +91,9 @@ struct Access : public Expression
     Expression * id;
     Expression * indexX;
     Expression * indexY;
+    int stride;                 // tamanho da linha em arranjos bidimensionais
     Access(int etype, Token * t, Expression * i, Expression * e);
-    Access(int etype, Token *t, Expression *i, Expression *e1, Expression *e2);
+    Access(int etype, Token *t, Expression *i, Expression *e1, Expression *e2, int s);
     string ToString();
 };
 
@@ -162,7 +167,23 @@ struct For : public Statement
     Expression *for_condition;
     Assign *for_increment;
     Statement *stmt;
+    bool optimized;             // ninho já reordenado pelo otimizador
+    bool blocks;                // percorre os blocos de um ninho dividido; não é desenrolado
     For(Assign *init, Expression *condition, Assign *increment, Statement *s);
+    bool Counted(CountedLoop & loop);
+    void Gen();
+};
+
+// laço 🧵: como o 🧬, mas com as iterações divididas entre threads
+struct ParallelFor : public Statement
+{
+    Assign *for_init;
+    Expression *for_condition;
+    Assign *for_increment;
+    Statement *stmt;
+    bool trusted;               // 🔒: independência garantida pelo programador
+    int line;                   // linha do cabeçalho, para os erros da verificação
+    ParallelFor(Assign *init, Expression *condition, Assign *increment, Statement *s, bool t, int l);
     void Gen();
 };
 
@@ -184,11 +205,12 @@ struct Func : public Statement
 
     std::vector<string> paramTypes;
     std::vector<string> paramNames;
+    std::vector<Symbol> locals;     // parâmetros e variáveis locais
 
     Statement *body;
     Statement *stmt;
     Expression *expr;
-    Func(std::string funcName, int returnType, std::vector<string> paramTypes, std::vector<string> paramNames, Statement *body, string ret);
+    Func(std::string funcName, int returnType, std::vector<string> paramTypes, std::vector<string> paramNames, std::vector<Symbol> locals, Statement *body, string ret);
     void Gen();
 };
 struct FuncCall : public Statement {
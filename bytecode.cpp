@@ -0,0 +1,685 @@
+#include <map>
+#include "bytecode.h"
+#include "error.h"
+using std::map;
+
+const char * OpNames[OP_COUNT] =
+{
+#define OPCODE_NAME(name) #name,
+    OPCODES(OPCODE_NAME)
+#undef OPCODE_NAME
+};
+
+// ----------------------
+// Operandos das instruções
+// ----------------------
+
+static int Suffix(int op, int first)
+{
+    return op - first;
+}
+
+int Generic(int op)
+{
+    switch (op)
+    {
+    case OP_MOV_I_L: return OP_MOV_I;
+    case OP_MOV_F_L: return OP_MOV_F;
+    case OP_ADD_I_L: case OP_ADD_I_LK: return OP_ADD_I;
+    case OP_SUB_I_L: case OP_SUB_I_LK: return OP_SUB_I;
+    case OP_MUL_I_L: case OP_MUL_I_LK: return OP_MUL_I;
+    case OP_ADD_F_L: return OP_ADD_F;
+    case OP_SUB_F_L: return OP_SUB_F;
+    case OP_MUL_F_L: return OP_MUL_F;
+    }
+    return op;
+}
+
+vector<Role> Roles(const Instr & i)
+{
+    int op = Generic(i.op);
+    if (op >= OP_MOV_I && op <= OP_MOV_B)
+        return {{0, Suffix(op, OP_MOV_I), true}, {1, Suffix(op, OP_MOV_I), false}};
+    if (op == OP_I2F)
+        return {{0, BANK_FLOAT, true}, {1, BANK_INT, false}};
+    if (op == OP_F2I)
+        return {{0, BANK_INT, true}, {1, BANK_FLOAT, false}};
+    if (op >= OP_ADD_I && op <= OP_AND_I)
+        return {{0, BANK_INT, true}, {1, BANK_INT, false}, {2, BANK_INT, false}};
+    if (op >= OP_ADD_F && op <= OP_DIV_F)
+        return {{0, BANK_FLOAT, true}, {1, BANK_FLOAT, false}, {2, BANK_FLOAT, false}};
+    if (op == OP_AND_B || op == OP_OR_B || op == OP_EQ_B || op == OP_NE_B)
+        return {{0, BANK_BOOL, true}, {1, BANK_BOOL, false}, {2, BANK_BOOL, false}};
+    if (op >= OP_LT_I && op <= OP_NE_I)
+        return {{0, BANK_BOOL, true}, {1, BANK_INT, false}, {2, BANK_INT, false}};
+    if (op >= OP_LT_F && op <= OP_NE_F)
+        return {{0, BANK_BOOL, true}, {1, BANK_FLOAT, false}, {2, BANK_FLOAT, false}};
+    if (op == OP_NEG_I)
+        return {{0, BANK_INT, true}, {1, BANK_INT, false}};
+    if (op == OP_NEG_F)
+        return {{0, BANK_FLOAT, true}, {1, BANK_FLOAT, false}};
+    if (op == OP_NOT_B)
+        return {{0, BANK_BOOL, true}, {1, BANK_BOOL, false}};
+    if (op >= OP_LOAD_I && op <= OP_LOAD_B)
+        return {{0, Suffix(op, OP_LOAD_I), true}, {1, BANK_ARRAY, false}, {2, BANK_INT, false}};
+    if (op >= OP_STORE_I && op <= OP_STORE_B)
+        return {{0, BANK_ARRAY, false}, {1, BANK_INT, false}, {2, Suffix(op, OP_STORE_I), false}};
+    if (op >= OP_SEL_I && op <= OP_SEL_B)
+    {
+        int bank = Suffix(op, OP_SEL_I);
+        return {{0, bank, true}, {1, BANK_BOOL, false}, {2, bank, false}, {3, bank, false}};
+    }
+    if (op == OP_JF || op == OP_JT)
+        return {{1, BANK_BOOL, false}};
+    if (op >= OP_PARAM_I && op <= OP_PARAM_A)
+        return {{0, Suffix(op, OP_PARAM_I), false}};
+    if (op >= OP_CALL_I && op <= OP_CALL_A)
+        return {{0, Suffix(op, OP_CALL_I), op != OP_CALL_A}};
+    if (op >= OP_RET_I && op <= OP_RET_A)
+        return {{0, Suffix(op, OP_RET_I), false}};
+    if (op >= OP_LOADX_I && op <= OP_LOADX_B)
+        return {{0, Suffix(op, OP_LOADX_I), true}, {1, BANK_ARRAY, false}, {2, BANK_INT, false}, {3, BANK_INT, false}};
+    if (op >= OP_STOREX_I && op <= OP_STOREX_B)
+        return {{0, BANK_ARRAY, false}, {1, BANK_INT, false}, {2, Suffix(op, OP_STOREX_I), false}, {3, BANK_INT, false}};
+    if (op >= OP_JLT_I && op <= OP_JNE_I)
+        return {{1, BANK_INT, false}, {2, BANK_INT, false}};
+    if (op == OP_LOOPLT_I || op == OP_LOOPNE_I)
+        return {{1, BANK_INT, true}, {1, BANK_INT, false}, {2, BANK_INT, false}, {3, BANK_INT, false}};
+
+    int lanes = int(i.e);
+    if (op == OP_VLOAD_I || op == OP_VLOAD_F)
+        return {{0, Suffix(op, OP_VLOAD_I), true, lanes}, {1, BANK_ARRAY, false}, {2, BANK_INT, false}};
+    if (op == OP_VSTORE_I || op == OP_VSTORE_F)
+        return {{0, BANK_ARRAY, false}, {1, BANK_INT, false}, {2, Suffix(op, OP_VSTORE_I), false, lanes}};
+    if (op == OP_VSPLAT_I || op == OP_VSPLAT_F)
+        return {{0, Suffix(op, OP_VSPLAT_I), true, lanes}, {1, Suffix(op, OP_VSPLAT_I), false}};
+    if (op >= OP_VADD_I && op <= OP_VMUL_I)
+        return {{0, BANK_INT, true, lanes}, {1, BANK_INT, false, lanes}, {2, BANK_INT, false, lanes}};
+    if (op >= OP_VADD_F && op <= OP_VDIV_F)
+        return {{0, BANK_FLOAT, true, lanes}, {1, BANK_FLOAT, false, lanes}, {2, BANK_FLOAT, false, lanes}};
+    return {};
+}
+
+uint32_t Field(const Instr & i, int field)
+{
+    const uint32_t fields[] = {i.a, i.b, i.c, i.d};
+    return fields[field];
+}
+
+bool IsBranch(int op)
+{
+    return op == OP_JMP || op == OP_JF || op == OP_JT || (op >= OP_JLT_I && op <= OP_LOOPNE_I);
+}
+
+// banco correspondente ao tipo de uma expressão
+static int BankOf(int type)
+{
+    if (type == ExprType::FLOAT)
+        return BANK_FLOAT;
+    if (type == ExprType::BOOL)
+        return BANK_BOOL;
+    return BANK_INT;
+}
+
+// operações binárias por banco dos operandos (OP_COUNT: não existe)
+struct BinaryOps
+{
+    const char * oper;
+    int ops[3];
+};
+
+static const BinaryOps binaryOps[] =
+{
+    {"+",  {OP_ADD_I, OP_ADD_F, OP_COUNT}},
+    {"-",  {OP_SUB_I, OP_SUB_F, OP_COUNT}},
+    {"*",  {OP_MUL_I, OP_MUL_F, OP_COUNT}},
+    {"/",  {OP_DIV_I, OP_DIV_F, OP_COUNT}},
+    {"<<", {OP_SHL_I, OP_COUNT, OP_COUNT}},
+    {">>", {OP_SHR_I, OP_COUNT, OP_COUNT}},
+    {"&",  {OP_AND_I, OP_COUNT, OP_COUNT}},
+    {"&&", {OP_COUNT, OP_COUNT, OP_AND_B}},
+    {"||", {OP_COUNT, OP_COUNT, OP_OR_B}},
+    {"<",  {OP_LT_I, OP_LT_F, OP_COUNT}},
+    {"<=", {OP_LE_I, OP_LE_F, OP_COUNT}},
+    {">",  {OP_GT_I, OP_GT_F, OP_COUNT}},
+    {">=", {OP_GE_I, OP_GE_F, OP_COUNT}},
+    {"==", {OP_EQ_I, OP_EQ_F, OP_EQ_B}},
+    {"!=", {OP_NE_I, OP_NE_F, OP_NE_B}},
+};
+
+// operações vetoriais; a divisão de inteiros (OP_DIV_I) é feita elemento a
+// elemento
+static const BinaryOps vectorOps[] =
+{
+    {"+", {OP_VADD_I, OP_VADD_F, OP_COUNT}},
+    {"-", {OP_VSUB_I, OP_VSUB_F, OP_COUNT}},
+    {"*", {OP_VMUL_I, OP_VMUL_F, OP_COUNT}},
+    {"/", {OP_DIV_I, OP_VDIV_F, OP_COUNT}},
+};
+
+// --------
+// Lowering
+// --------
+
+// tradução de uma função: nomes são associados a registradores do banco do
+// seu tipo; vetores ocupam registradores consecutivos, um por elemento
+class Lowering
+{
+private:
+    Program * program;
+    Module & module;
+    Function * func;
+    Chunk * chunk;
+    map<string, uint32_t> locals[BANK_COUNT];
+    map<string, uint32_t> globals[BANK_COUNT];
+    map<unsigned, uint32_t> labels;
+    vector<Quad> params;
+    int scratch = 0;
+
+    Symbol * Lookup(const string & name, bool & global);
+    int Natural(const Operand & o);
+    uint32_t Local(const string & name, int bank);
+    uint32_t Scratch(int bank);
+    uint32_t Const(const Operand & o, int bank);
+    uint32_t Use(const Operand & o, int bank);
+    uint32_t Def(const Operand & o);
+    uint32_t Lanes(const string & name, int bank, int lanes);
+    uint32_t Vector(const Operand & o, int bank, int lanes);
+    uint32_t ArrayRef(const string & name);
+    int Element(const string & name);
+    uint32_t Address(Quad & q);
+    void Emit(int op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0, uint32_t e = 0);
+    void Convert(uint32_t dst, int to, uint32_t src, int from);
+    void Binary(Quad & q);
+    void Call(Quad & q);
+    void Translate(Quad & q);
+
+public:
+    Lowering(Program * p, Module & m);
+    void Globals();
+    void Translate(Function * f, Chunk & c);
+};
+
+Lowering::Lowering(Program * p, Module & m) :
+    program(p),
+    module(m)
+{
+
+}
+
+// declaração visível do nome; global indica se pertence ao programa principal
+Symbol * Lowering::Lookup(const string & name, bool & global)
+{
+    Function * main = program->Main();
+    Symbol * s = (func != main) ? func->Local(name) : nullptr;
+    global = !s;
+    return s ? s : main->Local(name);
+}
+
+// banco em que o operando vive, pelo tipo declarado das variáveis
+int Lowering::Natural(const Operand & o)
+{
+    bool global;
+    Symbol * s = o.IsVar() ? Lookup(o.name, global) : nullptr;
+    if (s)
+        return (s->valX != -1) ? BANK_ARRAY : BankOf(TypeOf(s->type));
+    return BankOf(o.type);
+}
+
+uint32_t Lowering::Local(const string & name, int bank)
+{
+    auto found = locals[bank].find(name);
+    if (found != locals[bank].end())
+        return found->second;
+
+    uint32_t index = chunk->regs[bank]++;
+    locals[bank][name] = Ref(SPACE_LOCAL, index);
+    return Ref(SPACE_LOCAL, index);
+}
+
+// registrador auxiliar para endereços e conversões
+uint32_t Lowering::Scratch(int bank)
+{
+    return Local("#" + std::to_string(++scratch), bank);
+}
+
+uint32_t Lowering::Const(const Operand & o, int bank)
+{
+    int from = BankOf(o.type);
+    if (bank == BANK_FLOAT)
+    {
+        chunk->floats.push_back(std::stod(o.name));
+        return Ref(SPACE_CONST, chunk->floats.size() - 1);
+    }
+    if (bank == BANK_BOOL)
+    {
+        chunk->bools.push_back(o.name == "true");
+        return Ref(SPACE_CONST, chunk->bools.size() - 1);
+    }
+    chunk->ints.push_back(from == BANK_FLOAT ? int32_t(std::stod(o.name)) : int32_t(std::stoll(o.name)));
+    return Ref(SPACE_CONST, chunk->ints.size() - 1);
+}
+
+// operando lido no banco indicado, convertido se necessário
+uint32_t Lowering::Use(const Operand & o, int bank)
+{
+    if (o.IsConst())
+        return Const(o, bank);
+
+    int from = Natural(o);
+    uint32_t src = Def(o);
+    if (from == bank)
+        return src;
+
+    uint32_t dst = Scratch(bank);
+    Convert(dst, bank, src, from);
+    return dst;
+}
+
+// registrador de um temporário ou variável
+uint32_t Lowering::Def(const Operand & o)
+{
+    int bank = Natural(o);
+    if (o.IsTemp())
+        return Local(o.name, bank);
+
+    bool global = false;
+    Symbol * s = Lookup(o.name, global);
+    if (s && global)
+        return globals[bank].at(o.name);
+    return Local(o.name, bank);
+}
+
+// primeiro dos registradores consecutivos de um vetor, reservados no
+// primeiro uso do nome
+uint32_t Lowering::Lanes(const string & name, int bank, int lanes)
+{
+    if (bank != BANK_INT && bank != BANK_FLOAT)
+        throw RuntimeError{"vetor de valores lógicos em '" + chunk->name + "'"};
+
+    auto found = locals[bank].find(name);
+    if (found != locals[bank].end())
+        return found->second;
+
+    uint32_t index = chunk->regs[bank];
+    chunk->regs[bank] += lanes;
+    locals[bank][name] = Ref(SPACE_LOCAL, index);
+    return Ref(SPACE_LOCAL, index);
+}
+
+// operando vetorial no banco indicado: escalares são replicados e vetores
+// de outro tipo, convertidos elemento a elemento
+uint32_t Lowering::Vector(const Operand & o, int bank, int lanes)
+{
+    if (o.kind != OPD_VECTOR)
+    {
+        uint32_t value = Use(o, bank);
+        uint32_t dst = Lanes("#" + std::to_string(++scratch), bank, lanes);
+        Emit(OP_VSPLAT_I + bank, dst, value, 0, 0, lanes);
+        return dst;
+    }
+
+    int from = BankOf(o.type);
+    if (from == bank)
+        return Lanes(o.name, bank, lanes);
+    uint32_t src = Lanes(o.name, from, lanes);
+    uint32_t dst = Lanes("#" + std::to_string(++scratch), bank, lanes);
+    for (int k = 0; k < lanes; ++k)
+        Convert(dst + k, bank, src + k, from);
+    return dst;
+}
+
+uint32_t Lowering::ArrayRef(const string & name)
+{
+    bool global = false;
+    Symbol * s = Lookup(name, global);
+    if (!s || s->valX == -1)
+        throw RuntimeError{"'" + name + "' não é um arranjo"};
+    return global ? globals[BANK_ARRAY].at(name) : Local(name, BANK_ARRAY);
+}
+
+// banco dos elementos de um arranjo
+int Lowering::Element(const string & name)
+{
+    bool global = false;
+    Symbol * s = Lookup(name, global);
+    return s ? BankOf(TypeOf(s->type)) : BANK_INT;
+}
+
+// índice linear do elemento acessado
+uint32_t Lowering::Address(Quad & q)
+{
+    if (q.idx2.kind == OPD_NONE)
+        return Use(q.idx1, BANK_INT);
+
+    Operand stride(OPD_CONST, ExprType::INT, std::to_string(q.stride));
+    uint32_t index = Scratch(BANK_INT);
+    Emit(OP_MUL_I, index, Use(q.idx1, BANK_INT), Const(stride, BANK_INT));
+    Emit(OP_ADD_I, index, index, Use(q.idx2, BANK_INT));
+    return index;
+}
+
+void Lowering::Emit(int op, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e)
+{
+    chunk->code.push_back(Instr{uint16_t(op), a, b, c, d, e});
+}
+
+void Lowering::Convert(uint32_t dst, int to, uint32_t src, int from)
+{
+    if (from == BANK_INT && to == BANK_FLOAT)
+        Emit(OP_I2F, dst, src);
+    else if (from == BANK_FLOAT && to == BANK_INT)
+        Emit(OP_F2I, dst, src);
+    else
+        throw RuntimeError{"conversão entre tipos incompatíveis em '" + chunk->name + "'"};
+}
+
+void Lowering::Binary(Quad & q)
+{
+    const BinaryOps * entry = nullptr;
+    for (const BinaryOps & b : binaryOps)
+    {
+        if (q.oper == b.oper)
+            entry = &b;
+    }
+    if (!entry)
+        throw RuntimeError{"operador '" + q.oper + "' desconhecido"};
+
+    // operações com algum operando real são feitas em ponto flutuante
+    int bank = BANK_INT;
+    if (q.oper == "&&" || q.oper == "||")
+        bank = BANK_BOOL;
+    else if (Natural(q.arg1) == BANK_FLOAT || Natural(q.arg2) == BANK_FLOAT)
+        bank = BANK_FLOAT;
+    else if (Natural(q.arg1) == BANK_BOOL && Natural(q.arg2) == BANK_BOOL)
+        bank = BANK_BOOL;
+
+    int op = entry->ops[bank];
+    if (op == OP_COUNT)
+        throw RuntimeError{"operador '" + q.oper + "' inválido para o tipo dos operandos"};
+
+    uint32_t a = Use(q.arg1, bank);
+    uint32_t b = Use(q.arg2, bank);
+    int result = (op >= OP_LT_I && op <= OP_NE_B) ? BANK_BOOL : bank;
+    int natural = Natural(q.dst);
+    if (natural == result)
+    {
+        Emit(op, Def(q.dst), a, b);
+        return;
+    }
+
+    uint32_t t = Scratch(result);
+    Emit(op, t, a, b);
+    Convert(Def(q.dst), natural, t, result);
+}
+
+// as instruções param que antecedem a chamada são traduzidas com os tipos
+// dos parâmetros da função chamada
+void Lowering::Call(Quad & q)
+{
+    int index = -1;
+    for (int i = 0; i < int(program->funcs.size()); ++i)
+    {
+        if (program->funcs[i]->name == q.name)
+            index = i;
+    }
+    if (index <= 0)
+        throw RuntimeError{"função '" + q.name + "' não definida"};
+
+    Function * callee = program->funcs[index];
+    if (params.size() != callee->params.size())
+        throw RuntimeError{"número de argumentos incorreto na chamada de '" + q.name + "'"};
+
+    for (int i = 0; i < int(params.size()); ++i)
+    {
+        Symbol * s = callee->Local(callee->params[i]);
+        if (s->valX != -1)
+        {
+            Emit(OP_PARAM_A, ArrayRef(params[i].arg1.name));
+            continue;
+        }
+        int bank = BankOf(TypeOf(s->type));
+        Emit(OP_PARAM_I + bank, Use(params[i].arg1, bank));
+    }
+
+    Symbol * ret = callee->Local(callee->ret);
+    if (!ret)
+        ret = program->Main()->Local(callee->ret);
+    int bank = !ret ? BANK_INT : (ret->valX != -1) ? BANK_ARRAY : BankOf(TypeOf(ret->type));
+
+    int natural = Natural(q.dst);
+    if (bank == BANK_ARRAY)
+        Emit(OP_CALL_A, ArrayRef(q.dst.name), index, params.size());
+    else if (natural == bank)
+        Emit(OP_CALL_I + bank, Def(q.dst), index, params.size());
+    else
+    {
+        uint32_t t = Scratch(bank);
+        Emit(OP_CALL_I + bank, t, index, params.size());
+        Convert(Def(q.dst), natural, t, bank);
+    }
+    params.clear();
+}
+
+void Lowering::Translate(Quad & q)
+{
+    switch (q.op)
+    {
+    case IR_COPY:
+    {
+        int bank = Natural(q.dst);
+        Emit(OP_MOV_I + bank, Def(q.dst), Use(q.arg1, bank));
+        break;
+    }
+    case IR_BINARY:
+        Binary(q);
+        break;
+    case IR_UNARY:
+    {
+        int bank = Natural(q.dst);
+        int op = (q.oper == "!") ? OP_NOT_B : (bank == BANK_FLOAT) ? OP_NEG_F : OP_NEG_I;
+        Emit(op, Def(q.dst), Use(q.arg1, bank));
+        break;
+    }
+    case IR_LOAD:
+    {
+        int bank = Natural(q.dst);
+        uint32_t index = Address(q);
+        Emit(OP_LOAD_I + bank, Def(q.dst), ArrayRef(q.name), index, 0);
+        break;
+    }
+    case IR_STORE:
+    {
+        int bank = Element(q.name);
+        uint32_t index = Address(q);
+        Emit(OP_STORE_I + bank, ArrayRef(q.name), index, Use(q.arg1, bank), 0);
+        break;
+    }
+    case IR_VLOAD:
+    {
+        int bank = BankOf(q.dst.type);
+        uint32_t index = Address(q);
+        Emit(OP_VLOAD_I + bank, Vector(q.dst, bank, q.lanes), ArrayRef(q.name), index, 0, q.lanes);
+        break;
+    }
+    case IR_VSTORE:
+    {
+        int bank = Element(q.name);
+        uint32_t index = Address(q);
+        uint32_t value = Vector(q.arg1, bank, q.lanes);
+        Emit(OP_VSTORE_I + bank, ArrayRef(q.name), index, value, 0, q.lanes);
+        break;
+    }
+    case IR_VBINARY:
+    {
+        int bank = BankOf(q.dst.type);
+        const BinaryOps * entry = nullptr;
+        for (const BinaryOps & b : vectorOps)
+        {
+            if (q.oper == b.oper)
+                entry = &b;
+        }
+        if (!entry || entry->ops[bank] == OP_COUNT)
+            throw RuntimeError{"operador vetorial '" + q.oper + "' inválido"};
+        uint32_t x = Vector(q.arg1, bank, q.lanes);
+        uint32_t y = Vector(q.arg2, bank, q.lanes);
+        uint32_t dst = Vector(q.dst, bank, q.lanes);
+        if (entry->ops[bank] != OP_DIV_I)
+        {
+            Emit(entry->ops[bank], dst, x, y, 0, q.lanes);
+            break;
+        }
+        for (int k = 0; k < q.lanes; ++k)
+            Emit(OP_DIV_I, dst + k, x + k, y + k);
+        break;
+    }
+    case IR_SELECT:
+    {
+        int bank = Natural(q.dst);
+        Emit(OP_SEL_I + bank, Def(q.dst), Use(q.arg1, BANK_BOOL), Use(q.arg2, bank), Use(q.arg3, bank));
+        break;
+    }
+    case IR_LABEL:
+        labels[q.label] = chunk->code.size();
+        break;
+    case IR_GOTO:
+        Emit(OP_JMP, q.label);
+        break;
+    case IR_IFFALSE:
+    case IR_IFTRUE:
+    {
+        // a condição é calculada antes de emitir o desvio
+        uint32_t cond = Use(q.arg1, BANK_BOOL);
+        Emit(q.op == IR_IFFALSE ? OP_JF : OP_JT, q.label, cond);
+        break;
+    }
+    case IR_PARAM:
+        params.push_back(q);
+        break;
+    case IR_CALL:
+        Call(q);
+        break;
+    case IR_RETURN:
+    {
+        int bank = Natural(q.arg1);
+        if (bank == BANK_ARRAY)
+            Emit(OP_RET_A, ArrayRef(q.arg1.name));
+        else
+            Emit(OP_RET_I + bank, Use(q.arg1, bank));
+        break;
+    }
+    case IR_FUNC:
+        break;
+    }
+}
+
+// registradores globais: variáveis e arranjos do programa principal
+void Lowering::Globals()
+{
+    for (Symbol & s : program->Main()->locals)
+    {
+        if (s.isFunction)
+            continue;
+
+        int bank = (s.valX != -1) ? BANK_ARRAY : BankOf(TypeOf(s.type));
+        uint32_t index = module.globals[bank]++;
+        globals[bank][s.var] = Ref(SPACE_GLOBAL, index);
+        if (bank == BANK_ARRAY)
+            module.arrays.push_back(ArrayDecl{s.var, index, BankOf(TypeOf(s.type)), s.valX, s.valY > 0 ? s.valY : 1});
+        else
+            module.vars.push_back(GlobalDecl{s.var, bank, index});
+    }
+}
+
+void Lowering::Translate(Function * f, Chunk & c)
+{
+    func = f;
+    chunk = &c;
+    chunk->name = f->name;
+    chunk->parallel = f->parallel;
+    for (auto & bank : locals)
+        bank.clear();
+    labels.clear();
+
+    if (f != program->Main())
+    {
+        // parâmetros primeiro, depois os arranjos próprios da função
+        for (const string & name : f->params)
+        {
+            Symbol * s = f->Local(name);
+            int bank = (s->valX != -1) ? BANK_ARRAY : BankOf(TypeOf(s->type));
+            chunk->params.push_back({bank, Local(name, bank) & IndexMask});
+            if (bank == BANK_ARRAY)
+                chunk->elements.push_back(BankOf(TypeOf(s->type)));
+        }
+        for (Symbol & s : f->locals)
+        {
+            if (s.valX == -1 || locals[BANK_ARRAY].count(s.var))
+                continue;
+            uint32_t slot = Local(s.var, BANK_ARRAY) & IndexMask;
+            chunk->arrays.push_back(ArrayDecl{s.var, slot, BankOf(TypeOf(s.type)), s.valX, s.valY > 0 ? s.valY : 1});
+            chunk->elements.push_back(BankOf(TypeOf(s.type)));
+        }
+
+        Symbol * ret = f->Local(f->ret);
+        if (!ret)
+            ret = program->Main()->Local(f->ret);
+        if (ret)
+            chunk->ret = (ret->valX != -1) ? BANK_ARRAY : BankOf(TypeOf(ret->type));
+    }
+
+    for (Quad & q : f->code)
+        Translate(q);
+    Emit(OP_HALT);
+
+    // os desvios foram emitidos com os rótulos do código de três endereços
+    for (Instr & i : chunk->code)
+    {
+        if (i.op == OP_JMP || i.op == OP_JF || i.op == OP_JT)
+            i.a = labels.at(i.a);
+    }
+}
+
+Module Lower(Program * p)
+{
+    Module module;
+    Lowering lowering(p, module);
+    lowering.Globals();
+
+    module.chunks.resize(p->funcs.size());
+    for (int i = 0; i < int(p->funcs.size()); ++i)
+    {
+        lowering.Translate(p->funcs[i], module.chunks[i]);
+        Combine(module.chunks[i]);
+    }
+    return module;
+}
+
+vector<bool> SharedArrays(Module & m, int chunk)
+{
+    vector<bool> shared(m.globals[BANK_ARRAY], false);
+    vector<bool> seen(m.chunks.size(), false);
+    vector<int> pending = {chunk};
+    seen[chunk] = true;
+    while (!pending.empty())
+    {
+        Chunk & c = m.chunks[pending.back()];
+        pending.pop_back();
+        for (const Instr & i : c.code)
+        {
+            for (const Role & r : Roles(i))
+            {
+                uint32_t ref = Field(i, r.field);
+                if (r.bank == BANK_ARRAY && (ref >> SpaceShift) == SPACE_GLOBAL)
+                    shared[ref & IndexMask] = true;
+            }
+            int op = Generic(i.op);
+            if (op >= OP_CALL_I && op <= OP_CALL_A && !seen[i.b])
+            {
+                seen[i.b] = true;
+                pending.push_back(i.b);
+            }
+        }
+    }
+    return shared;
+}
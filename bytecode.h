@@ -0,0 +1,187 @@
+#ifndef COMPILER_BYTECODE
+#define COMPILER_BYTECODE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ir.h"
+using std::string;
+using std::vector;
+
+// bancos de registradores da máquina virtual, um por tipo
+enum Bank
+{
+    BANK_INT,
+    BANK_FLOAT,
+    BANK_BOOL,
+    BANK_ARRAY,
+    BANK_COUNT
+};
+
+// espaços de um operando: registradores da ativação, variáveis globais ou
+// constantes da função (apenas leitura)
+enum Space
+{
+    SPACE_LOCAL,
+    SPACE_GLOBAL,
+    SPACE_CONST
+};
+
+// operando codificado: espaço nos dois bits mais altos, índice no restante
+const uint32_t SpaceShift = 30;
+const uint32_t IndexMask = (1u << SpaceShift) - 1;
+
+inline uint32_t Ref(int space, uint32_t index)
+{
+    return (uint32_t(space) << SpaceShift) | index;
+}
+
+// códigos de operação; o sufixo indica o banco dos operandos
+//  a, b, c, d: destino e fontes, na ordem em que aparecem no comentário
+#define OPCODES(X) \
+    X(HALT)                                                     \
+    X(MOV_I) X(MOV_F) X(MOV_B)              /* a = b */         \
+    X(I2F) X(F2I)                           /* a = conv b */    \
+    X(ADD_I) X(SUB_I) X(MUL_I) X(DIV_I)     /* a = b op c */    \
+    X(SHL_I) X(SHR_I) X(AND_I)                                  \
+    X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F)                         \
+    X(AND_B) X(OR_B)                                            \
+    X(LT_I) X(LE_I) X(GT_I) X(GE_I) X(EQ_I) X(NE_I)             \
+    X(LT_F) X(LE_F) X(GT_F) X(GE_F) X(EQ_F) X(NE_F)             \
+    X(EQ_B) X(NE_B)                                             \
+    X(NEG_I) X(NEG_F) X(NOT_B)              /* a = op b */      \
+    X(LOAD_I) X(LOAD_F) X(LOAD_B)           /* a = b[c + d] */  \
+    X(STORE_I) X(STORE_F) X(STORE_B)        /* a[b + d] = c */  \
+    X(SEL_I) X(SEL_F) X(SEL_B)              /* a = b ? c : d */ \
+    X(JMP)                                  /* goto a */        \
+    X(JF) X(JT)                             /* if (!)b goto a */\
+    X(PARAM_I) X(PARAM_F) X(PARAM_B) X(PARAM_A)     /* param a */       \
+    X(CALL_I) X(CALL_F) X(CALL_B) X(CALL_A) /* a = call b, c argumentos */ \
+    X(RET_I) X(RET_F) X(RET_B) X(RET_A)     /* return a */     \
+    VECTORS(X)                                                  \
+    SUPERINSTRUCTIONS(X)                                        \
+    QUICKENED(X)
+
+// operações vetoriais: a.., b.. e c.. são e registradores locais
+// consecutivos, um por elemento; escalares são replicados por VSPLAT, e a
+// divisão de inteiros, que pode falhar, continua elemento a elemento
+#define VECTORS(X) \
+    X(VLOAD_I) X(VLOAD_F)                   /* a.. = b[c + d..] */  \
+    X(VSTORE_I) X(VSTORE_F)                 /* a[b + d..] = c.. */  \
+    X(VSPLAT_I) X(VSPLAT_F)                 /* a.. = b */           \
+    X(VADD_I) X(VSUB_I) X(VMUL_I)           /* a.. = b.. op c.. */  \
+    X(VADD_F) X(VSUB_F) X(VMUL_F) X(VDIV_F)
+
+// superinstruções, escolhidas pelos pares de instruções mais executados nos
+// programas de Testes/: endereço e acesso bidimensional (MUL_I ADD_I e
+// ADD_I LOAD_I/STORE_I), comparação seguida de desvio (LT_I JT) e incremento
+// seguido do teste do laço (ADD_I LT_I JT)
+#define SUPERINSTRUCTIONS(X) \
+    X(LOADX_I) X(LOADX_F) X(LOADX_B)        /* a = b[c * e + d] */  \
+    X(STOREX_I) X(STOREX_F) X(STOREX_B)     /* a[b * e + d] = c */  \
+    X(JLT_I) X(JLE_I) X(JGT_I) X(JGE_I)     /* if (b op c) goto a */\
+    X(JEQ_I) X(JNE_I)                                               \
+    X(LOOPLT_I) X(LOOPNE_I)                 /* b += c; if (b op d) goto a */
+
+// formas aceleradas, instaladas na primeira execução da instrução genérica
+// quando todos os operandos são registradores locais (_L) ou a última fonte
+// é uma constante (_LK): dispensam a decodificação do espaço dos operandos
+#define QUICKENED(X) \
+    X(MOV_I_L) X(MOV_F_L)                                           \
+    X(ADD_I_L) X(SUB_I_L) X(MUL_I_L)                                \
+    X(ADD_I_LK) X(SUB_I_LK) X(MUL_I_LK)                             \
+    X(ADD_F_L) X(SUB_F_L) X(MUL_F_L)
+
+enum OpCode
+{
+#define OPCODE_ENUM(name) OP_##name,
+    OPCODES(OPCODE_ENUM)
+#undef OPCODE_ENUM
+    OP_COUNT
+};
+
+extern const char * OpNames[OP_COUNT];
+
+// instrução da máquina virtual
+struct Instr
+{
+    uint16_t op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    uint32_t e;         // superinstruções e elementos das operações vetoriais
+};
+
+// campo de uma instrução lido ou escrito, com o banco do registrador
+struct Role
+{
+    int field;          // 0 = a, 1 = b, 2 = c, 3 = d
+    int bank;
+    bool write;
+    int count = 1;      // registradores consecutivos (operações vetoriais)
+};
+
+// operandos lidos e escritos pela instrução (as de escrita primeiro)
+vector<Role> Roles(const Instr & i);
+uint32_t Field(const Instr & i, int field);
+
+// forma genérica das instruções aceleradas pela máquina virtual
+int Generic(int op);
+
+// desvios, com o alvo no campo a
+bool IsBranch(int op);
+
+// arranjo declarado: registrador no banco de arranjos e dimensões
+struct ArrayDecl
+{
+    string name;
+    uint32_t slot;
+    int bank;           // banco dos elementos
+    int rows;
+    int cols;
+};
+
+// variável global, para exibir o estado final do programa
+struct GlobalDecl
+{
+    string name;
+    int bank;
+    uint32_t slot;
+};
+
+// código de uma função traduzido para a máquina virtual
+struct Chunk
+{
+    string name;
+    vector<Instr> code;
+    uint32_t regs[BANK_COUNT] = {0, 0, 0, 0};  // registradores locais por banco
+    vector<int32_t> ints;                       // constantes
+    vector<double> floats;
+    vector<uint8_t> bools;
+    vector<ArrayDecl> arrays;                   // arranjos alocados a cada ativação
+    vector<std::pair<int, uint32_t>> params;    // banco e registrador dos parâmetros
+    vector<int> elements;                       // banco dos elementos de cada registrador de arranjo
+    int ret = BANK_INT;                         // banco do valor devolvido
+    bool parallel = false;                      // corpo de laço 🧵: a chamada divide as iterações entre threads
+};
+
+// programa traduzido: chunks[0] é o programa principal
+struct Module
+{
+    vector<Chunk> chunks;
+    uint32_t globals[BANK_COUNT] = {0, 0, 0, 0};
+    vector<ArrayDecl> arrays;                   // arranjos globais
+    vector<GlobalDecl> vars;                    // escalares globais, na ordem declarada
+};
+
+// traduz o código de três endereços para a máquina virtual
+Module Lower(Program * p);
+
+// arranjos globais, por registrador, usados pela função ou pelas que ela chama
+vector<bool> SharedArrays(Module & m, int chunk);
+
+// troca sequências frequentes de instruções por superinstruções
+void Combine(Chunk & c);
+
+#endif
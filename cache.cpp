@@ -0,0 +1,305 @@
+#include <cpuid.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include "cache.h"
+
+// muda quando a codificação ou o formato dos arquivos mudam
+static const uint64_t CacheVersion = 4;
+static const char CacheMagic[8] = {'t', 'r', 'c', 'o', 'd', 'e', 0, 1};
+
+// ------
+// Digest
+// ------
+
+// resumo FNV-1a de 64 bits
+struct Digest
+{
+    uint64_t value = 14695981039346656037ull;
+
+    void Add(const void * data, size_t size)
+    {
+        const uint8_t * bytes = static_cast<const uint8_t *>(data);
+        for (size_t k = 0; k < size; ++k)
+            value = (value ^ bytes[k]) * 1099511628211ull;
+    }
+    void Add(uint64_t v)
+    {
+        Add(&v, sizeof(v));
+    }
+    void Add(const string & s)
+    {
+        Add(s.size());
+        Add(s.data(), s.size());
+    }
+};
+
+// assinatura e extensões do processador (cpuid 1 e 7), sem os campos que
+// variam entre os núcleos
+static void AddProcessor(Digest & d)
+{
+    unsigned a, b, c, e;
+    if (__get_cpuid(1, &a, &b, &c, &e))
+    {
+        d.Add(a);
+        d.Add(c);
+        d.Add(e);
+    }
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &e))
+    {
+        d.Add(b);
+        d.Add(c);
+        d.Add(e);
+    }
+}
+
+static void AddArrays(Digest & d, const vector<ArrayDecl> & arrays)
+{
+    d.Add(arrays.size());
+    for (const ArrayDecl & a : arrays)
+    {
+        d.Add(a.slot);
+        d.Add(a.bank);
+        d.Add(a.rows);
+        d.Add(a.cols);
+    }
+}
+
+// -----
+// Files
+// -----
+
+static void Put(std::ostream & out, uint64_t v)
+{
+    out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+static void Put(std::ostream & out, const string & s)
+{
+    Put(out, s.size());
+    out.write(s.data(), s.size());
+}
+
+// leitura que falha de vez no primeiro erro: arquivos truncados ou de outra
+// versão são tratados como ausentes
+struct CacheReader
+{
+    std::istream & in;
+    bool ok = true;
+
+    uint64_t Word()
+    {
+        uint64_t v = 0;
+        ok = ok && in.read(reinterpret_cast<char *>(&v), sizeof(v));
+        return v;
+    }
+    size_t Size()
+    {
+        uint64_t n = Word();
+        if (n > (uint64_t(1) << 30))
+            ok = false;
+        return ok ? size_t(n) : 0;
+    }
+    string Text()
+    {
+        string s(Size(), '\0');
+        ok = ok && in.read(&s[0], s.size());
+        return s;
+    }
+};
+
+// ---------
+// CodeCache
+// ---------
+
+CodeCache::CodeCache(Module & m, const char * dir) :
+    directory(dir ? dir : "")
+{
+    // a seleção consulta as assinaturas das funções chamadas e os
+    // arranjos globais
+    Digest d;
+    d.Add(CacheVersion);
+    AddProcessor(d);
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+        d.Add(m.globals[bank]);
+    AddArrays(d, m.arrays);
+    d.Add(m.chunks.size());
+    for (const Chunk & c : m.chunks)
+    {
+        d.Add(c.name);
+        d.Add(c.ret);
+        d.Add(c.parallel);
+        d.Add(c.params.size());
+        for (auto & p : c.params)
+        {
+            d.Add(p.first);
+            d.Add(p.second);
+        }
+        d.Add(c.elements.size());
+        for (int e : c.elements)
+            d.Add(e);
+    }
+    context = d.value;
+}
+
+uint64_t CodeCache::Key(Module & m, int chunk, int kind) const
+{
+    const Chunk & c = m.chunks[chunk];
+    Digest d;
+    d.Add(context);
+    d.Add(chunk);
+    d.Add(kind);
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+        d.Add(c.regs[bank]);
+    d.Add(c.code.size());
+    for (const Instr & i : c.code)
+    {
+        d.Add(i.op);
+        d.Add(i.a);
+        d.Add(i.b);
+        d.Add(i.c);
+        d.Add(i.d);
+        d.Add(i.e);
+    }
+    d.Add(c.ints.size());
+    for (int32_t v : c.ints)
+        d.Add(uint32_t(v));
+    d.Add(c.floats.size());
+    d.Add(c.floats.data(), c.floats.size() * sizeof(double));
+    d.Add(c.bools.size());
+    d.Add(c.bools.data(), c.bools.size());
+    AddArrays(d, c.arrays);
+    return d.value;
+}
+
+static string Path(const string & directory, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.code", (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+// resumo do conteúdo gravado, conferido na leitura: um arquivo corrompido
+// conta como ausente
+static uint64_t Checksum(const MachineCode & code)
+{
+    Digest d;
+    d.Add(code.name);
+    d.Add(code.bytes.size());
+    d.Add(code.bytes.data(), code.bytes.size());
+    d.Add(code.fixups.size());
+    for (const Fixup & f : code.fixups)
+    {
+        d.Add(f.at);
+        d.Add(f.end);
+        d.Add(f.symbol);
+        d.Add(uint64_t(f.addend));
+    }
+    d.Add(code.entries.size());
+    for (auto & e : code.entries)
+    {
+        d.Add(e.first);
+        d.Add(e.second);
+    }
+    return d.value;
+}
+
+bool CodeCache::Read(uint64_t key, MachineCode & code) const
+{
+    std::ifstream in(Path(directory, key), std::ios::binary);
+    if (!in.is_open())
+        return false;
+    char magic[sizeof(CacheMagic)];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, CacheMagic, sizeof(magic)) != 0)
+        return false;
+
+    CacheReader r{in};
+    if (r.Word() != key)
+        return false;
+    code.name = r.Text();
+    code.bytes.resize(r.Size());
+    r.ok = r.ok && in.read(reinterpret_cast<char *>(code.bytes.data()), code.bytes.size());
+    code.fixups.resize(r.Size());
+    for (Fixup & f : code.fixups)
+    {
+        f.at = r.Word();
+        f.end = r.Word();
+        f.symbol = r.Text();
+        f.addend = int64_t(r.Word());
+        r.ok = r.ok && f.at + 4 <= code.bytes.size() && f.end <= code.bytes.size();
+    }
+    code.entries.resize(r.Size());
+    for (auto & e : code.entries)
+    {
+        e.first = r.Text();
+        e.second = r.Word();
+        r.ok = r.ok && e.second <= code.bytes.size();
+    }
+    r.ok = r.ok && r.Word() == Checksum(code);
+    return r.ok && in.peek() == EOF;
+}
+
+// grava num arquivo temporário e o renomeia, para que execuções simultâneas
+// nunca leiam um arquivo pela metade; falhas apenas deixam de guardar
+void CodeCache::Write(uint64_t key, const MachineCode & code) const
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    string path = Path(directory, key);
+    string temporary = path + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out.is_open())
+            return;
+        out.write(CacheMagic, sizeof(CacheMagic));
+        Put(out, key);
+        Put(out, code.name);
+        Put(out, code.bytes.size());
+        out.write(reinterpret_cast<const char *>(code.bytes.data()), code.bytes.size());
+        Put(out, code.fixups.size());
+        for (const Fixup & f : code.fixups)
+        {
+            Put(out, f.at);
+            Put(out, f.end);
+            Put(out, f.symbol);
+            Put(out, uint64_t(f.addend));
+        }
+        Put(out, code.entries.size());
+        for (auto & e : code.entries)
+        {
+            Put(out, e.first);
+            Put(out, e.second);
+        }
+        Put(out, Checksum(code));
+        if (!out.flush())
+        {
+            out.close();
+            remove(temporary.c_str());
+            return;
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0)
+        remove(temporary.c_str());
+}
+
+MachineCode CodeCache::Compile(Module & m, int chunk, int kind)
+{
+    MachineCode code;
+    uint64_t key = 0;
+    if (!directory.empty())
+    {
+        key = Key(m, chunk, kind);
+        if (Read(key, code))
+            return code;
+    }
+
+    if (kind == CODE_BRIDGE)
+        code = Encode(Bridge(m, chunk));
+    else
+        code = Encode(Select(m, chunk, kind == CODE_LOOPS));
+    if (!directory.empty())
+        Write(key, code);
+    return code;
+}
@@ -0,0 +1,36 @@
+#ifndef COMPILER_CACHE
+#define COMPILER_CACHE
+
+#include "jit.h"
+
+// formas de código de uma função
+enum CodeKind
+{
+    CODE_PROCEDURE,     // procedimento
+    CODE_LOOPS,         // procedimento com entradas nos laços (execução em camadas)
+    CODE_BRIDGE         // ponte para as chamadas do interpretador
+};
+
+// cache de código de máquina em disco: cada função codificada fica num
+// arquivo cujo nome é o resumo do seu código na máquina virtual, das
+// declarações do módulo de que a seleção depende e das extensões do
+// processador. O código guardado mantém as referências a símbolos e um
+// resumo do conteúdo, conferido na leitura, e é instalado na imagem como o
+// recém-compilado; sem diretório, apenas compila
+class CodeCache
+{
+private:
+    string directory;
+    uint64_t context;               // resumo do módulo e do processador
+
+    uint64_t Key(Module & m, int chunk, int kind) const;
+    bool Read(uint64_t key, MachineCode & code) const;
+    void Write(uint64_t key, const MachineCode & code) const;
+
+public:
+    CodeCache(Module & m, const char * dir);
+
+    MachineCode Compile(Module & m, int chunk, int kind);
+};
+
+#endif
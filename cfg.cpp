@@ -0,0 +1,278 @@
+#include <algorithm>
+#include "cfg.h"
+
+// ---
+// CFG
+// ---
+
+CFG::CFG(Function * f) :
+    func(f)
+{
+    vector<Quad> & code = f->code;
+    int n = code.size();
+
+    // líderes: primeira instrução, rótulos e instruções após desvios
+    vector<bool> leader(n + 1, false);
+    leader[0] = true;
+    for (int i = 0; i < n; ++i)
+    {
+        if (code[i].op == IR_LABEL)
+            leader[i] = true;
+        if (code[i].IsJump() || code[i].op == IR_RETURN)
+            leader[i + 1] = true;
+    }
+
+    // divide o código em blocos básicos
+    blockOf.assign(n, 0);
+    for (int i = 0; i < n; ++i)
+    {
+        if (leader[i])
+        {
+            BasicBlock b;
+            b.first = i;
+            b.last = i;
+            blocks.push_back(b);
+        }
+        blocks.back().last = i + 1;
+        blockOf[i] = blocks.size() - 1;
+
+        if (code[i].op == IR_LABEL)
+            labels[code[i].label] = blocks.size() - 1;
+    }
+
+    // arestas entre os blocos
+    for (int b = 0; b < int(blocks.size()); ++b)
+    {
+        Quad & q = code[blocks[b].last - 1];
+        if (q.IsJump())
+            blocks[b].succ.push_back(labels[q.label]);
+        if (q.op != IR_GOTO && q.op != IR_RETURN && b + 1 < int(blocks.size()))
+            blocks[b].succ.push_back(b + 1);
+
+        for (int s : blocks[b].succ)
+            blocks[s].pred.push_back(b);
+    }
+
+    // variáveis escalares referenciadas pela função; as locais de uma função
+    // deixam de existir no retorno e não são vistas pelas funções chamadas
+    for (Quad & q : code)
+    {
+        for (Operand * o : q.Uses())
+            if (o->IsVar())
+                vars.insert(o->name);
+        if (q.Def() && q.Def()->IsVar())
+            vars.insert(q.Def()->name);
+    }
+    if (!f->name.empty())
+    {
+        for (Symbol & s : f->locals)
+            vars.erase(s.var);
+    }
+}
+
+// atualiza o conjunto de nomes vivos ao passar para trás pela instrução
+void CFG::Transfer(Quad & q, set<string> & live)
+{
+    Operand * d = q.Def();
+    if (d && d->IsName())
+        live.erase(d->name);
+
+    // a função chamada pode ler qualquer variável global
+    if (q.op == IR_CALL)
+        live.insert(vars.begin(), vars.end());
+
+    for (Operand * o : q.Uses())
+        live.insert(o->name);
+}
+
+// análise de vida dos nomes (temporários e variáveis)
+void CFG::Liveness()
+{
+    vector<Quad> & code = func->code;
+
+    // conjuntos use e def de cada bloco
+    for (BasicBlock & b : blocks)
+    {
+        b.use.clear();
+        b.def.clear();
+        b.in.clear();
+        b.out.clear();
+
+        set<string> live;
+        for (int i = b.last - 1; i >= b.first; --i)
+        {
+            Operand * d = code[i].Def();
+            if (d && d->IsName())
+                b.def.insert(d->name);
+            Transfer(code[i], live);
+        }
+        b.use = live;
+    }
+
+    // variáveis são observáveis ao fim da função, alcançado também quando o
+    // último bloco termina em um desvio condicional não tomado
+    for (BasicBlock & b : blocks)
+    {
+        if (b.succ.empty())
+            b.out = vars;
+    }
+    if (!blocks.empty() && code[blocks.back().last - 1].IsBranch())
+        blocks.back().out = vars;
+
+    // iteração até o ponto fixo, percorrendo os blocos de trás para frente
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = blocks.size() - 1; i >= 0; --i)
+        {
+            BasicBlock & b = blocks[i];
+            for (int s : b.succ)
+                b.out.insert(blocks[s].in.begin(), blocks[s].in.end());
+
+            set<string> in = b.use;
+            for (const string & name : b.out)
+            {
+                if (!b.def.count(name))
+                    in.insert(name);
+            }
+
+            if (in.size() != b.in.size())
+            {
+                b.in = in;
+                changed = true;
+            }
+        }
+    }
+}
+
+// dominadores imediatos pelo algoritmo iterativo de Cooper, Harvey e Kennedy
+void CFG::Dominators()
+{
+    int n = blocks.size();
+    idom.assign(n, -1);
+    if (n == 0)
+        return;
+
+    // ordem pós-fixada a partir da entrada
+    vector<int> post;
+    vector<int> order(n, -1);
+    vector<bool> visited(n, false);
+    vector<std::pair<int, int>> stack{{0, 0}};
+    visited[0] = true;
+    while (!stack.empty())
+    {
+        auto & [b, next] = stack.back();
+        if (next < int(blocks[b].succ.size()))
+        {
+            int s = blocks[b].succ[next++];
+            if (!visited[s])
+            {
+                visited[s] = true;
+                stack.push_back({s, 0});
+            }
+        }
+        else
+        {
+            order[b] = post.size();
+            post.push_back(b);
+            stack.pop_back();
+        }
+    }
+
+    auto intersect = [&](int a, int b)
+    {
+        while (a != b)
+        {
+            while (order[a] < order[b])
+                a = idom[a];
+            while (order[b] < order[a])
+                b = idom[b];
+        }
+        return a;
+    };
+
+    idom[0] = 0;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = post.size() - 1; i >= 0; --i)
+        {
+            int b = post[i];
+            if (b == 0)
+                continue;
+
+            int dom = -1;
+            for (int p : blocks[b].pred)
+            {
+                if (idom[p] == -1)
+                    continue;
+                dom = (dom == -1) ? p : intersect(p, dom);
+            }
+
+            if (dom != idom[b])
+            {
+                idom[b] = dom;
+                changed = true;
+            }
+        }
+    }
+}
+
+// verifica se o bloco a domina o bloco b
+bool CFG::Dominates(int a, int b)
+{
+    if (idom[b] == -1)
+        return false;
+
+    while (b != a && b != 0)
+        b = idom[b];
+    return b == a;
+}
+
+// laços naturais, identificados pelas arestas de retorno
+vector<Loop> CFG::Loops()
+{
+    if (idom.size() != blocks.size())
+        Dominators();
+
+    vector<Loop> loops;
+    for (int b = 0; b < int(blocks.size()); ++b)
+    {
+        for (int h : blocks[b].succ)
+        {
+            if (!Dominates(h, b))
+                continue;
+
+            // laços com o mesmo cabeçalho são unidos
+            auto found = std::find_if(loops.begin(), loops.end(), [h](Loop & l) { return l.header == h; });
+            if (found == loops.end())
+            {
+                loops.push_back(Loop{h, {h}});
+                found = loops.end() - 1;
+            }
+
+            vector<int> stack;
+            if (found->blocks.insert(b).second)
+                stack.push_back(b);
+            while (!stack.empty())
+            {
+                int x = stack.back();
+                stack.pop_back();
+                for (int p : blocks[x].pred)
+                {
+                    if (idom[p] != -1 && found->blocks.insert(p).second)
+                        stack.push_back(p);
+                }
+            }
+        }
+    }
+
+    // laços internos primeiro
+    std::sort(loops.begin(), loops.end(), [](const Loop & a, const Loop & b)
+    {
+        return a.blocks.size() < b.blocks.size();
+    });
+    return loops;
+}
@@ -0,0 +1,53 @@
+#ifndef COMPILER_CFG
+#define COMPILER_CFG
+
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ir.h"
+using std::set;
+using std::string;
+using std::vector;
+using std::unordered_map;
+
+// bloco básico: intervalo [first, last) do código da função
+struct BasicBlock
+{
+    int first;
+    int last;
+    vector<int> succ;
+    vector<int> pred;
+
+    set<string> use;        // nomes lidos antes de serem escritos no bloco
+    set<string> def;        // nomes escritos no bloco
+    set<string> in;         // nomes vivos na entrada do bloco
+    set<string> out;        // nomes vivos na saída do bloco
+};
+
+// laço natural: cabeçalho e blocos do corpo (incluindo o cabeçalho)
+struct Loop
+{
+    int header;
+    set<int> blocks;
+};
+
+// grafo de fluxo de controle de uma função
+struct CFG
+{
+    Function * func;
+    vector<BasicBlock> blocks;
+    vector<int> blockOf;                    // bloco de cada instrução
+    unordered_map<unsigned, int> labels;    // bloco de cada rótulo
+    set<string> vars;                       // variáveis visíveis fora da função
+    vector<int> idom;                       // dominador imediato de cada bloco
+
+    CFG(Function * f);
+    void Liveness();
+    void Transfer(Quad & q, set<string> & live);
+    void Dominators();
+    bool Dominates(int a, int b);
+    vector<Loop> Loops();
+};
+
+#endif
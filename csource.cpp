@@ -0,0 +1,687 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include "csource.h"
+#include "bytecode.h"
+#include "alias.h"
+#include "error.h"
+using std::endl;
+
+// -----
+// Names
+// -----
+
+static const char * types[BANK_COUNT] = {"int32_t", "double", "uint8_t", "void"};
+static const char * prefixes[BANK_COUNT] = {"i", "f", "b", "a"};
+
+// identificador C: bytes fora de [A-Za-z0-9] são escritos em hexadecimal
+static string CName(const string & name)
+{
+    string s;
+    for (unsigned char ch : name)
+    {
+        if (isalnum(ch) && ch < 128)
+            s += char(ch);
+        else
+        {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "_%02x", ch);
+            s += buffer;
+        }
+    }
+    return s;
+}
+
+static string FunctionName(Module & m, int chunk)
+{
+    if (chunk == 0)
+        return "tr_main";
+    return "fn_" + CName(m.chunks[chunk].name);
+}
+
+// posição do parâmetro marcado com 🔒 que a função devolve em todos os
+// retornos, ou -1: o chamador copia esse arranjo, e ele continua restrict
+static int Output(Chunk & c, Function * f)
+{
+    int found = -1;
+    for (const Instr & i : c.code)
+    {
+        if (i.op != OP_RET_A)
+            continue;
+        int k = 0;
+        while (k < int(f->params.size()) && i.a != Ref(SPACE_LOCAL, c.params[k].second))
+            ++k;
+        Symbol * s = (k < int(f->params.size())) ? f->Local(f->params[k]) : nullptr;
+        if (!s || !s->noalias || (found != -1 && found != k))
+            return -1;
+        found = k;
+    }
+    return found;
+}
+
+static string Literal(int32_t v)
+{
+    if (v == INT32_MIN)
+        return "(-2147483647 - 1)";
+    if (v < 0)
+        return "(" + std::to_string(v) + ")";
+    return std::to_string(v);
+}
+
+// reais com todos os dígitos, sempre com ponto ou expoente
+static string Literal(double v)
+{
+    if (std::isnan(v))
+        return "NAN";
+    if (std::isinf(v))
+        return v > 0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.17g", v);
+    string s = buffer;
+    if (s.find_first_of(".e") == string::npos)
+        s += ".0";
+    return v < 0 ? "(" + s + ")" : s;
+}
+
+// texto entre aspas: caracteres fora do ASCII visível em octal
+static string Quote(const string & text)
+{
+    string s = "\"";
+    for (unsigned char ch : text)
+    {
+        if (ch == '"' || ch == '\\')
+            s += string("\\") + char(ch);
+        else if (ch < 32 || ch > 126)
+        {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\%03o", ch);
+            s += buffer;
+        }
+        else
+            s += char(ch);
+    }
+    return s + "\"";
+}
+
+// ---------
+// Functions
+// ---------
+
+// tradução de uma função da máquina virtual: cada registrador é uma variável
+// local, e as instruções com destino de desvio recebem um rótulo
+class CEmitter
+{
+private:
+    Module & module;
+    Program * program;
+    Function * source;
+    int index;
+    Chunk & chunk;
+    std::ostream & out;
+    vector<Instr> params;
+    vector<bool> targets;           // instruções com rótulo
+    int returned = BANK_INT;        // banco dos elementos do arranjo devolvido
+    int output;                     // parâmetro 🔒 devolvido, copiado pelo chamador (ou -1)
+    vector<bool> shared;            // arranjos globais usados pela função e pelas que ela chama
+
+    string Operand(uint32_t ref, int bank);
+    string Elements(uint32_t ref);
+    string Count(uint32_t ref);
+    string Element(uint32_t array, const string & index);
+    string Offset(uint32_t ref, uint32_t d);
+    bool Restrict(const string & name);
+    void Declarations();
+    void Call(const Instr & i);
+    void Translate(const Instr & i);
+
+public:
+    CEmitter(Module & m, Program * p, int chunk, std::ostream & o);
+    string Signature();
+    void Run();
+};
+
+CEmitter::CEmitter(Module & m, Program * p, int chunk, std::ostream & o) :
+    module(m),
+    program(p),
+    source(p->funcs[chunk]),
+    index(chunk),
+    chunk(m.chunks[chunk]),
+    out(o),
+    targets(m.chunks[chunk].code.size(), false)
+{
+    output = Output(this->chunk, source);
+    for (const Instr & i : this->chunk.code)
+    {
+        if (IsBranch(i.op))
+            targets[i.a] = true;
+    }
+    Symbol * ret = source->Local(source->ret);
+    if (!ret)
+        ret = p->Main()->Local(source->ret);
+    if (ret && ret->valX != -1)
+        returned = (TypeOf(ret->type) == ExprType::FLOAT) ? BANK_FLOAT : (TypeOf(ret->type) == ExprType::BOOL) ? BANK_BOOL : BANK_INT;
+
+    shared = SharedArrays(m, chunk);
+}
+
+string CEmitter::Operand(uint32_t ref, int bank)
+{
+    uint32_t k = ref & IndexMask;
+    switch (ref >> SpaceShift)
+    {
+    case SPACE_LOCAL:
+        return prefixes[bank] + std::to_string(k);
+    case SPACE_GLOBAL:
+        return string("g") + prefixes[bank] + std::to_string(k);
+    }
+    if (bank == BANK_FLOAT)
+        return Literal(chunk.floats[k]);
+    if (bank == BANK_BOOL)
+        return chunk.bools[k] ? "1" : "0";
+    return Literal(chunk.ints[k]);
+}
+
+// endereço do primeiro elemento de um arranjo
+string CEmitter::Elements(uint32_t ref)
+{
+    return Operand(ref, BANK_ARRAY);
+}
+
+// número de elementos: constante nos arranjos globais
+string CEmitter::Count(uint32_t ref)
+{
+    if ((ref >> SpaceShift) == SPACE_GLOBAL)
+    {
+        for (ArrayDecl & a : module.arrays)
+        {
+            if (a.slot == (ref & IndexMask))
+                return std::to_string(a.rows * a.cols);
+        }
+    }
+    return Operand(ref, BANK_ARRAY) + "_n";
+}
+
+// elemento com verificação dos limites
+string CEmitter::Element(uint32_t array, const string & index)
+{
+    return Elements(array) + "[tr_index(" + index + ", " + Count(array) + ")]";
+}
+
+// índice b + d das instruções de acesso
+string CEmitter::Offset(uint32_t ref, uint32_t d)
+{
+    if (d == 0)
+        return Operand(ref, BANK_INT);
+    return "(int32_t)((uint32_t)" + Operand(ref, BANK_INT) + " + " + std::to_string(d) + "u)";
+}
+
+// o parâmetro não compartilha memória com os demais parâmetros nem com os
+// arranjos globais alcançados sem passar por ele; funções que devolvem
+// arranjos escrevem no arranjo do chamador, que pode ser qualquer um deles,
+// exceto quando o chamador copia o parâmetro 🔒 devolvido
+bool CEmitter::Restrict(const string & name)
+{
+    if (chunk.ret == BANK_ARRAY && (output == -1 || source->params[output] != name))
+        return false;
+    for (const string & other : source->params)
+    {
+        Symbol * s = source->Local(other);
+        if (other != name && s && s->valX != -1 && MayAlias(source->name, name, other))
+            return false;
+    }
+    for (ArrayDecl & a : module.arrays)
+    {
+        if (shared[a.slot] && MayAlias(source->name, name, a.name))
+            return false;
+    }
+    return true;
+}
+
+string CEmitter::Signature()
+{
+    std::ostringstream s;
+    s << "static TR_UNUSED " << (index == 0 ? "void" : types[chunk.ret]) << " " << FunctionName(module, index) << "(";
+    vector<string> list;
+    if (chunk.ret == BANK_ARRAY && output == -1)
+        list.push_back(string(types[returned]) + " * ret, int32_t ret_n");
+    int arrays = 0;
+    for (int k = 0; k < int(chunk.params.size()); ++k)
+    {
+        int bank = chunk.params[k].first;
+        string name = prefixes[bank] + std::to_string(chunk.params[k].second);
+        if (bank != BANK_ARRAY)
+        {
+            list.push_back(string(types[bank]) + " " + name);
+            continue;
+        }
+        int element = chunk.elements[arrays++];
+        string qualifier = Restrict(source->params[k]) ? " * restrict " : " * ";
+        list.push_back(types[element] + qualifier + name + ", int32_t " + name + "_n");
+    }
+    if (list.empty())
+        s << "void";
+    for (size_t k = 0; k < list.size(); ++k)
+        s << (k ? ", " : "") << list[k];
+    s << ")";
+    return s.str();
+}
+
+// registradores zerados, como na máquina virtual; arranjos próprios têm os
+// elementos na própria ativação
+void CEmitter::Declarations()
+{
+    // só os registradores que o código usa, exceto os parâmetros
+    vector<bool> used[BANK_COUNT];
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+        used[bank].assign(chunk.regs[bank], false);
+    for (const Instr & i : chunk.code)
+    {
+        for (const Role & r : Roles(i))
+        {
+            uint32_t ref = Field(i, r.field);
+            for (int k = 0; k < r.count && (ref >> SpaceShift) == SPACE_LOCAL; ++k)
+                used[r.bank][(ref & IndexMask) + k] = true;
+        }
+    }
+    for (auto & p : chunk.params)
+        used[p.first][p.second] = false;
+
+    for (int bank = 0; bank < BANK_ARRAY; ++bank)
+    {
+        string line;
+        for (uint32_t k = 0; k < chunk.regs[bank]; ++k)
+        {
+            if (!used[bank][k])
+                continue;
+            line += (line.empty() ? "" : ", ") + Operand(Ref(SPACE_LOCAL, k), bank) + " = 0";
+        }
+        if (!line.empty())
+            out << "    " << types[bank] << " " << line << ";" << endl;
+    }
+    for (ArrayDecl & a : chunk.arrays)
+    {
+        string name = Operand(Ref(SPACE_LOCAL, a.slot), BANK_ARRAY);
+        int count = a.rows * a.cols;
+        out << "    " << types[a.bank] << " " << name << "_s[" << std::max(count, 1) << "] = {0};" << endl;
+        out << "    " << types[a.bank] << " * " << name << " = " << name << "_s;" << endl;
+        out << "    const int32_t " << name << "_n = " << count << ";" << endl;
+    }
+}
+
+// os argumentos são as últimas instruções param antes da chamada
+void CEmitter::Call(const Instr & i)
+{
+    Chunk & callee = module.chunks[i.b];
+    vector<Instr> args(params.end() - i.c, params.end());
+    params.resize(params.size() - i.c);
+
+    int copy = (i.op == OP_CALL_A) ? Output(callee, program->funcs[i.b]) : -1;
+    vector<string> list;
+    if (i.op == OP_CALL_A && copy == -1)
+        list.push_back(Elements(i.a) + ", " + Count(i.a));
+    for (int k = 0; k < int(args.size()); ++k)
+    {
+        int bank = callee.params[k].first;
+        if (bank == BANK_ARRAY)
+            list.push_back(Elements(args[k].a) + ", " + Count(args[k].a));
+        else
+            list.push_back(Operand(args[k].a, bank));
+    }
+
+    string call = FunctionName(module, i.b) + "(";
+    for (size_t k = 0; k < list.size(); ++k)
+        call += (k ? ", " : "") + list[k];
+    call += ")";
+    if (i.op != OP_CALL_A)
+    {
+        out << "    " << Operand(i.a, i.op - OP_CALL_I) << " = " << call << ";" << endl;
+        return;
+    }
+    out << "    " << call << ";" << endl;
+
+    // o arranjo 🔒 devolvido é copiado aqui, fora do alcance do restrict
+    if (copy != -1 && Elements(i.a) != Elements(args[copy].a))
+    {
+        string to = Elements(i.a), from = Elements(args[copy].a);
+        string n = Count(i.a), m = Count(args[copy].a);
+        out << "    memmove(" << to << ", " << from << ", (size_t)(" << n << " < " << m << " ? " << n << " : " << m << ") * sizeof *" << to << ");" << endl;
+    }
+}
+
+void CEmitter::Translate(const Instr & i)
+{
+    static const char * intOps[] = {"+", "-", "*"};
+    static const char * floatOps[] = {"+", "-", "*", "/"};
+    static const char * compares[] = {"<", "<=", ">", ">=", "==", "!="};
+
+    int op = Generic(i.op);
+    auto I = [this](uint32_t ref) { return Operand(ref, BANK_INT); };
+    auto F = [this](uint32_t ref) { return Operand(ref, BANK_FLOAT); };
+    auto B = [this](uint32_t ref) { return Operand(ref, BANK_BOOL); };
+    auto Label = [](uint32_t pc) { return "L" + std::to_string(pc); };
+
+    if (op >= OP_PARAM_I && op <= OP_PARAM_A)
+    {
+        params.push_back(i);
+        return;
+    }
+    if (op >= OP_CALL_I && op <= OP_CALL_A)
+    {
+        Call(i);
+        return;
+    }
+
+    out << "    ";
+    switch (op)
+    {
+    case OP_HALT:
+        out << ((index == 0 || chunk.ret == BANK_ARRAY) ? "return;" : "return 0;");
+        break;
+
+    case OP_MOV_I:
+    case OP_MOV_F:
+    case OP_MOV_B:
+        out << Operand(i.a, op - OP_MOV_I) << " = " << Operand(i.b, op - OP_MOV_I) << ";";
+        break;
+    case OP_I2F:
+        out << F(i.a) << " = (double)" << I(i.b) << ";";
+        break;
+    case OP_F2I:
+        out << I(i.a) << " = (int32_t)" << F(i.b) << ";";
+        break;
+
+    // aritmética inteira de 32 bits, com estouro circular
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+        out << I(i.a) << " = (int32_t)((uint32_t)" << I(i.b) << " " << intOps[op - OP_ADD_I] << " (uint32_t)" << I(i.c) << ");";
+        break;
+    case OP_DIV_I:
+        out << I(i.a) << " = tr_divide(" << I(i.b) << ", " << I(i.c) << ");";
+        break;
+    case OP_SHL_I:
+        out << I(i.a) << " = (int32_t)((uint32_t)" << I(i.b) << " << (" << I(i.c) << " & 31));";
+        break;
+    case OP_SHR_I:
+        out << I(i.a) << " = " << I(i.b) << " >> (" << I(i.c) << " & 31);";
+        break;
+    case OP_AND_I:
+        out << I(i.a) << " = " << I(i.b) << " & " << I(i.c) << ";";
+        break;
+    case OP_ADD_F:
+    case OP_SUB_F:
+    case OP_MUL_F:
+    case OP_DIV_F:
+        out << F(i.a) << " = " << F(i.b) << " " << floatOps[op - OP_ADD_F] << " " << F(i.c) << ";";
+        break;
+    case OP_AND_B:
+    case OP_OR_B:
+        out << B(i.a) << " = " << B(i.b) << (op == OP_AND_B ? " && " : " || ") << B(i.c) << ";";
+        break;
+    case OP_LT_I: case OP_LE_I: case OP_GT_I: case OP_GE_I: case OP_EQ_I: case OP_NE_I:
+        out << B(i.a) << " = " << I(i.b) << " " << compares[op - OP_LT_I] << " " << I(i.c) << ";";
+        break;
+    case OP_LT_F: case OP_LE_F: case OP_GT_F: case OP_GE_F: case OP_EQ_F: case OP_NE_F:
+        out << B(i.a) << " = " << F(i.b) << " " << compares[op - OP_LT_F] << " " << F(i.c) << ";";
+        break;
+    case OP_EQ_B:
+    case OP_NE_B:
+        out << B(i.a) << " = " << B(i.b) << (op == OP_EQ_B ? " == " : " != ") << B(i.c) << ";";
+        break;
+    case OP_NEG_I:
+        out << I(i.a) << " = (int32_t)(0u - (uint32_t)" << I(i.b) << ");";
+        break;
+    case OP_NEG_F:
+        out << F(i.a) << " = -" << F(i.b) << ";";
+        break;
+    case OP_NOT_B:
+        out << B(i.a) << " = !" << B(i.b) << ";";
+        break;
+
+    case OP_LOAD_I:
+    case OP_LOAD_F:
+    case OP_LOAD_B:
+        out << Operand(i.a, op - OP_LOAD_I) << " = " << Element(i.b, Offset(i.c, i.d)) << ";";
+        break;
+    case OP_STORE_I:
+    case OP_STORE_F:
+    case OP_STORE_B:
+        out << Element(i.a, Offset(i.b, i.d)) << " = " << Operand(i.c, op - OP_STORE_I) << ";";
+        break;
+    case OP_LOADX_I:
+    case OP_LOADX_F:
+    case OP_LOADX_B:
+    {
+        string index = "(int32_t)((uint32_t)" + I(i.c) + " * " + std::to_string(i.e) + "u + (uint32_t)" + I(i.d) + ")";
+        out << Operand(i.a, op - OP_LOADX_I) << " = " << Element(i.b, index) << ";";
+        break;
+    }
+    case OP_STOREX_I:
+    case OP_STOREX_F:
+    case OP_STOREX_B:
+    {
+        string index = "(int32_t)((uint32_t)" + I(i.b) + " * " + std::to_string(i.e) + "u + (uint32_t)" + I(i.d) + ")";
+        out << Element(i.a, index) << " = " << Operand(i.c, op - OP_STOREX_I) << ";";
+        break;
+    }
+
+    case OP_SEL_I:
+    case OP_SEL_F:
+    case OP_SEL_B:
+    {
+        int bank = op - OP_SEL_I;
+        out << Operand(i.a, bank) << " = " << B(i.b) << " ? " << Operand(i.c, bank) << " : " << Operand(i.d, bank) << ";";
+        break;
+    }
+
+    case OP_JMP:
+        out << "goto " << Label(i.a) << ";";
+        break;
+    case OP_JF:
+        out << "if (!" << B(i.b) << ") goto " << Label(i.a) << ";";
+        break;
+    case OP_JT:
+        out << "if (" << B(i.b) << ") goto " << Label(i.a) << ";";
+        break;
+    case OP_JLT_I: case OP_JLE_I: case OP_JGT_I: case OP_JGE_I: case OP_JEQ_I: case OP_JNE_I:
+        out << "if (" << I(i.b) << " " << compares[op - OP_JLT_I] << " " << I(i.c) << ") goto " << Label(i.a) << ";";
+        break;
+    case OP_LOOPLT_I:
+    case OP_LOOPNE_I:
+        out << I(i.b) << " = (int32_t)((uint32_t)" << I(i.b) << " + (uint32_t)" << I(i.c) << "); ";
+        out << "if (" << I(i.b) << (op == OP_LOOPLT_I ? " < " : " != ") << I(i.d) << ") goto " << Label(i.a) << ";";
+        break;
+
+    case OP_RET_I:
+    case OP_RET_F:
+    case OP_RET_B:
+        out << "return " << Operand(i.a, op - OP_RET_I) << ";";
+        break;
+    case OP_RET_A:
+    {
+        // copia para o arranjo do chamador os elementos que cabem nele
+        if (output != -1)
+        {
+            out << "return;";
+            break;
+        }
+        string n = Count(i.a);
+        out << "memmove(ret, " << Elements(i.a) << ", (size_t)(ret_n < " << n << " ? ret_n : " << n << ") * sizeof *ret);" << endl << "    return;";
+        break;
+    }
+
+    // operações vetoriais, um elemento por vez: o compilador de C agrupa os
+    // elementos consecutivos
+    case OP_VLOAD_I:
+    case OP_VLOAD_F:
+        for (uint32_t k = 0; k < i.e; ++k)
+            out << (k ? " " : "") << Operand(i.a + k, op - OP_VLOAD_I) << " = " << Element(i.b, Offset(i.c, i.d + k)) << ";";
+        break;
+    case OP_VSTORE_I:
+    case OP_VSTORE_F:
+        for (uint32_t k = 0; k < i.e; ++k)
+            out << (k ? " " : "") << Element(i.a, Offset(i.b, i.d + k)) << " = " << Operand(i.c + k, op - OP_VSTORE_I) << ";";
+        break;
+    case OP_VSPLAT_I:
+    case OP_VSPLAT_F:
+        for (uint32_t k = 0; k < i.e; ++k)
+            out << (k ? " " : "") << Operand(i.a + k, op - OP_VSPLAT_I) << " = " << Operand(i.b, op - OP_VSPLAT_I) << ";";
+        break;
+    case OP_VADD_I:
+    case OP_VSUB_I:
+    case OP_VMUL_I:
+        for (uint32_t k = 0; k < i.e; ++k)
+        {
+            out << (k ? " " : "") << I(i.a + k) << " = (int32_t)((uint32_t)" << I(i.b + k) << " "
+                << intOps[op - OP_VADD_I] << " (uint32_t)" << I(i.c + k) << ");";
+        }
+        break;
+    case OP_VADD_F:
+    case OP_VSUB_F:
+    case OP_VMUL_F:
+    case OP_VDIV_F:
+        for (uint32_t k = 0; k < i.e; ++k)
+            out << (k ? " " : "") << F(i.a + k) << " = " << F(i.b + k) << " " << floatOps[op - OP_VADD_F] << " " << F(i.c + k) << ";";
+        break;
+
+    default:
+        throw RuntimeError{string("instrução ") + OpNames[i.op] + " sem tradução para C"};
+    }
+    out << endl;
+}
+
+void CEmitter::Run()
+{
+    out << Signature() << endl;
+    out << "{" << endl;
+    Declarations();
+    for (int pc = 0; pc < int(chunk.code.size()); ++pc)
+    {
+        if (targets[pc])
+            out << "L" << pc << ":" << endl;
+        Translate(chunk.code[pc]);
+    }
+    out << "}" << endl << endl;
+}
+
+// -------
+// Program
+// -------
+
+// rotinas de apoio: erros de execução, verificação de limites e exibição
+// de arranjos
+static const char * runtime = R"(#if defined(__GNUC__)
+#define TR_NORETURN __attribute__((noreturn))
+#define TR_UNUSED __attribute__((unused))
+#else
+#define TR_NORETURN
+#define TR_UNUSED
+#endif
+
+static TR_NORETURN void tr_bounds(int32_t index)
+{
+    printf("Erro de execu\303\247\303\243o: \303\255ndice %d fora dos limites do arranjo\n", (int)index);
+    exit(1);
+}
+
+static TR_NORETURN void tr_divzero(void)
+{
+    printf("Erro de execu\303\247\303\243o: divis\303\243o por zero\n");
+    exit(1);
+}
+
+/* índices negativos também ficam fora dos limites */
+static inline int32_t tr_index(int32_t index, int32_t count)
+{
+    if ((uint32_t)index >= (uint32_t)count)
+        tr_bounds(index);
+    return index;
+}
+
+static inline int32_t tr_divide(int32_t value, int32_t divisor)
+{
+    if (divisor == 0)
+        tr_divzero();
+    if (divisor == -1)
+        return (int32_t)(0u - (uint32_t)value);
+    return value / divisor;
+}
+
+static TR_UNUSED void tr_print_array(const char * name, const void * data, int rows, int cols, int bank)
+{
+    printf("%s =\n", name);
+    for (int r = 0; r < rows; ++r)
+    {
+        putchar('\t');
+        for (int k = 0; k < cols; ++k)
+        {
+            int index = r * cols + k;
+            if (k > 0)
+                putchar(' ');
+            if (bank == 1)
+                printf("%g", ((const double *)data)[index]);
+            else if (bank == 2)
+                printf("%s", ((const uint8_t *)data)[index] ? "true" : "false");
+            else
+                printf("%d", (int)((const int32_t *)data)[index]);
+        }
+        putchar('\n');
+    }
+}
+
+)";
+
+void EmitC(Program * p, std::ostream & out)
+{
+    Module module = Lower(p);
+
+    out << "/* programa traduzido para C99: cc -O3 -march=native programa.c */" << endl;
+    out << "#include <math.h>" << endl;
+    out << "#include <stdint.h>" << endl;
+    out << "#include <stdio.h>" << endl;
+    out << "#include <stdlib.h>" << endl;
+    out << "#include <string.h>" << endl << endl;
+    out << runtime;
+
+    // variáveis globais, zeradas como na máquina virtual
+    for (GlobalDecl & g : module.vars)
+        out << "static " << types[g.bank] << " g" << prefixes[g.bank] << g.slot << ";" << endl;
+    for (ArrayDecl & a : module.arrays)
+        out << "static " << types[a.bank] << " ga" << a.slot << "[" << std::max(a.rows * a.cols, 1) << "];" << endl;
+    out << endl;
+
+    vector<CEmitter> functions;
+    for (int c = 0; c < int(module.chunks.size()); ++c)
+        functions.emplace_back(module, p, c, out);
+    for (CEmitter & f : functions)
+        out << f.Signature() << ";" << endl;
+    out << endl;
+    for (CEmitter & f : functions)
+        f.Run();
+
+    // estado final: nomes com '_' foram criados pelo compilador
+    out << "int main(void)" << endl;
+    out << "{" << endl;
+    out << "    tr_main();" << endl;
+    for (GlobalDecl & g : module.vars)
+    {
+        if (g.name.find('_') != string::npos)
+            continue;
+        string value = string("g") + prefixes[g.bank] + std::to_string(g.slot);
+        if (g.bank == BANK_INT)
+            out << "    printf(\"%s = %d\\n\", " << Quote(g.name) << ", (int)" << value << ");" << endl;
+        else if (g.bank == BANK_FLOAT)
+            out << "    printf(\"%s = %g\\n\", " << Quote(g.name) << ", " << value << ");" << endl;
+        else
+            out << "    printf(\"%s = %s\\n\", " << Quote(g.name) << ", " << value << " ? \"true\" : \"false\");" << endl;
+    }
+    for (ArrayDecl & a : module.arrays)
+    {
+        if (a.name.find('_') != string::npos)
+            continue;
+        out << "    tr_print_array(" << Quote(a.name) << ", ga" << a.slot << ", " << a.rows << ", " << a.cols << ", " << a.bank << ");" << endl;
+    }
+    out << "    return 0;" << endl;
+    out << "}" << endl;
+}
@@ -0,0 +1,15 @@
+#ifndef COMPILER_CSOURCE
+#define COMPILER_CSOURCE
+
+#include <iostream>
+#include "ir.h"
+
+// programa completo em C99: uma função C por função do programa, com os
+// registradores da máquina virtual como variáveis locais e os desvios como
+// goto; arranjos são ponteiros para os elementos acompanhados do número de
+// elementos, qualificados com restrict quando a análise de apelidos garante
+// que não compartilham memória. O main executa o programa e exibe o estado
+// final das variáveis, como a máquina virtual
+void EmitC(Program * p, std::ostream & out);
+
+#endif
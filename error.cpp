@@ -12,3 +12,18 @@ void SyntaxError::What()
 {
 	cout << "Erro (linha " << lineno << "): " << desc << endl;
 }
+
+RuntimeError::RuntimeError(string msg) : desc(msg)
+{
+
+}
+
+void RuntimeError::What()
+{
+	cout << "Erro de execução: " << desc << endl;
+}
+
+string RuntimeError::Description()
+{
+	return desc;
+}
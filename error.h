@@ -14,4 +14,15 @@ public:
 	void What();
 };
 
+// erro durante a execução do programa traduzido
+class RuntimeError
+{
+private:
+	string desc;
+public:
+	RuntimeError(string msg);
+	void What();
+	string Description();
+};
+
 #endif
@@ -0,0 +1,175 @@
+#include "fusion.h"
+#include "nest.h"
+#include "alias.h"
+#include "ir.h"
+
+extern Program * program;
+
+// ----------------------
+// Acessos do corpo
+// ----------------------
+
+// variável lida e os contadores dos laços que a envolvem no corpo
+struct Read
+{
+    string name;
+    set<string> loops;
+};
+
+// acessos a arranjos, contadores de laços internos e variáveis lidas
+struct Shape
+{
+    vector<Ref> refs;
+    set<string> counters;
+    vector<Read> reads;
+};
+
+// nomes de variáveis lidas pela expressão
+static void Names(Expression * e, vector<string> & names)
+{
+    switch (e->node_type)
+    {
+    case NodeType::IDENTIFIER:
+        names.push_back(e->ToString());
+        break;
+    case NodeType::ACCESS:
+        Names(((Access*) e)->indexX, names);
+        if (((Access*) e)->indexY)
+            Names(((Access*) e)->indexY, names);
+        break;
+    case NodeType::LOG:
+        Names(((Logical*) e)->expr1, names);
+        Names(((Logical*) e)->expr2, names);
+        break;
+    case NodeType::REL:
+        Names(((Relational*) e)->expr1, names);
+        Names(((Relational*) e)->expr2, names);
+        break;
+    case NodeType::ARI:
+        Names(((Arithmetic*) e)->expr1, names);
+        Names(((Arithmetic*) e)->expr2, names);
+        break;
+    case NodeType::UNARY:
+        Names(((UnaryExpr*) e)->expr, names);
+        break;
+    }
+}
+
+static void Reads(Expression * e, set<string> & loops, Shape & shape)
+{
+    vector<string> names;
+    Names(e, names);
+    for (string & name : names)
+        shape.reads.push_back(Read{name, loops});
+}
+
+// o corpo só pode conter laços 🧬, condicionais e atribuições a arranjos;
+// as únicas variáveis escritas são os contadores dos laços internos
+static bool Walk(Statement * s, set<string> & loops, Shape & shape)
+{
+    if (!s)
+        return true;
+
+    switch (s->node_type)
+    {
+    case NodeType::SEQ:
+        return Walk(((Seq*) s)->stmt, loops, shape) && Walk(((Seq*) s)->stmts, loops, shape);
+    case NodeType::IF_STMT:
+        Reads(((If*) s)->expr, loops, shape);
+        return Collect(s, shape.refs) && Walk(((If*) s)->stmt, loops, shape);
+    case NodeType::ASSIGN:
+    {
+        Assign * a = (Assign*) s;
+        if (!Collect(s, shape.refs))
+            return false;
+        Reads(a->id, loops, shape);
+        Reads(a->expr, loops, shape);
+        return true;
+    }
+    case NodeType::FOR_STMT:
+    {
+        For * f = (For*) s;
+        string var = f->for_init->id->ToString();
+        if (f->for_init->id->node_type != NodeType::IDENTIFIER || f->for_increment->id->ToString() != var)
+            return false;
+
+        shape.counters.insert(var);
+        Reads(f->for_init->expr, loops, shape);
+        set<string> inner = loops;
+        inner.insert(var);
+        Reads(f->for_condition, inner, shape);
+        Reads(f->for_increment->expr, inner, shape);
+        return Walk(f->stmt, inner, shape);
+    }
+    }
+    return false;
+}
+
+// o corpo b não lê contadores de a fora dos próprios laços com esses contadores
+static bool Independent(Shape & a, Shape & b)
+{
+    for (Read & r : b.reads)
+    {
+        if (a.counters.count(r.name) && !r.loops.count(r.name))
+            return false;
+    }
+    return true;
+}
+
+// sequência das instruções de a seguidas das de b, sem blocos aninhados
+static void Flatten(Statement * s, vector<Statement*> & stmts)
+{
+    while (s && s->node_type == NodeType::SEQ)
+    {
+        Seq * seq = (Seq*) s;
+        Flatten(seq->stmt, stmts);
+        s = seq->stmts;
+    }
+    if (s)
+        stmts.push_back(s);
+}
+
+For * Fuse(For * a, For * b)
+{
+    CountedLoop x, y;
+    if (!a->Counted(x) || !b->Counted(y))
+        return nullptr;
+    if (x.var != y.var || x.init != y.init || x.inc != y.inc || x.trips != y.trips)
+        return nullptr;
+
+    Shape sa, sb;
+    set<string> loops{x.var};
+    if (!Walk(a->stmt, loops, sa) || !Walk(b->stmt, loops, sb))
+        return nullptr;
+    if (sa.counters.count(x.var) || sb.counters.count(x.var) || !Independent(sa, sb) || !Independent(sb, sa))
+        return nullptr;
+
+    // acessos dos dois corpos ao mesmo arranjo, com ao menos uma escrita, devem
+    // usar os mesmos índices simples com o contador: a iteração i de b só
+    // depende da iteração i de a, que continua executando antes dela
+    string func = program->current->name;
+    for (Ref & r : sa.refs)
+    {
+        for (Ref & s : sb.refs)
+        {
+            string p = r.acc->id->ToString();
+            string q = s.acc->id->ToString();
+            if ((!r.write && !s.write) || !MayAlias(func, p, q))
+                continue;
+
+            if (p != q || Subscript(r.acc) != Subscript(s.acc))
+                return nullptr;
+            if (!Simple(r.acc->indexX) || !Simple(r.acc->indexY) || !Uses(r.acc, x.var))
+                return nullptr;
+        }
+    }
+
+    vector<Statement*> stmts;
+    Flatten(a->stmt, stmts);
+    Flatten(b->stmt, stmts);
+    Statement * body = nullptr;
+    for (int i = stmts.size() - 1; i >= 0; --i)
+        body = new Seq(stmts[i], body);
+
+    return new For(a->for_init, a->for_condition, a->for_increment, body);
+}
@@ -0,0 +1,11 @@
+#ifndef COMPILER_FUSION
+#define COMPILER_FUSION
+
+#include "ast.h"
+
+// funde dois laços 🧬 adjacentes com o mesmo espaço de iterações em um só,
+// com o corpo de a seguido do corpo de b; retorna nullptr se o espaço for
+// diferente ou se alguma dependência impedir a fusão
+For * Fuse(For * a, For * b);
+
+#endif
@@ -1,8 +1,6 @@
-#include <iostream>
 #include "error.h"
 #include "gen.h"
-using std::cout;
-using std::endl;
+#include "ir.h"
 
 extern Lexer * scanner;
 extern SymTable * symtable;
@@ -17,7 +15,7 @@ Expression *Lvalue(Expression *n)
     {
         Access * a = (Access*) n;
         if (a->indexY) {
-            return new Access(a->type, a->token, a->id, Rvalue(a->indexX), Rvalue(a->indexY));
+            return new Access(a->type, a->token, a->id, Rvalue(a->indexX), Rvalue(a->indexY), a->stride);
         }
         return new Access(a->type, a->token, a->id, Rvalue(a->indexX));
     }
@@ -41,10 +39,7 @@ Expression *Rvalue(Expression *n)
         Temp * t = new Temp(ari->type);
         Expression * e1 = Rvalue(ari->expr1);
         Expression * e2 = Rvalue(ari->expr2);
-        cout << '\t' << t->ToString() << " = " 
-             << e1->ToString() << " " 
-             << ari->ToString() << " " 
-             << e2->ToString() << endl;
+        EmitBinary(Operand(t), Operand(e1), ari->ToString(), Operand(e2));
         return t;
     }
     else if (n->node_type == NodeType::REL)
@@ -53,10 +48,7 @@ Expression *Rvalue(Expression *n)
         Temp * t = new Temp(rel->type);
         Expression * e1 = Rvalue(rel->expr1);
         Expression * e2 = Rvalue(rel->expr2);
-        cout << '\t' << t->ToString() << " = " 
-             << e1->ToString() << " " 
-             << rel->ToString() << " " 
-             << e2->ToString() << endl;
+        EmitBinary(Operand(t), Operand(e1), rel->ToString(), Operand(e2));
         return t;
     }
     else if (n->node_type == NodeType::LOG)
@@ -65,10 +57,7 @@ Expression *Rvalue(Expression *n)
         Temp * t = new Temp(log->type);
         Expression * e1 = Rvalue(log->expr1);
         Expression * e2 = Rvalue(log->expr2);
-        cout << '\t' << t->ToString() << " = " 
-             << e1->ToString() << " " 
-             << log->ToString() << " " 
-             << e2->ToString() << endl;
+        EmitBinary(Operand(t), Operand(e1), log->ToString(), Operand(e2));
         return t;
     }
     else if (n->node_type == NodeType::UNARY)
@@ -76,10 +65,7 @@ Expression *Rvalue(Expression *n)
         UnaryExpr * una = (UnaryExpr*) n;
         Temp * t = new Temp(una->type);
         Expression * e = Rvalue(una->expr);
-        cout << '\t' << t->ToString() << " = " 
-             << una->ToString() 
-             << e->ToString() 
-             << endl;
+        EmitUnary(Operand(t), una->ToString(), Operand(e));
         return t;
     }
     else if (n->node_type == NodeType::ACCESS)
@@ -87,23 +73,17 @@ Expression *Rvalue(Expression *n)
         Access * access = (Access*) n;
 
         if (access->indexY) {
-            Expression * right = Lvalue(n);
+            Access * right = (Access*) Lvalue(n);
             Temp * temp = new Temp(access->type);
 
-            Symbol * s = symtable->Find(access->id->ToString());
-
-            cout << '\t' << temp->ToString() << " = "
-                << access->id->ToString() << "[" << access->indexX->ToString() << " * " << s->valY << " + " << access->indexY->ToString() << "]"
-                << endl;
+            EmitLoad(Operand(temp), access->id->ToString(), Operand(right->indexX), Operand(right->indexY), access->stride);
 
             return temp;
         }
 
         Temp * temp = new Temp(access->type);
-        Expression * right = Lvalue(n);
-        cout << '\t' << temp->ToString() << " = " 
-             << right->ToString() 
-             << endl;
+        Access * right = (Access*) Lvalue(n);
+        EmitLoad(Operand(temp), access->id->ToString(), Operand(right->indexX), Operand(), 0);
         return temp;
     }
     else if (n->node_type == NodeType::ASSIGN)
@@ -111,11 +91,7 @@ Expression *Rvalue(Expression *n)
         Access * acc = (Access*) Lvalue(n);
         Expression * left = Lvalue(acc->id);
         Expression * right = Rvalue(acc->indexX);
-        cout << '\t' 
-             << left->ToString()  
-             << " = " 
-             << right->ToString() 
-             << endl;
+        EmitCopy(Operand(left), Operand(right));
         return right;
     }
     else
@@ -124,4 +100,55 @@ Expression *Rvalue(Expression *n)
         ss << "Expressão \'" << n->ToString() << "\' não possui valor-r";
         throw SyntaxError{scanner->Lineno(), ss.str()};
     }
+}
+
+// código de desvios para expressões booleanas em testes: desvia para o rótulo
+// t se a expressão for verdadeira e para f se for falsa (0 segue em frente);
+// && e || avaliam o segundo operando apenas quando o primeiro não decide o resultado
+void Jumping(Expression *n, unsigned t, unsigned f)
+{
+    if (n->node_type == NodeType::LOG)
+    {
+        Logical * log = (Logical*) n;
+        if (log->token->tag == Tag::AND)
+        {
+            unsigned label = f ? f : NewLabel();
+            Jumping(log->expr1, 0, label);
+            Jumping(log->expr2, t, f);
+            if (!f)
+                EmitLabel(label);
+        }
+        else
+        {
+            unsigned label = t ? t : NewLabel();
+            Jumping(log->expr1, label, 0);
+            Jumping(log->expr2, t, f);
+            if (!t)
+                EmitLabel(label);
+        }
+    }
+    else if (n->node_type == NodeType::UNARY && n->token->tag == '!')
+    {
+        Jumping(((UnaryExpr*) n)->expr, f, t);
+    }
+    else if (n->node_type == NodeType::CONSTANT)
+    {
+        unsigned label = (n->token->tag == Tag::TRUE) ? t : f;
+        if (label)
+            EmitGoto(label);
+    }
+    else
+    {
+        Expression * e = Rvalue(n);
+        if (t)
+        {
+            EmitJump(IR_IFTRUE, Operand(e), t);
+            if (f)
+                EmitGoto(f);
+        }
+        else if (f)
+        {
+            EmitJump(IR_IFFALSE, Operand(e), f);
+        }
+    }
 }
\ No newline at end of file
@@ -7,5 +7,6 @@
 
 Expression * Lvalue(Expression * n);
 Expression * Rvalue(Expression * n);
+void Jumping(Expression * n, unsigned t, unsigned f);
 
 #endif
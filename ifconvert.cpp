@@ -0,0 +1,220 @@
+#include <map>
+#include "ifconvert.h"
+#include "cfg.h"
+using std::map;
+
+// -------------
+// Modelo de custo
+// -------------
+
+// instruções de cada lado executadas sempre depois da conversão
+static const int ArmLimit = 6;
+
+// ciclos perdidos em um desvio mal previsto; sem informação sobre os dados,
+// o desvio erra metade das vezes
+static const int MispredictCost = 8;
+
+// o select executa os dois lados e a escolha; o desvio executa o teste, em
+// média metade dos lados, e paga a previsão errada
+static bool Profitable(int a, int b)
+{
+    if (a > ArmLimit || b > ArmLimit)
+        return false;
+    return 2 * (a + b + 1) <= 2 + (a + b) + MispredictCost;
+}
+
+// ----
+// Lado
+// ----
+
+// trecho em linha reta [first, last) executado em um dos caminhos, que
+// termina escrevendo var; os demais resultados são temporários locais
+struct Arm
+{
+    int first;
+    int last;
+    Operand var;
+    set<string> defs;
+    set<string> uses;
+
+    int Size() const { return last - first; }
+};
+
+// instruções que podem ser executadas mesmo quando o caminho não seria
+// tomado: sem memória, chamadas ou divisão inteira (que pode falhar)
+static bool Speculable(Quad & q)
+{
+    if (q.op != IR_COPY && q.op != IR_BINARY && q.op != IR_UNARY)
+        return false;
+    if (q.op == IR_BINARY && q.oper == "/" && q.dst.type != ExprType::FLOAT)
+        return false;
+    return q.dst.IsVar() || q.dst.IsTemp();
+}
+
+// reconhece o lado [first, last); join são os nomes vivos na junção
+static bool Analyze(vector<Quad> & code, int first, int last, const set<string> & join, Arm & arm)
+{
+    if (last <= first)
+        return false;
+
+    arm.first = first;
+    arm.last = last;
+    arm.var = code[last - 1].dst;
+    for (int i = first; i < last; ++i)
+    {
+        Quad & q = code[i];
+        if (!Speculable(q))
+            return false;
+        for (Operand * o : q.Uses())
+            arm.uses.insert(o->name);
+
+        // resultados intermediários não podem ser vistos depois da junção
+        if (i < last - 1 && (!q.dst.IsTemp() || q.dst.name == arm.var.name || join.count(q.dst.name)))
+            return false;
+        arm.defs.insert(q.dst.name);
+    }
+    return true;
+}
+
+// copia o lado, com o resultado final em um novo temporário (ou, se for uma
+// cópia, devolve diretamente o valor copiado)
+static Operand Emit(vector<Quad> & code, Arm & arm, vector<Quad> & out)
+{
+    out.insert(out.end(), code.begin() + arm.first, code.begin() + arm.last - 1);
+
+    Quad last = code[arm.last - 1];
+    if (last.op == IR_COPY)
+        return last.arg1;
+
+    last.dst = NewTemp(arm.var.type);
+    out.push_back(last);
+    return last.dst;
+}
+
+static Quad Select(Operand dst, Operand cond, Operand a, Operand b)
+{
+    Quad q(IR_SELECT);
+    q.dst = dst;
+    q.arg1 = cond;
+    q.arg2 = a;
+    q.arg3 = b;
+    return q;
+}
+
+// ---------
+// Conversão
+// ---------
+
+// posição do rótulo e número de desvios para ele
+static int Uses(vector<Quad> & code, unsigned label)
+{
+    int count = 0;
+    for (Quad & q : code)
+    {
+        if (q.IsJump() && q.label == label)
+            ++count;
+    }
+    return count;
+}
+
+// fim do trecho em linha reta que começa em i
+static int Straight(vector<Quad> & code, int i)
+{
+    while (i < int(code.size()) && code[i].op != IR_LABEL && !code[i].IsJump()
+           && code[i].op != IR_RETURN && code[i].op != IR_FUNC && code[i].op != IR_CALL)
+        ++i;
+    return i;
+}
+
+// tenta converter o desvio em i; devolve true se o código foi alterado
+static bool Convert(Function * f, CFG & cfg, int i)
+{
+    vector<Quad> & code = f->code;
+    Quad & branch = code[i];
+    Operand cond = branch.arg1;
+    if (!branch.IsBranch() || !cond.IsName())
+        return false;
+
+    // ifFalse c goto L: o primeiro lado executa quando c é verdadeiro
+    bool whenTrue = (branch.op == IR_IFFALSE);
+    int end = Straight(code, i + 1);
+    if (end >= int(code.size()))
+        return false;
+
+    Arm a, b;
+    vector<Quad> out(code.begin(), code.begin() + i);
+    Operand value, other;
+    int rest;
+
+    if (code[end].op == IR_LABEL && code[end].label == branch.label)
+    {
+        // triângulo: ifFalse c goto L; x = ...; L:
+        const set<string> & join = cfg.blocks[cfg.blockOf[end]].in;
+        if (!Analyze(code, i + 1, end, join, a) || a.defs.count(cond.name) || !Profitable(a.Size(), 0))
+            return false;
+
+        value = Emit(code, a, out);
+        other = a.var;
+        rest = end;
+    }
+    else if (code[end].op == IR_GOTO && end + 1 < int(code.size()) && code[end + 1].op == IR_LABEL
+             && code[end + 1].label == branch.label && Uses(code, branch.label) == 1)
+    {
+        // losango: ifFalse c goto L1; x = ...; goto L2; L1: x = ...; L2:
+        int last = Straight(code, end + 2);
+        if (last >= int(code.size()) || code[last].op != IR_LABEL || code[last].label != code[end].label)
+            return false;
+
+        const set<string> & join = cfg.blocks[cfg.blockOf[last]].in;
+        if (!Analyze(code, i + 1, end, join, a) || !Analyze(code, end + 2, last, join, b))
+            return false;
+        if (a.var.name != b.var.name || a.defs.count(cond.name) || b.defs.count(cond.name))
+            return false;
+        for (const string & name : a.defs)
+        {
+            if (b.uses.count(name))
+                return false;
+        }
+        if (code[end - 1].op == IR_COPY && b.defs.count(code[end - 1].arg1.name))
+            return false;
+        if (!Profitable(a.Size(), b.Size()))
+            return false;
+
+        value = Emit(code, a, out);
+        other = Emit(code, b, out);
+        rest = last;
+    }
+    else
+    {
+        return false;
+    }
+
+    Operand dst = a.var;
+    out.push_back(whenTrue ? Select(dst, cond, value, other) : Select(dst, cond, other, value));
+    out.insert(out.end(), code.begin() + rest, code.end());
+    code.swap(out);
+    return true;
+}
+
+bool IfConvert(Function * f)
+{
+    if (f->code.empty())
+        return false;
+
+    bool changed = false;
+    CFG * cfg = new CFG(f);
+    cfg->Liveness();
+    for (int i = 0; i < int(f->code.size()); ++i)
+    {
+        if (!f->code[i].IsBranch() || !Convert(f, *cfg, i))
+            continue;
+
+        // cada conversão muda os blocos, então a análise é refeita
+        changed = true;
+        delete cfg;
+        cfg = new CFG(f);
+        cfg->Liveness();
+    }
+    delete cfg;
+    return changed;
+}
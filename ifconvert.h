@@ -0,0 +1,11 @@
+#ifndef COMPILER_IFCONVERT
+#define COMPILER_IFCONVERT
+
+#include "ir.h"
+
+// troca desvios sobre pequenos trechos que atribuem uma única variável
+// (🤔 sem senão, ou losangos com os dois lados) por uma instrução select,
+// quando o modelo de custo indica que o desvio sairia mais caro
+bool IfConvert(Function * f);
+
+#endif
@@ -0,0 +1,203 @@
+#include <map>
+#include <set>
+#include "inliner.h"
+#include "cfg.h"
+using std::map;
+using std::set;
+
+// número de instruções da função, sem contar rótulos
+static int Size(Function * f)
+{
+    int size = 0;
+    for (Quad & q : f->code)
+    {
+        if (q.op != IR_LABEL)
+            ++size;
+    }
+    return size;
+}
+
+// verifica se a chamada pode ser expandida: a função deve ser pequena, não
+// recursiva, sem funções aninhadas nem arranjos próprios (que começariam
+// zerados a cada chamada), com retorno escalar e sem usar globais que a
+// função chamadora esconde com variáveis locais; o corpo de um laço 🧵
+// continua uma chamada, que divide as iterações entre as threads
+static bool Inlinable(Program * p, Function * caller, Function * callee, vector<Quad> & body, int args, int limit)
+{
+    if (!callee || callee == caller || callee->parallel || int(callee->params.size()) != args || Size(callee) > limit)
+        return false;
+
+    set<string> params(callee->params.begin(), callee->params.end());
+    for (Symbol & s : callee->locals)
+    {
+        if (s.valX != -1 && !params.count(s.var))
+            return false;
+    }
+
+    for (Quad & q : body)
+    {
+        if (q.op == IR_FUNC || (q.op == IR_CALL && q.name == callee->name))
+            return false;
+
+        for (Operand * o : {&q.dst, &q.arg1, &q.arg2, &q.arg3, &q.idx1, &q.idx2})
+        {
+            if (o->IsVar() && !callee->Local(o->name) && caller != p->Main() && caller->Local(o->name))
+                return false;
+        }
+    }
+
+    Symbol * ret = callee->Local(callee->ret);
+    if (!ret)
+        ret = p->Main()->Local(callee->ret);
+    return ret && ret->valX == -1;
+}
+
+// constante nula de um tipo, valor inicial das variáveis locais
+static Operand Zero(int type)
+{
+    if (type == ExprType::FLOAT)
+        return Operand(OPD_CONST, type, "0.0");
+    if (type == ExprType::BOOL)
+        return Operand(OPD_CONST, type, "false");
+    return Operand(OPD_CONST, ExprType::INT, "0");
+}
+
+// substitui param/call pelo corpo da função, com parâmetros, variáveis locais,
+// temporários e rótulos renomeados para não colidir com os da função chamadora
+static void Expand(Function * caller, Function * callee, vector<Quad> & body, vector<Quad> & params, Quad & call, vector<Quad> & code)
+{
+    static int sites = 0;
+    string suffix = "_" + std::to_string(++sites);
+
+    // identificadores da linguagem não têm '_', então os novos nomes são únicos
+    map<string, string> names;
+    for (int i = 0; i < int(callee->params.size()); ++i)
+    {
+        Symbol * s = callee->Local(callee->params[i]);
+        if (s->valX != -1)
+        {
+            // arranjos são passados por referência
+            names[s->var] = params[i].arg1.name;
+            continue;
+        }
+
+        Quad copy(IR_COPY);
+        copy.dst = Operand(OPD_VAR, TypeOf(s->type), s->var + suffix);
+        copy.arg1 = params[i].arg1;
+        code.push_back(copy);
+    }
+    for (Symbol s : callee->locals)
+    {
+        if (names.count(s.var))
+            continue;
+        names[s.var] = s.var + suffix;
+        s.var += suffix;
+        caller->locals.push_back(s);
+    }
+
+    // como numa nova ativação, as variáveis locais lidas antes de escritas
+    // começam zeradas a cada entrada, mesmo com a chamada dentro de um laço
+    Function original(callee->name);
+    original.code = body;
+    original.locals = callee->locals;
+    CFG cfg(&original);
+    cfg.Liveness();
+    set<string> inputs(callee->params.begin(), callee->params.end());
+    for (Symbol & s : callee->locals)
+    {
+        if (s.valX == -1 && !inputs.count(s.var) && cfg.blocks[0].in.count(s.var))
+        {
+            Quad reset(IR_COPY);
+            reset.dst = Operand(OPD_VAR, TypeOf(s.type), names[s.var]);
+            reset.arg1 = Zero(TypeOf(s.type));
+            code.push_back(reset);
+        }
+    }
+
+    map<string, Operand> temps;
+    map<unsigned, unsigned> labels;
+    unsigned end = NewLabel();
+
+    for (Quad q : body)
+    {
+        for (Operand * o : {&q.dst, &q.arg1, &q.arg2, &q.arg3, &q.idx1, &q.idx2})
+        {
+            if (o->IsTemp())
+            {
+                if (!temps.count(o->name))
+                    temps[o->name] = NewTemp(o->type);
+                *o = temps[o->name];
+            }
+            else if (o->IsVar() && names.count(o->name))
+            {
+                o->name = names[o->name];
+            }
+        }
+        if ((q.IsLoad() || q.IsStore()) && names.count(q.name))
+            q.name = names[q.name];
+        if (q.op == IR_LABEL || q.IsJump())
+        {
+            if (!labels.count(q.label))
+                labels[q.label] = NewLabel();
+            q.label = labels[q.label];
+        }
+
+        if (q.op == IR_RETURN)
+        {
+            Quad copy(IR_COPY);
+            copy.dst = call.dst;
+            copy.arg1 = q.arg1;
+            code.push_back(copy);
+
+            Quad jump(IR_GOTO);
+            jump.label = end;
+            code.push_back(jump);
+            continue;
+        }
+        code.push_back(q);
+    }
+
+    Quad label(IR_LABEL);
+    label.label = end;
+    code.push_back(label);
+}
+
+void InlineCalls(Program * p, int limit)
+{
+    // as expansões usam o código original das funções, sem expansões aninhadas
+    map<Function*, vector<Quad>> original;
+    for (Function * f : p->funcs)
+        original[f] = f->code;
+
+    for (Function * caller : p->funcs)
+    {
+        vector<Quad> code;
+        for (Quad & q : caller->code)
+        {
+            if (q.op != IR_CALL)
+            {
+                code.push_back(q);
+                continue;
+            }
+
+            // os argumentos são as instruções param imediatamente anteriores
+            Function * callee = p->Find(q.name);
+            int args = 0;
+            while (args < int(code.size()) && code[code.size() - 1 - args].op == IR_PARAM)
+                ++args;
+            if (callee && args > int(callee->params.size()))
+                args = callee->params.size();
+
+            if (!Inlinable(p, caller, callee, original[callee], args, limit))
+            {
+                code.push_back(q);
+                continue;
+            }
+
+            vector<Quad> params(code.end() - args, code.end());
+            code.erase(code.end() - args, code.end());
+            Expand(caller, callee, original[callee], params, q, code);
+        }
+        caller->code.swap(code);
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef COMPILER_INLINER
+#define COMPILER_INLINER
+
+#include "ir.h"
+
+// expande no ponto de chamada as funções com até limit instruções
+void InlineCalls(Program * p, int limit);
+
+#endif
@@ -0,0 +1,488 @@
+#include <iostream>
+#include <sstream>
+#include "ir.h"
+using std::cout;
+using std::endl;
+using std::stringstream;
+
+extern Program * program;
+
+// -------
+// Operand
+// -------
+
+Operand::Operand() :
+    kind(OPD_NONE),
+    type(ExprType::VOID)
+{
+
+}
+
+Operand::Operand(int k, int t, string n) :
+    kind(k),
+    type(t),
+    name(n)
+{
+
+}
+
+Operand::Operand(Expression *e) :
+    kind(OPD_VAR),
+    type(e->type),
+    name(e->ToString())
+{
+    if (e->node_type == NodeType::TEMP)
+        kind = OPD_TEMP;
+    else if (e->node_type == NodeType::CONSTANT)
+        kind = OPD_CONST;
+}
+
+bool Operand::IsTemp() const
+{
+    return kind == OPD_TEMP;
+}
+
+bool Operand::IsVar() const
+{
+    return kind == OPD_VAR;
+}
+
+bool Operand::IsConst() const
+{
+    return kind == OPD_CONST;
+}
+
+// temporários e variáveis ocupam armazenamento, constantes não
+bool Operand::IsName() const
+{
+    return kind == OPD_TEMP || kind == OPD_VAR || kind == OPD_VECTOR;
+}
+
+string Operand::ToString() const
+{
+    return name;
+}
+
+// ----
+// Quad
+// ----
+
+Quad::Quad(int o) :
+    op(o),
+    stride(0),
+    lanes(0),
+    label(0)
+{
+
+}
+
+// operando escrito pela instrução (nullptr se não houver)
+Operand * Quad::Def()
+{
+    switch (op)
+    {
+    case IR_COPY:
+    case IR_BINARY:
+    case IR_UNARY:
+    case IR_LOAD:
+    case IR_CALL:
+    case IR_VLOAD:
+    case IR_VBINARY:
+    case IR_SELECT:
+        return &dst;
+    default:
+        return nullptr;
+    }
+}
+
+// operandos lidos pela instrução (apenas temporários e variáveis)
+vector<Operand*> Quad::Uses()
+{
+    vector<Operand*> uses;
+    for (Operand * o : {&arg1, &arg2, &arg3, &idx1, &idx2})
+    {
+        if (o->IsName())
+            uses.push_back(o);
+    }
+    return uses;
+}
+
+bool Quad::IsJump() const
+{
+    return op == IR_GOTO || op == IR_IFFALSE || op == IR_IFTRUE;
+}
+
+bool Quad::IsBranch() const
+{
+    return op == IR_IFFALSE || op == IR_IFTRUE;
+}
+
+// instruções sem efeito além de escrever no destino
+bool Quad::IsPure() const
+{
+    switch (op)
+    {
+    case IR_COPY:
+    case IR_BINARY:
+    case IR_UNARY:
+    case IR_LOAD:
+    case IR_VLOAD:
+    case IR_VBINARY:
+    case IR_SELECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// instruções que podem interromper a execução (divisão inteira e acesso a
+// arranjo): mesmo sem uso do resultado, não podem ser removidas nem movidas
+// para caminhos em que não executariam
+bool Quad::CanTrap() const
+{
+    if (IsLoad())
+        return true;
+    return (op == IR_BINARY || op == IR_VBINARY) && oper == "/" && dst.type != ExprType::FLOAT;
+}
+
+// leituras e escritas de arranjos, escalares ou vetoriais
+bool Quad::IsLoad() const
+{
+    return op == IR_LOAD || op == IR_VLOAD;
+}
+
+bool Quad::IsStore() const
+{
+    return op == IR_STORE || op == IR_VSTORE;
+}
+
+// nome da operação vetorial correspondente ao operador
+static string VectorOp(const string & oper)
+{
+    if (oper == "+")
+        return "vadd";
+    if (oper == "-")
+        return "vsub";
+    if (oper == "*")
+        return "vmul";
+    return "vdiv";
+}
+
+string Quad::ToString()
+{
+    stringstream ss;
+    switch (op)
+    {
+    case IR_COPY:
+        ss << '\t' << dst.ToString() << " = " << arg1.ToString();
+        break;
+    case IR_BINARY:
+        ss << '\t' << dst.ToString() << " = "
+           << arg1.ToString() << " "
+           << oper << " "
+           << arg2.ToString();
+        break;
+    case IR_UNARY:
+        ss << '\t' << dst.ToString() << " = " << oper << arg1.ToString();
+        break;
+    case IR_LOAD:
+        ss << '\t' << dst.ToString() << " = " << name << "[" << idx1.ToString();
+        if (idx2.kind != OPD_NONE)
+            ss << " * " << stride << " + " << idx2.ToString();
+        ss << "]";
+        break;
+    case IR_STORE:
+        ss << '\t' << name << "[" << idx1.ToString();
+        if (idx2.kind != OPD_NONE)
+            ss << ":" << idx2.ToString();
+        ss << "] = " << arg1.ToString();
+        break;
+    case IR_LABEL:
+        ss << 'L' << label << ':';
+        break;
+    case IR_GOTO:
+        ss << "\tgoto L" << label;
+        break;
+    case IR_IFFALSE:
+        ss << "\tifFalse " << arg1.ToString() << " goto L" << label;
+        break;
+    case IR_IFTRUE:
+        ss << "\tifTrue " << arg1.ToString() << " goto L" << label;
+        break;
+    case IR_PARAM:
+        ss << "\tparam " << arg1.ToString();
+        break;
+    case IR_CALL:
+        ss << '\t' << dst.ToString() << " = call " << name;
+        break;
+    case IR_RETURN:
+        ss << "\treturn " << arg1.ToString();
+        break;
+    case IR_FUNC:
+        ss << name << ":";
+        break;
+    case IR_VLOAD:
+        ss << '\t' << dst.ToString() << " = vload" << lanes << " " << name << "[" << idx1.ToString();
+        if (idx2.kind != OPD_NONE)
+            ss << " * " << stride << " + " << idx2.ToString();
+        ss << "]";
+        break;
+    case IR_VSTORE:
+        ss << "\tvstore" << lanes << " " << name << "[" << idx1.ToString();
+        if (idx2.kind != OPD_NONE)
+            ss << ":" << idx2.ToString();
+        ss << "] = " << arg1.ToString();
+        break;
+    case IR_VBINARY:
+        ss << '\t' << dst.ToString() << " = " << VectorOp(oper) << lanes << " "
+           << arg1.ToString() << ", " << arg2.ToString();
+        break;
+    case IR_SELECT:
+        ss << '\t' << dst.ToString() << " = select " << arg1.ToString() << ", "
+           << arg2.ToString() << ", " << arg3.ToString();
+        break;
+    }
+    return ss.str();
+}
+
+// --------
+// Function
+// --------
+
+Function::Function(string n) :
+    name(n)
+{
+
+}
+
+// declaração de um parâmetro ou variável local (nullptr se não for local)
+Symbol * Function::Local(const string & var)
+{
+    for (Symbol & s : locals)
+    {
+        if (s.var == var)
+            return &s;
+    }
+    return nullptr;
+}
+
+// -------
+// Program
+// -------
+
+Program::Program()
+{
+    funcs.push_back(new Function(""));
+    current = funcs[0];
+}
+
+Function * Program::Main()
+{
+    return funcs[0];
+}
+
+Function * Program::Find(string name)
+{
+    for (Function * f : funcs)
+    {
+        if (f->name == name)
+            return f;
+    }
+    return nullptr;
+}
+
+// inicia a emissão do código de uma nova função
+Function * Program::Begin(string name)
+{
+    Function * saved = current;
+    current->code.push_back(Quad(IR_FUNC));
+    current->code.back().name = name;
+
+    current = new Function(name);
+    funcs.push_back(current);
+    return saved;
+}
+
+// retoma a emissão na função envolvente
+void Program::End(Function * saved)
+{
+    current = saved;
+}
+
+// ----------------------------
+// Tipos, temporários e rótulos
+// ----------------------------
+
+int TypeOf(const string & type)
+{
+    if (type == "int")
+        return ExprType::INT;
+    if (type == "float")
+        return ExprType::FLOAT;
+    if (type == "bool")
+        return ExprType::BOOL;
+    return ExprType::VOID;
+}
+
+Operand NewTemp(int type)
+{
+    Temp t(type);
+    return Operand(&t);
+}
+
+// temporários vetoriais usam o contador dos temporários, com prefixo v
+Operand NewVector(int type)
+{
+    return Operand(OPD_VECTOR, type, "v" + std::to_string(++Temp::count));
+}
+
+unsigned NewLabel()
+{
+    return ++Node::labels;
+}
+
+// --------
+// Emissão
+// --------
+
+void EmitCopy(Operand dst, Operand src)
+{
+    Quad q(IR_COPY);
+    q.dst = dst;
+    q.arg1 = src;
+    program->current->code.push_back(q);
+}
+
+void EmitBinary(Operand dst, Operand a, string oper, Operand b)
+{
+    Quad q(IR_BINARY);
+    q.dst = dst;
+    q.arg1 = a;
+    q.oper = oper;
+    q.arg2 = b;
+    program->current->code.push_back(q);
+}
+
+void EmitUnary(Operand dst, string oper, Operand a)
+{
+    Quad q(IR_UNARY);
+    q.dst = dst;
+    q.oper = oper;
+    q.arg1 = a;
+    program->current->code.push_back(q);
+}
+
+void EmitLoad(Operand dst, string array, Operand i, Operand j, int stride)
+{
+    Quad q(IR_LOAD);
+    q.dst = dst;
+    q.name = array;
+    q.idx1 = i;
+    q.idx2 = j;
+    q.stride = stride;
+    program->current->code.push_back(q);
+}
+
+void EmitStore(string array, Operand i, Operand j, int stride, Operand value)
+{
+    Quad q(IR_STORE);
+    q.name = array;
+    q.idx1 = i;
+    q.idx2 = j;
+    q.stride = stride;
+    q.arg1 = value;
+    program->current->code.push_back(q);
+}
+
+void EmitLabel(unsigned label)
+{
+    Quad q(IR_LABEL);
+    q.label = label;
+    program->current->code.push_back(q);
+}
+
+void EmitGoto(unsigned label)
+{
+    Quad q(IR_GOTO);
+    q.label = label;
+    program->current->code.push_back(q);
+}
+
+void EmitJump(int op, Operand cond, unsigned label)
+{
+    Quad q(op);
+    q.arg1 = cond;
+    q.label = label;
+    program->current->code.push_back(q);
+}
+
+void EmitParam(Operand a)
+{
+    Quad q(IR_PARAM);
+    q.arg1 = a;
+    program->current->code.push_back(q);
+}
+
+void EmitCall(Operand dst, string func)
+{
+    Quad q(IR_CALL);
+    q.dst = dst;
+    q.name = func;
+    program->current->code.push_back(q);
+}
+
+void EmitReturn(Operand a)
+{
+    Quad q(IR_RETURN);
+    q.arg1 = a;
+    program->current->code.push_back(q);
+}
+
+void EmitVLoad(Operand dst, string array, Operand i, Operand j, int stride, int lanes)
+{
+    EmitLoad(dst, array, i, j, stride);
+    program->current->code.back().op = IR_VLOAD;
+    program->current->code.back().lanes = lanes;
+}
+
+void EmitVStore(string array, Operand i, Operand j, int stride, int lanes, Operand value)
+{
+    EmitStore(array, i, j, stride, value);
+    program->current->code.back().op = IR_VSTORE;
+    program->current->code.back().lanes = lanes;
+}
+
+void EmitVBinary(Operand dst, Operand a, string oper, Operand b, int lanes)
+{
+    EmitBinary(dst, a, oper, b);
+    program->current->code.back().op = IR_VBINARY;
+    program->current->code.back().lanes = lanes;
+}
+
+// ---------
+// Impressão
+// ---------
+
+static void PrintFunction(Program * p, Function * f)
+{
+    for (Quad & q : f->code)
+    {
+        if (q.op == IR_FUNC)
+        {
+            // o corpo da função aparece no ponto em que foi definida
+            Function * g = p->Find(q.name);
+            cout << q.ToString() << endl;
+            PrintFunction(p, g);
+            cout << '\t' << endl;
+        }
+        else
+        {
+            cout << q.ToString() << endl;
+        }
+    }
+}
+
+void Print(Program * p)
+{
+    PrintFunction(p, p->Main());
+}
@@ -0,0 +1,157 @@
+#ifndef COMPILER_IR
+#define COMPILER_IR
+
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "symtable.h"
+using std::string;
+using std::vector;
+
+// categorias de operandos do código de três endereços
+enum OperandKind
+{
+    OPD_NONE,
+    OPD_TEMP,
+    OPD_VAR,
+    OPD_CONST,
+    OPD_VECTOR      // temporário vetorial, com um valor por elemento
+};
+
+// instruções do código de três endereços
+enum IrOp
+{
+    IR_COPY,        // dst = arg1
+    IR_BINARY,      // dst = arg1 oper arg2
+    IR_UNARY,       // dst = oper arg1
+    IR_LOAD,        // dst = name[idx1] ou dst = name[idx1 * stride + idx2]
+    IR_STORE,       // name[idx1] = arg1 ou name[idx1:idx2] = arg1
+    IR_LABEL,       // L<label>:
+    IR_GOTO,        // goto L<label>
+    IR_IFFALSE,     // ifFalse arg1 goto L<label>
+    IR_IFTRUE,      // ifTrue arg1 goto L<label>
+    IR_PARAM,       // param arg1
+    IR_CALL,        // dst = call name
+    IR_RETURN,      // return arg1
+    IR_FUNC,        // posição da definição da função name no código envolvente
+    IR_VLOAD,       // dst = vload name[idx1 ...], lanes elementos consecutivos
+    IR_VSTORE,      // vstore name[idx1 ...] = arg1, lanes elementos consecutivos
+    IR_VBINARY,     // dst = arg1 oper arg2 elemento a elemento; escalares valem para todos
+    IR_SELECT       // dst = arg1 ? arg2 : arg3, sem desvio (movimentação condicional)
+};
+
+// operando: temporário, variável ou constante
+struct Operand
+{
+    int kind;
+    int type;
+    string name;
+
+    Operand();
+    Operand(int k, int t, string n);
+    Operand(Expression *e);
+    bool IsTemp() const;
+    bool IsVar() const;
+    bool IsConst() const;
+    bool IsName() const;
+    string ToString() const;
+};
+
+// instrução de três endereços (quádrupla)
+struct Quad
+{
+    int op;
+    string oper;        // operador de IR_BINARY e IR_UNARY
+    Operand dst;
+    Operand arg1;
+    Operand arg2;
+    Operand arg3;       // valor de IR_SELECT quando a condição é falsa
+    string name;        // arranjo de IR_LOAD/IR_STORE ou função de IR_CALL/IR_FUNC
+    Operand idx1;       // índices de IR_LOAD/IR_STORE
+    Operand idx2;       // vazio em arranjos unidimensionais
+    int stride;         // tamanho da linha em arranjos bidimensionais
+    int lanes;          // elementos das operações vetoriais
+    unsigned label;     // alvo de desvios e rótulos
+
+    Quad(int o);
+    Operand * Def();
+    vector<Operand*> Uses();
+    bool IsJump() const;
+    bool IsBranch() const;
+    bool IsPure() const;
+    bool CanTrap() const;
+    bool IsLoad() const;
+    bool IsStore() const;
+    string ToString();
+};
+
+// laço 🧬 com número de iterações conhecido na compilação; os rótulos
+// delimitam o corpo (before), o incremento (step) e a saída (after)
+struct CountedLoop
+{
+    unsigned before;
+    unsigned step;
+    unsigned after;
+    string var;         // variável de controle
+    int init;           // valor inicial
+    int inc;            // incremento por iteração
+    int trips;          // número de iterações
+};
+
+// código de uma função (ou do programa principal)
+struct Function
+{
+    string name;
+    string ret;
+    vector<string> params;
+    vector<Symbol> locals;      // parâmetros e variáveis declaradas na função
+    vector<Quad> code;
+    vector<CountedLoop> counted;
+    bool parallel = false;      // corpo de um laço 🧵: os três primeiros parâmetros são a
+                                // faixa [primeira, fim) de iterações e o indicador da última
+
+    Function(string n);
+    Symbol * Local(const string & var);
+};
+
+// programa traduzido: funcs[0] contém o código do programa principal
+struct Program
+{
+    vector<Function*> funcs;
+    Function * current;
+
+    Program();
+    Function * Main();
+    Function * Find(string name);
+    Function * Begin(string name);
+    void End(Function * saved);
+};
+
+// tipo de expressão correspondente ao nome de um tipo declarado
+int TypeOf(const string & type);
+
+// novos temporários e rótulos usam os mesmos contadores da árvore sintática
+Operand NewTemp(int type);
+Operand NewVector(int type);
+unsigned NewLabel();
+
+// emissão de instruções na função corrente
+void EmitCopy(Operand dst, Operand src);
+void EmitBinary(Operand dst, Operand a, string oper, Operand b);
+void EmitUnary(Operand dst, string oper, Operand a);
+void EmitLoad(Operand dst, string array, Operand i, Operand j, int stride);
+void EmitStore(string array, Operand i, Operand j, int stride, Operand value);
+void EmitLabel(unsigned label);
+void EmitGoto(unsigned label);
+void EmitJump(int op, Operand cond, unsigned label);
+void EmitParam(Operand a);
+void EmitCall(Operand dst, string func);
+void EmitReturn(Operand a);
+void EmitVLoad(Operand dst, string array, Operand i, Operand j, int stride, int lanes);
+void EmitVStore(string array, Operand i, Operand j, int stride, int lanes, Operand value);
+void EmitVBinary(Operand dst, Operand a, string oper, Operand b, int lanes);
+
+// impressão do código de três endereços
+void Print(Program * p);
+
+#endif
@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <csetjmp>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "jit.h"
+#include "cache.h"
+#include "vm.h"
+#include "options.h"
+#include "pool.h"
+#include "error.h"
+
+extern Options options;
+
+// --------
+// Encoding
+// --------
+
+// número do registrador nos campos da instrução (xmm0..xmm15 são 0..15)
+static int Number(int reg)
+{
+    return reg >= XMM0 ? reg - XMM0 : reg;
+}
+
+static bool FitsByte(int64_t v)
+{
+    return v >= -128 && v <= 127;
+}
+
+// chamadas diretas apenas entre funções do programa; as demais rotinas são
+// alcançadas pela tabela de endereços
+static bool Direct(const string & symbol)
+{
+    return symbol.compare(0, 3, "fn_") == 0 || symbol == "tr_main";
+}
+
+static string TableSymbol(const string & routine)
+{
+    return "*" + routine;
+}
+
+class Encoder
+{
+private:
+    const MFunction & func;
+    MachineCode result;
+    vector<int64_t> labels;                 // posição de cada rótulo
+    vector<pair<size_t, int>> jumps;        // deslocamentos para rótulos
+    size_t pending = 0;                     // primeiro fixup da instrução
+
+    void Byte(int b);
+    void Int32(int64_t v);
+    void Immediate(int64_t v, int bytes);
+    void ModRM(int reg, const MOperand & rm);
+    void Op(int prefix, bool wide, bool bytes, std::initializer_list<int> opcode, int reg, const MOperand & rm);
+    void Jump(std::initializer_list<int> opcode, int label);
+    void Arith(int ext, const MInstr & i);
+    void Translate(const MInstr & i);
+
+public:
+    Encoder(const MFunction & f);
+    MachineCode Run();
+};
+
+Encoder::Encoder(const MFunction & f) :
+    func(f),
+    labels(f.labels, -1)
+{
+    result.name = f.name;
+}
+
+void Encoder::Byte(int b)
+{
+    result.bytes.push_back(uint8_t(b));
+}
+
+void Encoder::Int32(int64_t v)
+{
+    for (int k = 0; k < 4; ++k)
+        Byte(int(v >> (8 * k)) & 0xFF);
+}
+
+void Encoder::Immediate(int64_t v, int bytes)
+{
+    if (bytes == 1)
+        Byte(int(v) & 0xFF);
+    else
+        Int32(v);
+}
+
+// modo de endereçamento: registrador, [base + index * scale + disp] ou
+// [rip + disp] para símbolos
+void Encoder::ModRM(int reg, const MOperand & rm)
+{
+    int r = (reg & 7) << 3;
+    if (rm.IsReg())
+    {
+        Byte(0xC0 | r | (Number(rm.reg) & 7));
+        return;
+    }
+    if (!rm.symbol.empty())
+    {
+        Byte(0x05 | r);
+        result.fixups.push_back(Fixup{result.bytes.size(), 0, rm.symbol, rm.imm});
+        Int32(0);
+        return;
+    }
+
+    // rbp e r13 sem deslocamento significariam rip; rsp e r12 exigem sib
+    int base = rm.reg & 7;
+    int mod = (rm.imm == 0 && base != 5) ? 0 : FitsByte(rm.imm) ? 1 : 2;
+    bool sib = (rm.index != NOREG || base == 4);
+    Byte((mod << 6) | r | (sib ? 4 : base));
+    if (sib)
+    {
+        int scale = (rm.scale == 8) ? 3 : (rm.scale == 4) ? 2 : (rm.scale == 2) ? 1 : 0;
+        int index = (rm.index != NOREG) ? (rm.index & 7) : 4;
+        Byte((scale << 6) | (index << 3) | base);
+    }
+    if (mod == 1)
+        Byte(int(rm.imm) & 0xFF);
+    else if (mod == 2)
+        Int32(rm.imm);
+}
+
+// prefixo obrigatório, REX, código e operandos; operações de 8 bits sempre
+// levam REX, para que sil, dil e r8b..r15b sejam endereçáveis
+void Encoder::Op(int prefix, bool wide, bool bytes, std::initializer_list<int> opcode, int reg, const MOperand & rm)
+{
+    if (prefix)
+        Byte(prefix);
+    int rex = (wide ? 8 : 0) | ((reg & 8) ? 4 : 0);
+    if (rm.IsReg())
+        rex |= (Number(rm.reg) & 8) ? 1 : 0;
+    else if (rm.IsMem() && rm.symbol.empty())
+    {
+        rex |= (rm.reg & 8) ? 1 : 0;
+        rex |= (rm.index != NOREG && (rm.index & 8)) ? 2 : 0;
+    }
+    if (rex || bytes)
+        Byte(0x40 | rex);
+    for (int b : opcode)
+        Byte(b);
+    ModRM(reg, rm);
+}
+
+void Encoder::Jump(std::initializer_list<int> opcode, int label)
+{
+    for (int b : opcode)
+        Byte(b);
+    jumps.push_back({result.bytes.size(), label});
+    Int32(0);
+}
+
+// add, or, and, sub, xor e cmp: ext é o campo reg das formas com imediato
+void Encoder::Arith(int ext, const MInstr & i)
+{
+    bool wide = (i.size == 8);
+    bool bytes = (i.size == 1);
+    if (i.src.IsImm())
+    {
+        if (bytes)
+            Op(0, false, true, {0x80}, ext, i.dst);
+        else
+            Op(0, wide, false, {FitsByte(i.src.imm) ? 0x83 : 0x81}, ext, i.dst);
+        Immediate(i.src.imm, (bytes || FitsByte(i.src.imm)) ? 1 : 4);
+    }
+    else if (i.src.IsReg())
+        Op(0, wide, bytes, {ext * 8 + (bytes ? 0 : 1)}, Number(i.src.reg), i.dst);
+    else
+        Op(0, wide, bytes, {ext * 8 + (bytes ? 2 : 3)}, Number(i.dst.reg), i.src);
+}
+
+void Encoder::Translate(const MInstr & i)
+{
+    static const int sse[] = {0x58, 0x5C, 0x59, 0x5E};     // addsd, subsd, mulsd, divsd
+    // paddd, psubd, addpd, subpd, mulpd, divpd, punpckldq, punpcklqdq
+    static const int packed[] = {0xFE, 0xFA, 0x58, 0x5C, 0x59, 0x5E, 0x62, 0x6C};
+
+    const MOperand & dst = i.dst;
+    const MOperand & src = i.src;
+    bool wide = (i.size == 8);
+    bool bytes = (i.size == 1);
+    switch (i.op)
+    {
+    case M_LABEL:
+        labels[dst.imm] = result.bytes.size();
+        break;
+    case M_MOV:
+        if (src.IsImm())
+        {
+            Op(0, wide, bytes, {bytes ? 0xC6 : 0xC7}, 0, dst);
+            Immediate(src.imm, bytes ? 1 : 4);
+        }
+        else if (src.IsReg())
+            Op(0, wide, bytes, {bytes ? 0x88 : 0x89}, Number(src.reg), dst);
+        else
+            Op(0, wide, bytes, {bytes ? 0x8A : 0x8B}, Number(dst.reg), src);
+        break;
+    case M_MOVZX:
+        Op(0, false, true, {0x0F, 0xB6}, Number(dst.reg), src);
+        break;
+    case M_LEA:
+        Op(0, true, false, {0x8D}, Number(dst.reg), src);
+        break;
+    case M_ADD:
+        Arith(0, i);
+        break;
+    case M_OR:
+        Arith(1, i);
+        break;
+    case M_AND:
+        Arith(4, i);
+        break;
+    case M_SUB:
+        Arith(5, i);
+        break;
+    case M_XOR:
+        Arith(6, i);
+        break;
+    case M_CMP:
+        Arith(7, i);
+        break;
+    case M_IMUL:
+        if (src.IsImm())
+        {
+            Op(0, wide, false, {FitsByte(src.imm) ? 0x6B : 0x69}, Number(dst.reg), dst);
+            Immediate(src.imm, FitsByte(src.imm) ? 1 : 4);
+        }
+        else
+            Op(0, wide, false, {0x0F, 0xAF}, Number(dst.reg), src);
+        break;
+    case M_SHL:
+    case M_SAR:
+        if (src.IsImm())
+        {
+            Op(0, wide, false, {0xC1}, i.op == M_SHL ? 4 : 7, dst);
+            Byte(int(src.imm) & 0xFF);
+        }
+        else
+            Op(0, wide, false, {0xD3}, i.op == M_SHL ? 4 : 7, dst);
+        break;
+    case M_BTC:
+        Op(0, wide, false, {0x0F, 0xBA}, 7, dst);
+        Byte(int(src.imm) & 0xFF);
+        break;
+    case M_NEG:
+        Op(0, wide, false, {0xF7}, 3, dst);
+        break;
+    case M_CDQ:
+        Byte(0x99);
+        break;
+    case M_IDIV:
+        Op(0, wide, false, {0xF7}, 7, dst);
+        break;
+    case M_SET:
+        Op(0, false, true, {0x0F, 0x90 + i.cond}, 0, dst);
+        break;
+    case M_CMOV:
+        Op(0, wide, false, {0x0F, 0x40 + i.cond}, Number(dst.reg), src);
+        break;
+    case M_MOVSD:
+        if (dst.IsReg())
+            Op(0xF2, false, false, {0x0F, 0x10}, Number(dst.reg), src);
+        else
+            Op(0xF2, false, false, {0x0F, 0x11}, Number(src.reg), dst);
+        break;
+    case M_MOVQ:
+        if (dst.IsReg() && dst.reg >= XMM0)
+            Op(0x66, wide, false, {0x0F, 0x6E}, Number(dst.reg), src);
+        else
+            Op(0x66, wide, false, {0x0F, 0x7E}, Number(src.reg), dst);
+        break;
+    case M_ADDSD:
+    case M_SUBSD:
+    case M_MULSD:
+    case M_DIVSD:
+        Op(0xF2, false, false, {0x0F, sse[i.op - M_ADDSD]}, Number(dst.reg), src);
+        break;
+    case M_UCOMISD:
+        Op(0x66, false, false, {0x0F, 0x2E}, Number(dst.reg), src);
+        break;
+    case M_CVTSI2SD:
+        Op(0xF2, false, false, {0x0F, 0x2A}, Number(dst.reg), src);
+        break;
+    case M_CVTTSD2SI:
+        Op(0xF2, false, false, {0x0F, 0x2C}, Number(dst.reg), src);
+        break;
+    case M_MOVDQU:
+        if (dst.IsReg())
+            Op(0xF3, false, false, {0x0F, 0x6F}, Number(dst.reg), src);
+        else
+            Op(0xF3, false, false, {0x0F, 0x7F}, Number(src.reg), dst);
+        break;
+    case M_PADDD:
+    case M_PSUBD:
+    case M_ADDPD:
+    case M_SUBPD:
+    case M_MULPD:
+    case M_DIVPD:
+    case M_PUNPCKLDQ:
+    case M_PUNPCKLQDQ:
+        Op(0x66, false, false, {0x0F, packed[i.op - M_PADDD]}, Number(dst.reg), src);
+        break;
+    case M_PUSH:
+    case M_POP:
+        if (dst.reg & 8)
+            Byte(0x41);
+        Byte((i.op == M_PUSH ? 0x50 : 0x58) + (dst.reg & 7));
+        break;
+    case M_JMP:
+        Jump({0xE9}, dst.imm);
+        break;
+    case M_JCC:
+        Jump({0x0F, 0x80 + i.cond}, dst.imm);
+        break;
+    case M_CALL:
+        if (Direct(dst.symbol))
+        {
+            Byte(0xE8);
+            result.fixups.push_back(Fixup{result.bytes.size(), 0, dst.symbol, 0});
+            Int32(0);
+        }
+        else
+            Op(0, false, false, {0xFF}, 2, SymOp(TableSymbol(dst.symbol)));
+        break;
+    case M_LEAVE:
+        Byte(0xC9);
+        break;
+    case M_RET:
+        Byte(0xC3);
+        break;
+    default:
+        throw RuntimeError{"instrução de máquina sem codificação"};
+    }
+
+    // deslocamentos relativos ao fim da instrução
+    for (; pending < result.fixups.size(); ++pending)
+        result.fixups[pending].end = result.bytes.size();
+}
+
+MachineCode Encoder::Run()
+{
+    for (const MInstr & i : func.code)
+        Translate(i);
+
+    // desvios sempre com deslocamento de 32 bits, resolvidos no fim
+    for (auto & jump : jumps)
+    {
+        int64_t rel = labels[jump.second] - int64_t(jump.first + 4);
+        for (int k = 0; k < 4; ++k)
+            result.bytes[jump.first + k] = uint8_t(rel >> (8 * k));
+    }
+    for (auto & entry : func.entries)
+        result.entries.push_back({entry.first, size_t(labels[entry.second])});
+    return result;
+}
+
+MachineCode Encode(const MFunction & f)
+{
+    Encoder encoder(f);
+    return encoder.Run();
+}
+
+// -------
+// Runtime
+// -------
+
+// erros de execução no código nativo voltam ao chamador por longjmp, já
+// que as funções geradas não têm informação para desempilhar exceções; cada
+// thread dos laços 🧵 tem o seu ponto de retorno
+static thread_local jmp_buf * escape = nullptr;
+static thread_local string failure;
+
+static void Bounds(int32_t index)
+{
+    failure = "índice " + std::to_string(index) + " fora dos limites do arranjo";
+    longjmp(*escape, 1);
+}
+
+static void DivZero()
+{
+    failure = "divisão por zero";
+    longjmp(*escape, 1);
+}
+
+// a rotina protegida não deve ter objetos com destrutores entre ela e o
+// código nativo, já que o longjmp os ignora
+void Protect(const std::function<void()> & body)
+{
+    jmp_buf env;
+    jmp_buf * outer = escape;
+    escape = &env;
+    if (setjmp(env))
+    {
+        escape = outer;
+        throw RuntimeError{failure};
+    }
+    body();
+    escape = outer;
+}
+
+// laço 🧵: args traz as count palavras dos parâmetros da função do corpo, e
+// cada bloco de iterações chama a ponte com uma cópia que tem a sua faixa
+static bool Divide(void * bridge, const uint64_t * args, int32_t count)
+{
+    auto call = reinterpret_cast<void (*)(const uint64_t *, uint64_t *)>(bridge);
+    int32_t end = int32_t(args[1]);
+    int32_t last = int32_t(args[2]);
+    try
+    {
+        RunParallel(int32_t(args[0]), end, [&](int, int first, int stop)
+        {
+            vector<uint64_t> range(args, args + count);
+            range.push_back(0);
+            range[0] = uint32_t(first);
+            range[1] = uint32_t(stop);
+            range[2] = uint32_t(stop == end ? last : 0);
+            uint64_t out = 0;
+            Protect([&] { call(range.data(), &out); });
+        });
+    }
+    catch (RuntimeError & e)
+    {
+        failure = e.Description();
+        return false;
+    }
+    return true;
+}
+
+// o erro de um bloco continua no código que chamou, como os demais; não
+// há objetos com destrutores neste quadro
+static int32_t Spread(void * bridge, const uint64_t * args, int32_t count)
+{
+    if (!Divide(bridge, args, count))
+        longjmp(*escape, 1);
+    return int32_t(args[1]);
+}
+
+// -----
+// Image
+// -----
+
+static size_t Round(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+// espaço reservado para o código, além dos dados
+static const size_t CodeReserve = size_t(256) << 20;
+
+Image::Image(Module & m) :
+    module(m)
+{
+    // disposição dos dados: globais contíguas por banco, arranjos alinhados
+    // com cabeçalho, constantes reais e a tabela de rotinas externas
+    map<string, size_t> offsets;
+    size_t size = 0;
+    for (int k = 0; k < int(m.globals[BANK_FLOAT]); ++k)
+        offsets[GlobalSymbol(BANK_FLOAT, k)] = size + 8 * k;
+    size += 8 * m.globals[BANK_FLOAT];
+    for (int k = 0; k < int(m.globals[BANK_INT]); ++k)
+        offsets[GlobalSymbol(BANK_INT, k)] = size + 4 * k;
+    size += 4 * m.globals[BANK_INT];
+    for (int k = 0; k < int(m.globals[BANK_BOOL]); ++k)
+        offsets[GlobalSymbol(BANK_BOOL, k)] = size + k;
+    size += m.globals[BANK_BOOL];
+    for (ArrayDecl & a : m.arrays)
+    {
+        size = Round(size, ArrayAlign) + ArrayAlign;
+        offsets[GlobalSymbol(BANK_ARRAY, a.slot)] = size;
+        size += std::max(a.rows * a.cols * ElementBytes(a.bank), 1);
+    }
+    size = Round(size, 8);
+    for (int c = 0; c < int(m.chunks.size()); ++c)
+    {
+        for (int k = 0; k < int(m.chunks[c].floats.size()); ++k)
+        {
+            offsets[ConstSymbol(c, k)] = size;
+            size += 8;
+        }
+    }
+    const vector<pair<string, void *>> routines =
+    {
+        {BoundsRoutine, reinterpret_cast<void *>(&Bounds)},
+        {DivZeroRoutine, reinterpret_cast<void *>(&DivZero)},
+        {ParallelRoutine, reinterpret_cast<void *>(&Spread)},
+        {"memmove", reinterpret_cast<void *>(&memmove)}
+    };
+    for (auto & r : routines)
+    {
+        offsets[TableSymbol(r.first)] = size;
+        size += 8;
+    }
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    data = Round(std::max(size, size_t(1)), page);
+    reserved = data + CodeReserve;
+    void * p = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        throw RuntimeError{"falha ao reservar memória para o código nativo"};
+    region = static_cast<uint8_t *>(p);
+    if (mprotect(region, data, PROT_READ | PROT_WRITE) != 0)
+        throw RuntimeError{"falha ao proteger a memória do código nativo"};
+
+    for (auto & o : offsets)
+        Define(o.first, o.second);
+    for (ArrayDecl & a : m.arrays)
+    {
+        int32_t * header = reinterpret_cast<int32_t *>(symbols[GlobalSymbol(BANK_ARRAY, a.slot)] - ArrayHeader);
+        header[0] = a.rows * a.cols;
+        header[1] = ElementBytes(a.bank);
+    }
+    for (int c = 0; c < int(m.chunks.size()); ++c)
+    {
+        for (int k = 0; k < int(m.chunks[c].floats.size()); ++k)
+            memcpy(symbols[ConstSymbol(c, k)], &m.chunks[c].floats[k], sizeof(double));
+    }
+    for (auto & r : routines)
+        memcpy(symbols[TableSymbol(r.first)], &r.second, sizeof(void *));
+}
+
+Image::~Image()
+{
+    if (region)
+        munmap(region, reserved);
+}
+
+void Image::Define(const string & symbol, size_t offset)
+{
+    symbols[symbol] = region + offset;
+}
+
+// copia as funções para páginas novas, resolve os deslocamentos e só então
+// torna as páginas executáveis
+void Image::Install(const vector<MachineCode> & functions)
+{
+    vector<size_t> starts;
+    size_t size = 0;
+    for (const MachineCode & f : functions)
+    {
+        size = Round(size, 16);
+        starts.push_back(size);
+        size += f.bytes.size();
+    }
+    size_t pages = Round(std::max(size, size_t(1)), sysconf(_SC_PAGESIZE));
+    if (data + code + pages > reserved)
+        throw RuntimeError{"memória reservada para o código nativo esgotada"};
+
+    uint8_t * at = region + data + code;
+    if (mprotect(at, pages, PROT_READ | PROT_WRITE) != 0)
+        throw RuntimeError{"falha ao proteger a memória do código nativo"};
+    memset(at, 0xCC, pages);
+    for (size_t k = 0; k < functions.size(); ++k)
+    {
+        memcpy(at + starts[k], functions[k].bytes.data(), functions[k].bytes.size());
+        Define(functions[k].name, data + code + starts[k]);
+        for (auto & entry : functions[k].entries)
+            Define(entry.first, data + code + starts[k] + entry.second);
+    }
+
+    for (size_t k = 0; k < functions.size(); ++k)
+    {
+        uint8_t * start = at + starts[k];
+        for (const Fixup & f : functions[k].fixups)
+        {
+            int64_t rel = static_cast<uint8_t *>(Address(f.symbol)) + f.addend - (start + f.end);
+            int32_t disp = int32_t(rel);
+            memcpy(start + f.at, &disp, sizeof(disp));
+        }
+    }
+
+    if (mprotect(at, pages, PROT_READ | PROT_EXEC) != 0)
+        throw RuntimeError{"falha ao proteger a memória do código nativo"};
+    code += pages;
+}
+
+void * Image::Address(const string & symbol) const
+{
+    auto s = symbols.find(symbol);
+    if (s == symbols.end())
+        throw RuntimeError{"símbolo " + symbol + " não definido no código nativo"};
+    return s->second;
+}
+
+int32_t * Image::Ints() const
+{
+    return reinterpret_cast<int32_t *>(region + 8 * module.globals[BANK_FLOAT]);
+}
+
+double * Image::Floats() const
+{
+    return reinterpret_cast<double *>(region);
+}
+
+uint8_t * Image::Bools() const
+{
+    return region + 8 * module.globals[BANK_FLOAT] + 4 * module.globals[BANK_INT];
+}
+
+// ---------
+// Execution
+// ---------
+
+void RunJit(Program * p)
+{
+    Module module = Lower(p);
+    Image image(module);
+    CodeCache cache(module, options.codeCache);
+    vector<MachineCode> functions;
+    for (int c = 0; c < int(module.chunks.size()); ++c)
+    {
+        functions.push_back(cache.Compile(module, c, CODE_PROCEDURE));
+        if (module.chunks[c].parallel)
+            functions.push_back(cache.Compile(module, c, CODE_BRIDGE));
+    }
+    image.Install(functions);
+
+    void (*entry)() = reinterpret_cast<void (*)()>(image.Address("tr_main"));
+    Protect(entry);
+
+    vector<void *> arrays(module.globals[BANK_ARRAY], nullptr);
+    for (ArrayDecl & a : module.arrays)
+        arrays[a.slot] = image.Address(GlobalSymbol(BANK_ARRAY, a.slot));
+    PrintGlobals(module, std::cout, image.Ints(), image.Floats(), image.Bools(), arrays);
+}
@@ -0,0 +1,73 @@
+#ifndef COMPILER_JIT
+#define COMPILER_JIT
+
+#include <functional>
+#include <map>
+#include "ir.h"
+#include "x86.h"
+using std::map;
+using std::pair;
+
+// deslocamento de 32 bits a resolver, relativo ao fim da instrução: rótulo
+// da própria função (resolvido na codificação) ou símbolo (na instalação)
+struct Fixup
+{
+    size_t at;          // posição do deslocamento no código
+    size_t end;         // fim da instrução
+    string symbol;
+    int64_t addend;
+};
+
+// código de máquina de uma função, com as referências a símbolos pendentes
+struct MachineCode
+{
+    string name;
+    vector<uint8_t> bytes;
+    vector<Fixup> fixups;
+    vector<pair<string, size_t>> entries;   // outras entradas e sua posição
+};
+
+// codificação x86-64 das instruções escolhidas pela seleção; chamadas a
+// rotinas externas passam pela tabela de endereços da imagem
+MachineCode Encode(const MFunction & f);
+
+// imagem executável do programa: dados globais e código numa mesma região
+// reservada, para que os endereços relativos a rip alcancem os dados; cada
+// instalação usa páginas novas, escritas e depois protegidas contra escrita
+// antes de receberem permissão de execução (W^X)
+class Image
+{
+private:
+    Module & module;
+    uint8_t * region = nullptr;
+    size_t reserved = 0;
+    size_t data = 0;                // bytes de dados, em páginas inteiras
+    size_t code = 0;                // fim do código instalado
+    map<string, uint8_t *> symbols;
+
+    void Define(const string & symbol, size_t offset);
+
+public:
+    Image(Module & m);
+    ~Image();
+    Image(const Image &) = delete;
+    Image & operator=(const Image &) = delete;
+
+    void Install(const vector<MachineCode> & functions);
+    void * Address(const string & symbol) const;
+
+    // variáveis globais, contíguas por banco
+    int32_t * Ints() const;
+    double * Floats() const;
+    uint8_t * Bools() const;
+};
+
+// executa código nativo instalado: os erros de execução voltam ao chamador
+// como RuntimeError
+void Protect(const std::function<void()> & body);
+
+// compila o programa para a memória e o executa no próprio processo,
+// exibindo o estado final das variáveis como a máquina virtual
+void RunJit(Program * p);
+
+#endif
@@ -21,6 +21,8 @@ Lexer::Lexer()
 	token_table["🧬"]	  = Token{ Tag::FOR,       "for" };
 	token_table["👻"]	  = Token{ Tag::FUNC,     "func" };
 	token_table["🦋"] = Token{ Tag::RETURN, "return" };
+	token_table["🔒"] = Token{ Tag::NOALIAS, "noalias" };
+	token_table["🧵"] = Token{ Tag::PARFOR, "parfor" };
 
 	
 	// inicia leitura da entrada
@@ -0,0 +1,997 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include "llvmir.h"
+#include "bytecode.h"
+#include "alias.h"
+#include "error.h"
+using std::endl;
+using std::map;
+
+// -----
+// Names
+// -----
+
+static const char * types[BANK_COUNT] = {"i32", "double", "i8", "void"};
+static const char * prefixes[BANK_COUNT] = {"i", "f", "b", "a"};
+static const int sizes[BANK_COUNT] = {4, 8, 1, 8};
+
+// identificador LLVM: nomes com bytes fora de [A-Za-z0-9._] vão entre aspas,
+// com esses bytes em hexadecimal
+static string Identifier(const string & name)
+{
+    bool plain = !name.empty() && !isdigit((unsigned char)name[0]);
+    string s;
+    for (unsigned char ch : name)
+    {
+        if ((isalnum(ch) && ch < 128) || ch == '.' || ch == '_')
+            s += char(ch);
+        else
+        {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\%02X", ch);
+            s += buffer;
+            plain = false;
+        }
+    }
+    return plain ? s : "\"" + s + "\"";
+}
+
+static string FunctionName(Module & m, int chunk)
+{
+    if (chunk == 0)
+        return "@tr.main";
+    return "@" + Identifier("fn." + m.chunks[chunk].name);
+}
+
+static string Literal(int32_t v)
+{
+    return std::to_string(v);
+}
+
+// reais pelo padrão de bits, sem perda de precisão
+static string Literal(double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "0x%016llX", (unsigned long long)bits);
+    return buffer;
+}
+
+// acesso a elementos e variáveis globais: cada tipo de elemento é um tipo
+// TBAA próprio, já que arranjos de tipos diferentes nunca se sobrepõem
+static string Tbaa(int bank)
+{
+    return ", !tbaa !" + std::to_string(4 + bank);
+}
+
+// textos constantes, definidos no fim do módulo
+class Strings
+{
+private:
+    map<string, string> symbols;
+    vector<string> texts;
+
+public:
+    string Pointer(const string & text);
+    void Define(std::ostream & out);
+};
+
+string Strings::Pointer(const string & text)
+{
+    string & symbol = symbols[text];
+    if (symbol.empty())
+    {
+        symbol = "@.str." + std::to_string(texts.size());
+        texts.push_back(text);
+    }
+    string type = "[" + std::to_string(text.size() + 1) + " x i8]";
+    return "getelementptr inbounds (" + type + ", " + type + "* " + symbol + ", i64 0, i64 0)";
+}
+
+void Strings::Define(std::ostream & out)
+{
+    for (size_t k = 0; k < texts.size(); ++k)
+    {
+        out << "@.str." << k << " = private unnamed_addr constant [" << texts[k].size() + 1 << " x i8] c\"";
+        for (unsigned char ch : texts[k])
+        {
+            if (ch < 32 || ch > 126 || ch == '"' || ch == '\\')
+            {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\%02X", ch);
+                out << buffer;
+            }
+            else
+                out << ch;
+        }
+        out << "\\00\"" << endl;
+    }
+}
+
+// ---------
+// Functions
+// ---------
+
+// tradução de uma função da máquina virtual: os registradores ficam em
+// allocas do bloco de entrada, e cada instrução que é destino de desvio ou
+// segue um desvio inicia um bloco básico
+class LlvmEmitter
+{
+private:
+    Module & module;
+    Function * source;
+    int index;
+    Chunk & chunk;
+    std::ostream & out;
+    vector<Instr> params;
+    vector<bool> starts;            // instruções que iniciam um bloco
+    int returned = BANK_INT;        // banco dos elementos do arranjo devolvido
+    vector<bool> shared;            // arranjos globais usados pela função e pelas que ela chama
+    int temps = 0;
+    bool open = false;              // bloco atual ainda sem terminador
+
+    string Temp();
+    string Load(uint32_t ref, int bank);
+    void Store(uint32_t ref, int bank, const string & value);
+    string Condition(uint32_t ref);
+    int ElementBank(uint32_t ref);
+    string Elements(uint32_t ref);
+    string Count(uint32_t ref);
+    string Address(uint32_t array, const string & index);
+    string Offset(uint32_t ref, uint32_t d);
+    string Span(uint32_t array, const string & index, int lanes);
+    string Gather(uint32_t ref, int bank, int lanes);
+    void Scatter(uint32_t ref, int bank, int lanes, const string & value);
+    bool NoAlias(const string & name);
+    string Signature();
+    void Declarations();
+    void Call(const Instr & i);
+    void Return();
+    void Translate(int pc);
+
+public:
+    LlvmEmitter(Module & m, Program * p, int chunk, std::ostream & o);
+    void Run();
+};
+
+LlvmEmitter::LlvmEmitter(Module & m, Program * p, int chunk, std::ostream & o) :
+    module(m),
+    source(p->funcs[chunk]),
+    index(chunk),
+    chunk(m.chunks[chunk]),
+    out(o),
+    starts(m.chunks[chunk].code.size() + 1, false)
+{
+    vector<Instr> & code = this->chunk.code;
+    starts[0] = true;
+    for (int pc = 0; pc < int(code.size()); ++pc)
+    {
+        int op = Generic(code[pc].op);
+        if (IsBranch(op))
+            starts[code[pc].a] = true;
+        if (IsBranch(op) || op == OP_HALT || (op >= OP_RET_I && op <= OP_RET_A))
+            starts[pc + 1] = true;
+    }
+    Symbol * ret = source->Local(source->ret);
+    if (!ret)
+        ret = p->Main()->Local(source->ret);
+    if (ret && ret->valX != -1)
+        returned = (TypeOf(ret->type) == ExprType::FLOAT) ? BANK_FLOAT : (TypeOf(ret->type) == ExprType::BOOL) ? BANK_BOOL : BANK_INT;
+    shared = SharedArrays(m, chunk);
+}
+
+string LlvmEmitter::Temp()
+{
+    return "%t" + std::to_string(temps++);
+}
+
+// valor de um operando: registradores e globais são lidos da memória
+string LlvmEmitter::Load(uint32_t ref, int bank)
+{
+    uint32_t k = ref & IndexMask;
+    switch (ref >> SpaceShift)
+    {
+    case SPACE_LOCAL:
+    case SPACE_GLOBAL:
+    {
+        bool global = (ref >> SpaceShift) == SPACE_GLOBAL;
+        string value = Temp();
+        out << "    " << value << " = load " << types[bank] << ", " << types[bank] << "* "
+            << (global ? "@g" : "%") << prefixes[bank] << k << (global ? Tbaa(bank) : "") << endl;
+        return value;
+    }
+    }
+    if (bank == BANK_FLOAT)
+        return Literal(chunk.floats[k]);
+    if (bank == BANK_BOOL)
+        return chunk.bools[k] ? "1" : "0";
+    return Literal(chunk.ints[k]);
+}
+
+void LlvmEmitter::Store(uint32_t ref, int bank, const string & value)
+{
+    bool global = (ref >> SpaceShift) == SPACE_GLOBAL;
+    out << "    store " << types[bank] << " " << value << ", " << types[bank] << "* "
+        << (global ? "@g" : "%") << prefixes[bank] << (ref & IndexMask) << (global ? Tbaa(bank) : "") << endl;
+}
+
+// valores lógicos ficam em bytes; desvios e seleções usam i1
+string LlvmEmitter::Condition(uint32_t ref)
+{
+    string value = Load(ref, BANK_BOOL);
+    string test = Temp();
+    out << "    " << test << " = icmp ne i8 " << value << ", 0" << endl;
+    return test;
+}
+
+int LlvmEmitter::ElementBank(uint32_t ref)
+{
+    if ((ref >> SpaceShift) == SPACE_GLOBAL)
+    {
+        for (ArrayDecl & a : module.arrays)
+        {
+            if (a.slot == (ref & IndexMask))
+                return a.bank;
+        }
+    }
+    return chunk.elements[ref & IndexMask];
+}
+
+// endereço do primeiro elemento de um arranjo
+string LlvmEmitter::Elements(uint32_t ref)
+{
+    uint32_t k = ref & IndexMask;
+    if ((ref >> SpaceShift) == SPACE_GLOBAL)
+    {
+        for (ArrayDecl & a : module.arrays)
+        {
+            if (a.slot != k)
+                continue;
+            string type = "[" + std::to_string(std::max(a.rows * a.cols, 1)) + " x " + types[a.bank] + "]";
+            return "getelementptr inbounds (" + type + ", " + type + "* @ga" + std::to_string(k) + ", i64 0, i64 0)";
+        }
+    }
+    return "%a" + std::to_string(k);
+}
+
+// número de elementos: constante nos arranjos globais e próprios
+string LlvmEmitter::Count(uint32_t ref)
+{
+    uint32_t k = ref & IndexMask;
+    vector<ArrayDecl> & arrays = ((ref >> SpaceShift) == SPACE_GLOBAL) ? module.arrays : chunk.arrays;
+    for (ArrayDecl & a : arrays)
+    {
+        if (a.slot == k)
+            return std::to_string(a.rows * a.cols);
+    }
+    return "%a" + std::to_string(k) + ".n";
+}
+
+// endereço do elemento, com verificação dos limites
+string LlvmEmitter::Address(uint32_t array, const string & index)
+{
+    const char * type = types[ElementBank(array)];
+    string checked = Temp();
+    out << "    " << checked << " = call i32 @tr.index(i32 " << index << ", i32 " << Count(array) << ")" << endl;
+    string wide = Temp();
+    out << "    " << wide << " = sext i32 " << checked << " to i64" << endl;
+    string address = Temp();
+    out << "    " << address << " = getelementptr inbounds " << type << ", " << type << "* " << Elements(array) << ", i64 " << wide << endl;
+    return address;
+}
+
+// índice b + d das instruções de acesso
+string LlvmEmitter::Offset(uint32_t ref, uint32_t d)
+{
+    string value = Load(ref, BANK_INT);
+    if (d == 0)
+        return value;
+    string sum = Temp();
+    out << "    " << sum << " = add i32 " << value << ", " << d << endl;
+    return sum;
+}
+
+// tipo dos vetores de lanes elementos
+static string VectorType(int bank, int lanes)
+{
+    return "<" + std::to_string(lanes) + " x " + types[bank] + ">";
+}
+
+// endereço de lanes elementos consecutivos, como ponteiro para o vetor;
+// na falha, o índice informado é o primeiro fora dos limites
+string LlvmEmitter::Span(uint32_t array, const string & index, int lanes)
+{
+    int bank = ElementBank(array);
+    string address = Address(array, index);
+    string count = Count(array);
+    string last = Temp();
+    out << "    " << last << " = add i32 " << index << ", " << lanes - 1 << endl;
+    string over = Temp();
+    out << "    " << over << " = icmp uge i32 " << last << ", " << count << endl;
+    string reported = Temp();
+    out << "    " << reported << " = select i1 " << over << ", i32 " << count << ", i32 " << last << endl;
+    out << "    call i32 @tr.index(i32 " << reported << ", i32 " << count << ")" << endl;
+    string pointer = Temp();
+    out << "    " << pointer << " = bitcast " << types[bank] << "* " << address << " to " << VectorType(bank, lanes) << "*" << endl;
+    return pointer;
+}
+
+// valor vetorial formado pelos registradores consecutivos a partir de ref;
+// o otimizador do LLVM elimina a passagem pelos registradores
+string LlvmEmitter::Gather(uint32_t ref, int bank, int lanes)
+{
+    string vector = "undef";
+    for (int k = 0; k < lanes; ++k)
+    {
+        string lane = Load(ref + k, bank);
+        string next = Temp();
+        out << "    " << next << " = insertelement " << VectorType(bank, lanes) << " " << vector << ", "
+            << types[bank] << " " << lane << ", i32 " << k << endl;
+        vector = next;
+    }
+    return vector;
+}
+
+void LlvmEmitter::Scatter(uint32_t ref, int bank, int lanes, const string & value)
+{
+    for (int k = 0; k < lanes; ++k)
+    {
+        string lane = Temp();
+        out << "    " << lane << " = extractelement " << VectorType(bank, lanes) << " " << value << ", i32 " << k << endl;
+        Store(ref + k, bank, lane);
+    }
+}
+
+// o parâmetro marcado com 🔒 é o arranjo devolvido em todos os retornos
+static bool Returned(Chunk & c, Function * f, const string & name)
+{
+    Symbol * s = f->Local(name);
+    if (!s || !s->noalias)
+        return false;
+    uint32_t ref = 0;
+    for (size_t k = 0; k < f->params.size(); ++k)
+    {
+        if (f->params[k] == name)
+            ref = Ref(SPACE_LOCAL, c.params[k].second);
+    }
+    bool any = false;
+    for (const Instr & i : c.code)
+    {
+        if (i.op != OP_RET_A)
+            continue;
+        if (i.a != ref)
+            return false;
+        any = true;
+    }
+    return any;
+}
+
+// o parâmetro não compartilha memória com os demais parâmetros nem com os
+// arranjos globais alcançados sem passar por ele; funções que devolvem
+// arranjos escrevem no arranjo do chamador, que pode ser qualquer um deles,
+// exceto o 🔒 devolvido, que a cópia do retorno pula quando é o próprio
+bool LlvmEmitter::NoAlias(const string & name)
+{
+    if (chunk.ret == BANK_ARRAY && !Returned(chunk, source, name))
+        return false;
+    for (const string & other : source->params)
+    {
+        Symbol * s = source->Local(other);
+        if (other != name && s && s->valX != -1 && MayAlias(source->name, name, other))
+            return false;
+    }
+    for (ArrayDecl & a : module.arrays)
+    {
+        if (shared[a.slot] && MayAlias(source->name, name, a.name))
+            return false;
+    }
+    return true;
+}
+
+// arranjos nunca escapam da função: são nocapture
+string LlvmEmitter::Signature()
+{
+    std::ostringstream s;
+    s << "define internal " << (index == 0 ? "void" : types[chunk.ret]) << " " << FunctionName(module, index) << "(";
+    vector<string> list;
+    if (chunk.ret == BANK_ARRAY)
+        list.push_back(string(types[returned]) + "* nocapture %ret, i32 %ret.n");
+    for (int k = 0; k < int(chunk.params.size()); ++k)
+    {
+        int bank = chunk.params[k].first;
+        string name = prefixes[bank] + std::to_string(chunk.params[k].second);
+        if (bank != BANK_ARRAY)
+        {
+            list.push_back(string(types[bank]) + " %" + name + ".in");
+            continue;
+        }
+        string attributes = NoAlias(source->params[k]) ? "* noalias nocapture %" : "* nocapture %";
+        list.push_back(types[chunk.elements[chunk.params[k].second]] + attributes + name + ", i32 %" + name + ".n");
+    }
+    for (size_t k = 0; k < list.size(); ++k)
+        s << (k ? ", " : "") << list[k];
+    s << ") nounwind";
+    return s.str();
+}
+
+// registradores zerados, como na máquina virtual; arranjos próprios têm os
+// elementos na própria ativação
+void LlvmEmitter::Declarations()
+{
+    // só os registradores que o código usa, e os parâmetros
+    vector<bool> used[BANK_COUNT];
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+        used[bank].assign(chunk.regs[bank], false);
+    for (const Instr & i : chunk.code)
+    {
+        for (const Role & r : Roles(i))
+        {
+            uint32_t ref = Field(i, r.field);
+            for (int k = 0; k < r.count && (ref >> SpaceShift) == SPACE_LOCAL; ++k)
+                used[r.bank][(ref & IndexMask) + k] = true;
+        }
+    }
+    vector<bool> param[BANK_COUNT];
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+        param[bank].assign(chunk.regs[bank], false);
+    for (auto & p : chunk.params)
+        param[p.first][p.second] = true;
+
+    for (int bank = 0; bank < BANK_ARRAY; ++bank)
+    {
+        for (uint32_t k = 0; k < chunk.regs[bank]; ++k)
+        {
+            if (!used[bank][k] && !param[bank][k])
+                continue;
+            string name = prefixes[bank] + std::to_string(k);
+            string initial = param[bank][k] ? "%" + name + ".in" : (bank == BANK_FLOAT ? "0.0" : "0");
+            out << "    %" << name << " = alloca " << types[bank] << endl;
+            out << "    store " << types[bank] << " " << initial << ", " << types[bank] << "* %" << name << endl;
+        }
+    }
+    for (ArrayDecl & a : chunk.arrays)
+    {
+        string name = "%a" + std::to_string(a.slot);
+        int count = std::max(a.rows * a.cols, 1);
+        string type = "[" + std::to_string(count) + " x " + types[a.bank] + "]";
+        out << "    " << name << ".s = alloca " << type << endl;
+        out << "    " << name << ".p = bitcast " << type << "* " << name << ".s to i8*" << endl;
+        out << "    call void @llvm.memset.p0i8.i64(i8* " << name << ".p, i8 0, i64 " << count * sizes[a.bank] << ", i1 false)" << endl;
+        out << "    " << name << " = getelementptr inbounds " << type << ", " << type << "* " << name << ".s, i64 0, i64 0" << endl;
+    }
+}
+
+// os argumentos são as últimas instruções param antes da chamada
+void LlvmEmitter::Call(const Instr & i)
+{
+    Chunk & callee = module.chunks[i.b];
+    vector<Instr> args(params.end() - i.c, params.end());
+    params.resize(params.size() - i.c);
+
+    vector<string> list;
+    if (i.op == OP_CALL_A)
+    {
+        const char * type = types[ElementBank(i.a)];
+        list.push_back(string(type) + "* " + Elements(i.a) + ", i32 " + Count(i.a));
+    }
+    for (int k = 0; k < int(args.size()); ++k)
+    {
+        int bank = callee.params[k].first;
+        if (bank == BANK_ARRAY)
+        {
+            const char * type = types[ElementBank(args[k].a)];
+            list.push_back(string(type) + "* " + Elements(args[k].a) + ", i32 " + Count(args[k].a));
+        }
+        else
+            list.push_back(string(types[bank]) + " " + Load(args[k].a, bank));
+    }
+
+    string call = FunctionName(module, i.b) + "(";
+    for (size_t k = 0; k < list.size(); ++k)
+        call += (k ? ", " : "") + list[k];
+    call += ")";
+    if (i.op == OP_CALL_A)
+    {
+        out << "    call void " << call << endl;
+        return;
+    }
+    int bank = i.op - OP_CALL_I;
+    string value = Temp();
+    out << "    " << value << " = call " << types[bank] << " " << call << endl;
+    Store(i.a, bank, value);
+}
+
+// fim da função sem valor: zero, como na máquina virtual
+void LlvmEmitter::Return()
+{
+    if (index == 0 || chunk.ret == BANK_ARRAY)
+        out << "    ret void" << endl;
+    else
+        out << "    ret " << types[chunk.ret] << (chunk.ret == BANK_FLOAT ? " 0.0" : " 0") << endl;
+    open = false;
+}
+
+void LlvmEmitter::Translate(int pc)
+{
+    static const char * intOps[] = {"add", "sub", "mul", "sdiv", "shl", "ashr", "and"};
+    static const char * floatOps[] = {"fadd", "fsub", "fmul", "fdiv"};
+    static const char * intCompares[] = {"slt", "sle", "sgt", "sge", "eq", "ne"};
+    static const char * floatCompares[] = {"olt", "ole", "ogt", "oge", "oeq", "une"};
+
+    const Instr & i = chunk.code[pc];
+    int op = Generic(i.op);
+    auto I = [this](uint32_t ref) { return Load(ref, BANK_INT); };
+    auto F = [this](uint32_t ref) { return Load(ref, BANK_FLOAT); };
+    auto Label = [](uint32_t target) { return "label %L" + std::to_string(target); };
+    auto Compute = [this](const string & text) { string v = Temp(); out << "    " << v << " = " << text << endl; return v; };
+    // comparação guardada como byte
+    auto Flag = [&](const string & test) { Store(i.a, BANK_BOOL, Compute("zext i1 " + test + " to i8")); };
+
+    switch (op)
+    {
+    case OP_PARAM_I: case OP_PARAM_F: case OP_PARAM_B: case OP_PARAM_A:
+        params.push_back(i);
+        break;
+    case OP_CALL_I: case OP_CALL_F: case OP_CALL_B: case OP_CALL_A:
+        Call(i);
+        break;
+
+    case OP_HALT:
+        Return();
+        break;
+
+    case OP_MOV_I:
+    case OP_MOV_F:
+    case OP_MOV_B:
+        Store(i.a, op - OP_MOV_I, Load(i.b, op - OP_MOV_I));
+        break;
+    case OP_I2F:
+        Store(i.a, BANK_FLOAT, Compute("sitofp i32 " + I(i.b) + " to double"));
+        break;
+    case OP_F2I:
+        Store(i.a, BANK_INT, Compute("fptosi double " + F(i.b) + " to i32"));
+        break;
+
+    // aritmética inteira de 32 bits, com estouro circular
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+    case OP_AND_I:
+    {
+        string b = I(i.b), c = I(i.c);
+        Store(i.a, BANK_INT, Compute(string(intOps[op - OP_ADD_I]) + " i32 " + b + ", " + c));
+        break;
+    }
+    case OP_DIV_I:
+    {
+        string b = I(i.b), c = I(i.c);
+        Store(i.a, BANK_INT, Compute("call i32 @tr.divide(i32 " + b + ", i32 " + c + ")"));
+        break;
+    }
+    case OP_SHL_I:
+    case OP_SHR_I:
+    {
+        string b = I(i.b);
+        string c = Compute("and i32 " + I(i.c) + ", 31");
+        Store(i.a, BANK_INT, Compute(string(intOps[op - OP_ADD_I]) + " i32 " + b + ", " + c));
+        break;
+    }
+    case OP_ADD_F:
+    case OP_SUB_F:
+    case OP_MUL_F:
+    case OP_DIV_F:
+    {
+        string b = F(i.b), c = F(i.c);
+        Store(i.a, BANK_FLOAT, Compute(string(floatOps[op - OP_ADD_F]) + " double " + b + ", " + c));
+        break;
+    }
+    case OP_AND_B:
+    case OP_OR_B:
+    {
+        string b = Load(i.b, BANK_BOOL), c = Load(i.c, BANK_BOOL);
+        Store(i.a, BANK_BOOL, Compute(string(op == OP_AND_B ? "and" : "or") + " i8 " + b + ", " + c));
+        break;
+    }
+    case OP_LT_I: case OP_LE_I: case OP_GT_I: case OP_GE_I: case OP_EQ_I: case OP_NE_I:
+    {
+        string b = I(i.b), c = I(i.c);
+        Flag(Compute(string("icmp ") + intCompares[op - OP_LT_I] + " i32 " + b + ", " + c));
+        break;
+    }
+    case OP_LT_F: case OP_LE_F: case OP_GT_F: case OP_GE_F: case OP_EQ_F: case OP_NE_F:
+    {
+        string b = F(i.b), c = F(i.c);
+        Flag(Compute(string("fcmp ") + floatCompares[op - OP_LT_F] + " double " + b + ", " + c));
+        break;
+    }
+    case OP_EQ_B:
+    case OP_NE_B:
+    {
+        string b = Load(i.b, BANK_BOOL), c = Load(i.c, BANK_BOOL);
+        Flag(Compute(string("icmp ") + (op == OP_EQ_B ? "eq" : "ne") + " i8 " + b + ", " + c));
+        break;
+    }
+    case OP_NEG_I:
+        Store(i.a, BANK_INT, Compute("sub i32 0, " + I(i.b)));
+        break;
+    case OP_NEG_F:
+        Store(i.a, BANK_FLOAT, Compute("fneg double " + F(i.b)));
+        break;
+    case OP_NOT_B:
+        Store(i.a, BANK_BOOL, Compute("xor i8 " + Load(i.b, BANK_BOOL) + ", 1"));
+        break;
+
+    case OP_LOAD_I:
+    case OP_LOAD_F:
+    case OP_LOAD_B:
+    {
+        int bank = op - OP_LOAD_I;
+        string address = Address(i.b, Offset(i.c, i.d));
+        Store(i.a, bank, Compute(string("load ") + types[bank] + ", " + types[bank] + "* " + address + Tbaa(bank)));
+        break;
+    }
+    case OP_STORE_I:
+    case OP_STORE_F:
+    case OP_STORE_B:
+    {
+        int bank = op - OP_STORE_I;
+        string address = Address(i.a, Offset(i.b, i.d));
+        string value = Load(i.c, bank);
+        out << "    store " << types[bank] << " " << value << ", " << types[bank] << "* " << address << Tbaa(bank) << endl;
+        break;
+    }
+    case OP_LOADX_I:
+    case OP_LOADX_F:
+    case OP_LOADX_B:
+    {
+        int bank = op - OP_LOADX_I;
+        string row = Compute("mul i32 " + I(i.c) + ", " + std::to_string(i.e));
+        string address = Address(i.b, Compute("add i32 " + row + ", " + I(i.d)));
+        Store(i.a, bank, Compute(string("load ") + types[bank] + ", " + types[bank] + "* " + address + Tbaa(bank)));
+        break;
+    }
+    case OP_STOREX_I:
+    case OP_STOREX_F:
+    case OP_STOREX_B:
+    {
+        int bank = op - OP_STOREX_I;
+        string row = Compute("mul i32 " + I(i.b) + ", " + std::to_string(i.e));
+        string address = Address(i.a, Compute("add i32 " + row + ", " + I(i.d)));
+        string value = Load(i.c, bank);
+        out << "    store " << types[bank] << " " << value << ", " << types[bank] << "* " << address << Tbaa(bank) << endl;
+        break;
+    }
+
+    case OP_SEL_I:
+    case OP_SEL_F:
+    case OP_SEL_B:
+    {
+        int bank = op - OP_SEL_I;
+        string test = Condition(i.b);
+        string c = Load(i.c, bank), d = Load(i.d, bank);
+        Store(i.a, bank, Compute("select i1 " + test + ", " + types[bank] + " " + c + ", " + types[bank] + " " + d));
+        break;
+    }
+
+    case OP_JMP:
+        out << "    br " << Label(i.a) << endl;
+        open = false;
+        break;
+    case OP_JF:
+    case OP_JT:
+    {
+        string test = Condition(i.b);
+        string taken = Label(i.a), next = Label(pc + 1);
+        out << "    br i1 " << test << ", " << (op == OP_JT ? taken : next) << ", " << (op == OP_JT ? next : taken) << endl;
+        open = false;
+        break;
+    }
+    case OP_JLT_I: case OP_JLE_I: case OP_JGT_I: case OP_JGE_I: case OP_JEQ_I: case OP_JNE_I:
+    {
+        string b = I(i.b), c = I(i.c);
+        string test = Compute(string("icmp ") + intCompares[op - OP_JLT_I] + " i32 " + b + ", " + c);
+        out << "    br i1 " << test << ", " << Label(i.a) << ", " << Label(pc + 1) << endl;
+        open = false;
+        break;
+    }
+    case OP_LOOPLT_I:
+    case OP_LOOPNE_I:
+    {
+        string b = I(i.b), c = I(i.c);
+        Store(i.b, BANK_INT, Compute("add i32 " + b + ", " + c));
+        string counter = I(i.b), limit = I(i.d);
+        string test = Compute(string("icmp ") + (op == OP_LOOPLT_I ? "slt" : "ne") + " i32 " + counter + ", " + limit);
+        out << "    br i1 " << test << ", " << Label(i.a) << ", " << Label(pc + 1) << endl;
+        open = false;
+        break;
+    }
+
+    case OP_RET_I:
+    case OP_RET_F:
+    case OP_RET_B:
+    {
+        int bank = op - OP_RET_I;
+        string value = Load(i.a, bank);
+        out << "    ret " << types[bank] << " " << value << endl;
+        open = false;
+        break;
+    }
+    case OP_RET_A:
+    {
+        // copia para o arranjo do chamador os elementos que cabem nele; nada a
+        // copiar quando ele é o próprio arranjo devolvido
+        int bank = ElementBank(i.a);
+        string n = Count(i.a);
+        string fits = Compute("icmp slt i32 %ret.n, " + n);
+        string count = Compute("select i1 " + fits + ", i32 %ret.n, i32 " + n);
+        string same = Compute(string("icmp eq ") + types[bank] + "* %ret, " + Elements(i.a));
+        string copied = Compute("select i1 " + same + ", i32 0, i32 " + count);
+        string wide = Compute("sext i32 " + copied + " to i64");
+        string bytes = Compute("mul i64 " + wide + ", " + std::to_string(sizes[bank]));
+        string to = Compute(string("bitcast ") + types[bank] + "* %ret to i8*");
+        string from = Compute(string("bitcast ") + types[bank] + "* " + Elements(i.a) + " to i8*");
+        out << "    call void @llvm.memmove.p0i8.p0i8.i64(i8* " << to << ", i8* " << from << ", i64 " << bytes << ", i1 false)" << endl;
+        out << "    ret void" << endl;
+        open = false;
+        break;
+    }
+
+    // operações vetoriais em <N x T>
+    case OP_VLOAD_I:
+    case OP_VLOAD_F:
+    {
+        int bank = op - OP_VLOAD_I;
+        string type = VectorType(bank, i.e);
+        string pointer = Span(i.b, Offset(i.c, i.d), i.e);
+        string value = Compute("load " + type + ", " + type + "* " + pointer + ", align " + std::to_string(sizes[bank]) + Tbaa(bank));
+        Scatter(i.a, bank, i.e, value);
+        break;
+    }
+    case OP_VSTORE_I:
+    case OP_VSTORE_F:
+    {
+        int bank = op - OP_VSTORE_I;
+        string type = VectorType(bank, i.e);
+        string pointer = Span(i.a, Offset(i.b, i.d), i.e);
+        string value = Gather(i.c, bank, i.e);
+        out << "    store " << type << " " << value << ", " << type << "* " << pointer << ", align " << sizes[bank] << Tbaa(bank) << endl;
+        break;
+    }
+    case OP_VSPLAT_I:
+    case OP_VSPLAT_F:
+    {
+        int bank = op - OP_VSPLAT_I;
+        string type = VectorType(bank, i.e);
+        string first = Compute("insertelement " + type + " undef, " + types[bank] + " " + Load(i.b, bank) + ", i32 0");
+        string mask = "<" + std::to_string(i.e) + " x i32> zeroinitializer";
+        Scatter(i.a, bank, i.e, Compute("shufflevector " + type + " " + first + ", " + type + " undef, " + mask));
+        break;
+    }
+    case OP_VADD_I:
+    case OP_VSUB_I:
+    case OP_VMUL_I:
+    {
+        string type = VectorType(BANK_INT, i.e);
+        string b = Gather(i.b, BANK_INT, i.e), c = Gather(i.c, BANK_INT, i.e);
+        Scatter(i.a, BANK_INT, i.e, Compute(string(intOps[op - OP_VADD_I]) + " " + type + " " + b + ", " + c));
+        break;
+    }
+    case OP_VADD_F:
+    case OP_VSUB_F:
+    case OP_VMUL_F:
+    case OP_VDIV_F:
+    {
+        string type = VectorType(BANK_FLOAT, i.e);
+        string b = Gather(i.b, BANK_FLOAT, i.e), c = Gather(i.c, BANK_FLOAT, i.e);
+        Scatter(i.a, BANK_FLOAT, i.e, Compute(string(floatOps[op - OP_VADD_F]) + " " + type + " " + b + ", " + c));
+        break;
+    }
+
+    default:
+        throw RuntimeError{string("instrução ") + OpNames[i.op] + " sem tradução para LLVM"};
+    }
+}
+
+void LlvmEmitter::Run()
+{
+    out << Signature() << endl;
+    out << "{" << endl;
+    out << "entry:" << endl;
+    Declarations();
+    open = true;
+    for (int pc = 0; pc < int(chunk.code.size()); ++pc)
+    {
+        if (starts[pc])
+        {
+            if (open)
+                out << "    br label %L" << pc << endl;
+            out << "L" << pc << ":" << endl;
+            open = true;
+        }
+        Translate(pc);
+    }
+    if (open)
+        Return();
+    out << "}" << endl << endl;
+}
+
+// -------
+// Program
+// -------
+
+// rotinas de apoio: erros de execução, verificação de limites e exibição
+// de arranjos
+static void Runtime(Strings & strings, std::ostream & out)
+{
+    out << "declare i32 @printf(i8*, ...) nounwind" << endl;
+    out << "declare i32 @putchar(i32) nounwind" << endl;
+    out << "declare void @exit(i32) noreturn nounwind" << endl;
+    out << "declare void @llvm.memmove.p0i8.p0i8.i64(i8*, i8*, i64, i1)" << endl;
+    out << "declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i1)" << endl << endl;
+
+    out << "define internal void @tr.bounds(i32 %index) noreturn nounwind cold noinline" << endl;
+    out << "{" << endl;
+    out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("Erro de execução: índice %d fora dos limites do arranjo\n") << ", i32 %index)" << endl;
+    out << "    call void @exit(i32 1)" << endl;
+    out << "    unreachable" << endl;
+    out << "}" << endl << endl;
+
+    out << "define internal void @tr.divzero() noreturn nounwind cold noinline" << endl;
+    out << "{" << endl;
+    out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("Erro de execução: divisão por zero\n") << ")" << endl;
+    out << "    call void @exit(i32 1)" << endl;
+    out << "    unreachable" << endl;
+    out << "}" << endl << endl;
+
+    // índices negativos também ficam fora dos limites
+    out << R"(define internal i32 @tr.index(i32 %index, i32 %count) nounwind alwaysinline
+{
+entry:
+    %inside = icmp ult i32 %index, %count
+    br i1 %inside, label %ok, label %fail
+ok:
+    ret i32 %index
+fail:
+    call void @tr.bounds(i32 %index)
+    unreachable
+}
+
+define internal i32 @tr.divide(i32 %value, i32 %divisor) nounwind alwaysinline
+{
+entry:
+    %zero = icmp eq i32 %divisor, 0
+    br i1 %zero, label %fail, label %sign
+sign:
+    %minus = icmp eq i32 %divisor, -1
+    br i1 %minus, label %negate, label %divide
+negate:
+    %negated = sub i32 0, %value
+    ret i32 %negated
+divide:
+    %quotient = sdiv i32 %value, %divisor
+    ret i32 %quotient
+fail:
+    call void @tr.divzero()
+    unreachable
+}
+
+)";
+
+    // uma rotina de exibição por tipo de elemento
+    for (int bank = 0; bank < BANK_ARRAY; ++bank)
+    {
+        const char * type = types[bank];
+        out << "define internal void @tr.print." << prefixes[bank] << "(i8* %name, " << type << "* %data, i32 %rows, i32 %cols) nounwind" << endl;
+        out << "{" << endl;
+        out << "entry:" << endl;
+        out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("%s =\n") << ", i8* %name)" << endl;
+        out << "    %n = mul i32 %rows, %cols" << endl;
+        out << "    %last = sub i32 %cols, 1" << endl;
+        out << "    %empty = icmp sle i32 %n, 0" << endl;
+        out << "    br i1 %empty, label %done, label %loop" << endl;
+        out << "loop:" << endl;
+        out << "    %k = phi i32 [0, %entry], [%next, %after]" << endl;
+        out << "    %col = srem i32 %k, %cols" << endl;
+        out << "    %first = icmp eq i32 %col, 0" << endl;
+        out << "    %separator = select i1 %first, i32 9, i32 32" << endl;
+        out << "    call i32 @putchar(i32 %separator)" << endl;
+        out << "    %address = getelementptr inbounds " << type << ", " << type << "* %data, i32 %k" << endl;
+        out << "    %value = load " << type << ", " << type << "* %address" << endl;
+        if (bank == BANK_INT)
+            out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("%d") << ", i32 %value)" << endl;
+        else if (bank == BANK_FLOAT)
+            out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("%g") << ", double %value)" << endl;
+        else
+        {
+            out << "    %true = icmp ne i8 %value, 0" << endl;
+            out << "    %text = select i1 %true, i8* " << strings.Pointer("true") << ", i8* " << strings.Pointer("false") << endl;
+            out << "    call i32 (i8*, ...) @printf(i8* %text)" << endl;
+        }
+        out << "    %end = icmp eq i32 %col, %last" << endl;
+        out << "    br i1 %end, label %newline, label %after" << endl;
+        out << "newline:" << endl;
+        out << "    call i32 @putchar(i32 10)" << endl;
+        out << "    br label %after" << endl;
+        out << "after:" << endl;
+        out << "    %next = add i32 %k, 1" << endl;
+        out << "    %more = icmp slt i32 %next, %n" << endl;
+        out << "    br i1 %more, label %loop, label %done" << endl;
+        out << "done:" << endl;
+        out << "    ret void" << endl;
+        out << "}" << endl << endl;
+    }
+}
+
+void EmitLlvm(Program * p, std::ostream & out)
+{
+    Module module = Lower(p);
+    Strings strings;
+
+    out << "; programa traduzido para LLVM: clang -O3 -march=native programa.ll" << endl;
+    out << "target triple = \"x86_64-pc-linux-gnu\"" << endl << endl;
+    Runtime(strings, out);
+
+    // variáveis globais, zeradas como na máquina virtual
+    for (GlobalDecl & g : module.vars)
+        out << "@g" << prefixes[g.bank] << g.slot << " = internal global " << types[g.bank] << (g.bank == BANK_FLOAT ? " 0.0" : " 0") << endl;
+    for (ArrayDecl & a : module.arrays)
+        out << "@ga" << a.slot << " = internal global [" << std::max(a.rows * a.cols, 1) << " x " << types[a.bank] << "] zeroinitializer" << endl;
+    out << endl;
+
+    for (int c = 0; c < int(module.chunks.size()); ++c)
+        LlvmEmitter(module, p, c, out).Run();
+
+    // estado final: nomes com '_' foram criados pelo compilador
+    out << "define i32 @main() nounwind" << endl;
+    out << "{" << endl;
+    out << "entry:" << endl;
+    out << "    call void @tr.main()" << endl;
+    int temps = 0;
+    for (GlobalDecl & g : module.vars)
+    {
+        if (g.name.find('_') != string::npos)
+            continue;
+        const char * type = types[g.bank];
+        string value = "%v" + std::to_string(temps++);
+        out << "    " << value << " = load " << type << ", " << type << "* @g" << prefixes[g.bank] << g.slot << Tbaa(g.bank) << endl;
+        string name = strings.Pointer(g.name);
+        if (g.bank == BANK_INT)
+            out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("%s = %d\n") << ", i8* " << name << ", i32 " << value << ")" << endl;
+        else if (g.bank == BANK_FLOAT)
+            out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("%s = %g\n") << ", i8* " << name << ", double " << value << ")" << endl;
+        else
+        {
+            string test = "%v" + std::to_string(temps++);
+            string text = "%v" + std::to_string(temps++);
+            out << "    " << test << " = icmp ne i8 " << value << ", 0" << endl;
+            out << "    " << text << " = select i1 " << test << ", i8* " << strings.Pointer("true") << ", i8* " << strings.Pointer("false") << endl;
+            out << "    call i32 (i8*, ...) @printf(i8* " << strings.Pointer("%s = %s\n") << ", i8* " << name << ", i8* " << text << ")" << endl;
+        }
+    }
+    for (ArrayDecl & a : module.arrays)
+    {
+        if (a.name.find('_') != string::npos)
+            continue;
+        string type = "[" + std::to_string(std::max(a.rows * a.cols, 1)) + " x " + types[a.bank] + "]";
+        out << "    call void @tr.print." << prefixes[a.bank] << "(i8* " << strings.Pointer(a.name) << ", " << types[a.bank] << "* "
+            << "getelementptr inbounds (" << type << ", " << type << "* @ga" << a.slot << ", i64 0, i64 0), i32 " << a.rows << ", i32 " << a.cols << ")" << endl;
+    }
+    out << "    ret i32 0" << endl;
+    out << "}" << endl << endl;
+
+    strings.Define(out);
+    out << endl;
+
+    // tipos TBAA: um por tipo de elemento, abaixo de uma raiz própria
+    out << "!0 = !{!\"tradutor\"}" << endl;
+    out << "!1 = !{!\"int\", !0, i64 0}" << endl;
+    out << "!2 = !{!\"float\", !0, i64 0}" << endl;
+    out << "!3 = !{!\"bool\", !0, i64 0}" << endl;
+    out << "!4 = !{!1, !1, i64 0}" << endl;
+    out << "!5 = !{!2, !2, i64 0}" << endl;
+    out << "!6 = !{!3, !3, i64 0}" << endl;
+}
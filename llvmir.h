@@ -0,0 +1,15 @@
+#ifndef COMPILER_LLVMIR
+#define COMPILER_LLVMIR
+
+#include <iostream>
+#include "ir.h"
+
+// módulo LLVM textual (.ll): cada registrador da máquina virtual é um alloca,
+// promovido a SSA pelo mem2reg; arranjos são ponteiros para os elementos
+// acompanhados do número de elementos, noalias quando a análise de apelidos
+// garante que não compartilham memória, e os acessos levam metadados TBAA
+// por tipo de elemento. O main executa o programa e exibe o estado final das
+// variáveis, como a máquina virtual
+void EmitLlvm(Program * p, std::ostream & out);
+
+#endif
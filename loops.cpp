@@ -0,0 +1,677 @@
+#include <algorithm>
+#include <map>
+#include "loops.h"
+#include "cfg.h"
+#include "alias.h"
+using std::map;
+
+// ------------------
+// Pré-cabeçalho
+// ------------------
+
+// instruções do laço em ordem de posição no código
+static vector<int> Body(CFG & cfg, Loop & loop)
+{
+    vector<int> body;
+    for (int b : loop.blocks)
+    {
+        for (int i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i)
+            body.push_back(i);
+    }
+    std::sort(body.begin(), body.end());
+    return body;
+}
+
+// o pré-cabeçalho é criado imediatamente antes do rótulo do cabeçalho,
+// o que só é possível se nenhum bloco do laço cair nele por fluxo direto
+static bool HasPreheader(CFG & cfg, Loop & loop)
+{
+    vector<Quad> & code = cfg.func->code;
+    BasicBlock & head = cfg.blocks[loop.header];
+    if (code[head.first].op != IR_LABEL)
+        return false;
+
+    if (loop.header > 0 && loop.blocks.count(loop.header - 1))
+    {
+        Quad & last = code[cfg.blocks[loop.header - 1].last - 1];
+        return last.op == IR_GOTO || last.op == IR_RETURN;
+    }
+    return true;
+}
+
+// insere as instruções no pré-cabeçalho do laço e após as posições indicadas,
+// removendo as instruções marcadas
+static void Rebuild(CFG & cfg, Loop & loop, vector<Quad> & pre, vector<bool> & removed,
+                    map<int, vector<Quad>> after = {})
+{
+    vector<Quad> & code = cfg.func->code;
+    int first = cfg.blocks[loop.header].first;
+    unsigned header = code[first].label;
+
+    // desvios de fora do laço para o cabeçalho passam a entrar pelo pré-cabeçalho
+    unsigned label = 0;
+    for (int i = 0; i < int(code.size()); ++i)
+    {
+        if (code[i].IsJump() && code[i].label == header && !loop.blocks.count(cfg.blockOf[i]))
+        {
+            if (!label)
+                label = NewLabel();
+            code[i].label = label;
+        }
+    }
+
+    vector<Quad> result;
+    for (int i = 0; i < int(code.size()); ++i)
+    {
+        if (i == first)
+        {
+            if (label)
+            {
+                Quad q(IR_LABEL);
+                q.label = label;
+                result.push_back(q);
+            }
+            result.insert(result.end(), pre.begin(), pre.end());
+        }
+        if (!removed[i])
+            result.push_back(code[i]);
+        if (after.count(i))
+            result.insert(result.end(), after[i].begin(), after[i].end());
+    }
+    code.swap(result);
+}
+
+// nomes escritos, arranjos modificados e chamadas dentro do laço
+struct Summary
+{
+    vector<int> body;
+    map<string, int> defs;
+    map<string, int> defAt;
+    set<string> stored;
+    bool call = false;
+
+    Summary(CFG & cfg, Loop & loop);
+    bool Invariant(Operand & o);
+    bool Stores(const string & func, const string & array);
+};
+
+Summary::Summary(CFG & cfg, Loop & loop)
+{
+    vector<Quad> & code = cfg.func->code;
+    body = Body(cfg, loop);
+    for (int i : body)
+    {
+        Operand * d = code[i].Def();
+        if (d)
+        {
+            defs[d->name]++;
+            defAt[d->name] = i;
+        }
+        if (code[i].IsStore())
+            stored.insert(code[i].name);
+        if (code[i].op == IR_CALL)
+            call = true;
+    }
+}
+
+// operando cujo valor não muda durante o laço
+bool Summary::Invariant(Operand & o)
+{
+    if (o.IsConst())
+        return true;
+    if (o.IsVar() && call)
+        return false;
+    return o.IsName() && !defs.count(o.name);
+}
+
+// verifica se o laço escreve em algum arranjo que pode ser o arranjo indicado
+bool Summary::Stores(const string & func, const string & array)
+{
+    for (const string & s : stored)
+    {
+        if (MayAlias(func, s, array))
+            return true;
+    }
+    return false;
+}
+
+// aplica uma transformação a cada laço, dos internos para os externos; a
+// análise só é refeita quando uma transformação altera o código
+static void ForEachLoop(Function * f, bool (*transform)(CFG &, Loop &))
+{
+    set<unsigned> done;
+    bool changed = true;
+    while (changed && !f->code.empty())
+    {
+        changed = false;
+        CFG cfg(f);
+        cfg.Liveness();
+        vector<Loop> loops = cfg.Loops();
+
+        for (Loop & l : loops)
+        {
+            Quad & label = f->code[cfg.blocks[l.header].first];
+            if (label.op != IR_LABEL || done.count(label.label))
+                continue;
+            done.insert(label.label);
+            if (HasPreheader(cfg, l) && transform(cfg, l))
+            {
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+// -------------------------------------
+// Movimentação de código invariante
+// -------------------------------------
+
+// move para o pré-cabeçalho as computações invariantes do laço
+static bool HoistLoop(CFG & cfg, Loop & loop)
+{
+    vector<Quad> & code = cfg.func->code;
+    BasicBlock & head = cfg.blocks[loop.header];
+    Summary sum(cfg, loop);
+    vector<int> & body = sum.body;
+    map<string, int> & defs = sum.defs;
+    map<string, int> & defAt = sum.defAt;
+    bool call = sum.call;
+
+    // blocos de onde se sai do laço e nomes vivos após a saída
+    vector<int> exiting;
+    set<string> liveOut;
+    for (int b : loop.blocks)
+    {
+        for (int s : cfg.blocks[b].succ)
+        {
+            if (!loop.blocks.count(s))
+            {
+                exiting.push_back(b);
+                liveOut.insert(cfg.blocks[s].in.begin(), cfg.blocks[s].in.end());
+            }
+        }
+    }
+
+    // uma instrução é invariante se seus operandos são constantes, definidos
+    // fora do laço ou definidos por uma única instrução invariante anterior
+    vector<bool> hoist(code.size(), false);
+    bool changed = true;
+    bool any = false;
+    while (changed)
+    {
+        changed = false;
+        for (int i : body)
+        {
+            Quad & q = code[i];
+            if (hoist[i] || !q.IsPure() || !q.dst.IsName())
+                continue;
+
+            // o destino deve ter uma única definição e não estar vivo na entrada do laço
+            const string & d = q.dst.name;
+            if (defs[d] != 1 || head.in.count(d) || (call && q.dst.IsVar()))
+                continue;
+
+            bool invariant = true;
+            for (Operand * o : q.Uses())
+            {
+                if (o->IsVar() && call)
+                    invariant = false;
+                else if (!defs.count(o->name))
+                    continue;
+                else if (defs[o->name] != 1 || !hoist[defAt[o->name]] || defAt[o->name] > i || head.in.count(o->name))
+                    invariant = false;
+            }
+            if (q.IsLoad() && (sum.Stores(cfg.func->name, q.name) || call))
+                invariant = false;
+            if (!invariant)
+                continue;
+
+            // instruções que não executam em toda iteração só podem ser movidas
+            // se não interrompem a execução e seu resultado não é usado após o laço
+            bool always = true;
+            for (int b : exiting)
+            {
+                if (!cfg.Dominates(cfg.blockOf[i], b))
+                    always = false;
+            }
+            if (!always && (q.CanTrap() || liveOut.count(d)))
+                continue;
+
+            hoist[i] = true;
+            changed = true;
+            any = true;
+        }
+    }
+
+    if (!any)
+        return false;
+
+    vector<Quad> pre;
+    for (int i : body)
+    {
+        if (hoist[i])
+            pre.push_back(code[i]);
+    }
+    Rebuild(cfg, loop, pre, hoist);
+    return true;
+}
+
+// aplica a movimentação de invariantes a cada laço, dos internos para os externos,
+// de modo que uma computação suba quantos níveis de aninhamento for possível
+void HoistInvariants(Function * f)
+{
+    ForEachLoop(f, HoistLoop);
+}
+
+// ----------------------------------------------
+// Redução de força em variáveis de indução
+// ----------------------------------------------
+
+// variável de indução básica: x = x + c, possivelmente por meio de um temporário
+struct Induction
+{
+    int step;           // incremento constante por iteração
+    int update;         // instrução que escreve x
+    int add;            // instrução que calcula x + c
+};
+
+// variável de indução derivada: valor igual a x * scale + deslocamento
+struct Derived
+{
+    string iv;          // variável de indução básica
+    Operand reg;        // temporário mantido em sincronia com a variável básica
+    Operand step;       // incremento de reg por iteração
+    int scale;          // fator constante (0 se não for constante)
+    bool offset;        // possui deslocamento além do fator
+};
+
+// constante inteira
+static bool IntConst(Operand & o, int & value)
+{
+    if (!o.IsConst() || o.type != ExprType::INT)
+        return false;
+    value = std::stoi(o.name);
+    return true;
+}
+
+static Operand IntOperand(int value)
+{
+    return Operand(OPD_CONST, ExprType::INT, std::to_string(value));
+}
+
+static Quad Binary(Operand dst, Operand a, string oper, Operand b)
+{
+    Quad q(IR_BINARY);
+    q.dst = dst;
+    q.arg1 = a;
+    q.oper = oper;
+    q.arg2 = b;
+    return q;
+}
+
+static Quad Copy(Operand dst, Operand src)
+{
+    Quad q(IR_COPY);
+    q.dst = dst;
+    q.arg1 = src;
+    return q;
+}
+
+// encontra as variáveis de indução básicas do laço
+static map<string, Induction> BasicInductions(CFG & cfg, Summary & sum)
+{
+    vector<Quad> & code = cfg.func->code;
+    map<string, Induction> basics;
+
+    for (auto & [name, count] : sum.defs)
+    {
+        int i = sum.defAt[name];
+        Quad & q = code[i];
+        if (count != 1 || q.dst.type != ExprType::INT || (q.dst.IsVar() && sum.call))
+            continue;
+
+        // x = t, com t = x + c definido no mesmo bloco
+        int add = i;
+        if (q.op == IR_COPY && q.arg1.IsTemp() && sum.defs[q.arg1.name] == 1)
+        {
+            add = sum.defAt[q.arg1.name];
+            if (add > i || cfg.blockOf[add] != cfg.blockOf[i])
+                continue;
+        }
+
+        Quad & a = code[add];
+        int c;
+        if (a.op != IR_BINARY || a.arg1.name != name || !IntConst(a.arg2, c))
+            continue;
+        if (a.oper == "+")
+            basics[name] = Induction{c, i, add};
+        else if (a.oper == "-")
+            basics[name] = Induction{-c, i, add};
+    }
+
+    return basics;
+}
+
+// substitui multiplicações por variáveis de indução por somas de um passo constante:
+// d = x * n passa a d = s, com s = x * n no pré-cabeçalho e s = s + c * n após o
+// incremento de x; somas de invariantes a d são reduzidas da mesma forma
+static bool ReduceLoop(CFG & cfg, Loop & loop)
+{
+    vector<Quad> & code = cfg.func->code;
+    Summary sum(cfg, loop);
+    map<string, Induction> basics = BasicInductions(cfg, sum);
+    if (basics.empty())
+        return false;
+
+    vector<Quad> pre;
+    map<int, vector<Quad>> after;
+    map<string, Derived> derived;
+
+    for (int i : sum.body)
+    {
+        Quad & q = code[i];
+        if (q.op != IR_BINARY || q.dst.type != ExprType::INT || sum.defs[q.dst.name] != 1)
+            continue;
+
+        // d = x * n ou d = n * x, com n invariante
+        if (q.oper == "*")
+        {
+            Operand x = q.arg1;
+            Operand n = q.arg2;
+            if (!basics.count(x.name))
+                std::swap(x, n);
+            if (!basics.count(x.name) || !sum.Invariant(n) || i == basics[x.name].add)
+                continue;
+
+            Induction & iv = basics[x.name];
+            Operand reg = NewTemp(ExprType::INT);
+            pre.push_back(Binary(reg, x, "*", n));
+
+            int value;
+            Operand step;
+            if (IntConst(n, value))
+            {
+                step = IntOperand(iv.step * value);
+            }
+            else
+            {
+                value = 0;
+                step = NewTemp(ExprType::INT);
+                pre.push_back(Binary(step, n, "*", IntOperand(iv.step)));
+            }
+
+            after[iv.update].push_back(Binary(reg, reg, "+", step));
+            derived[q.dst.name] = Derived{x.name, reg, step, value, false};
+            q = Copy(q.dst, reg);
+            continue;
+        }
+
+        // e = d + y, e = y + d ou e = d - y, com d derivada e y invariante
+        if (q.oper == "+" || q.oper == "-")
+        {
+            Operand d = q.arg1;
+            Operand y = q.arg2;
+            if (!derived.count(d.name) && q.oper == "+")
+                std::swap(d, y);
+            if (!derived.count(d.name) || !sum.Invariant(y))
+                continue;
+
+            // a variável básica não pode mudar entre a definição de d e seu uso
+            Derived & base = derived[d.name];
+            int def = sum.defAt[d.name];
+            int update = basics[base.iv].update;
+            if (cfg.blockOf[def] != cfg.blockOf[i] || def > i || (update > def && update < i))
+                continue;
+
+            Operand reg = NewTemp(ExprType::INT);
+            pre.push_back(Binary(reg, base.reg, q.oper, y));
+            after[update].push_back(Binary(reg, reg, "+", base.step));
+            derived[q.dst.name] = Derived{base.iv, reg, base.step, base.scale, true};
+            q = Copy(q.dst, reg);
+        }
+    }
+
+    if (derived.empty())
+        return false;
+
+    // substituição do teste do laço: x < n passa a s < n * c quando s = x * c, c > 0;
+    // apenas com n constante e n * c representável, já que o produto não pode
+    // dar a volta
+    set<string> liveOut;
+    for (int b : loop.blocks)
+    {
+        for (int s : cfg.blocks[b].succ)
+        {
+            if (!loop.blocks.count(s))
+                liveOut.insert(cfg.blocks[s].in.begin(), cfg.blocks[s].in.end());
+        }
+    }
+
+    for (int i : sum.body)
+    {
+        Quad & q = code[i];
+        static const set<string> relational{"<", "<=", ">", ">=", "==", "!="};
+        if (q.op != IR_BINARY || !relational.count(q.oper) || !basics.count(q.arg1.name) || !sum.Invariant(q.arg2))
+            continue;
+
+        for (auto & [name, family] : derived)
+        {
+            if (family.iv != q.arg1.name || family.offset || family.scale <= 0)
+                continue;
+
+            int value;
+            if (!IntConst(q.arg2, value))
+                continue;
+            int64_t limit = int64_t(value) * family.scale;
+            if (limit < INT32_MIN || limit > INT32_MAX)
+                continue;
+            q.arg1 = family.reg;
+            q.arg2 = IntOperand(int(limit));
+            break;
+        }
+    }
+
+    // variáveis básicas usadas apenas no próprio incremento são removidas
+    vector<bool> removed(code.size(), false);
+    for (auto & [name, iv] : basics)
+    {
+        if (liveOut.count(name))
+            continue;
+
+        bool used = false;
+        for (int i : sum.body)
+        {
+            if (i == iv.add || i == iv.update)
+                continue;
+            for (Operand * o : code[i].Uses())
+            {
+                if (o->name == name || (iv.add != iv.update && o->name == code[iv.add].dst.name))
+                    used = true;
+            }
+        }
+
+        if (!used)
+        {
+            removed[iv.add] = true;
+            removed[iv.update] = true;
+        }
+    }
+
+    Rebuild(cfg, loop, pre, removed, after);
+    return true;
+}
+
+// redução de força das variáveis de indução de cada laço
+void ReduceInductions(Function * f)
+{
+    ForEachLoop(f, ReduceLoop);
+}
+
+// ---------------
+// Desenrolamento
+// ---------------
+
+// tamanho máximo, em instruções, de um laço completamente desenrolado e das
+// cópias do corpo num desenrolamento parcial
+static const int UnrollBudget = 64;
+static const int PartialBudget = 256;
+
+// posição do rótulo no código, ou -1
+static int Find(vector<Quad> & code, unsigned label)
+{
+    for (int i = 0; i < int(code.size()); ++i)
+    {
+        if (code[i].op == IR_LABEL && code[i].label == label)
+            return i;
+    }
+    return -1;
+}
+
+// o corpo [first, last) pode ser replicado se não tiver desvios para fora,
+// entradas laterais, chamadas ou atribuições à variável de controle
+static bool Replicable(vector<Quad> & code, int first, int last, int end, const string & var)
+{
+    set<unsigned> inside;
+    for (int i = first; i < last; ++i)
+    {
+        if (code[i].op == IR_LABEL)
+            inside.insert(code[i].label);
+    }
+
+    for (int i = 0; i < int(code.size()); ++i)
+    {
+        Quad & q = code[i];
+        if (i < first || i >= end)
+        {
+            if (q.IsJump() && (inside.count(q.label) || q.label == code[first - 1].label || q.label == code[last].label))
+                return false;
+            continue;
+        }
+        if (i >= last)
+            continue;
+
+        if (q.op == IR_CALL || q.op == IR_FUNC || q.op == IR_RETURN)
+            return false;
+        if (q.IsJump() && !inside.count(q.label))
+            return false;
+        if (q.Def() && q.Def()->IsVar() && q.Def()->name == var)
+            return false;
+    }
+    return true;
+}
+
+// copia as instruções [first, last) com rótulos novos, trocando os usos da
+// variável de controle pelo valor da iteração
+static void Replicate(vector<Quad> & code, int first, int last, const string & var, Operand value, vector<Quad> & out)
+{
+    map<unsigned, unsigned> labels;
+    for (int i = first; i < last; ++i)
+    {
+        Quad q = code[i];
+        for (Operand * o : q.Uses())
+        {
+            if (o->IsVar() && o->name == var)
+                *o = value;
+        }
+        if (q.op == IR_LABEL || q.IsJump())
+        {
+            if (!labels.count(q.label))
+                labels[q.label] = NewLabel();
+            q.label = labels[q.label];
+        }
+        out.push_back(q);
+    }
+}
+
+// x = var + d (ou var - d)
+static Quad Offset(Operand dst, Operand var, int d)
+{
+    return d < 0 ? Binary(dst, var, "-", IntOperand(-d)) : Binary(dst, var, "+", IntOperand(d));
+}
+
+// desenrola um laço contado: completamente se for pequeno, ou pelo fator
+// indicado, com as iterações restantes em sequência após o laço, se for um
+// laço interno de corpo pequeno
+static bool UnrollLoop(Function * f, CountedLoop & loop, int factor)
+{
+    vector<Quad> & code = f->code;
+    int before = Find(code, loop.before);
+    int step = Find(code, loop.step);
+    int after = Find(code, loop.after);
+    if (before < 0 || step < before || after < step)
+        return false;
+    if (!Replicable(code, before + 1, step, after, loop.var))
+        return false;
+
+    // laços internos têm o corpo em linha reta, sem rótulos nem desvios
+    int size = 0;
+    bool inner = true;
+    for (int i = before + 1; i < step; ++i)
+    {
+        if (code[i].op == IR_LABEL || code[i].IsJump())
+            inner = false;
+        else
+            ++size;
+    }
+
+    Operand var(OPD_VAR, ExprType::INT, loop.var);
+    vector<Quad> result(code.begin(), code.begin() + before);
+
+    if (loop.trips * (size + 1) <= UnrollBudget)
+    {
+        // cada cópia usa o valor constante do contador na iteração
+        for (int k = 0; k < loop.trips; ++k)
+            Replicate(code, before + 1, step, loop.var, IntOperand(loop.init + k * loop.inc), result);
+        result.push_back(Copy(var, IntOperand(loop.init + loop.trips * loop.inc)));
+    }
+    else if (factor > 1 && loop.trips >= 2 * factor && inner
+             && (factor + loop.trips % factor) * (size + 1) <= PartialBudget)
+    {
+        int groups = loop.trips / factor;
+        int rest = loop.trips % factor;
+
+        // a cópia j usa var + j * inc; o contador avança uma vez por grupo
+        result.push_back(code[before]);
+        for (int j = 0; j < factor; ++j)
+        {
+            Operand value = var;
+            if (j > 0)
+            {
+                value = NewTemp(ExprType::INT);
+                result.push_back(Offset(value, var, j * loop.inc));
+            }
+            Replicate(code, before + 1, step, loop.var, value, result);
+        }
+        result.push_back(Offset(var, var, factor * loop.inc));
+
+        Operand test = NewTemp(ExprType::BOOL);
+        result.push_back(Binary(test, var, "!=", IntOperand(loop.init + groups * factor * loop.inc)));
+        Quad jump(IR_IFTRUE);
+        jump.arg1 = test;
+        jump.label = loop.before;
+        result.push_back(jump);
+
+        // iterações restantes
+        for (int k = groups * factor; k < loop.trips; ++k)
+            Replicate(code, before + 1, step, loop.var, IntOperand(loop.init + k * loop.inc), result);
+        if (rest)
+            result.push_back(Copy(var, IntOperand(loop.init + loop.trips * loop.inc)));
+    }
+    else
+    {
+        return false;
+    }
+
+    result.insert(result.end(), code.begin() + after, code.end());
+    code.swap(result);
+    return true;
+}
+
+// desenrolamento dos laços contados, dos internos para os externos
+void UnrollLoops(Function * f, int factor)
+{
+    for (CountedLoop & loop : f->counted)
+        UnrollLoop(f, loop, factor);
+    f->counted.clear();
+}
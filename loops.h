@@ -0,0 +1,11 @@
+#ifndef COMPILER_LOOPS
+#define COMPILER_LOOPS
+
+#include "ir.h"
+
+// otimizações de laços sobre o código de três endereços
+void HoistInvariants(Function * f);
+void ReduceInductions(Function * f);
+void UnrollLoops(Function * f, int factor);
+
+#endif
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <set>
+#include "nest.h"
+#include "alias.h"
+#include "ir.h"
+using std::set;
+
+extern Program * program;
+
+// -------------
+// Acessos
+// -------------
+
+// verifica se a expressão usa a variável
+bool Uses(Expression * e, const string & var)
+{
+    switch (e->node_type)
+    {
+    case NodeType::IDENTIFIER:
+        return e->ToString() == var;
+    case NodeType::ACCESS:
+    {
+        Access * a = (Access*) e;
+        return Uses(a->indexX, var) || (a->indexY && Uses(a->indexY, var));
+    }
+    case NodeType::LOG:
+        return Uses(((Logical*) e)->expr1, var) || Uses(((Logical*) e)->expr2, var);
+    case NodeType::REL:
+        return Uses(((Relational*) e)->expr1, var) || Uses(((Relational*) e)->expr2, var);
+    case NodeType::ARI:
+        return Uses(((Arithmetic*) e)->expr1, var) || Uses(((Arithmetic*) e)->expr2, var);
+    case NodeType::UNARY:
+        return Uses(((UnaryExpr*) e)->expr, var);
+    }
+    return false;
+}
+
+// acessos lidos por uma expressão
+static void Reads(Expression * e, vector<Ref> & refs)
+{
+    switch (e->node_type)
+    {
+    case NodeType::ACCESS:
+    {
+        Access * a = (Access*) e;
+        refs.push_back({a, false});
+        Reads(a->indexX, refs);
+        if (a->indexY)
+            Reads(a->indexY, refs);
+        break;
+    }
+    case NodeType::LOG:
+        Reads(((Logical*) e)->expr1, refs);
+        Reads(((Logical*) e)->expr2, refs);
+        break;
+    case NodeType::REL:
+        Reads(((Relational*) e)->expr1, refs);
+        Reads(((Relational*) e)->expr2, refs);
+        break;
+    case NodeType::ARI:
+        Reads(((Arithmetic*) e)->expr1, refs);
+        Reads(((Arithmetic*) e)->expr2, refs);
+        break;
+    case NodeType::UNARY:
+        Reads(((UnaryExpr*) e)->expr, refs);
+        break;
+    }
+}
+
+// acessos do corpo; o corpo só pode conter atribuições a arranjos e
+// condicionais, sem escrever variáveis escalares
+bool Collect(Statement * s, vector<Ref> & refs)
+{
+    if (!s)
+        return true;
+
+    switch (s->node_type)
+    {
+    case NodeType::SEQ:
+        return Collect(((Seq*) s)->stmt, refs) && Collect(((Seq*) s)->stmts, refs);
+    case NodeType::IF_STMT:
+        Reads(((If*) s)->expr, refs);
+        return Collect(((If*) s)->stmt, refs);
+    case NodeType::ASSIGN:
+    {
+        Assign * a = (Assign*) s;
+        if (a->id->node_type != NodeType::ACCESS)
+            return false;
+
+        Access * acc = (Access*) a->id;
+        Reads(a->expr, refs);
+        Reads(acc->indexX, refs);
+        if (acc->indexY)
+            Reads(acc->indexY, refs);
+        refs.push_back({acc, true});
+        return true;
+    }
+    }
+    return false;
+}
+
+// índices simples: variável ou constante
+bool Simple(Expression * e)
+{
+    return !e || e->node_type == NodeType::IDENTIFIER || e->node_type == NodeType::CONSTANT;
+}
+
+// forma textual dos índices de um acesso
+string Subscript(Access * a)
+{
+    return a->indexX->ToString() + ":" + (a->indexY ? a->indexY->ToString() : "");
+}
+
+// ---------------
+// Ninho de laços
+// ---------------
+
+// laço do ninho, com os limites calculados por For::Counted
+struct Level
+{
+    For * loop;
+    CountedLoop counted;
+    int cost;               // soma dos passos de memória dos acessos que usam a variável
+    bool tiled;
+};
+
+// laço interno de um ninho perfeito
+static For * Inner(Statement * s)
+{
+    if (s && s->node_type == NodeType::SEQ && !((Seq*) s)->stmts)
+        s = ((Seq*) s)->stmt;
+    return (s && s->node_type == NodeType::FOR_STMT) ? (For*) s : nullptr;
+}
+
+static Expression * Id(const string & name)
+{
+    return new Identifier(ExprType::INT, new Token(Tag::ID, name));
+}
+
+static Expression * Int(int value)
+{
+    return new Constant(ExprType::INT, new Token(Tag::INTEGER, std::to_string(value)));
+}
+
+Expression * Declare(const string & name)
+{
+    Function * f = program->current;
+    if (!f->Local(name))
+    {
+        Symbol s{};
+        s.var = name;
+        s.type = "int";
+        s.valX = -1;
+        s.valY = -1;
+        f->locals.push_back(s);
+    }
+    return Id(name);
+}
+
+static For * Loop(Assign * init, Expression * cond, Assign * inc, Statement * body)
+{
+    For * loop = new For(init, cond, inc, body);
+    loop->optimized = true;
+    return loop;
+}
+
+Statement * OptimizeNest(For * outer, int tile)
+{
+    // níveis do ninho, todos contados e com ao menos uma iteração
+    vector<Level> levels;
+    set<string> vars;
+    Statement * body = outer;
+    for (For * loop = outer; loop; loop = Inner(loop->stmt))
+    {
+        Level l{loop, {}, 0, false};
+        if (!loop->Counted(l.counted) || l.counted.trips == 0 || !vars.insert(l.counted.var).second)
+            return nullptr;
+        levels.push_back(l);
+        body = loop->stmt;
+    }
+    if (levels.size() < 2)
+        return nullptr;
+
+    vector<Ref> refs;
+    if (!Collect(body, refs))
+        return nullptr;
+
+    // arranjos escritos só podem ser acessados com os mesmos índices simples,
+    // de modo que as dependências ligam apenas iterações com os mesmos índices
+    set<string> written;
+    for (Ref & r : refs)
+    {
+        if (r.write)
+            written.insert(r.acc->id->ToString());
+    }
+    if (written.empty())
+        return nullptr;
+
+    for (Ref & w : refs)
+    {
+        string name = w.acc->id->ToString();
+        if (!w.write)
+            continue;
+        if (!Simple(w.acc->indexX) || !Simple(w.acc->indexY))
+            return nullptr;
+
+        for (Ref & r : refs)
+        {
+            string other = r.acc->id->ToString();
+            if (other == name && Subscript(r.acc) != Subscript(w.acc))
+                return nullptr;
+            if (other != name && MayAlias(program->current->name, name, other))
+                return nullptr;
+        }
+    }
+
+    // as dependências são carregadas pelos laços cujas variáveis não indexam
+    // os arranjos escritos; com mais de um deles a ordem relativa importaria
+    int free = 0;
+    for (Level & l : levels)
+    {
+        bool indexes = false;
+        for (Ref & r : refs)
+            indexes = indexes || (r.write && Uses(r.acc, l.counted.var));
+        free += !indexes;
+    }
+    if (free > 1)
+        return nullptr;
+
+    // custo de cada variável: o passo de memória dos acessos que ela indexa;
+    // os laços de menor custo ficam mais internos
+    for (Level & l : levels)
+    {
+        for (Ref & r : refs)
+        {
+            if (r.acc->indexY && Uses(r.acc->indexX, l.counted.var))
+                l.cost += r.acc->stride;
+            if (Uses(r.acc->indexY ? r.acc->indexY : r.acc->indexX, l.counted.var))
+                l.cost += 1;
+        }
+        l.tiled = tile > 0 && l.counted.inc == 1 && l.counted.trips > tile;
+    }
+
+    vector<Level> order = levels;
+    std::stable_sort(order.begin(), order.end(), [](const Level & a, const Level & b)
+    {
+        return a.cost > b.cost;
+    });
+
+    bool changed = false;
+    for (int l = 0; l < int(levels.size()); ++l)
+        changed = changed || order[l].loop != levels[l].loop || order[l].tiled;
+    if (!changed)
+        return nullptr;
+
+    // laços de elementos, do interno para o externo; os laços divididos
+    // percorrem o bloco [var_tile, var_end), com o limite numa variável que
+    // o vetorizador aceita
+    Statement * nest = body;
+    for (int l = order.size() - 1; l >= 0; --l)
+    {
+        For * loop = order[l].loop;
+        if (!order[l].tiled)
+        {
+            nest = Loop(loop->for_init, loop->for_condition, loop->for_increment, nest);
+            continue;
+        }
+
+        string var = order[l].counted.var;
+        nest = Loop(new Assign(loop->for_init->id, Declare(var + "_tile")),
+                    new Relational(new Token('<'), loop->for_init->id, Declare(var + "_end")),
+                    loop->for_increment, nest);
+    }
+
+    // limites dos blocos: var_end = var_tile + tile, limitado ao fim do laço
+    // quando o último bloco é incompleto
+    for (int l = order.size() - 1; l >= 0; --l)
+    {
+        CountedLoop & c = order[l].counted;
+        if (!order[l].tiled)
+            continue;
+
+        int limit = c.init + c.trips;
+        Assign * end = new Assign(Declare(c.var + "_end"),
+            new Arithmetic(ExprType::INT, new Token('+'), Id(c.var + "_tile"), Int(tile)));
+        if (c.trips % tile == 0)
+        {
+            nest = new Seq(end, nest);
+            continue;
+        }
+        If * clamp = new If(new Relational(new Token('>'), Id(c.var + "_end"), Int(limit)),
+            new Assign(Id(c.var + "_end"), Int(limit)));
+        nest = new Seq(end, new Seq(clamp, nest));
+    }
+
+    // laços dos blocos, na mesma ordem dos laços de elementos; o
+    // desenrolamento copiaria o ninho inteiro e os deixa de lado
+    for (int l = order.size() - 1; l >= 0; --l)
+    {
+        CountedLoop & c = order[l].counted;
+        if (!order[l].tiled)
+            continue;
+
+        Expression * var = Id(c.var + "_tile");
+        For * blocks = Loop(new Assign(var, Int(c.init)),
+                            new Relational(new Token('<'), var, Int(c.init + c.trips)),
+                            new Assign(var, new Arithmetic(ExprType::INT, new Token('+'), var, Int(tile))),
+                            nest);
+        blocks->blocks = true;
+        nest = blocks;
+    }
+    return nest;
+}
@@ -0,0 +1,28 @@
+#ifndef COMPILER_NEST
+#define COMPILER_NEST
+
+#include <vector>
+#include "ast.h"
+
+// acesso a arranjo no corpo de um laço
+struct Ref
+{
+    Access * acc;
+    bool write;
+};
+
+// análise dos acessos a arranjos, usada também pelo vetorizador
+bool Uses(Expression * e, const string & var);
+bool Collect(Statement * s, std::vector<Ref> & refs);
+bool Simple(Expression * e);
+string Subscript(Access * a);
+
+// nova variável inteira auxiliar da função corrente
+Expression * Declare(const string & name);
+
+// reordena um ninho perfeito de laços 🧬 para que o laço interno percorra a
+// memória com passo unitário e divide os laços longos em blocos de tile
+// iterações (0 desativa a divisão); retorna nullptr se o ninho não mudar
+Statement * OptimizeNest(For * outer, int tile);
+
+#endif
@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <map>
+#include "optimizer.h"
+#include "cfg.h"
+#include "loops.h"
+#include "inliner.h"
+#include "peephole.h"
+#include "ifconvert.h"
+using std::map;
+using std::sort;
+
+// ------------------
+// Código inalcançável
+// ------------------
+
+// remove os blocos que não são alcançados a partir da entrada
+bool RemoveUnreachable(Function * f)
+{
+    if (f->code.empty())
+        return false;
+
+    CFG cfg(f);
+    vector<bool> reached(cfg.blocks.size(), false);
+    vector<int> stack{0};
+    reached[0] = true;
+    while (!stack.empty())
+    {
+        int b = stack.back();
+        stack.pop_back();
+        for (int s : cfg.blocks[b].succ)
+        {
+            if (!reached[s])
+            {
+                reached[s] = true;
+                stack.push_back(s);
+            }
+        }
+    }
+
+    // definições de funções não são executadas e apenas marcam posição
+    vector<Quad> code;
+    for (int b = 0; b < int(cfg.blocks.size()); ++b)
+    {
+        for (int i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i)
+        {
+            if (reached[b] || f->code[i].op == IR_FUNC)
+                code.push_back(f->code[i]);
+        }
+    }
+
+    bool changed = code.size() != f->code.size();
+    f->code.swap(code);
+    return changed;
+}
+
+// ----------------------
+// Encadeamento de desvios
+// ----------------------
+
+// posição de cada rótulo no código
+static map<unsigned, int> LabelPositions(vector<Quad> & code)
+{
+    map<unsigned, int> pos;
+    for (int i = 0; i < int(code.size()); ++i)
+    {
+        if (code[i].op == IR_LABEL)
+            pos[code[i].label] = i;
+    }
+    return pos;
+}
+
+// primeira instrução após o rótulo que não é outro rótulo
+static int SkipLabels(vector<Quad> & code, int i)
+{
+    while (i < int(code.size()) && code[i].op == IR_LABEL)
+        ++i;
+    return i;
+}
+
+// destino final de um desvio, seguindo cadeias de goto
+static unsigned FinalTarget(vector<Quad> & code, map<unsigned, int> & pos, unsigned label)
+{
+    set<unsigned> seen;
+    while (seen.insert(label).second)
+    {
+        int i = SkipLabels(code, pos[label]);
+        if (i >= int(code.size()) || code[i].op != IR_GOTO)
+            break;
+        label = code[i].label;
+    }
+
+    // entre rótulos consecutivos, usa sempre o primeiro
+    int i = pos[label];
+    while (i > 0 && code[i - 1].op == IR_LABEL)
+        --i;
+    return code[i].label;
+}
+
+// encurta cadeias de desvios: desvios para um goto vão direto ao destino final,
+// desvios para a instrução seguinte são removidos, um desvio condicional sobre
+// um goto é invertido e rótulos sem referências são eliminados
+bool ThreadJumps(Function * f)
+{
+    vector<Quad> & code = f->code;
+    bool changed = false;
+    bool again = true;
+
+    while (again)
+    {
+        again = false;
+        map<unsigned, int> pos = LabelPositions(code);
+
+        // desvios para goto
+        for (Quad & q : code)
+        {
+            if (q.IsJump())
+            {
+                unsigned target = FinalTarget(code, pos, q.label);
+                if (target != q.label)
+                {
+                    q.label = target;
+                    again = true;
+                }
+            }
+        }
+
+        // desvio condicional para outro desvio sobre a mesma condição: o resultado
+        // do segundo teste já é conhecido
+        for (Quad & q : code)
+        {
+            if (!q.IsBranch())
+                continue;
+            int i = SkipLabels(code, pos[q.label]);
+            if (i >= int(code.size()) || !code[i].IsBranch() || code[i].arg1.name != q.arg1.name || q.arg1.IsConst())
+                continue;
+
+            unsigned target = 0;
+            if (code[i].op == q.op)
+                target = code[i].label;
+            else if (i + 1 < int(code.size()) && code[i + 1].op == IR_LABEL)
+                target = code[i + 1].label;
+
+            if (target && target != q.label)
+            {
+                q.label = target;
+                again = true;
+            }
+        }
+
+        // ifFalse c goto L1; goto L2; L1: passa a ifTrue c goto L2; L1:
+        for (int i = 0; i + 2 < int(code.size()); ++i)
+        {
+            Quad & q = code[i];
+            Quad & next = code[i + 1];
+            if (q.IsBranch() && next.op == IR_GOTO && pos[q.label] > i + 1 && SkipLabels(code, i + 2) > pos[q.label])
+            {
+                q.op = (q.op == IR_IFFALSE) ? IR_IFTRUE : IR_IFFALSE;
+                q.label = next.label;
+                next.op = IR_LABEL;
+                next.label = 0;
+                again = true;
+            }
+        }
+
+        // desvios para a instrução seguinte e rótulos sem referências
+        set<unsigned> used;
+        vector<Quad> result;
+        for (int i = 0; i < int(code.size()); ++i)
+        {
+            Quad & q = code[i];
+            if (q.IsJump() && pos[q.label] > i && SkipLabels(code, i + 1) > pos[q.label])
+            {
+                again = true;
+                continue;
+            }
+            if (q.IsJump())
+                used.insert(q.label);
+            result.push_back(q);
+        }
+
+        code.clear();
+        for (Quad & q : result)
+        {
+            if (q.op == IR_LABEL && !used.count(q.label))
+                continue;
+            code.push_back(q);
+        }
+
+        changed = changed || again;
+    }
+
+    return changed;
+}
+
+// -----------------------------
+// Chamadas em posição de cauda
+// -----------------------------
+
+// constante nula de um tipo, valor inicial de uma nova ativação
+static Operand Zero(int type)
+{
+    if (type == ExprType::FLOAT)
+        return Operand(OPD_CONST, type, "0.0");
+    if (type == ExprType::BOOL)
+        return Operand(OPD_CONST, type, "false");
+    return Operand(OPD_CONST, ExprType::INT, "0");
+}
+
+// verifica se a chamada em i é seguida apenas de rótulos e desvios até o
+// retorno do próprio resultado
+static bool InTailPosition(vector<Quad> & code, map<unsigned, int> & pos, int i)
+{
+    set<unsigned> seen;
+    int j = SkipLabels(code, i + 1);
+    while (j < int(code.size()) && code[j].op == IR_GOTO && seen.insert(code[j].label).second)
+        j = SkipLabels(code, pos[code[j].label]);
+
+    return j < int(code.size()) && code[j].op == IR_RETURN && code[j].arg1.name == code[i].dst.name;
+}
+
+// transforma chamadas recursivas em posição de cauda em um desvio para o
+// início da função, com os parâmetros reatribuídos, e a recursão em laço
+bool EliminateTailCalls(Function * f)
+{
+    if (f->name.empty() || f->code.empty())
+        return false;
+
+    // arranjos locais seriam novos a cada ativação
+    set<string> params(f->params.begin(), f->params.end());
+    for (Symbol & s : f->locals)
+    {
+        if (s.valX != -1 && !params.count(s.var))
+            return false;
+    }
+
+    vector<Quad> & code = f->code;
+    map<unsigned, int> pos = LabelPositions(code);
+    int n = f->params.size();
+
+    vector<int> tails;
+    for (int i = n; i < int(code.size()); ++i)
+    {
+        if (code[i].op != IR_CALL || code[i].name != f->name || !InTailPosition(code, pos, i))
+            continue;
+
+        // arranjos passados por referência não podem trocar de arranjo
+        bool valid = true;
+        for (int k = 0; k < n; ++k)
+        {
+            Quad & param = code[i - n + k];
+            Symbol * s = f->Local(f->params[k]);
+            if (param.op != IR_PARAM || (s->valX != -1 && param.arg1.name != s->var))
+                valid = false;
+        }
+        if (valid)
+            tails.push_back(i);
+    }
+
+    if (tails.empty())
+        return false;
+
+    // variáveis locais lidas antes de escritas recomeçam zeradas
+    CFG cfg(f);
+    cfg.Liveness();
+    vector<Quad> resets;
+    for (Symbol & s : f->locals)
+    {
+        if (s.valX == -1 && !params.count(s.var) && cfg.blocks[0].in.count(s.var))
+        {
+            Quad reset(IR_COPY);
+            reset.dst = Operand(OPD_VAR, TypeOf(s.type), s.var);
+            reset.arg1 = Zero(TypeOf(s.type));
+            resets.push_back(reset);
+        }
+    }
+
+    Quad start(IR_LABEL);
+    start.label = NewLabel();
+
+    vector<Quad> result{start};
+    int t = 0;
+    for (int i = 0; i < int(code.size()); ++i)
+    {
+        if (t < int(tails.size()) && i == tails[t] - n)
+        {
+            // atribuição paralela: os argumentos podem ler os próprios parâmetros
+            vector<Quad> copies;
+            for (int k = 0; k < n; ++k)
+            {
+                Symbol * s = f->Local(f->params[k]);
+                Operand arg = code[i + k].arg1;
+                if (s->valX != -1 || arg.name == s->var)
+                    continue;
+
+                Quad save(IR_COPY);
+                save.dst = NewTemp(TypeOf(s->type));
+                save.arg1 = arg;
+                result.push_back(save);
+
+                Quad copy(IR_COPY);
+                copy.dst = Operand(OPD_VAR, TypeOf(s->type), s->var);
+                copy.arg1 = save.dst;
+                copies.push_back(copy);
+            }
+            result.insert(result.end(), copies.begin(), copies.end());
+            result.insert(result.end(), resets.begin(), resets.end());
+
+            Quad jump(IR_GOTO);
+            jump.label = start.label;
+            result.push_back(jump);
+
+            i = tails[t++];
+            continue;
+        }
+        result.push_back(code[i]);
+    }
+
+    code.swap(result);
+    return true;
+}
+
+// ------------
+// Código morto
+// ------------
+
+// remove instruções cujo destino não está vivo logo após a instrução, exceto
+// as que podem interromper a execução
+bool EliminateDeadCode(Function * f)
+{
+    bool changed = false;
+    bool removed = true;
+
+    // a remoção de uma instrução pode tornar mortas as que a alimentavam
+    while (removed && !f->code.empty())
+    {
+        removed = false;
+        CFG cfg(f);
+        cfg.Liveness();
+
+        vector<bool> dead(f->code.size(), false);
+        for (BasicBlock & b : cfg.blocks)
+        {
+            set<string> live = b.out;
+            for (int i = b.last - 1; i >= b.first; --i)
+            {
+                Quad & q = f->code[i];
+                if (q.IsPure() && !q.CanTrap() && !live.count(q.dst.name))
+                {
+                    dead[i] = true;
+                    removed = true;
+                    continue;
+                }
+                cfg.Transfer(q, live);
+            }
+        }
+
+        if (removed)
+        {
+            vector<Quad> code;
+            for (int i = 0; i < int(f->code.size()); ++i)
+            {
+                if (!dead[i])
+                    code.push_back(f->code[i]);
+            }
+            f->code.swap(code);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// ------------------------------
+// Reaproveitamento de temporários
+// ------------------------------
+
+// intervalo de vida de um temporário no código linearizado;
+// a posição 2i corresponde às leituras da instrução i e 2i+1 à sua escrita
+struct Interval
+{
+    string name;
+    int type;
+    int start;
+    int end;
+};
+
+// renomeia temporários cujos intervalos de vida não se sobrepõem
+// para um mesmo nome, reduzindo o número de temporários distintos
+void CoalesceTemps(Function * f)
+{
+    if (f->code.empty())
+        return;
+
+    CFG cfg(f);
+    cfg.Liveness();
+
+    map<string, Interval> ranges;
+    auto extend = [&ranges](const string & name, int type, int pos)
+    {
+        auto found = ranges.find(name);
+        if (found == ranges.end())
+        {
+            ranges[name] = Interval{name, type, pos, pos};
+        }
+        else
+        {
+            found->second.start = std::min(found->second.start, pos);
+            found->second.end = std::max(found->second.end, pos);
+        }
+    };
+
+    for (int i = 0; i < int(f->code.size()); ++i)
+    {
+        Quad & q = f->code[i];
+        for (Operand * o : q.Uses())
+            if (o->IsTemp())
+                extend(o->name, o->type, 2 * i);
+        Operand * d = q.Def();
+        if (d && d->IsTemp())
+            extend(d->name, d->type, 2 * i + 1);
+    }
+
+    // temporários vivos nas fronteiras dos blocos cobrem o bloco inteiro
+    for (BasicBlock & b : cfg.blocks)
+    {
+        for (const string & name : b.in)
+            if (ranges.count(name))
+                extend(name, ranges[name].type, 2 * b.first);
+        for (const string & name : b.out)
+            if (ranges.count(name))
+                extend(name, ranges[name].type, 2 * b.last);
+    }
+
+    vector<Interval> order;
+    for (auto & [name, range] : ranges)
+        order.push_back(range);
+    sort(order.begin(), order.end(), [](const Interval & a, const Interval & b)
+    {
+        return a.start < b.start;
+    });
+
+    // varredura linear: nomes livres são separados por tipo
+    map<string, string> rename;
+    map<int, set<int>> available;
+    std::multimap<int, std::pair<int, int>> active;     // fim -> (tipo, número)
+    int count = 0;
+
+    for (Interval & r : order)
+    {
+        while (!active.empty() && active.begin()->first < r.start)
+        {
+            auto [type, number] = active.begin()->second;
+            available[type].insert(number);
+            active.erase(active.begin());
+        }
+
+        int number;
+        set<int> & pool = available[r.type];
+        if (pool.empty())
+        {
+            number = ++count;
+        }
+        else
+        {
+            number = *pool.begin();
+            pool.erase(pool.begin());
+        }
+
+        rename[r.name] = "t" + std::to_string(number);
+        active.insert({r.end, {r.type, number}});
+    }
+
+    for (Quad & q : f->code)
+    {
+        for (Operand * o : {&q.dst, &q.arg1, &q.arg2, &q.arg3, &q.idx1, &q.idx2})
+        {
+            if (o->IsTemp())
+                o->name = rename[o->name];
+        }
+    }
+}
+
+// ----------------------
+// Cálculo de endereços
+// ----------------------
+
+// explicita o deslocamento dos acessos bidimensionais, a[i * n + j] passa a
+// t1 = i * n; t2 = t1 + j; a[t2], expondo a multiplicação às demais otimizações
+void LowerAddresses(Function * f)
+{
+    vector<Quad> code;
+    for (Quad & q : f->code)
+    {
+        if ((q.IsLoad() || q.IsStore()) && q.idx2.kind != OPD_NONE)
+        {
+            Quad mul(IR_BINARY);
+            mul.dst = NewTemp(ExprType::INT);
+            mul.arg1 = q.idx1;
+            mul.oper = "*";
+            mul.arg2 = Operand(OPD_CONST, ExprType::INT, std::to_string(q.stride));
+            code.push_back(mul);
+
+            Quad add(IR_BINARY);
+            add.dst = NewTemp(ExprType::INT);
+            add.arg1 = mul.dst;
+            add.oper = "+";
+            add.arg2 = q.idx2;
+            code.push_back(add);
+
+            q.idx1 = add.dst;
+            q.idx2 = Operand();
+            q.stride = 0;
+        }
+        code.push_back(q);
+    }
+    f->code.swap(code);
+}
+
+// ---------
+// Otimizador
+// ---------
+
+void Optimize(Program * p, Options & opt)
+{
+    if (opt.level < 1)
+        return;
+
+    if (opt.level >= 2 && opt.inlineLimit > 0)
+        InlineCalls(p, opt.inlineLimit);
+
+    for (Function * f : p->funcs)
+    {
+        if (opt.level >= 2)
+        {
+            if (opt.unroll > 0)
+                UnrollLoops(f, opt.unroll);
+            LowerAddresses(f);
+            HoistInvariants(f);
+            ReduceInductions(f);
+        }
+
+        EliminateTailCalls(f);
+        ThreadJumps(f);
+        RemoveUnreachable(f);
+        if (opt.level >= 2)
+            IfConvert(f);
+        // desvios resolvidos pela janela deixam saltos e blocos a limpar
+        if (Peephole(f))
+        {
+            ThreadJumps(f);
+            RemoveUnreachable(f);
+        }
+        EliminateDeadCode(f);
+        CoalesceTemps(f);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef COMPILER_OPTIMIZER
+#define COMPILER_OPTIMIZER
+
+#include "ir.h"
+#include "options.h"
+
+// otimizações sobre o código de três endereços
+//  -O0: nenhuma
+//  -O1: eliminação de chamadas de cauda, encadeamento de desvios, otimização
+//       por janela (peephole), remoção de código morto e reaproveitamento de
+//       temporários
+//  -O2: expansão de funções pequenas, desenrolamento de laços contados,
+//       cálculo explícito de endereços, otimizações de laços e troca de
+//       desvios curtos por select (os ninhos de laços são reordenados já na
+//       geração, por OptimizeNest)
+void Optimize(Program * p, Options & opt);
+
+void LowerAddresses(Function * f);
+bool EliminateTailCalls(Function * f);
+bool ThreadJumps(Function * f);
+bool RemoveUnreachable(Function * f);
+bool EliminateDeadCode(Function * f);
+void CoalesceTemps(Function * f);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef COMPILER_OPTIONS
+#define COMPILER_OPTIONS
+
+// formas de saída do código traduzido
+enum Emit
+{
+    EMIT_IR,        // código de três endereços
+    EMIT_ASM,       // assembly x86-64 para o montador GNU
+    EMIT_C,         // programa em C99
+    EMIT_LLVM       // módulo LLVM textual
+};
+
+// opções de linha de comando do tradutor
+struct Options
+{
+    int level = 0;              // -O<nível>
+    int inlineLimit = 16;       // --inline-limit=<n>: tamanho máximo das funções expandidas
+    int unroll = 4;             // --unroll=<n>: fator de desenrolamento parcial de laços (0 desativa)
+    int tile = 32;              // --tile=<n>: iterações por bloco nos ninhos de laços (0 desativa)
+    int vectorWidth = 4;        // --vector-width=<n>: elementos das operações vetoriais (0 desativa)
+    bool vectorReport = false;  // --vector-report: informa quais laços foram vetorizados
+    bool run = false;           // --run: executa o programa na máquina virtual
+    bool jit = false;           // --jit: compila para a memória e executa o código nativo
+    bool tiered = false;        // --tiered: interpreta e compila em segundo plano as funções e laços frequentes
+    int tierThreshold = 1000;   // --tier-threshold=<n>: chamadas ou voltas de laço até a compilação
+    const char * codeCache = nullptr;   // --code-cache=<dir>: guarda o código nativo entre execuções
+    int threads = 0;            // --threads=<n>: threads dos laços 🧵 (0: um por núcleo)
+    int parallelChunk = 0;      // --parallel-chunk=<n>: iterações por bloco dos laços 🧵 (0: automático)
+    int emit = EMIT_IR;         // --emit=<ir|asm|c|llvm>: forma da saída
+};
+
+#endif
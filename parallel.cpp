@@ -0,0 +1,530 @@
+#include <set>
+#include "parallel.h"
+#include "alias.h"
+#include "error.h"
+#include "gen.h"
+#include "ir.h"
+using std::set;
+
+extern Program * program;
+
+// acesso a um arranjo no corpo do laço; sem índices, o arranjo inteiro
+// (destino de uma chamada que devolve arranjo)
+struct Touch
+{
+    string array;
+    Expression * x;
+    Expression * y;
+    bool write;
+};
+
+// efeitos do corpo do laço
+struct Footprint
+{
+    set<string> names;              // nomes usados: variáveis e arranjos
+    vector<string> written;         // variáveis escritas, na ordem do corpo
+    set<string> early;              // variáveis lidas antes de serem escritas na iteração
+    vector<Touch> touches;
+    vector<string> calls;
+};
+
+// declaração visível do nome na função envolvente ou no programa principal
+static Symbol * Declared(const string & name)
+{
+    Function * outer = program->current;
+    Symbol * s = (outer != program->Main()) ? outer->Local(name) : nullptr;
+    return s ? s : program->Main()->Local(name);
+}
+
+static bool Scalar(const string & name)
+{
+    Symbol * s = Declared(name);
+    return s && !s->isFunction && s->valX == -1;
+}
+
+static void Read(const string & name, const set<string> & assigned, Footprint & fp)
+{
+    fp.names.insert(name);
+    if (!assigned.count(name))
+        fp.early.insert(name);
+}
+
+static void Reads(Expression * e, const set<string> & assigned, Footprint & fp)
+{
+    if (!e)
+        return;
+
+    switch (e->node_type)
+    {
+    case NodeType::IDENTIFIER:
+        Read(e->ToString(), assigned, fp);
+        break;
+    case NodeType::ACCESS:
+    {
+        Access * a = (Access*) e;
+        fp.names.insert(a->id->ToString());
+        fp.touches.push_back(Touch{a->id->ToString(), a->indexX, a->indexY, false});
+        Reads(a->indexX, assigned, fp);
+        Reads(a->indexY, assigned, fp);
+        break;
+    }
+    case NodeType::LOG:
+        Reads(((Logical*) e)->expr1, assigned, fp);
+        Reads(((Logical*) e)->expr2, assigned, fp);
+        break;
+    case NodeType::REL:
+        Reads(((Relational*) e)->expr1, assigned, fp);
+        Reads(((Relational*) e)->expr2, assigned, fp);
+        break;
+    case NodeType::ARI:
+        Reads(((Arithmetic*) e)->expr1, assigned, fp);
+        Reads(((Arithmetic*) e)->expr2, assigned, fp);
+        break;
+    case NodeType::UNARY:
+        Reads(((UnaryExpr*) e)->expr, assigned, fp);
+        break;
+    }
+}
+
+static void Write(const string & name, set<string> & assigned, Footprint & fp)
+{
+    fp.names.insert(name);
+    if (!Scalar(name))
+    {
+        fp.touches.push_back(Touch{name, nullptr, nullptr, true});
+        return;
+    }
+    bool seen = false;
+    for (const string & w : fp.written)
+        seen = seen || w == name;
+    if (!seen)
+        fp.written.push_back(name);
+    assigned.insert(name);
+}
+
+static void Write(Expression * target, set<string> & assigned, Footprint & fp)
+{
+    if (target->node_type != NodeType::ACCESS)
+    {
+        Write(target->ToString(), assigned, fp);
+        return;
+    }
+
+    Access * a = (Access*) target;
+    fp.names.insert(a->id->ToString());
+    fp.touches.push_back(Touch{a->id->ToString(), a->indexX, a->indexY, true});
+    Reads(a->indexX, assigned, fp);
+    Reads(a->indexY, assigned, fp);
+}
+
+static bool Is(Expression * e, const string & var)
+{
+    return e && e->node_type == NodeType::IDENTIFIER && e->ToString() == var;
+}
+
+static void Loop(Assign * init, Expression * cond, Assign * inc, Statement * body, set<string> & assigned, Footprint & fp);
+
+// percorre o corpo na ordem da execução; assigned são as variáveis com
+// certeza escritas na iteração até o ponto corrente
+static void Walk(Statement * s, set<string> & assigned, Footprint & fp)
+{
+    if (!s)
+        return;
+
+    switch (s->node_type)
+    {
+    case NodeType::SEQ:
+        Walk(((Seq*) s)->stmt, assigned, fp);
+        Walk(((Seq*) s)->stmts, assigned, fp);
+        break;
+    case NodeType::ASSIGN:
+        Reads(((Assign*) s)->expr, assigned, fp);
+        Write(((Assign*) s)->id, assigned, fp);
+        break;
+    case NodeType::IF_STMT:
+    {
+        Reads(((If*) s)->expr, assigned, fp);
+        set<string> inner = assigned;
+        Walk(((If*) s)->stmt, inner, fp);
+        break;
+    }
+    case NodeType::WHILE_STMT:
+    {
+        Reads(((While*) s)->expr, assigned, fp);
+        set<string> inner = assigned;
+        Walk(((While*) s)->stmt, inner, fp);
+        break;
+    }
+    case NodeType::DOWHILE_STMT:
+        // o corpo executa ao menos uma vez
+        Walk(((DoWhile*) s)->stmt, assigned, fp);
+        Reads(((DoWhile*) s)->expr, assigned, fp);
+        break;
+    case NodeType::FOR_STMT:
+    {
+        For * f = (For*) s;
+        Loop(f->for_init, f->for_condition, f->for_increment, f->stmt, assigned, fp);
+        break;
+    }
+    case NodeType::PARFOR_STMT:
+    {
+        ParallelFor * f = (ParallelFor*) s;
+        Loop(f->for_init, f->for_condition, f->for_increment, f->stmt, assigned, fp);
+        break;
+    }
+    case NodeType::FUNC_CALL:
+    {
+        FuncCall * c = (FuncCall*) s;
+        fp.calls.push_back(c->function);
+        for (const string & arg : c->args)
+            Read(arg, assigned, fp);
+        Write(c->ret, assigned, fp);
+        break;
+    }
+    }
+}
+
+// o laço executa o corpo ao menos uma vez: início e limite constantes que
+// satisfazem a condição
+static bool Enters(Assign * init, Expression * cond)
+{
+    if (cond->node_type != NodeType::REL || !Is(((Relational*) cond)->expr1, init->id->ToString()))
+        return false;
+    Expression * from = init->expr;
+    Expression * to = ((Relational*) cond)->expr2;
+    if (from->node_type != NodeType::CONSTANT || from->type != ExprType::INT
+        || to->node_type != NodeType::CONSTANT || to->type != ExprType::INT)
+        return false;
+
+    long long a = std::stoll(from->ToString());
+    long long b = std::stoll(to->ToString());
+    switch (cond->token->tag)
+    {
+    case '<': return a < b;
+    case '>': return a > b;
+    case Tag::LTE: return a <= b;
+    case Tag::GTE: return a >= b;
+    }
+    return false;
+}
+
+// a inicialização sempre executa; o corpo e o incremento, talvez nenhuma
+// vez, a menos que a condição valha já no início
+static void Loop(Assign * init, Expression * cond, Assign * inc, Statement * body, set<string> & assigned, Footprint & fp)
+{
+    Reads(init->expr, assigned, fp);
+    Write(init->id, assigned, fp);
+    Reads(cond, assigned, fp);
+    set<string> inner = assigned;
+    set<string> & once = Enters(init, cond) ? assigned : inner;
+    Walk(body, once, fp);
+    Reads(inc->expr, once, fp);
+    Write(inc->id, once, fp);
+}
+
+static Operand Int(int value)
+{
+    return Operand(OPD_CONST, ExprType::INT, std::to_string(value));
+}
+
+static Operand Var(const string & name)
+{
+    Symbol * s = Declared(name);
+    return Operand(OPD_VAR, s ? TypeOf(s->type) : ExprType::INT, name);
+}
+
+// variável (elements -1) ou arranjo de uma dimensão da função gerada
+static Symbol Local(const string & name, const string & type, int elements = -1)
+{
+    Symbol s{};
+    s.var = name;
+    s.type = type;
+    s.valX = elements;
+    s.valY = -1;
+    return s;
+}
+
+static void Fail(ParallelFor * loop, const string & message)
+{
+    throw SyntaxError{loop->line, message};
+}
+
+// os acessos aos arranjos escritos usam o contador, sozinho, numa mesma
+// posição do índice: iterações diferentes alcançam linhas (ou colunas)
+// diferentes. Arranjos que podem compartilhar memória com um arranjo
+// escrito não são aceitos
+static void CheckArrays(ParallelFor * loop, const string & var, Footprint & fp)
+{
+    string func = program->current->name;
+    for (Touch & w : fp.touches)
+    {
+        if (!w.write)
+            continue;
+
+        bool rows = true;
+        bool cols = true;
+        for (Touch & t : fp.touches)
+        {
+            if (t.array != w.array)
+            {
+                if (MayAlias(func, t.array, w.array))
+                    Fail(loop, "'" + t.array + "' pode compartilhar memória com '" + w.array
+                         + "', escrito no laço paralelo (🔒 dispensa a verificação)");
+                continue;
+            }
+            rows = rows && Is(t.x, var);
+            cols = cols && Is(t.y, var);
+        }
+        if (!rows && !cols)
+            Fail(loop, "iterações do laço paralelo podem alcançar os mesmos elementos de '" + w.array
+                 + "': os acessos devem ter o contador '" + var + "' numa mesma posição do índice"
+                 + " (🔒 dispensa a verificação)");
+    }
+}
+
+void Parallelize(ParallelFor * loop)
+{
+    // forma: contador inteiro, limite na direção de um passo constante
+    Expression * id = loop->for_init->id;
+    string var = id->ToString();
+    int step = 0;
+    int rel = 0;
+    if (id->node_type == NodeType::IDENTIFIER && id->type == ExprType::INT
+        && loop->for_condition->node_type == NodeType::REL
+        && Is(((Relational*) loop->for_condition)->expr1, var)
+        && ((Relational*) loop->for_condition)->expr2->type == ExprType::INT
+        && Is(loop->for_increment->id, var) && loop->for_increment->expr->node_type == NodeType::ARI)
+    {
+        Arithmetic * inc = (Arithmetic*) loop->for_increment->expr;
+        rel = loop->for_condition->token->tag;
+        if ((inc->token->tag == '+' || inc->token->tag == '-') && Is(inc->expr1, var)
+            && inc->expr2->node_type == NodeType::CONSTANT && inc->expr2->type == ExprType::INT)
+        {
+            step = std::stoi(inc->expr2->ToString());
+            if (inc->token->tag == '-')
+                step = -step;
+        }
+    }
+    bool up = (rel == '<' || rel == Tag::LTE) && step > 0;
+    bool down = (rel == '>' || rel == Tag::GTE) && step < 0;
+    if (!up && !down)
+        Fail(loop, "o laço paralelo deve ter a forma (i = a; i op b; i = i ± c), com c constante"
+                   " e op entre <, <=, > e >= na direção do passo, com limite inteiro");
+    Expression * bound = ((Relational*) loop->for_condition)->expr2;
+
+    set<string> assigned = {var};
+    Footprint fp;
+    Walk(loop->stmt, assigned, fp);
+
+    Footprint limit;
+    Reads(bound, {}, limit);
+    for (const string & w : fp.written)
+    {
+        if (w == var)
+            Fail(loop, "o contador '" + var + "' do laço paralelo é alterado no corpo");
+        if (limit.names.count(w))
+            Fail(loop, "o limite do laço paralelo depende de '" + w + "', alterada no corpo");
+        if (!assigned.count(w))
+            Fail(loop, "'" + w + "' nem sempre é escrita nas iterações do laço paralelo:"
+                       " o valor final dependeria da divisão entre as threads");
+        if (fp.early.count(w))
+            Fail(loop, "'" + w + "' é lida no laço paralelo antes de ser escrita na mesma iteração:"
+                       " as iterações dependem umas das outras");
+    }
+    if (limit.names.count(var))
+        Fail(loop, "o limite do laço paralelo depende do contador '" + var + "'");
+    if (!loop->trusted)
+    {
+        if (!fp.calls.empty())
+            Fail(loop, "chamada de '" + fp.calls.front() + "' no laço paralelo (🔒 dispensa a verificação)");
+        CheckArrays(loop, var, fp);
+    }
+
+    static int count = 0;
+    Function * outer = program->current;
+    string name = "paralelo_" + std::to_string(++count);
+
+    // variáveis privadas: o contador e as escritas no corpo; as escritas
+    // voltam pelos arranjos de saída, um por tipo
+    vector<Symbol> privates;
+    privates.push_back(*Declared(var));
+    for (const string & w : fp.written)
+        privates.push_back(*Declared(w));
+    const string types[] = {"int", "float", "bool"};
+    vector<Symbol> outputs;
+    vector<std::pair<string, int>> slots(privates.size());   // arranjo de saída e posição
+    for (const string & type : types)
+    {
+        Symbol out = Local(name + "_" + type, type, 0);
+        for (size_t k = 1; k < privates.size(); ++k)
+        {
+            if (privates[k].type == type)
+                slots[k] = {out.var, out.valX++};
+        }
+        if (out.valX > 0)
+            outputs.push_back(out);
+    }
+
+    // parâmetros: faixa de iterações, indicador da última faixa, valor
+    // inicial do contador, nomes locais da função envolvente usados no corpo
+    // (arranjos por referência) e arranjos de saída
+    vector<Symbol> params =
+    {
+        Local("primeira_", "int"),
+        Local("fim_", "int"),
+        Local("ultima_", "int"),
+        Local("base_", "int")
+    };
+    for (const string & n : fp.names)
+    {
+        bool own = (n == var);
+        for (const string & w : fp.written)
+            own = own || w == n;
+        Symbol * s = (outer != program->Main()) ? outer->Local(n) : nullptr;
+        if (!own && s && !s->isFunction)
+            params.push_back(*s);
+    }
+    for (Symbol & out : outputs)
+    {
+        outer->locals.push_back(out);
+        params.push_back(out);
+    }
+
+    // a função executa as iterações da faixa com o corpo original e devolve
+    // o fim da faixa, que a chamada guarda de volta no número de iterações
+    Operand first(OPD_VAR, ExprType::INT, "primeira_");
+    Operand end(OPD_VAR, ExprType::INT, "fim_");
+    Operand last(OPD_VAR, ExprType::INT, "ultima_");
+    Operand base(OPD_VAR, ExprType::INT, "base_");
+    Operand trip(OPD_VAR, ExprType::INT, "volta_");
+
+    Function * saved = program->Begin(name);
+    Function * f = program->current;
+    f->parallel = true;
+    f->ret = end.name;
+    f->locals = params;
+    for (Symbol & p : params)
+        f->params.push_back(p.var);
+    f->locals.push_back(Local(trip.name, "int"));
+    for (Symbol & p : privates)
+        f->locals.push_back(p);
+    ShareAliases(f->name, outer->name);
+
+    unsigned top = NewLabel();
+    unsigned done = NewLabel();
+    Operand enter = NewTemp(ExprType::BOOL);
+    EmitCopy(trip, first);
+    EmitBinary(enter, trip, "<", end);
+    EmitJump(IR_IFFALSE, enter, done);
+    EmitLabel(top);
+    Operand offset = NewTemp(ExprType::INT);
+    EmitBinary(offset, trip, "*", Int(step));
+    EmitBinary(Operand(OPD_VAR, ExprType::INT, var), base, "+", offset);
+    loop->stmt->Gen();
+    Operand again = NewTemp(ExprType::BOOL);
+    EmitBinary(trip, trip, "+", Int(1));
+    EmitBinary(again, trip, "<", end);
+    EmitJump(IR_IFTRUE, again, top);
+
+    // a última faixa guarda os valores da última iteração
+    Operand closing = NewTemp(ExprType::BOOL);
+    EmitBinary(closing, last, "!=", Int(0));
+    EmitJump(IR_IFFALSE, closing, done);
+    for (size_t k = 1; k < privates.size(); ++k)
+        EmitStore(slots[k].first, Int(slots[k].second), Operand(), 0, Var(privates[k].var));
+    EmitLabel(done);
+    EmitReturn(end);
+    program->End(saved);
+
+    // iterações menos uma, com o início e o limite calculados uma vez: a
+    // distância entre eles vai até 2^32 - 1 e é tratada sem sinal; a
+    // divisão pelo passo c usa a metade h da distância d, que cabe num
+    // inteiro: d / c = 2 * (h / c) + (2 * (h % c) + d % 2 >= c)
+    Operand start = NewTemp(ExprType::INT);
+    Operand limitValue = NewTemp(ExprType::INT);
+    Operand rest = NewTemp(ExprType::INT);
+    Operand trips = NewTemp(ExprType::INT);
+    Operand from = NewTemp(ExprType::INT);
+    Operand test = NewTemp(ExprType::BOOL);
+    unsigned finish = NewLabel();
+    EmitCopy(start, Operand(Rvalue(loop->for_init->expr)));
+    EmitCopy(limitValue, Operand(Rvalue(bound)));
+    EmitCopy(from, start);
+    EmitCopy(trips, Int(0));
+    string oper = (rel == '<') ? "<" : (rel == '>') ? ">" : (rel == Tag::LTE) ? "<=" : ">=";
+    EmitBinary(test, start, oper, limitValue);
+    EmitJump(IR_IFFALSE, test, finish);
+    int stride = up ? step : -step;
+    if (up)
+        EmitBinary(rest, limitValue, "-", start);
+    else
+        EmitBinary(rest, start, "-", limitValue);
+    if (rel == '<' || rel == '>')
+        EmitBinary(rest, rest, "-", Int(1));
+    if (stride > 1)
+    {
+        Operand half = NewTemp(ExprType::INT);
+        Operand odd = NewTemp(ExprType::INT);
+        Operand remainder = NewTemp(ExprType::INT);
+        Operand room = NewTemp(ExprType::INT);
+        Operand carry = NewTemp(ExprType::BOOL);
+        unsigned even = NewLabel();
+        EmitBinary(half, rest, ">>", Int(1));
+        EmitBinary(half, half, "&", Int(INT32_MAX));
+        EmitBinary(odd, rest, "&", Int(1));
+        EmitBinary(rest, half, "/", Int(stride));
+        EmitBinary(remainder, rest, "*", Int(stride));
+        EmitBinary(remainder, half, "-", remainder);
+        EmitBinary(rest, rest, "+", rest);
+        EmitBinary(room, Int(stride), "-", remainder);
+        EmitBinary(room, room, "-", odd);
+        EmitBinary(carry, remainder, ">=", room);
+        EmitJump(IR_IFFALSE, carry, even);
+        EmitBinary(rest, rest, "+", Int(1));
+        EmitLabel(even);
+    }
+
+    // a faixa vai à função em blocos de até 2^30 iterações, para que o
+    // número de iterações de cada chamada caiba num inteiro; só o último
+    // bloco guarda os valores da última iteração
+    const int block = 1 << 30;
+    Operand high = NewTemp(ExprType::INT);
+    Operand more = NewTemp(ExprType::BOOL);
+    Operand final = NewTemp(ExprType::INT);
+    unsigned round = NewLabel();
+    unsigned call = NewLabel();
+    EmitLabel(round);
+    EmitBinary(high, rest, ">>", Int(30));
+    EmitBinary(more, high, "!=", Int(0));
+    EmitCopy(trips, Int(block));
+    EmitCopy(final, Int(0));
+    EmitJump(IR_IFTRUE, more, call);
+    EmitBinary(trips, rest, "+", Int(1));
+    EmitCopy(final, Int(1));
+    EmitLabel(call);
+    EmitParam(Int(0));
+    EmitParam(trips);
+    EmitParam(final);
+    EmitParam(from);
+    for (size_t k = 4; k < params.size(); ++k)
+        EmitParam(Operand(OPD_VAR, TypeOf(params[k].type), params[k].var));
+    EmitCall(trips, name);
+    EmitJump(IR_IFFALSE, more, finish);
+    EmitBinary(from, from, "+", Int(int32_t(uint32_t(block) * uint32_t(step))));
+    EmitBinary(rest, rest, "-", Int(block));
+    EmitGoto(round);
+    EmitLabel(finish);
+
+    // o contador termina como no laço sequencial; as variáveis privadas
+    // recebem os valores da última iteração, quando houve alguma
+    Operand moved = NewTemp(ExprType::INT);
+    Operand ran = NewTemp(ExprType::BOOL);
+    unsigned after = NewLabel();
+    EmitBinary(moved, trips, "*", Int(step));
+    EmitBinary(Operand(OPD_VAR, ExprType::INT, var), from, "+", moved);
+    EmitBinary(ran, trips, ">", Int(0));
+    EmitJump(IR_IFFALSE, ran, after);
+    for (size_t k = 1; k < privates.size(); ++k)
+        EmitLoad(Var(privates[k].var), slots[k].first, Int(slots[k].second), Operand(), 0);
+    EmitLabel(after);
+}
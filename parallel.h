@@ -0,0 +1,15 @@
+#ifndef COMPILER_PARALLEL
+#define COMPILER_PARALLEL
+
+#include "ast.h"
+
+// laço 🧵 (i = a; i op b; i = i ± c), com c constante: verifica que as
+// iterações são independentes (com 🔒, apenas que as variáveis escritas são
+// privadas de cada iteração) e extrai o corpo para uma função que executa
+// uma faixa de iterações, chamada com a faixa inteira (em blocos de até
+// 2^30 iterações); a execução divide a faixa entre as threads. As variáveis escritas no corpo são locais da
+// função, escritas em todas as iterações, e os valores que a última
+// iteração deixa nelas voltam por arranjos de saída
+void Parallelize(ParallelFor * loop);
+
+#endif
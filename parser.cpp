@@ -137,6 +137,13 @@ void Parser::Decls()
             ss << "variável \"" << name << "\" já definida";
             throw SyntaxError(scanner->Lineno(), ss.str());
         }
+
+        // registra a declaração no escopo de função corrente
+        bool known = false;
+        for (Symbol & d : *decls)
+            known = known || d.var == name;
+        if (!known)
+            decls->push_back(s);
     }
 }
 
@@ -155,6 +162,7 @@ Statement *Parser::Stmts()
     case Tag::IF:
     case Tag::WHILE:
     case Tag::FOR:
+    case Tag::PARFOR:
     case Tag::DO:
     case Tag::FUNC:
 
@@ -231,8 +239,14 @@ Statement *Parser::Stmt()
         return stmt;
     }
     case Tag::FOR:
-    {
-        Match(Tag::FOR);
+    case Tag::PARFOR:
+    {
+        // 🧵 é a forma paralela do 🧬; 🔒 logo depois dela dispensa a
+        // verificação da independência entre as iterações
+        bool parallel = Match(Tag::PARFOR);
+        bool trusted = parallel && Match(Tag::NOALIAS);
+        if (!parallel)
+            Match(Tag::FOR);
         if (!Match('('))
         {
             stringstream ss;
@@ -281,8 +295,12 @@ Statement *Parser::Stmt()
             ss << "esperado ) no lugar de  \'" << lookahead->lexeme << "\'";
             throw SyntaxError{scanner->Lineno(), ss.str()};
         }
+        int line = scanner->Lineno();
         Statement *inst = Stmt();
-        stmt = new For(init, cond, increment, inst);
+        if (parallel)
+            stmt = new ParallelFor(init, cond, increment, inst, trusted, line);
+        else
+            stmt = new For(init, cond, increment, inst);
 
         return stmt;
     }
@@ -359,14 +377,36 @@ Statement *Parser::Stmt()
         }
         std::vector<string> paramTypes;
         std::vector<string> paramNames;
+
+        // ---------------------------------------------------------
+        // parâmetros e variáveis locais pertencem ao escopo da função
+        // ---------------------------------------------------------
+        SymTable *saved = symtable;
+        symtable = new SymTable(symtable);
+        std::vector<Symbol> *outer = decls;
+        std::vector<Symbol> locals;
+        decls = &locals;
+        // ---------------------------------------------------------
+
         if (lookahead->tag != ')') // Verificar se não está vazio
         {
             do
             {
+                // 🔒 antes do tipo: o arranjo não compartilha memória com
+                // nenhum outro arranjo acessado pela função
+                bool noalias = Match(Tag::NOALIAS);
                 Decls();
+                if (noalias && !locals.empty())
+                    locals.back().noalias = true;
             } while (Match(',')); // Permitir lista separada por vírgulas
         }
 
+        for (Symbol &p : locals)
+        {
+            paramTypes.push_back(p.type);
+            paramNames.push_back(p.var);
+        }
+
         if (!Match(')'))
         {
             stringstream ss;
@@ -389,22 +429,16 @@ Statement *Parser::Stmt()
         string type{lookahead->lexeme};
         Match(Tag::TYPE);
 
-        Statement *body;
-        // Corpo da função (espera um bloco de instruções)
-        string ret;
-        body = Block(ret);
-
         Symbol s;
         s.isFunction = true;
         s.var = name;
         s.type = type;
         s.paramTypes = paramTypes;
         s.paramNames = paramNames;
-        s.ret = ret;
-        s.body = body;
 
-        // insere variável na tabela de símbolos
-        if (!symtable->Insert(name, s))
+        // a função é inserida no escopo envolvente antes do corpo,
+        // permitindo chamadas recursivas
+        if (!saved->Insert(name, s))
         {
             // a inserção falha quando a variável já está na tabela
             stringstream ss;
@@ -412,7 +446,24 @@ Statement *Parser::Stmt()
             throw SyntaxError(scanner->Lineno(), ss.str());
         }
 
-        stmt = new Func(funcName, returnType, paramTypes, paramNames, body, ret);
+        Statement *body;
+        // Corpo da função (espera um bloco de instruções)
+        string ret;
+        body = Block(ret);
+
+        // ------------------------------------------------------
+        // tabela do escopo envolvente volta a ser a tabela ativa
+        // ------------------------------------------------------
+        delete symtable;
+        symtable = saved;
+        decls = outer;
+        // ------------------------------------------------------
+
+        Symbol *f = symtable->Find(name);
+        f->ret = ret;
+        f->body = body;
+
+        stmt = new Func(funcName, returnType, paramTypes, paramNames, locals, body, ret);
         // Criar o nó da função
         return stmt;
     }
@@ -518,7 +569,7 @@ Expression *Parser::Local()
             if (Match(':')) {
                 // Acesso a matriz bidimensional
                 Expression *index2 = Bool();
-                expr = new Access(etype, new Token{Tag::ID, "[:]"}, expr, index1, index2);
+                expr = new Access(etype, new Token{Tag::ID, "[:]"}, expr, index1, index2, s->valY);
             } else {
                 // Acesso a vetor unidimensional
                 expr = new Access(etype, new Token{Tag::ID, "[]"}, expr, index1);
@@ -882,6 +933,7 @@ Parser::Parser()
 {
     lookahead = scanner->Scan();
     symtable = nullptr;
+    decls = &globals;
 }
 
 Statement * Parser::Start()
@@ -9,6 +9,7 @@ class Parser
 {
 private:
 	Token * lookahead;
+	std::vector<Symbol> * decls;	// declarações do escopo de função corrente
 	
 	Statement * Program();
 	Statement * Block(string &str = *(new string("op")));
@@ -29,6 +30,8 @@ private:
 	bool Match(int tag);
 
 public:
+	std::vector<Symbol> globals;	// declarações do programa principal
+
 	Parser();
 	Statement * Start();
 	static int LineNo();
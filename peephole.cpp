@@ -0,0 +1,419 @@
+#include <map>
+#include "peephole.h"
+#include "cfg.h"
+#include "alias.h"
+using std::map;
+
+// -------
+// Janela
+// -------
+
+// instruções anteriores examinadas pelos padrões de memória
+static const int WindowSize = 8;
+
+// estado de uma passada: nomes vivos após cada instrução, instruções
+// removidas e sequências que substituem uma instrução
+struct Window
+{
+    Function * func;
+    vector<Quad> & code;
+    vector<set<string>> live;
+    vector<int> block;
+    vector<bool> removed;
+    map<int, vector<Quad>> expand;
+
+    Window(Function * f);
+    bool Dead(const string & name, int i);
+    bool Writes(int i, Operand & o);
+    bool Clobbers(int i, Quad & access);
+};
+
+Window::Window(Function * f) :
+    func(f),
+    code(f->code),
+    live(f->code.size()),
+    block(f->code.size()),
+    removed(f->code.size(), false)
+{
+    CFG cfg(f);
+    cfg.Liveness();
+    for (int b = 0; b < int(cfg.blocks.size()); ++b)
+    {
+        set<string> names = cfg.blocks[b].out;
+        for (int i = cfg.blocks[b].last - 1; i >= cfg.blocks[b].first; --i)
+        {
+            live[i] = names;
+            block[i] = b;
+            cfg.Transfer(code[i], names);
+        }
+    }
+}
+
+// o nome não é lido depois da instrução i
+bool Window::Dead(const string & name, int i)
+{
+    return !live[i].count(name);
+}
+
+// a instrução i escreve no operando
+bool Window::Writes(int i, Operand & o)
+{
+    Operand * d = code[i].Def();
+    return o.IsName() && d && d->name == o.name;
+}
+
+// a instrução i pode alterar o elemento lido ou escrito por access
+bool Window::Clobbers(int i, Quad & access)
+{
+    Quad & q = code[i];
+    if (q.op == IR_CALL)
+        return true;
+    if (q.IsStore() && MayAlias(func->name, q.name, access.name))
+        return true;
+    for (Operand * o : {&access.idx1, &access.idx2, &access.arg1})
+    {
+        if (Writes(i, *o))
+            return true;
+    }
+    return Writes(i, access.dst);
+}
+
+// -------
+// Padrões
+// -------
+
+static bool IntConst(Operand & o, long long & v)
+{
+    if (!o.IsConst() || o.type != ExprType::INT)
+        return false;
+    v = std::stoll(o.name);
+    return true;
+}
+
+// constante inteira, com o estouro dos inteiros de 32 bits
+static Operand Int(long long v)
+{
+    return Operand(OPD_CONST, ExprType::INT, std::to_string(int(v)));
+}
+
+// expoente k se v = 2^k, com k > 0
+static int Log2(long long v)
+{
+    int k = 0;
+    while (v > 1 && v % 2 == 0)
+    {
+        v /= 2;
+        ++k;
+    }
+    return (v == 1) ? k : 0;
+}
+
+static void ToCopy(Quad & q, Operand value)
+{
+    Quad copy(IR_COPY);
+    copy.dst = q.dst;
+    copy.arg1 = value;
+    q = copy;
+}
+
+static Quad Binary(Operand dst, Operand a, string oper, Operand b)
+{
+    Quad q(IR_BINARY);
+    q.dst = dst;
+    q.arg1 = a;
+    q.oper = oper;
+    q.arg2 = b;
+    return q;
+}
+
+// mesmo endereço de arranjo
+static bool SameAddress(Quad & a, Quad & b)
+{
+    return a.name == b.name && a.stride == b.stride
+        && a.idx1.kind == b.idx1.kind && a.idx1.name == b.idx1.name
+        && a.idx2.kind == b.idx2.kind && a.idx2.name == b.idx2.name;
+}
+
+// t = e; x = t  =>  x = e, se t não for lido depois
+static bool FoldCopy(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (i + 1 >= int(w.code.size()) || w.removed[i + 1] || w.expand.count(i + 1))
+        return false;
+
+    Quad & next = w.code[i + 1];
+    Operand * d = q.Def();
+    if (!d || !d->IsTemp() || next.op != IR_COPY || next.arg1.name != d->name || !next.arg1.IsTemp())
+        return false;
+    if (!w.Dead(d->name, i + 1) || next.dst.type != d->type)
+        return false;
+
+    q.dst = next.dst;
+    w.removed[i + 1] = true;
+    return true;
+}
+
+// t = c; ... t ...  =>  t = c; ... c ..., na instrução seguinte
+static bool Constant(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (q.op != IR_COPY || !q.arg1.IsConst() || !q.dst.IsName() || i + 1 >= int(w.code.size()))
+        return false;
+
+    bool changed = false;
+    for (Operand * o : w.code[i + 1].Uses())
+    {
+        if (o->name == q.dst.name && o->type == q.arg1.type)
+        {
+            *o = q.arg1;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// x = x
+static bool SelfCopy(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (q.op != IR_COPY || !q.dst.IsName() || q.dst.name != q.arg1.name)
+        return false;
+    w.removed[i] = true;
+    return true;
+}
+
+// operações inteiras com constantes calculadas na compilação
+static bool Fold(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    long long a, b;
+    if (q.op != IR_BINARY || !IntConst(q.arg1, a) || !IntConst(q.arg2, b))
+        return false;
+
+    const string & o = q.oper;
+    if (o == "+") ToCopy(q, Int(a + b));
+    else if (o == "-") ToCopy(q, Int(a - b));
+    else if (o == "*") ToCopy(q, Int(a * b));
+    else if (o == "/" && b != 0) ToCopy(q, Int(a / b));
+    else if (o == "<" || o == "<=" || o == ">" || o == ">=" || o == "==" || o == "!=")
+    {
+        bool r = (o == "<") ? a < b : (o == "<=") ? a <= b : (o == ">") ? a > b
+               : (o == ">=") ? a >= b : (o == "==") ? a == b : a != b;
+        ToCopy(q, Operand(OPD_CONST, ExprType::BOOL, r ? "true" : "false"));
+    }
+    else
+        return false;
+    return true;
+}
+
+// x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1 e x * 0 sobre inteiros
+static bool Identity(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (q.op != IR_BINARY || q.dst.type != ExprType::INT)
+        return false;
+
+    long long a = -1, b = -1;
+    bool ca = IntConst(q.arg1, a);
+    bool cb = IntConst(q.arg2, b);
+    const string & o = q.oper;
+
+    if ((o == "+" && cb && b == 0) || (o == "-" && cb && b == 0) || ((o == "*" || o == "/") && cb && b == 1))
+        ToCopy(q, q.arg1);
+    else if ((o == "+" && ca && a == 0) || (o == "*" && ca && a == 1))
+        ToCopy(q, q.arg2);
+    else if (o == "*" && ((ca && a == 0) || (cb && b == 0)))
+        ToCopy(q, Int(0));
+    else
+        return false;
+    return true;
+}
+
+// x * 2^k  =>  x << k;  x / 2^k  =>  (x + ((x >> 31) & (2^k - 1))) >> k,
+// que arredonda para zero também com x negativo (inteiros de 32 bits)
+static bool Shift(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    long long a = 0, b = 0;
+    if (q.op != IR_BINARY || q.dst.type != ExprType::INT)
+        return false;
+
+    if (q.oper == "*")
+    {
+        Operand x = q.arg1;
+        int k = IntConst(q.arg2, b) ? Log2(b) : 0;
+        if (k == 0 && IntConst(q.arg1, a))
+        {
+            x = q.arg2;
+            k = Log2(a);
+        }
+        if (k == 0)
+            return false;
+        q = Binary(q.dst, x, "<<", Int(k));
+        return true;
+    }
+
+    if (q.oper == "/" && IntConst(q.arg2, b) && Log2(b) > 0 && !q.arg1.IsConst())
+    {
+        int k = Log2(b);
+        Operand sign = NewTemp(ExprType::INT);
+        Operand bias = NewTemp(ExprType::INT);
+        Operand sum = NewTemp(ExprType::INT);
+        w.expand[i] = {
+            Binary(sign, q.arg1, ">>", Int(31)),
+            Binary(bias, sign, "&", Int(b - 1)),
+            Binary(sum, q.arg1, "+", bias),
+            Binary(q.dst, sum, ">>", Int(k))
+        };
+        return true;
+    }
+    return false;
+}
+
+// a[i] = v ... t = a[i]  =>  t = v;  u = a[i] ... t = a[i]  =>  t = u
+static bool Forward(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (q.op != IR_LOAD)
+        return false;
+
+    for (int j = i - 1; j >= 0 && j >= i - WindowSize && w.block[j] == w.block[i]; --j)
+    {
+        if (w.removed[j] || w.expand.count(j))
+            return false;
+
+        Quad & p = w.code[j];
+        if ((p.op == IR_STORE || p.op == IR_LOAD) && SameAddress(p, q))
+        {
+            Operand value = (p.op == IR_STORE) ? p.arg1 : p.dst;
+            for (int k = j + 1; k < i; ++k)
+            {
+                if (w.Writes(k, value) || (p.op == IR_LOAD && w.Clobbers(k, p)))
+                    return false;
+            }
+            ToCopy(q, value);
+            return true;
+        }
+        if (w.Clobbers(j, q))
+            return false;
+    }
+    return false;
+}
+
+// t = a[i] ... a[i] = t  =>  remove a escrita
+static bool RedundantStore(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (q.op != IR_STORE || !q.arg1.IsName())
+        return false;
+
+    for (int j = i - 1; j >= 0 && j >= i - WindowSize && w.block[j] == w.block[i]; --j)
+    {
+        if (w.removed[j] || w.expand.count(j))
+            return false;
+
+        Quad & p = w.code[j];
+        if (p.op == IR_LOAD && SameAddress(p, q) && p.dst.name == q.arg1.name)
+        {
+            w.removed[i] = true;
+            return true;
+        }
+        if (w.Clobbers(j, q))
+            return false;
+    }
+    return false;
+}
+
+// select com condição constante, lados iguais ou lados true/false
+static bool Choose(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (q.op != IR_SELECT)
+        return false;
+
+    if (q.arg1.IsConst())
+        ToCopy(q, q.arg1.name == "true" ? q.arg2 : q.arg3);
+    else if (q.arg2.name == q.arg3.name && q.arg2.kind == q.arg3.kind)
+        ToCopy(q, q.arg2);
+    else if (q.arg2.name == "true" && q.arg3.name == "false" && q.arg2.IsConst() && q.arg3.IsConst())
+        ToCopy(q, q.arg1);
+    else
+        return false;
+    return true;
+}
+
+// desvio condicional sobre constante: vira goto quando sempre desvia e é
+// removido quando nunca desvia
+static bool Branch(Window & w, int i)
+{
+    Quad & q = w.code[i];
+    if (!q.IsBranch() || !q.arg1.IsConst())
+        return false;
+
+    if ((q.arg1.name == "true") == (q.op == IR_IFTRUE))
+    {
+        q.op = IR_GOTO;
+        q.arg1 = Operand();
+    }
+    else
+        w.removed[i] = true;
+    return true;
+}
+
+// tabela de padrões, aplicados em ordem a cada instrução
+struct Pattern
+{
+    const char * name;
+    bool (*rewrite)(Window & w, int i);
+};
+
+static const Pattern patterns[] =
+{
+    {"cópia de si mesmo", SelfCopy},
+    {"constantes", Fold},
+    {"seleção trivial", Choose},
+    {"desvio constante", Branch},
+    {"identidade algébrica", Identity},
+    {"potência de dois", Shift},
+    {"propagação de constante", Constant},
+    {"carga repetida", Forward},
+    {"escrita redundante", RedundantStore},
+    {"cópia de temporário", FoldCopy},
+};
+
+// uma passada pelo código; as vidas calculadas no início continuam válidas
+// adiante da instrução corrente, pois as reescritas só acrescentam leituras
+// de nomes em instruções já examinadas
+static bool Pass(Function * f)
+{
+    Window w(f);
+    bool changed = false;
+    for (int i = 0; i < int(f->code.size()); ++i)
+    {
+        for (const Pattern & p : patterns)
+        {
+            if (w.removed[i] || w.expand.count(i))
+                break;
+            changed = p.rewrite(w, i) || changed;
+        }
+    }
+
+    vector<Quad> code;
+    for (int i = 0; i < int(f->code.size()); ++i)
+    {
+        if (w.expand.count(i))
+            code.insert(code.end(), w.expand[i].begin(), w.expand[i].end());
+        else if (!w.removed[i])
+            code.push_back(f->code[i]);
+    }
+    f->code.swap(code);
+    return changed;
+}
+
+bool Peephole(Function * f)
+{
+    bool changed = false;
+    for (int pass = 0; pass < 4 && !f->code.empty() && Pass(f); ++pass)
+        changed = true;
+    return changed;
+}
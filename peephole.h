@@ -0,0 +1,11 @@
+#ifndef COMPILER_PEEPHOLE
+#define COMPILER_PEEPHOLE
+
+#include "ir.h"
+
+// otimização por janela: percorre o código aplicando a tabela de padrões
+// (cópias, identidades algébricas, constantes, desvios constantes, potências
+// de dois, cargas e escritas redundantes) até não haver mais mudanças
+bool Peephole(Function * f);
+
+#endif
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "pool.h"
+#include "options.h"
+using std::vector;
+
+extern Options options;
+
+// verdadeiro nas threads que já executam um laço 🧵
+static thread_local bool inside = false;
+
+int Threads()
+{
+    if (options.threads > 0)
+        return options.threads;
+    return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+// ----
+// Pool
+// ----
+
+// iterações ainda não tomadas de uma thread: o dono tira blocos do início,
+// e quem rouba leva a metade final
+struct Range
+{
+    std::mutex lock;
+    int next = 0;
+    int end = 0;
+};
+
+class Pool
+{
+private:
+    int count;
+    vector<std::thread> workers;
+    std::unique_ptr<Range[]> ranges;
+
+    // laço em execução
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(int, int, int)> * body = nullptr;
+    int chunk = 1;
+    unsigned generation = 0;
+    int active = 0;
+    bool stop = false;
+
+    // primeiro bloco com erro: os blocos seguintes são dispensados
+    std::atomic<int> failed;
+    std::mutex errors;
+    std::exception_ptr error;
+    int errorAt = INT_MAX;
+
+    bool Take(int thread, int & first, int & end);
+    bool Steal(int thread);
+    void Block(int thread, int first, int end);
+    void Drain(int thread);
+    void Work(int thread);
+
+public:
+    Pool(int n);
+    ~Pool();
+
+    void Run(int first, int end, const std::function<void(int, int, int)> & f);
+};
+
+Pool::Pool(int n) :
+    count(n),
+    ranges(new Range[n]),
+    failed(INT_MAX)
+{
+    for (int t = 1; t < count; ++t)
+        workers.emplace_back(&Pool::Work, this, t);
+}
+
+Pool::~Pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (std::thread & w : workers)
+        w.join();
+}
+
+bool Pool::Take(int thread, int & first, int & end)
+{
+    Range & own = ranges[thread];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (own.next >= own.end)
+        return false;
+    first = own.next;
+    end = std::min(own.end, own.next + chunk);
+    own.next = end;
+    return true;
+}
+
+// toma a metade final das iterações restantes da primeira thread que ainda
+// as tem, a partir da seguinte
+bool Pool::Steal(int thread)
+{
+    for (int k = 1; k < count; ++k)
+    {
+        Range & victim = ranges[(thread + k) % count];
+        int first, end;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            int left = victim.end - victim.next;
+            if (left <= 0)
+                continue;
+            first = victim.next + left / 2;
+            end = victim.end;
+            victim.end = first;
+        }
+        Range & own = ranges[thread];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.next = first;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
+
+void Pool::Block(int thread, int first, int end)
+{
+    if (first >= failed.load(std::memory_order_relaxed))
+        return;
+    try
+    {
+        (*body)(thread, first, end);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> guard(errors);
+        if (first < errorAt)
+        {
+            errorAt = first;
+            error = std::current_exception();
+            failed.store(first, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Pool::Drain(int thread)
+{
+    int first, end;
+    do
+    {
+        while (Take(thread, first, end))
+            Block(thread, first, end);
+    }
+    while (Steal(thread));
+}
+
+void Pool::Work(int thread)
+{
+    inside = true;
+    unsigned seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stop || generation != seen; });
+            if (stop)
+                return;
+            seen = generation;
+        }
+        Drain(thread);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (--active == 0)
+                finished.notify_one();
+        }
+    }
+}
+
+// a thread que chama também executa blocos, como a thread 0
+void Pool::Run(int first, int end, const std::function<void(int, int, int)> & f)
+{
+    int64_t n = int64_t(end) - first;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        body = &f;
+        chunk = options.parallelChunk > 0 ? options.parallelChunk : int(std::max<int64_t>(1, n / (count * 4)));
+        for (int t = 0; t < count; ++t)
+        {
+            ranges[t].next = int(first + n * t / count);
+            ranges[t].end = int(first + n * (t + 1) / count);
+        }
+        failed.store(INT_MAX);
+        error = nullptr;
+        errorAt = INT_MAX;
+        active = count - 1;
+        ++generation;
+    }
+    wake.notify_all();
+
+    inside = true;
+    Drain(0);
+    inside = false;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this] { return active == 0; });
+        body = nullptr;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void RunParallel(int first, int end, const std::function<void(int thread, int first, int end)> & body)
+{
+    if (end <= first)
+        return;
+
+    int threads = Threads();
+    if (inside || threads == 1 || end - first == 1)
+    {
+        body(0, first, end);
+        return;
+    }
+
+    static Pool pool(threads);
+    pool.Run(first, end, body);
+}
@@ -0,0 +1,17 @@
+#ifndef COMPILER_POOL
+#define COMPILER_POOL
+
+#include <functional>
+
+// threads que executam os laços 🧵 (--threads, ou uma por núcleo)
+int Threads();
+
+// executa body(thread, primeira, fim) sobre blocos que cobrem a faixa
+// [first, end) de iterações, em threads persistentes com roubo de trabalho:
+// cada thread começa com uma parte contígua da faixa e, ao terminá-la, toma
+// a metade do que resta a outra. Blocos têm --parallel-chunk iterações
+// (0: um quarto da parte de cada thread). Laços dentro de laços executam na
+// própria thread; o erro da iteração mais baixa é relançado ao final
+void RunParallel(int first, int end, const std::function<void(int thread, int first, int end)> & body);
+
+#endif
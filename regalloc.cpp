@@ -0,0 +1,752 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <queue>
+#include "regalloc.h"
+using std::unique_ptr;
+
+// voláteis primeiro: em caso de empate evitam salvar registradores no quadro
+const vector<int> GprRegs = {RSI, RDI, R8, R9, R10, RBX, R12, R13, R14, R15};
+const vector<int> XmmRegs =
+{
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11, XMM12, XMM13
+};
+
+bool CalleeSaved(int reg)
+{
+    return reg == RBX || (reg >= R12 && reg <= R15);
+}
+
+// ----------
+// Allocation
+// ----------
+
+Allocation::Allocation(Chunk & c)
+{
+    uint32_t n = 0;
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+    {
+        base[bank] = n;
+        n += c.regs[bank];
+        banks.insert(banks.end(), c.regs[bank], bank);
+    }
+    where.resize(n);
+    spilled.resize(n, false);
+}
+
+int Allocation::Count() const
+{
+    return banks.size();
+}
+
+int Allocation::Vreg(uint32_t ref, int bank) const
+{
+    return base[bank] + (ref & IndexMask);
+}
+
+int Allocation::Bank(int vreg) const
+{
+    return banks[vreg];
+}
+
+uint32_t Allocation::Ref(int vreg) const
+{
+    return ::Ref(SPACE_LOCAL, vreg - base[banks[vreg]]);
+}
+
+// registrador da parte do intervalo que contém a posição
+int Allocation::Where(int vreg, int pos) const
+{
+    const vector<pair<int, int>> & parts = where[vreg];
+    if (parts.empty())
+        return NOREG;
+    auto after = std::upper_bound(parts.begin(), parts.end(), pair<int, int>(pos, INT_MAX));
+    if (after == parts.begin())
+        return parts.front().second;
+    return (after - 1)->second;
+}
+
+void Allocation::Place(int vreg, int from, int reg)
+{
+    where[vreg].push_back({from, reg});
+    if (reg == NOREG)
+        spilled[vreg] = true;
+}
+
+// ---------
+// Intervals
+// ---------
+
+struct LiveRange
+{
+    int from;
+    int to;             // exclusivo
+};
+
+// intervalo de vida de um registrador virtual (ou bloqueio de um registrador
+// físico, quando fixed); partes criadas por divisão começam em split
+struct LiveInterval
+{
+    int vreg = -1;
+    int cls = 0;        // 0: registradores gerais, 1: xmm
+    int reg = NOREG;
+    bool fixed = false;
+    int split = 0;
+    vector<LiveRange> ranges;
+    vector<int> uses;
+    vector<double> weights;     // peso acumulado dos usos a partir de cada um
+    size_t cursor = 0;
+
+    int Start() const { return ranges.front().from; }
+    int End() const { return ranges.back().to; }
+    bool Covers(int pos);
+    void Add(int from, int to);
+    void Define(int pos);
+    double Weight(int from) const;
+};
+
+// as posições consultadas só avançam durante a varredura
+bool LiveInterval::Covers(int pos)
+{
+    while (cursor < ranges.size() && ranges[cursor].to <= pos)
+        ++cursor;
+    return cursor < ranges.size() && ranges[cursor].from <= pos;
+}
+
+// construção de trás para frente: ranges fica em ordem decrescente até o fim
+void LiveInterval::Add(int from, int to)
+{
+    if (!ranges.empty() && ranges.back().from <= to)
+    {
+        ranges.back().from = std::min(ranges.back().from, from);
+        ranges.back().to = std::max(ranges.back().to, to);
+        return;
+    }
+    ranges.push_back({from, to});
+}
+
+void LiveInterval::Define(int pos)
+{
+    if (!ranges.empty() && ranges.back().from <= pos && pos < ranges.back().to)
+        ranges.back().from = pos;
+    else
+        ranges.push_back({pos, pos + 1});
+}
+
+double LiveInterval::Weight(int from) const
+{
+    size_t k = std::lower_bound(uses.begin(), uses.end(), from) - uses.begin();
+    return k < weights.size() ? weights[k] : 0.0;
+}
+
+static int Floor4(int pos)
+{
+    return pos & ~3;
+}
+
+// primeira posição a partir de cur->Start() coberta pelos dois intervalos
+// (-1 se não houver)
+static int Intersection(const LiveInterval * a, const LiveInterval * cur)
+{
+    size_t i = a->cursor;
+    size_t j = 0;
+    while (i < a->ranges.size() && j < cur->ranges.size())
+    {
+        const LiveRange & x = a->ranges[i];
+        const LiveRange & y = cur->ranges[j];
+        int from = std::max(x.from, y.from);
+        if (from < std::min(x.to, y.to))
+            return from;
+        if (x.to <= y.to)
+            ++i;
+        else
+            ++j;
+    }
+    return -1;
+}
+
+// ---------
+// Allocator
+// ---------
+
+struct FlowBlock
+{
+    int first;
+    int last;
+    vector<int> succ;
+    int depth = 0;
+    vector<int> use;            // conjuntos ordenados de registradores virtuais
+    vector<int> def;
+    vector<int> in;
+    vector<int> out;
+};
+
+struct StartsLater
+{
+    bool operator()(const LiveInterval * a, const LiveInterval * b) const
+    {
+        if (a->Start() != b->Start())
+            return a->Start() > b->Start();
+        return a->vreg > b->vreg;
+    }
+};
+
+class Allocator
+{
+private:
+    Chunk & chunk;
+    Allocation & result;
+    vector<FlowBlock> blocks;
+    vector<int> blockOf;
+    vector<double> weightOf;                    // peso de um uso em cada instrução
+    vector<unique_ptr<LiveInterval>> intervals;
+    vector<LiveInterval *> parts;                   // todas as partes, para o resultado
+    std::priority_queue<LiveInterval *, vector<LiveInterval *>, StartsLater> unhandled;
+    vector<LiveInterval *> active;
+    vector<LiveInterval *> inactive;
+    vector<bool> lanes;                             // elementos de vetores
+
+    void Vectors();
+    void Blocks();
+    void Liveness();
+    void Build();
+    void Weigh(LiveInterval * i);
+    LiveInterval * Split(LiveInterval * i, int pos);
+    void Spill(LiveInterval * i, int pos);
+    bool TryFree(LiveInterval * cur);
+    void Blocked(LiveInterval * cur);
+    void Walk();
+    void Resolve();
+
+public:
+    Allocator(Chunk & c, Allocation & a);
+    void Run();
+};
+
+Allocator::Allocator(Chunk & c, Allocation & a) :
+    chunk(c),
+    result(a)
+{
+
+}
+
+// os elementos dos vetores ficam em posições consecutivas do quadro, onde
+// as instruções vetoriais os leem e escrevem de uma vez; não recebem
+// intervalos de vida
+void Allocator::Vectors()
+{
+    lanes.assign(result.Count(), false);
+    for (const Instr & q : chunk.code)
+    {
+        for (const Role & r : Roles(q))
+        {
+            uint32_t ref = Field(q, r.field);
+            if (r.count == 1 || (ref >> SpaceShift) != SPACE_LOCAL)
+                continue;
+            int v = result.Vreg(ref, r.bank);
+            result.vectors[v] = r.count;
+            std::fill(lanes.begin() + v, lanes.begin() + v + r.count, true);
+        }
+    }
+}
+
+// blocos básicos e profundidade de laços: arestas para trás, na ordem do
+// código, delimitam os laços do programa estruturado
+void Allocator::Blocks()
+{
+    vector<Instr> & code = chunk.code;
+    int n = code.size();
+    vector<bool> leader(n + 1, false);
+    leader[0] = true;
+    for (int i = 0; i < n; ++i)
+    {
+        int op = code[i].op;
+        if (IsBranch(op))
+        {
+            leader[code[i].a] = true;
+            leader[i + 1] = true;
+        }
+        if (op == OP_HALT || (op >= OP_RET_I && op <= OP_RET_A))
+            leader[i + 1] = true;
+    }
+
+    blockOf.resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+        if (leader[i])
+        {
+            blocks.emplace_back();
+            blocks.back().first = i;
+        }
+        blocks.back().last = i;
+        blockOf[i] = blocks.size() - 1;
+    }
+
+    vector<int> nesting(blocks.size() + 1, 0);
+    for (int b = 0; b < int(blocks.size()); ++b)
+    {
+        const Instr & q = code[blocks[b].last];
+        int op = q.op;
+        bool ends = op == OP_HALT || (op >= OP_RET_I && op <= OP_RET_A);
+        if (IsBranch(op))
+            blocks[b].succ.push_back(blockOf[q.a]);
+        if (op != OP_JMP && !ends && b + 1 < int(blocks.size()))
+            blocks[b].succ.push_back(b + 1);
+
+        for (int s : blocks[b].succ)
+        {
+            if (s <= b)
+            {
+                nesting[s]++;
+                nesting[b + 1]--;
+            }
+        }
+    }
+
+    weightOf.resize(n);
+    int depth = 0;
+    for (int b = 0; b < int(blocks.size()); ++b)
+    {
+        depth += nesting[b];
+        blocks[b].depth = depth;
+        for (int i = blocks[b].first; i <= blocks[b].last; ++i)
+            weightOf[i] = std::pow(10.0, std::min(depth, 8));
+    }
+}
+
+static void Insert(vector<int> & set, int v)
+{
+    auto at = std::lower_bound(set.begin(), set.end(), v);
+    if (at == set.end() || *at != v)
+        set.insert(at, v);
+}
+
+// conjuntos esparsos e ordenados: o custo acompanha o número de
+// registradores vivos, não o total de registradores da função
+void Allocator::Liveness()
+{
+    for (FlowBlock & b : blocks)
+    {
+        for (int i = b.first; i <= b.last; ++i)
+        {
+            const Instr & q = chunk.code[i];
+            vector<Role> roles = Roles(q);
+            for (Role & r : roles)
+            {
+                uint32_t ref = Field(q, r.field);
+                if (r.write || (ref >> SpaceShift) != SPACE_LOCAL || lanes[result.Vreg(ref, r.bank)])
+                    continue;
+                int v = result.Vreg(ref, r.bank);
+                if (!std::binary_search(b.def.begin(), b.def.end(), v))
+                    Insert(b.use, v);
+            }
+            for (Role & r : roles)
+            {
+                uint32_t ref = Field(q, r.field);
+                if (r.write && (ref >> SpaceShift) == SPACE_LOCAL && !lanes[result.Vreg(ref, r.bank)])
+                    Insert(b.def, result.Vreg(ref, r.bank));
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int k = blocks.size() - 1; k >= 0; --k)
+        {
+            FlowBlock & b = blocks[k];
+            vector<int> out;
+            for (int s : b.succ)
+            {
+                vector<int> merged;
+                std::set_union(out.begin(), out.end(), blocks[s].in.begin(), blocks[s].in.end(), std::back_inserter(merged));
+                out.swap(merged);
+            }
+            vector<int> through, in;
+            std::set_difference(out.begin(), out.end(), b.def.begin(), b.def.end(), std::back_inserter(through));
+            std::set_union(b.use.begin(), b.use.end(), through.begin(), through.end(), std::back_inserter(in));
+            b.out.swap(out);
+            if (in != b.in)
+            {
+                b.in.swap(in);
+                changed = true;
+            }
+        }
+    }
+}
+
+// intervalos de vida, construídos de trás para frente em cada bloco; as
+// chamadas bloqueiam os registradores voláteis alocáveis
+void Allocator::Build()
+{
+    int count = result.Count();
+    for (int v = 0; v < count; ++v)
+    {
+        intervals.emplace_back(new LiveInterval);
+        intervals.back()->vreg = v;
+        intervals.back()->cls = (result.Bank(v) == BANK_FLOAT) ? 1 : 0;
+    }
+
+    vector<LiveInterval *> fixed(NOREG, nullptr);
+    for (const vector<int> * regs : {&GprRegs, &XmmRegs})
+    {
+        for (int r : *regs)
+        {
+            if (CalleeSaved(r))
+                continue;
+            intervals.emplace_back(new LiveInterval);
+            fixed[r] = intervals.back().get();
+            fixed[r]->fixed = true;
+            fixed[r]->reg = r;
+            fixed[r]->cls = (r >= XMM0) ? 1 : 0;
+        }
+    }
+
+    for (int k = blocks.size() - 1; k >= 0; --k)
+    {
+        FlowBlock & b = blocks[k];
+        int from = UsePos(b.first);
+        int to = UsePos(b.last + 1);
+        for (int v : b.out)
+            intervals[v]->Add(from, to);
+
+        // os argumentos são lidos pela chamada, não pelas instruções param
+        int call = -1;
+        for (int i = b.last; i >= b.first; --i)
+        {
+            const Instr & q = chunk.code[i];
+            int op = q.op;
+            if (op >= OP_CALL_I && op <= OP_CALL_A)
+            {
+                call = UsePos(i);
+                for (LiveInterval * f : fixed)
+                {
+                    if (f)
+                        f->Add(UsePos(i) + 1, DefPos(i));
+                }
+            }
+
+            vector<Role> roles = Roles(q);
+            for (Role & r : roles)
+            {
+                uint32_t ref = Field(q, r.field);
+                if (!r.write || (ref >> SpaceShift) != SPACE_LOCAL || lanes[result.Vreg(ref, r.bank)])
+                    continue;
+                LiveInterval * v = intervals[result.Vreg(ref, r.bank)].get();
+                v->Define(DefPos(i));
+                v->uses.push_back(DefPos(i));
+            }
+            for (Role & r : roles)
+            {
+                uint32_t ref = Field(q, r.field);
+                if (r.write || (ref >> SpaceShift) != SPACE_LOCAL || lanes[result.Vreg(ref, r.bank)])
+                    continue;
+                int pos = (op >= OP_PARAM_I && op <= OP_PARAM_A && call >= 0) ? call : UsePos(i);
+                LiveInterval * v = intervals[result.Vreg(ref, r.bank)].get();
+                v->Add(from, pos + 1);
+                v->uses.push_back(pos);
+            }
+        }
+    }
+
+    for (auto & i : intervals)
+    {
+        std::reverse(i->ranges.begin(), i->ranges.end());
+        std::sort(i->uses.begin(), i->uses.end());
+        if (i->ranges.empty())
+            continue;
+        i->split = i->Start();
+        Weigh(i.get());
+        if (i->fixed)
+            inactive.push_back(i.get());
+        else
+        {
+            unhandled.push(i.get());
+            parts.push_back(i.get());
+        }
+    }
+}
+
+void Allocator::Weigh(LiveInterval * i)
+{
+    i->weights.assign(i->uses.size(), 0.0);
+    double sum = 0.0;
+    for (int k = int(i->uses.size()) - 1; k >= 0; --k)
+    {
+        sum += weightOf[i->uses[k] / 4];
+        i->weights[k] = sum;
+    }
+}
+
+// parte do intervalo a partir da posição (pos está entre o início e o fim)
+LiveInterval * Allocator::Split(LiveInterval * i, int pos)
+{
+    intervals.emplace_back(new LiveInterval);
+    LiveInterval * rest = intervals.back().get();
+    rest->vreg = i->vreg;
+    rest->cls = i->cls;
+    rest->split = pos;
+
+    size_t k = 0;
+    while (k < i->ranges.size() && i->ranges[k].to <= pos)
+        ++k;
+    if (k < i->ranges.size() && i->ranges[k].from < pos)
+    {
+        rest->ranges.push_back({pos, i->ranges[k].to});
+        i->ranges[k].to = pos;
+        ++k;
+    }
+    rest->ranges.insert(rest->ranges.end(), i->ranges.begin() + k, i->ranges.end());
+    i->ranges.erase(i->ranges.begin() + k, i->ranges.end());
+    i->cursor = std::min(i->cursor, i->ranges.size() - 1);
+
+    auto at = std::lower_bound(i->uses.begin(), i->uses.end(), pos);
+    rest->uses.assign(at, i->uses.end());
+    i->uses.erase(at, i->uses.end());
+    Weigh(i);
+    Weigh(rest);
+
+    parts.push_back(rest);
+    return rest;
+}
+
+// a partir de pos o valor fica no quadro até o próximo uso, quando tem uma
+// segunda chance de receber um registrador
+void Allocator::Spill(LiveInterval * i, int pos)
+{
+    LiveInterval * memory = (pos <= i->Start()) ? i : Split(i, pos);
+    memory->reg = NOREG;
+
+    for (int use : memory->uses)
+    {
+        int at = Floor4(use);
+        if (at > pos && at > memory->Start())
+        {
+            unhandled.push(Split(memory, at));
+            break;
+        }
+    }
+}
+
+// registrador livre por mais tempo; entre os que comportam todo o intervalo,
+// o que fica livre por menos tempo depois dele (melhor encaixe)
+bool Allocator::TryFree(LiveInterval * cur)
+{
+    int freeUntil[NOREG];
+    std::fill(freeUntil, freeUntil + NOREG, -1);
+    const vector<int> & regs = cur->cls ? XmmRegs : GprRegs;
+    for (int r : regs)
+        freeUntil[r] = INT_MAX;
+    for (LiveInterval * a : active)
+    {
+        if (a->cls == cur->cls)
+            freeUntil[a->reg] = 0;
+    }
+    for (LiveInterval * a : inactive)
+    {
+        if (a->cls != cur->cls || freeUntil[a->reg] <= 0)
+            continue;
+        int x = Intersection(a, cur);
+        if (x >= 0)
+            freeUntil[a->reg] = std::min(freeUntil[a->reg], x);
+    }
+
+    int best = NOREG;
+    for (int r : regs)
+    {
+        if (freeUntil[r] >= cur->End() && (best == NOREG || freeUntil[r] < freeUntil[best]))
+            best = r;
+    }
+    if (best == NOREG)
+    {
+        for (int r : regs)
+        {
+            if (best == NOREG || freeUntil[r] > freeUntil[best])
+                best = r;
+        }
+    }
+
+    if (freeUntil[best] >= cur->End())
+    {
+        cur->reg = best;
+        return true;
+    }
+    int pos = Floor4(freeUntil[best]);
+    if (pos <= cur->Start())
+        return false;
+    cur->reg = best;
+    unhandled.push(Split(cur, pos));
+    return true;
+}
+
+// nenhum registrador livre: o intervalo de menor peso (usos ponderados pela
+// profundidade dos laços) vai para o quadro
+void Allocator::Blocked(LiveInterval * cur)
+{
+    double cost[NOREG];
+    int limit[NOREG];
+    const vector<int> & regs = cur->cls ? XmmRegs : GprRegs;
+    int pos = cur->Start();
+    for (int r : regs)
+    {
+        cost[r] = 0.0;
+        limit[r] = INT_MAX;
+    }
+    for (LiveInterval * a : active)
+    {
+        if (a->cls == cur->cls)
+            cost[a->reg] += a->fixed ? HUGE_VAL : a->Weight(pos);
+    }
+    for (LiveInterval * a : inactive)
+    {
+        if (a->cls != cur->cls)
+            continue;
+        int x = Intersection(a, cur);
+        if (x >= 0)
+            limit[a->reg] = std::min(limit[a->reg], x);
+    }
+
+    int best = NOREG;
+    for (int r : regs)
+    {
+        if (Floor4(limit[r]) > pos && (best == NOREG || cost[r] < cost[best]))
+            best = r;
+    }
+    if (best == NOREG || cost[best] >= cur->Weight(pos))
+    {
+        Spill(cur, pos);
+        return;
+    }
+
+    // o ocupante sai do registrador antes da instrução em que cur começa
+    for (size_t k = 0; k < active.size(); ++k)
+    {
+        if (active[k]->reg == best && active[k]->cls == cur->cls)
+        {
+            LiveInterval * victim = active[k];
+            active.erase(active.begin() + k);
+            Spill(victim, Floor4(pos));
+            break;
+        }
+    }
+    cur->reg = best;
+    if (limit[best] < cur->End())
+        unhandled.push(Split(cur, Floor4(limit[best])));
+}
+
+void Allocator::Walk()
+{
+    while (!unhandled.empty())
+    {
+        LiveInterval * cur = unhandled.top();
+        unhandled.pop();
+        int pos = cur->Start();
+
+        for (size_t k = 0; k < active.size();)
+        {
+            LiveInterval * a = active[k];
+            if (a->End() <= pos || !a->Covers(pos))
+            {
+                active[k] = active.back();
+                active.pop_back();
+                if (a->End() > pos)
+                    inactive.push_back(a);
+                continue;
+            }
+            ++k;
+        }
+        for (size_t k = 0; k < inactive.size();)
+        {
+            LiveInterval * a = inactive[k];
+            if (a->End() <= pos || a->Covers(pos))
+            {
+                inactive[k] = inactive.back();
+                inactive.pop_back();
+                if (a->End() > pos)
+                    active.push_back(a);
+                continue;
+            }
+            ++k;
+        }
+
+        if (!TryFree(cur))
+            Blocked(cur);
+        if (cur->reg != NOREG)
+            active.push_back(cur);
+    }
+}
+
+// movimentos nas divisões dentro dos blocos e nas arestas entre blocos
+void Allocator::Resolve()
+{
+    std::sort(parts.begin(), parts.end(), [](const LiveInterval * a, const LiveInterval * b)
+    {
+        return a->vreg != b->vreg ? a->vreg < b->vreg : a->split < b->split;
+    });
+    for (LiveInterval * p : parts)
+        result.Place(p->vreg, p->split, p->reg);
+    for (int v = 0; v < result.Count(); ++v)
+    {
+        if (lanes[v])
+            result.Place(v, 0, NOREG);
+    }
+
+    vector<bool> start(chunk.code.size() + 1, false);
+    for (FlowBlock & b : blocks)
+        start[b.first] = true;
+    for (size_t k = 1; k < parts.size(); ++k)
+    {
+        LiveInterval * prev = parts[k - 1];
+        LiveInterval * p = parts[k];
+        if (prev->vreg != p->vreg || prev->reg == p->reg || p->Start() != p->split || start[p->split / 4])
+            continue;
+        result.splits[p->split / 4].push_back(Transfer{p->vreg, prev->reg, p->reg});
+    }
+
+    for (FlowBlock & b : blocks)
+    {
+        for (int s : b.succ)
+        {
+            FlowBlock & next = blocks[s];
+            if (s <= &b - blocks.data())
+                result.loops[next.first] = next.in;
+            for (int v : next.in)
+            {
+                int from = result.Where(v, UsePos(b.last + 1) - 1);
+                int to = result.Where(v, UsePos(next.first));
+                if (from != to)
+                    result.edges[{b.last, next.first}].push_back(Transfer{v, from, to});
+            }
+        }
+    }
+
+    result.entry = blocks.empty() ? vector<int>() : blocks[0].in;
+    for (LiveInterval * p : parts)
+    {
+        if (CalleeSaved(p->reg) && std::find(result.saved.begin(), result.saved.end(), p->reg) == result.saved.end())
+            result.saved.push_back(p->reg);
+    }
+}
+
+void Allocator::Run()
+{
+    if (chunk.code.empty())
+        return;
+    Vectors();
+    Blocks();
+    Liveness();
+    Build();
+    Walk();
+    Resolve();
+}
+
+Allocation Allocate(Chunk & c)
+{
+    Allocation a(c);
+    Allocator allocator(c, a);
+    allocator.Run();
+    return a;
+}
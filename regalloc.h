@@ -0,0 +1,69 @@
+#ifndef COMPILER_REGALLOC
+#define COMPILER_REGALLOC
+
+#include <map>
+#include <utility>
+#include "bytecode.h"
+#include "x86.h"
+using std::map;
+using std::pair;
+
+// posições dos intervalos de vida: a instrução pc lê os operandos em 4 * pc,
+// destrói os registradores voláteis (chamadas) em 4 * pc + 1 e escreve o
+// resultado em 4 * pc + 2
+inline int UsePos(int pc)
+{
+    return 4 * pc;
+}
+
+inline int DefPos(int pc)
+{
+    return 4 * pc + 2;
+}
+
+// registradores alocáveis; rax, rcx, rdx, r11, xmm14 e xmm15 ficam livres
+// para as instruções
+extern const vector<int> GprRegs;
+extern const vector<int> XmmRegs;
+bool CalleeSaved(int reg);
+
+// mudança de localização de um registrador da máquina virtual
+// (NOREG: posição no quadro)
+struct Transfer
+{
+    int vreg;
+    int from;
+    int to;
+};
+
+// resultado da alocação de uma função
+class Allocation
+{
+private:
+    uint32_t base[BANK_COUNT];
+    vector<int> banks;                          // banco de cada registrador virtual
+    vector<vector<pair<int, int>>> where;       // (início, registrador) de cada parte
+
+public:
+    vector<bool> spilled;                       // precisa de posição no quadro
+    vector<int> entry;                          // vivos na entrada da função
+    map<int, vector<int>> loops;                // vivos no início de cada laço (alvo de desvio para trás)
+    map<int, vector<Transfer>> splits;          // antes da instrução pc
+    map<pair<int, int>, vector<Transfer>> edges;    // da última instrução de um bloco ao início de outro
+    vector<int> saved;                          // registradores não voláteis usados
+    map<int, int> vectors;                      // primeiro registrador e elementos de cada vetor, sempre no quadro
+
+    Allocation(Chunk & c);
+    int Count() const;
+    int Vreg(uint32_t ref, int bank) const;
+    int Bank(int vreg) const;
+    uint32_t Ref(int vreg) const;
+    int Where(int vreg, int pos) const;
+    void Place(int vreg, int from, int reg);
+};
+
+// alocação por varredura linear dos intervalos de vida, com buracos
+// ocupados por outros intervalos e segunda chance para os derramados
+Allocation Allocate(Chunk & c);
+
+#endif
@@ -0,0 +1,374 @@
+#include <set>
+#include "scev.h"
+#include "nest.h"
+using std::set;
+using std::vector;
+
+// -----------------
+// Expressões
+// -----------------
+
+static bool Value(Expression * e, long long & v)
+{
+    if (e->node_type != NodeType::CONSTANT)
+        return false;
+    v = std::stoll(e->ToString());
+    return true;
+}
+
+static Expression * Int(long long v)
+{
+    return new Constant(ExprType::INT, new Token(Tag::INTEGER, std::to_string(v)));
+}
+
+static Expression * Id(const string & name)
+{
+    return new Identifier(ExprType::INT, new Token(Tag::ID, name));
+}
+
+// operação aritmética com as constantes já calculadas
+static Expression * Op(char op, Expression * a, Expression * b)
+{
+    long long x, y;
+    bool cx = Value(a, x);
+    bool cy = Value(b, y);
+    if (cx && cy)
+    {
+        switch (op)
+        {
+        case '+': return Int(x + y);
+        case '-': return Int(x - y);
+        case '*': return Int(x * y);
+        case '/': return Int(x / y);
+        }
+    }
+    if ((op == '+' && cx && x == 0) || (op == '*' && cx && x == 1))
+        return b;
+    if (((op == '+' || op == '-') && cy && y == 0) || ((op == '*' || op == '/') && cy && y == 1))
+        return a;
+    if (op == '*' && ((cx && x == 0) || (cy && y == 0)))
+        return Int(0);
+    return new Arithmetic(ExprType::INT, new Token(op), a, b);
+}
+
+// -----------------
+// Recorrências
+// -----------------
+
+// laço do ninho: o contador evolui como {init, +, step} por trips iterações
+struct Evolution
+{
+    string var;
+    Expression * init;
+    Expression * bound;
+    int rel;
+    long long step;
+    Expression * trips;
+    vector<int> outer;      // laços envolventes
+};
+
+// acumulação x = x ± value no corpo dos laços indicados
+struct Update
+{
+    string var;
+    Expression * value;
+    bool negate;
+    vector<int> loops;
+};
+
+// contador, relação, limite e passo de um laço, com relação e passo coerentes
+static bool Counter(Expression * cond, Assign * inc, string & var, int & rel, Expression * & bound, long long & step)
+{
+    if (cond->node_type != NodeType::REL || inc->id->node_type != NodeType::IDENTIFIER)
+        return false;
+    Relational * r = (Relational*) cond;
+    var = inc->id->ToString();
+    rel = r->token->tag;
+    bound = r->expr2;
+    if (r->expr1->ToString() != var || r->expr1->node_type != NodeType::IDENTIFIER || inc->id->type != ExprType::INT)
+        return false;
+    if (bound->node_type != NodeType::CONSTANT && bound->node_type != NodeType::IDENTIFIER)
+        return false;
+
+    if (inc->expr->node_type != NodeType::ARI)
+        return false;
+    Arithmetic * a = (Arithmetic*) inc->expr;
+    if (a->expr1->ToString() != var || !Value(a->expr2, step) || step <= 0)
+        return false;
+    if (a->token->tag == '-')
+        step = -step;
+    else if (a->token->tag != '+')
+        return false;
+
+    // o laço termina: cresce até o limite superior ou decresce até o inferior
+    if (step > 0)
+        return rel == '<' || rel == Tag::LTE;
+    return rel == '>' || rel == Tag::GTE;
+}
+
+// percorre o corpo registrando laços internos e acumulações
+static bool Walk(Statement * s, vector<int> & path, vector<Evolution> & loops, vector<Update> & updates)
+{
+    if (!s)
+        return true;
+
+    switch (s->node_type)
+    {
+    case NodeType::SEQ:
+        return Walk(((Seq*) s)->stmt, path, loops, updates) && Walk(((Seq*) s)->stmts, path, loops, updates);
+    case NodeType::FOR_STMT:
+    {
+        For * f = (For*) s;
+        Evolution e;
+        if (!Counter(f->for_condition, f->for_increment, e.var, e.rel, e.bound, e.step))
+            return false;
+        if (f->for_init->id->ToString() != e.var)
+            return false;
+        e.init = f->for_init->expr;
+        if (e.init->node_type != NodeType::CONSTANT && e.init->node_type != NodeType::IDENTIFIER)
+            return false;
+        e.outer = path;
+
+        loops.push_back(e);
+        path.push_back(loops.size() - 1);
+        bool valid = Walk(f->stmt, path, loops, updates);
+        path.pop_back();
+        return valid;
+    }
+    case NodeType::ASSIGN:
+    {
+        // x = x + e ou x = x - e
+        Assign * a = (Assign*) s;
+        if (a->id->node_type != NodeType::IDENTIFIER || a->id->type != ExprType::INT
+            || a->expr->node_type != NodeType::ARI)
+            return false;
+        Arithmetic * ari = (Arithmetic*) a->expr;
+        int tag = ari->token->tag;
+        if ((tag != '+' && tag != '-') || ari->expr1->node_type != NodeType::IDENTIFIER
+            || ari->expr1->ToString() != a->id->ToString())
+            return false;
+        if (ari->expr2->node_type != NodeType::CONSTANT && ari->expr2->node_type != NodeType::IDENTIFIER)
+            return false;
+
+        updates.push_back(Update{a->id->ToString(), ari->expr2, tag == '-', path});
+        return true;
+    }
+    }
+    return false;
+}
+
+// valores possíveis de um início ou limite: a constante ou qualquer inteiro
+static void Range(Expression * e, long long & low, long long & high)
+{
+    if (!Value(e, low))
+    {
+        low = INT32_MIN;
+        high = INT32_MAX;
+        return;
+    }
+    high = low;
+}
+
+// nas iterações que executam, a distância entre o início e o limite cabe
+// num inteiro de 32 bits
+static bool Bounded(Evolution & e, Expression * init)
+{
+    long long fromLow, fromHigh, toLow, toHigh;
+    Range(e.step > 0 ? init : e.bound, fromLow, fromHigh);
+    Range(e.step > 0 ? e.bound : init, toLow, toHigh);
+    return toHigh - fromLow <= INT32_MAX;
+}
+
+// número de iterações: 0 se o laço não executa; senão, com a distância d
+// entre o início e o limite, (d - k) / passo + 1, em que k é 1 nas relações
+// estritas e 0 nas demais; nenhuma parcela passa da distância
+static Expression * Trips(Evolution & e, Expression * init, Statement * & pre)
+{
+    long long c = e.step > 0 ? e.step : -e.step;
+    Expression * distance = e.step > 0 ? Op('-', e.bound, init) : Op('-', init, e.bound);
+    long long k = (e.rel == Tag::LTE || e.rel == Tag::GTE) ? 0 : 1;
+
+    long long value;
+    if (Value(distance, value))
+        return Int(value < k ? 0 : (value - k) / c + 1);
+
+    Token * rel = (e.rel == Tag::LTE) ? new Token(Tag::LTE, "<=")
+                : (e.rel == Tag::GTE) ? new Token(Tag::GTE, ">=")
+                : new Token(char(e.rel));
+    Expression * var = Declare(e.var + "_trips");
+    Statement * count = new If(new Relational(rel, init, e.bound),
+                               new Assign(var, Op('+', Op('/', Op('-', distance, Int(k)), Int(c)), Int(1))));
+    pre = new Seq(new Assign(var, Int(0)), new Seq(count, pre));
+    return var;
+}
+
+// sequência de instruções na ordem indicada
+static Statement * Sequence(vector<Statement*> & stmts)
+{
+    Statement * seq = nullptr;
+    for (int i = stmts.size() - 1; i >= 0; --i)
+        seq = new Seq(stmts[i], seq);
+    return seq;
+}
+
+// substitui o ninho cujo laço externo é descrito por outer, com o contador
+// já inicializado, pelas instruções que calculam os valores finais
+static Statement * Replace(Evolution & outer, Statement * body, Statement * init)
+{
+    vector<Evolution> loops{outer};
+    vector<Update> updates;
+    vector<int> path{0};
+    if (!Walk(body, path, loops, updates))
+        return nullptr;
+
+    // contadores distintos, não escritos pelas acumulações
+    set<string> written;
+    for (Evolution & e : loops)
+    {
+        if (!written.insert(e.var).second)
+            return nullptr;
+    }
+    for (Update & u : updates)
+    {
+        for (Evolution & e : loops)
+        {
+            if (e.var == u.var)
+                return nullptr;
+        }
+        written.insert(u.var);
+    }
+
+    // limites, valores iniciais dos laços internos e parcelas invariantes
+    auto invariant = [&written](Expression * e)
+    {
+        return e->node_type == NodeType::CONSTANT || !written.count(e->ToString());
+    };
+    for (int k = 0; k < int(loops.size()); ++k)
+    {
+        if (!invariant(loops[k].bound) || (k > 0 && !invariant(loops[k].init)))
+            return nullptr;
+    }
+    for (Update & u : updates)
+    {
+        bool counter = false;
+        for (int k : u.loops)
+            counter = counter || loops[k].var == u.value->ToString();
+        if (!counter && !invariant(u.value))
+            return nullptr;
+    }
+
+    for (Evolution & e : loops)
+    {
+        if (!Bounded(e, e.init))
+            return nullptr;
+    }
+
+    Statement * pre = nullptr;
+    vector<Expression*> starts;
+    for (int k = 0; k < int(loops.size()); ++k)
+    {
+        starts.push_back(loops[k].init);
+        loops[k].trips = Trips(loops[k], starts[k], pre);
+    }
+
+    vector<Statement*> stmts;
+    if (init)
+        stmts.push_back(init);
+    if (pre)
+        stmts.push_back(pre);
+
+    // cada acumulação soma a parcela de todas as iterações dos laços
+    // envolventes; o contador k soma trips * início + passo * trips * (trips - 1) / 2,
+    // com a série calculada como h * (2 * trips - 2 * h - 1), h = trips / 2, para
+    // que a divisão venha antes dos produtos que podem dar a volta
+    for (Update & u : updates)
+    {
+        Expression * total = nullptr;
+        for (int k : u.loops)
+        {
+            if (loops[k].var == u.value->ToString())
+            {
+                Expression * t = loops[k].trips;
+                Expression * h = Op('/', t, Int(2));
+                Expression * series = Op('*', h, Op('-', Op('-', Op('*', Int(2), t), Op('*', Int(2), h)), Int(1)));
+                total = Op('+', Op('*', t, starts[k]), Op('*', Int(loops[k].step), series));
+            }
+        }
+        if (!total)
+            total = u.value;
+        for (int k : u.loops)
+        {
+            if (loops[k].var != u.value->ToString())
+                total = Op('*', total, loops[k].trips);
+        }
+        stmts.push_back(new Assign(Id(u.var), Op(u.negate ? '-' : '+', Id(u.var), total)));
+    }
+
+    // valores finais dos contadores internos, se os laços chegaram a executar
+    for (int k = loops.size() - 1; k >= 0; --k)
+    {
+        Assign * last = new Assign(Id(loops[k].var), Op('+', starts[k], Op('*', loops[k].trips, Int(loops[k].step))));
+        Expression * runs = Int(1);
+        for (int o : loops[k].outer)
+            runs = Op('*', runs, loops[o].trips);
+
+        long long value;
+        if (!Value(runs, value))
+            stmts.push_back(new If(new Relational(new Token('>'), runs, Int(0)), last));
+        else if (value > 0)
+            stmts.push_back(last);
+    }
+    return Sequence(stmts);
+}
+
+Statement * ClosedForm(For * loop)
+{
+    Evolution outer;
+    if (!Counter(loop->for_condition, loop->for_increment, outer.var, outer.rel, outer.bound, outer.step))
+        return nullptr;
+    if (loop->for_init->id->ToString() != outer.var)
+        return nullptr;
+
+    // o contador externo já recebeu o valor inicial quando as acumulações são feitas
+    Expression * init = loop->for_init->expr;
+    outer.init = init->node_type == NodeType::CONSTANT ? init : Id(outer.var);
+    return Replace(outer, loop->stmt, loop->for_init);
+}
+
+// 🔁 (i < n) { ...; i = i + c }: o incremento encerra o corpo
+Statement * ClosedForm(While * loop)
+{
+    Statement * body = loop->stmt;
+    Statement * last = body;
+    Seq * before = nullptr;
+    while (last && last->node_type == NodeType::SEQ)
+    {
+        Seq * seq = (Seq*) last;
+        if (!seq->stmts)
+        {
+            last = seq->stmt;
+            continue;
+        }
+        before = seq;
+        last = seq->stmts;
+    }
+    if (!last || last->node_type != NodeType::ASSIGN)
+        return nullptr;
+
+    Evolution outer;
+    if (!Counter(loop->expr, (Assign*) last, outer.var, outer.rel, outer.bound, outer.step))
+        return nullptr;
+    outer.init = Id(outer.var);
+
+    // corpo sem o incremento final
+    Statement * rest = nullptr;
+    if (before)
+    {
+        Statement * saved = before->stmts;
+        before->stmts = nullptr;
+        Statement * result = Replace(outer, body, nullptr);
+        before->stmts = saved;
+        return result;
+    }
+    return Replace(outer, rest, nullptr);
+}
@@ -0,0 +1,13 @@
+#ifndef COMPILER_SCEV
+#define COMPILER_SCEV
+
+#include "ast.h"
+
+// evolução escalar: laços cujo corpo apenas acumula x = x ± e, com e
+// invariante ou contador de um laço envolvente, e laços 🧬 internos da mesma
+// forma, são substituídos pelo valor final das variáveis; retorna nullptr se
+// o laço não tiver essa forma
+Statement * ClosedForm(For * loop);
+Statement * ClosedForm(While * loop);
+
+#endif
@@ -0,0 +1,317 @@
+#include <set>
+#include "bytecode.h"
+using std::set;
+
+// registrador local identificado pelo banco e índice (globais e constantes
+// não entram na análise de vida)
+static bool LocalKey(uint32_t ref, int bank, uint64_t & key)
+{
+    if ((ref >> SpaceShift) != SPACE_LOCAL)
+        return false;
+    key = (uint64_t(bank) << 32) | ref;
+    return true;
+}
+
+static bool IsJump(int op)
+{
+    return op == OP_JMP || op == OP_JF || op == OP_JT;
+}
+
+// ------------------
+// Análise de vida
+// ------------------
+
+// registradores locais vivos após cada instrução, por blocos básicos
+static vector<set<uint64_t>> Liveness(Chunk & c)
+{
+    vector<Instr> & code = c.code;
+    int n = code.size();
+
+    vector<bool> leader(n + 1, false);
+    leader[0] = true;
+    for (int i = 0; i < n; ++i)
+    {
+        if (IsJump(code[i].op))
+        {
+            leader[code[i].a] = true;
+            leader[i + 1] = true;
+        }
+        if (code[i].op == OP_HALT || (code[i].op >= OP_RET_I && code[i].op <= OP_RET_A))
+            leader[i + 1] = true;
+    }
+
+    vector<int> first, last, blockOf(n);
+    for (int i = 0; i < n; ++i)
+    {
+        if (leader[i])
+        {
+            first.push_back(i);
+            last.push_back(i);
+        }
+        last.back() = i + 1;
+        blockOf[i] = first.size() - 1;
+    }
+
+    int blocks = first.size();
+    vector<vector<int>> succ(blocks);
+    for (int b = 0; b < blocks; ++b)
+    {
+        const Instr & q = code[last[b] - 1];
+        bool ends = q.op == OP_HALT || (q.op >= OP_RET_I && q.op <= OP_RET_A);
+        if (IsJump(q.op))
+            succ[b].push_back(blockOf[q.a]);
+        if (q.op != OP_JMP && !ends && b + 1 < blocks)
+            succ[b].push_back(b + 1);
+    }
+
+    // transferência para trás de uma instrução; vetores ocupam r.count
+    // registradores
+    auto transfer = [](const Instr & i, set<uint64_t> & live)
+    {
+        vector<Role> roles = Roles(i);
+        uint64_t key;
+        for (Role & r : roles)
+        {
+            for (int k = 0; k < r.count; ++k)
+            {
+                if (r.write && LocalKey(Field(i, r.field) + k, r.bank, key))
+                    live.erase(key);
+            }
+        }
+        for (Role & r : roles)
+        {
+            for (int k = 0; k < r.count; ++k)
+            {
+                if (!r.write && LocalKey(Field(i, r.field) + k, r.bank, key))
+                    live.insert(key);
+            }
+        }
+    };
+
+    vector<set<uint64_t>> in(blocks), out(blocks);
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b = blocks - 1; b >= 0; --b)
+        {
+            for (int s : succ[b])
+                out[b].insert(in[s].begin(), in[s].end());
+
+            set<uint64_t> live = out[b];
+            for (int i = last[b] - 1; i >= first[b]; --i)
+                transfer(code[i], live);
+
+            if (live.size() != in[b].size())
+            {
+                in[b] = live;
+                changed = true;
+            }
+        }
+    }
+
+    vector<set<uint64_t>> after(n);
+    for (int b = 0; b < blocks; ++b)
+    {
+        set<uint64_t> live = out[b];
+        for (int i = last[b] - 1; i >= first[b]; --i)
+        {
+            after[i] = live;
+            transfer(code[i], live);
+        }
+    }
+    return after;
+}
+
+// --------------
+// Superinstruções
+// --------------
+
+// contexto da combinação: vida dos registradores e alvos de desvios
+struct Combiner
+{
+    Chunk & chunk;
+    vector<Instr> & code;
+    vector<set<uint64_t>> live;
+    vector<bool> target;
+
+    Combiner(Chunk & c);
+    bool Dead(uint32_t ref, int bank, int i);
+    bool Straight(int i, int count);
+    bool Constant(uint32_t ref, int32_t & value);
+    int Loop(int i, vector<Instr> & out);
+    int Branch(int i, vector<Instr> & out);
+    int Access(int i, vector<Instr> & out);
+};
+
+Combiner::Combiner(Chunk & c) :
+    chunk(c),
+    code(c.code),
+    live(Liveness(c)),
+    target(c.code.size() + 1, false)
+{
+    for (Instr & i : code)
+    {
+        if (IsJump(i.op))
+            target[i.a] = true;
+    }
+}
+
+// registrador local sem leitura depois da instrução i
+bool Combiner::Dead(uint32_t ref, int bank, int i)
+{
+    uint64_t key;
+    return LocalKey(ref, bank, key) && !live[i].count(key);
+}
+
+// instruções i .. i + count - 1 existem e só a primeira pode ser alvo
+bool Combiner::Straight(int i, int count)
+{
+    if (i + count > int(code.size()))
+        return false;
+    for (int k = i + 1; k < i + count; ++k)
+    {
+        if (target[k])
+            return false;
+    }
+    return true;
+}
+
+bool Combiner::Constant(uint32_t ref, int32_t & value)
+{
+    if ((ref >> SpaceShift) != SPACE_CONST)
+        return false;
+    value = chunk.ints[ref & IndexMask];
+    return true;
+}
+
+// r = r + k; t = r < n (ou r != n); if t goto L
+int Combiner::Loop(int i, vector<Instr> & out)
+{
+    if (!Straight(i, 3))
+        return 0;
+
+    const Instr & add = code[i];
+    const Instr & cmp = code[i + 1];
+    const Instr & jump = code[i + 2];
+    if (add.op != OP_ADD_I || add.a != add.b || (cmp.op != OP_LT_I && cmp.op != OP_NE_I))
+        return 0;
+    if (cmp.b != add.a || cmp.c == add.a || jump.op != OP_JT || jump.b != cmp.a || !Dead(cmp.a, BANK_BOOL, i + 2))
+        return 0;
+
+    int op = (cmp.op == OP_LT_I) ? OP_LOOPLT_I : OP_LOOPNE_I;
+    out.push_back(Instr{uint16_t(op), jump.a, add.a, add.c, cmp.c, 0});
+    return 3;
+}
+
+// t = x op y; if (!)t goto L
+int Combiner::Branch(int i, vector<Instr> & out)
+{
+    if (!Straight(i, 2))
+        return 0;
+
+    const Instr & cmp = code[i];
+    const Instr & jump = code[i + 1];
+    if (cmp.op < OP_LT_I || cmp.op > OP_NE_I || (jump.op != OP_JT && jump.op != OP_JF))
+        return 0;
+    if (jump.b != cmp.a || !Dead(cmp.a, BANK_BOOL, i + 1))
+        return 0;
+
+    // ifFalse usa a comparação oposta, exata para inteiros
+    static const int taken[] = {OP_JLT_I, OP_JLE_I, OP_JGT_I, OP_JGE_I, OP_JEQ_I, OP_JNE_I};
+    static const int negated[] = {OP_JGE_I, OP_JGT_I, OP_JLE_I, OP_JLT_I, OP_JNE_I, OP_JEQ_I};
+    int k = cmp.op - OP_LT_I;
+    int op = (jump.op == OP_JT) ? taken[k] : negated[k];
+    out.push_back(Instr{uint16_t(op), jump.a, cmp.b, cmp.c, 0, 0});
+    return 2;
+}
+
+// s = i * k (ou i << k); s = s + j; x = a[s]  ou  s = i + j; a[s] = x
+int Combiner::Access(int i, vector<Instr> & out)
+{
+    int length = 1;
+    uint32_t row = 0;
+    int32_t stride = 1;
+
+    const Instr * scale = &code[i];
+    int32_t k;
+    if ((scale->op == OP_MUL_I && Constant(scale->c, k)) || (scale->op == OP_SHL_I && Constant(scale->c, k)))
+    {
+        stride = (scale->op == OP_MUL_I) ? k : (1 << (k & 31));
+        row = scale->b;
+        length = 2;
+    }
+
+    if (!Straight(i, length + 1))
+        return 0;
+    const Instr & add = code[i + length - 1];
+    const Instr & access = code[i + length];
+    if (add.op != OP_ADD_I || access.d != 0)
+        return 0;
+
+    uint32_t col = add.c;
+    if (length == 2)
+    {
+        // o endereço da linha só pode ser lido pela soma
+        if (add.b != scale->a || add.c == scale->a || (add.a != scale->a && !Dead(scale->a, BANK_INT, i + 1)))
+            return 0;
+    }
+    else
+    {
+        row = add.b;
+    }
+
+    if (access.op >= OP_LOAD_I && access.op <= OP_LOAD_B)
+    {
+        if (access.c != add.a || !Dead(add.a, BANK_INT, i + length))
+            return 0;
+        int op = OP_LOADX_I + (access.op - OP_LOAD_I);
+        out.push_back(Instr{uint16_t(op), access.a, access.b, row, col, uint32_t(stride)});
+        return length + 1;
+    }
+    if (access.op >= OP_STORE_I && access.op <= OP_STORE_B)
+    {
+        if (access.b != add.a || access.c == add.a || !Dead(add.a, BANK_INT, i + length))
+            return 0;
+        int op = OP_STOREX_I + (access.op - OP_STORE_I);
+        out.push_back(Instr{uint16_t(op), access.a, row, access.c, col, uint32_t(stride)});
+        return length + 1;
+    }
+    return 0;
+}
+
+void Combine(Chunk & c)
+{
+    Combiner combiner(c);
+    vector<Instr> & code = c.code;
+
+    // posição nova de cada instrução, para refazer os alvos dos desvios
+    vector<uint32_t> moved(code.size() + 1);
+    vector<Instr> out;
+    int i = 0;
+    while (i < int(code.size()))
+    {
+        moved[i] = out.size();
+        int used = combiner.Loop(i, out);
+        if (!used)
+            used = combiner.Branch(i, out);
+        if (!used)
+            used = combiner.Access(i, out);
+        if (!used)
+        {
+            out.push_back(code[i]);
+            used = 1;
+        }
+        for (int k = 1; k < used; ++k)
+            moved[i + k] = out.size();
+        i += used;
+    }
+    moved[code.size()] = out.size();
+
+    for (Instr & q : out)
+    {
+        if (IsBranch(q.op))
+            q.a = moved[q.a];
+    }
+    code.swap(out);
+}
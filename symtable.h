@@ -4,10 +4,12 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
-#include "ast.h"
 using std::unordered_map;
 using std::string;
 
+struct Statement;
+struct Expression;
+
 
 // modelo para símbolos
 struct Symbol {
@@ -15,6 +17,7 @@ struct Symbol {
     std::string type;                       
     int valX;
     int valY;
+    bool noalias = false;                   // parâmetro arranjo marcado com 🔒
     
 	bool isFunction = false;
     std::vector<string> paramTypes;
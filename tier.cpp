@@ -0,0 +1,280 @@
+#include <cstring>
+#include <iostream>
+#include "tier.h"
+#include "options.h"
+#include "error.h"
+
+extern Options options;
+
+// ---------
+// Compiling
+// ---------
+
+Tier::Tier(Module & m, int limit, const char * directory) :
+    module(m),
+    pristine(m),
+    image(pristine),
+    cache(pristine, directory),
+    threshold(std::max(limit, 1)),
+    calls(m.chunks.size(), 0),
+    backedges(m.chunks.size()),
+    requested(m.chunks.size(), false),
+    compiled(new std::atomic<NativeCode *>[m.chunks.size()]()),
+    done(m.chunks.size(), false)
+{
+    worker = std::thread(&Tier::Work, this);
+}
+
+Tier::~Tier()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void Tier::Request(int chunk)
+{
+    if (requested[chunk])
+        return;
+    requested[chunk] = true;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(chunk);
+    }
+    wake.notify_one();
+}
+
+void Tier::Work()
+{
+    for (;;)
+    {
+        int chunk;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return stop || !queue.empty(); });
+            if (stop)
+                return;
+            chunk = queue.front();
+            queue.pop_front();
+        }
+
+        // funções que o código nativo não traduz continuam interpretadas
+        try
+        {
+            Compile(chunk);
+        }
+        catch (RuntimeError &)
+        {
+        }
+    }
+}
+
+// a função e todas as que ela alcança por chamadas, já que o código nativo
+// não volta ao interpretador; as funções são publicadas depois de instaladas
+void Tier::Compile(int chunk)
+{
+    vector<int> pending;
+    vector<bool> seen = done;
+    if (!seen[chunk])
+    {
+        seen[chunk] = true;
+        pending.push_back(chunk);
+    }
+    for (size_t k = 0; k < pending.size(); ++k)
+    {
+        for (const Instr & i : pristine.chunks[pending[k]].code)
+        {
+            int op = Generic(i.op);
+            if (op >= OP_CALL_I && op <= OP_CALL_A && !seen[i.b])
+            {
+                seen[i.b] = true;
+                pending.push_back(i.b);
+            }
+        }
+    }
+    if (pending.empty())
+        return;
+
+    vector<MachineCode> functions;
+    for (int c : pending)
+    {
+        functions.push_back(cache.Compile(pristine, c, CODE_LOOPS));
+        functions.push_back(cache.Compile(pristine, c, CODE_BRIDGE));
+    }
+    image.Install(functions);
+
+    for (int c : pending)
+    {
+        NativeCode * code = new NativeCode{image.Address(BridgeSymbol(c)), {}};
+        codes.emplace_back(code);
+        vector<Instr> & instrs = pristine.chunks[c].code;
+        for (int pc = 0; pc < int(instrs.size()); ++pc)
+        {
+            int target = instrs[pc].a;
+            if (IsBranch(instrs[pc].op) && target <= pc)
+                code->loops[target] = image.Address(LoopSymbol(c, target));
+        }
+        done[c] = true;
+        compiled[c].store(code, std::memory_order_release);
+    }
+}
+
+// ---------
+// Execution
+// ---------
+
+int32_t * Tier::Ints() const
+{
+    return image.Ints();
+}
+
+double * Tier::Floats() const
+{
+    return image.Floats();
+}
+
+uint8_t * Tier::Bools() const
+{
+    return image.Bools();
+}
+
+void * Tier::Global(uint32_t slot) const
+{
+    return image.Address(GlobalSymbol(BANK_ARRAY, slot));
+}
+
+// valores de 8 bytes trocados com o código nativo; arranjos são passados
+// pelo endereço do primeiro elemento
+static uint64_t Word(const Value & v, int bank)
+{
+    uint64_t w = 0;
+    switch (bank)
+    {
+    case BANK_INT: w = uint32_t(v.i); break;
+    case BANK_FLOAT: memcpy(&w, &v.f, sizeof(double)); break;
+    case BANK_BOOL: w = v.b; break;
+    case BANK_ARRAY: w = v.a ? reinterpret_cast<uintptr_t>(v.a->data) : 0; break;
+    }
+    return w;
+}
+
+static Value Unword(uint64_t w, int bank)
+{
+    Value v{};
+    switch (bank)
+    {
+    case BANK_INT: v.i = int32_t(uint32_t(w)); break;
+    case BANK_FLOAT: memcpy(&v.f, &w, sizeof(double)); break;
+    case BANK_BOOL: v.b = uint8_t(w); break;
+    }
+    return v;
+}
+
+void Tier::Count(int chunk)
+{
+    if (!compiled[chunk].load(std::memory_order_acquire) && ++calls[chunk] >= threshold)
+        Request(chunk);
+}
+
+bool Tier::Call(int chunk, const Value * args, Array * into, Value & result)
+{
+    NativeCode * code = compiled[chunk].load(std::memory_order_acquire);
+    if (!code)
+        return false;
+
+    Chunk & c = module.chunks[chunk];
+    vector<uint64_t> in;
+    for (int k = 0; k < int(c.params.size()); ++k)
+        in.push_back(Word(args[k], c.params[k].first));
+    in.push_back(c.ret == BANK_ARRAY ? reinterpret_cast<uintptr_t>(into->data) : 0);
+
+    uint64_t out = 0;
+    auto bridge = reinterpret_cast<void (*)(const uint64_t *, uint64_t *)>(code->bridge);
+    Protect([&] { bridge(in.data(), &out); });
+    result = Unword(out, c.ret);
+    return true;
+}
+
+bool Tier::Enter(int chunk, const Value * args, Array * into, Value & result)
+{
+    if (Call(chunk, args, into, result))
+        return true;
+    Count(chunk);
+    return false;
+}
+
+// o estado da ativação segue a ordem dos registradores virtuais da alocação:
+// bancos inteiro, real, lógico e de arranjos, e por fim o arranjo devolvido
+bool Tier::Loop(int chunk, int branch, int header, const Locals & locals, Array * into, Value & result)
+{
+    NativeCode * code = compiled[chunk].load(std::memory_order_acquire);
+    if (!code)
+    {
+        vector<int> & counts = backedges[chunk];
+        if (counts.empty())
+            counts.resize(module.chunks[chunk].code.size(), 0);
+        if (++counts[branch] >= threshold)
+            Request(chunk);
+        return false;
+    }
+    auto entry = code->loops.find(header);
+    if (entry == code->loops.end())
+        return false;
+
+    Chunk & c = module.chunks[chunk];
+    vector<uint64_t> state;
+    Value v;
+    for (uint32_t k = 0; k < c.regs[BANK_INT]; ++k)
+    {
+        v.i = locals.ints[k];
+        state.push_back(Word(v, BANK_INT));
+    }
+    for (uint32_t k = 0; k < c.regs[BANK_FLOAT]; ++k)
+    {
+        v.f = locals.floats[k];
+        state.push_back(Word(v, BANK_FLOAT));
+    }
+    for (uint32_t k = 0; k < c.regs[BANK_BOOL]; ++k)
+    {
+        v.b = locals.bools[k];
+        state.push_back(Word(v, BANK_BOOL));
+    }
+    for (uint32_t k = 0; k < c.regs[BANK_ARRAY]; ++k)
+    {
+        v.a = locals.arrays[k];
+        state.push_back(Word(v, BANK_ARRAY));
+    }
+    state.push_back(c.ret == BANK_ARRAY ? reinterpret_cast<uintptr_t>(into->data) : 0);
+
+    const uint64_t * s = state.data();
+    void * start = entry->second;
+    result = Value{};
+    switch (c.ret)
+    {
+    case BANK_INT:
+        Protect([&] { result.i = reinterpret_cast<int32_t (*)(const uint64_t *)>(start)(s); });
+        break;
+    case BANK_FLOAT:
+        Protect([&] { result.f = reinterpret_cast<double (*)(const uint64_t *)>(start)(s); });
+        break;
+    case BANK_BOOL:
+        Protect([&] { result.b = reinterpret_cast<uint8_t (*)(const uint64_t *)>(start)(s); });
+        break;
+    default:
+        Protect([&] { reinterpret_cast<void (*)(const uint64_t *)>(start)(s); });
+        break;
+    }
+    return true;
+}
+
+void RunTiered(Program * p)
+{
+    Module module = Lower(p);
+    Tier tier(module, options.tierThreshold, options.codeCache);
+    Machine machine(module, &tier);
+    machine.Run();
+    machine.Print(std::cout);
+}
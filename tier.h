@@ -0,0 +1,88 @@
+#ifndef COMPILER_TIER
+#define COMPILER_TIER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "cache.h"
+#include "vm.h"
+
+// código nativo de uma função: ponte para as chamadas do interpretador e
+// entradas dos laços, pelo índice da instrução de início
+struct NativeCode
+{
+    void * bridge;
+    map<int, void *> loops;
+};
+
+// registradores locais de uma ativação interpretada
+struct Locals
+{
+    int32_t * ints;
+    double * floats;
+    uint8_t * bools;
+    Array ** arrays;
+};
+
+// execução em camadas: a máquina virtual conta as chamadas de cada função e
+// as voltas de cada laço; quando uma contagem chega ao limite, a função e as
+// que ela chama são compiladas em segundo plano, e as próximas chamadas e
+// voltas passam ao código nativo. A compilação usa uma cópia do módulo, já
+// que o interpretador altera o código ao acelerar as instruções, e reusa o
+// código guardado no diretório do cache, quando há um
+class Tier
+{
+private:
+    Module & module;
+    Module pristine;
+    Image image;
+    CodeCache cache;
+    int threshold;
+    vector<int> calls;                      // chamadas de cada função
+    vector<vector<int>> backedges;          // voltas de cada desvio para trás
+    vector<bool> requested;
+    std::unique_ptr<std::atomic<NativeCode *>[]> compiled;
+
+    // estado da compilação em segundo plano
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<int> queue;
+    bool stop = false;
+    vector<bool> done;
+    vector<std::unique_ptr<NativeCode>> codes;
+    std::thread worker;
+
+    void Request(int chunk);
+    void Compile(int chunk);
+    void Work();
+
+public:
+    Tier(Module & m, int limit, const char * directory = nullptr);
+    ~Tier();
+    Tier(const Tier &) = delete;
+    Tier & operator=(const Tier &) = delete;
+
+    // variáveis globais compartilhadas com o código nativo
+    int32_t * Ints() const;
+    double * Floats() const;
+    uint8_t * Bools() const;
+    void * Global(uint32_t slot) const;
+
+    // contagem de uma chamada, e chamada apenas do código nativo que já
+    // existe, segura nas threads dos laços 🧵
+    void Count(int chunk);
+    bool Call(int chunk, const Value * args, Array * into, Value & result);
+
+    // chamada de uma função e desvio para o início de um laço: executam o
+    // código nativo quando ele existe, devolvendo o valor da função em result
+    bool Enter(int chunk, const Value * args, Array * into, Value & result);
+    bool Loop(int chunk, int branch, int header, const Locals & locals, Array * into, Value & result);
+};
+
+// executa o programa em camadas e exibe o estado final das variáveis globais
+void RunTiered(Program * p);
+
+#endif
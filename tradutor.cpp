@@ -7,22 +7,79 @@
 #include "ast.h"
 #include "gen.h"
 #include "checker.h"
+#include "ir.h"
+#include "alias.h"
+#include "optimizer.h"
+#include "options.h"
+#include "vm.h"
+#include "asm.h"
+#include "jit.h"
+#include "tier.h"
+#include "csource.h"
+#include "llvmir.h"
 
 using namespace std;
 
 ifstream fin;
 Lexer * scanner;
 SymTable * symtable;
+Program * program;
+Options options;
 
-// programa pode receber nomes de arquivos
+// programa pode receber opções e nomes de arquivos
+// uso: tradutor [-O<nível>] [--inline-limit=<n>] [--unroll=<n>] [--tile=<n>]
+//            [--vector-width=<n>] [--vector-report] [--run] [--jit] [--tiered]
+//            [--tier-threshold=<n>] [--code-cache=<dir>] [--threads=<n>]
+//            [--parallel-chunk=<n>] [--emit=<ir|asm|c|llvm>] arquivo
 int main(int argc, char **argv)
 {
-	if (argc == 2)
+	char * file = nullptr;
+	for (int i = 1; i < argc; ++i)
 	{
-		fin.open(argv[1]);
+		if (strncmp(argv[i], "-O", 2) == 0)
+			options.level = atoi(argv[i] + 2);
+		else if (strncmp(argv[i], "--inline-limit=", 15) == 0)
+			options.inlineLimit = atoi(argv[i] + 15);
+		else if (strncmp(argv[i], "--unroll=", 9) == 0)
+			options.unroll = atoi(argv[i] + 9);
+		else if (strncmp(argv[i], "--tile=", 7) == 0)
+			options.tile = atoi(argv[i] + 7);
+		else if (strncmp(argv[i], "--vector-width=", 15) == 0)
+			options.vectorWidth = atoi(argv[i] + 15);
+		else if (strcmp(argv[i], "--vector-report") == 0)
+			options.vectorReport = true;
+		else if (strcmp(argv[i], "--run") == 0)
+			options.run = true;
+		else if (strcmp(argv[i], "--jit") == 0)
+			options.jit = true;
+		else if (strcmp(argv[i], "--tiered") == 0)
+			options.tiered = true;
+		else if (strncmp(argv[i], "--tier-threshold=", 17) == 0)
+			options.tierThreshold = atoi(argv[i] + 17);
+		else if (strncmp(argv[i], "--code-cache=", 13) == 0)
+			options.codeCache = argv[i] + 13;
+		else if (strncmp(argv[i], "--threads=", 10) == 0)
+			options.threads = atoi(argv[i] + 10);
+		else if (strncmp(argv[i], "--parallel-chunk=", 17) == 0)
+			options.parallelChunk = atoi(argv[i] + 17);
+		else if (strcmp(argv[i], "--emit=asm") == 0)
+			options.emit = EMIT_ASM;
+		else if (strcmp(argv[i], "--emit=c") == 0)
+			options.emit = EMIT_C;
+		else if (strcmp(argv[i], "--emit=llvm") == 0)
+			options.emit = EMIT_LLVM;
+		else if (strcmp(argv[i], "--emit=ir") == 0)
+			options.emit = EMIT_IR;
+		else
+			file = argv[i];
+	}
+
+	if (file)
+	{
+		fin.open(file);
 		if (!fin.is_open())
 		{
-			cout << "Falha na abertura do arquivo \'" << argv[1] << "\'.\n";
+			cout << "Falha na abertura do arquivo \'" << file << "\'.\n";
 			exit(EXIT_FAILURE);
 		}
 
@@ -37,12 +94,36 @@ int main(int argc, char **argv)
 			ast = tradutor.Start();
 			
 			// gera código intermediário
+			AnalyzeAliases(ast);
+			program = new Program();
+			program->Main()->locals = tradutor.globals;
 			ast->Gen();
+
+			// otimiza e exibe, traduz ou executa o código intermediário
+			Optimize(program, options);
+			if (options.jit)
+				RunJit(program);
+			else if (options.tiered)
+				RunTiered(program);
+			else if (options.run)
+				Run(program);
+			else if (options.emit == EMIT_ASM)
+				EmitAssembly(program, cout);
+			else if (options.emit == EMIT_C)
+				EmitC(program, cout);
+			else if (options.emit == EMIT_LLVM)
+				EmitLlvm(program, cout);
+			else
+				Print(program);
 		}
 		catch (SyntaxError err)
 		{
 			err.What();
 		}
+		catch (RuntimeError err)
+		{
+			err.What();
+		}
 		fin.close();
 		//TestParser(ast);		
 	}
@@ -0,0 +1,286 @@
+#include <iostream>
+#include "vectorizer.h"
+#include "nest.h"
+#include "alias.h"
+#include "gen.h"
+#include "ir.h"
+
+extern Program * program;
+
+// ---------
+// Análise
+// ---------
+
+// verifica se há laços no corpo
+static bool HasLoop(Statement * s)
+{
+    if (!s)
+        return false;
+
+    switch (s->node_type)
+    {
+    case NodeType::SEQ:
+        return HasLoop(((Seq*) s)->stmt) || HasLoop(((Seq*) s)->stmts);
+    case NodeType::IF_STMT:
+        return HasLoop(((If*) s)->stmt);
+    case NodeType::WHILE_STMT:
+    case NodeType::DOWHILE_STMT:
+    case NodeType::FOR_STMT:
+    case NodeType::PARFOR_STMT:
+        return true;
+    }
+    return false;
+}
+
+// corpo formado apenas por atribuições a arranjos
+static bool Straight(Statement * s)
+{
+    if (!s)
+        return true;
+    if (s->node_type == NodeType::SEQ)
+        return Straight(((Seq*) s)->stmt) && Straight(((Seq*) s)->stmts);
+    return s->node_type == NodeType::ASSIGN && ((Assign*) s)->id->node_type == NodeType::ACCESS;
+}
+
+// índice que percorre elementos consecutivos: o contador ou algo que não o usa
+static bool Contiguous(Access * a, const string & var)
+{
+    Expression * inner = a->indexY ? a->indexY : a->indexX;
+    if (a->indexY && Uses(a->indexX, var))
+        return false;
+    return !Uses(inner, var) || (inner->node_type == NodeType::IDENTIFIER && inner->ToString() == var);
+}
+
+// expressão formada por operações com equivalente vetorial; o contador só
+// pode aparecer nos índices
+static bool Operations(Expression * e, const string & var)
+{
+    if (e->type != ExprType::INT && e->type != ExprType::FLOAT)
+        return false;
+
+    switch (e->node_type)
+    {
+    case NodeType::CONSTANT:
+        return true;
+    case NodeType::IDENTIFIER:
+        return e->ToString() != var;
+    case NodeType::ACCESS:
+        return true;
+    case NodeType::ARI:
+    {
+        Arithmetic * a = (Arithmetic*) e;
+        int tag = a->token->tag;
+        return (tag == '+' || tag == '-' || tag == '*' || tag == '/')
+            && Operations(a->expr1, var) && Operations(a->expr2, var);
+    }
+    }
+    return false;
+}
+
+static bool Operations(Statement * s, const string & var)
+{
+    if (!s)
+        return true;
+    if (s->node_type == NodeType::SEQ)
+        return Operations(((Seq*) s)->stmt, var) && Operations(((Seq*) s)->stmts, var);
+    return Operations(((Assign*) s)->expr, var);
+}
+
+// limite que o corpo não altera: constantes e variáveis escalares (o corpo
+// só escreve em arranjos) combinadas por operações aritméticas
+static bool Invariant(Expression * e, const string & var)
+{
+    switch (e->node_type)
+    {
+    case NodeType::CONSTANT:
+        return true;
+    case NodeType::IDENTIFIER:
+        return e->ToString() != var;
+    case NodeType::ARI:
+        return Invariant(((Arithmetic*) e)->expr1, var) && Invariant(((Arithmetic*) e)->expr2, var);
+    case NodeType::UNARY:
+        return Invariant(((UnaryExpr*) e)->expr, var);
+    }
+    return false;
+}
+
+// motivo pelo qual o laço não pode ser vetorizado, ou vazio
+static string Reason(For * loop, int lanes)
+{
+    Assign * inc = loop->for_increment;
+    string var = loop->for_init->id->ToString();
+    if (loop->for_init->id->node_type != NodeType::IDENTIFIER)
+        return "contador não é uma variável";
+
+    // incremento unitário e limite invariante: i < n ou i <= n
+    if (inc->id->ToString() != var || inc->expr->node_type != NodeType::ARI)
+        return "incremento não unitário";
+    Arithmetic * step = (Arithmetic*) inc->expr;
+    if (step->token->tag != '+' || step->expr1->ToString() != var
+        || step->expr2->node_type != NodeType::CONSTANT || step->expr2->ToString() != "1")
+        return "incremento não unitário";
+
+    if (loop->for_condition->node_type != NodeType::REL)
+        return "condição não reconhecida";
+    Relational * cond = (Relational*) loop->for_condition;
+    if ((cond->token->tag != '<' && cond->token->tag != Tag::LTE) || cond->expr1->ToString() != var
+        || !Invariant(cond->expr2, var))
+        return "condição não reconhecida";
+
+    CountedLoop counted;
+    if (loop->Counted(counted) && counted.trips < lanes)
+        return "poucas iterações";
+
+    if (!Straight(loop->stmt))
+        return "o corpo não contém apenas atribuições a arranjos";
+    if (!Operations(loop->stmt, var))
+        return "operação sem equivalente vetorial";
+
+    vector<Ref> refs;
+    Collect(loop->stmt, refs);
+    for (Ref & r : refs)
+    {
+        if (!Contiguous(r.acc, var))
+            return "acesso não contíguo a " + r.acc->id->ToString();
+    }
+
+    // cada iteração escreve seus próprios elementos e só lê os elementos
+    // escritos por ela mesma
+    for (Ref & w : refs)
+    {
+        if (!w.write)
+            continue;
+
+        string name = w.acc->id->ToString();
+        if (!Uses(w.acc, var) || !Simple(w.acc->indexX) || !Simple(w.acc->indexY))
+            return "dependência entre iterações em " + name;
+
+        for (Ref & r : refs)
+        {
+            string other = r.acc->id->ToString();
+            if (other == name && Subscript(r.acc) != Subscript(w.acc))
+                return "dependência entre iterações em " + name;
+            if (other != name && MayAlias(program->current->name, name, other))
+                return name + " pode ser o mesmo arranjo que " + other;
+        }
+    }
+    return "";
+}
+
+// --------
+// Emissão
+// --------
+
+// valor vetorial da expressão; partes que não dependem do contador
+// permanecem escalares e valem para todos os elementos
+static Operand Vector(Expression * e, const string & var, int lanes)
+{
+    if (e->node_type == NodeType::ACCESS && Uses(e, var))
+    {
+        Access * a = (Access*) e;
+        Operand dst = NewVector(a->type);
+        if (a->indexY)
+            EmitVLoad(dst, a->id->ToString(), Operand(Rvalue(a->indexX)), Operand(a->indexY), a->stride, lanes);
+        else
+            EmitVLoad(dst, a->id->ToString(), Operand(a->indexX), Operand(), 0, lanes);
+        return dst;
+    }
+
+    if (e->node_type == NodeType::ARI)
+    {
+        Arithmetic * a = (Arithmetic*) e;
+        Operand x = Vector(a->expr1, var, lanes);
+        Operand y = Vector(a->expr2, var, lanes);
+        if (x.kind != OPD_VECTOR && y.kind != OPD_VECTOR)
+        {
+            Operand dst = NewTemp(a->type);
+            EmitBinary(dst, x, a->ToString(), y);
+            return dst;
+        }
+
+        Operand dst = NewVector(a->type);
+        EmitVBinary(dst, x, a->ToString(), y, lanes);
+        return dst;
+    }
+    return Operand(Rvalue(e));
+}
+
+static void Vector(Statement * s, const string & var, int lanes)
+{
+    if (!s)
+        return;
+    if (s->node_type == NodeType::SEQ)
+    {
+        Vector(((Seq*) s)->stmt, var, lanes);
+        Vector(((Seq*) s)->stmts, var, lanes);
+        return;
+    }
+
+    Assign * assign = (Assign*) s;
+    Access * a = (Access*) assign->id;
+    Operand value = Vector(assign->expr, var, lanes);
+    if (a->indexY)
+        EmitVStore(a->id->ToString(), Operand(Rvalue(a->indexX)), Operand(a->indexY), a->stride, lanes, value);
+    else
+        EmitVStore(a->id->ToString(), Operand(a->indexX), Operand(), 0, lanes, value);
+}
+
+bool Vectorize(For * loop, int lanes, bool report)
+{
+    if (HasLoop(loop->stmt))
+        return false;
+
+    string var = loop->for_init->id->ToString();
+    string where = program->current->name.empty() ? "" : program->current->name + ": ";
+    string reason = Reason(loop, lanes);
+    if (!reason.empty())
+    {
+        if (report)
+            std::cerr << where << "laço em " << var << " não vetorizado: " << reason << std::endl;
+        return false;
+    }
+    if (report)
+        std::cerr << where << "laço em " << var << " vetorizado com " << lanes << " elementos" << std::endl;
+
+    // i + (lanes - 1) < n: há um grupo completo de elementos pela frente;
+    // o limite é invariante e é calculado uma vez, antes do laço
+    Relational * cond = (Relational*) loop->for_condition;
+    Operand counter(loop->for_init->id);
+    Operand limit;
+    auto test = [&](int op, unsigned label)
+    {
+        Operand last = NewTemp(ExprType::INT);
+        EmitBinary(last, counter, "+", Operand(OPD_CONST, ExprType::INT, std::to_string(lanes - 1)));
+        Operand t = NewTemp(ExprType::BOOL);
+        EmitBinary(t, last, cond->ToString(), limit);
+        EmitJump(op, t, label);
+    };
+
+    // com o número de iterações conhecido, o primeiro grupo é certo e o laço
+    // escalar só é necessário se sobrarem iterações
+    CountedLoop counted;
+    bool known = loop->Counted(counted);
+    unsigned vector = NewLabel();
+    unsigned scalar = NewLabel();
+
+    loop->for_init->Gen();
+    limit = Operand(Rvalue(cond->expr2));
+    if (!known)
+        test(IR_IFFALSE, scalar);
+    EmitLabel(vector);
+    Vector(loop->stmt, var, lanes);
+    EmitBinary(counter, counter, "+", Operand(OPD_CONST, ExprType::INT, std::to_string(lanes)));
+    test(IR_IFTRUE, vector);
+    EmitLabel(scalar);
+    if (known && counted.trips % lanes == 0)
+        return true;
+
+    // laço escalar rotacionado para as iterações restantes
+    Jumping(loop->for_condition, 0, loop->after);
+    EmitLabel(loop->before);
+    loop->stmt->Gen();
+    loop->for_increment->Gen();
+    Jumping(loop->for_condition, loop->before, 0);
+    EmitLabel(loop->after);
+    return true;
+}
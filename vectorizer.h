@@ -0,0 +1,11 @@
+#ifndef COMPILER_VECTORIZER
+#define COMPILER_VECTORIZER
+
+#include "ast.h"
+
+// gera o laço 🧬 interno com operações vetoriais de lanes elementos, seguido
+// de um laço escalar para as iterações restantes; retorna falso, sem emitir
+// código, se o laço não puder ser vetorizado (com o motivo em report)
+bool Vectorize(For * loop, int lanes, bool report);
+
+#endif
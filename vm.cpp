@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <cstring>
+#include "vm.h"
+#include "tier.h"
+#include "pool.h"
+#include "error.h"
+using std::endl;
+
+// despacho por goto calculado quando o compilador oferece rótulos como
+// valores; -DVM_SWITCH força o despacho por switch
+#if defined(__GNUC__) && !defined(VM_SWITCH)
+#define VM_COMPUTED_GOTO
+#endif
+
+// -----
+// Array
+// -----
+
+static int ElementSize(int bank)
+{
+    if (bank == BANK_FLOAT)
+        return sizeof(double);
+    if (bank == BANK_BOOL)
+        return sizeof(uint8_t);
+    return sizeof(int32_t);
+}
+
+void Array::Allocate(const ArrayDecl & decl)
+{
+    size = decl.rows * decl.cols;
+    bank = decl.bank;
+    storage.reset(new uint64_t[1 + (size_t(size) * ElementSize(bank) + 7) / 8]());
+    int32_t * header = reinterpret_cast<int32_t *>(storage.get());
+    header[0] = size;
+    header[1] = ElementSize(bank);
+    data = storage.get() + 1;
+}
+
+// -------
+// Machine
+// -------
+
+Machine::Machine(Module & m, Tier * t) :
+    module(m),
+    tier(t),
+    ints(t ? 0 : m.globals[BANK_INT]),
+    floats(t ? 0 : m.globals[BANK_FLOAT]),
+    bools(t ? 0 : m.globals[BANK_BOOL]),
+    globalInts(t ? t->Ints() : ints.data()),
+    globalFloats(t ? t->Floats() : floats.data()),
+    globalBools(t ? t->Bools() : bools.data()),
+    arrays(m.globals[BANK_ARRAY]),
+    storage(m.arrays.size())
+{
+    // em camadas, as variáveis globais são as do código nativo
+    for (int i = 0; i < int(m.arrays.size()); ++i)
+    {
+        ArrayDecl & decl = m.arrays[i];
+        if (t)
+        {
+            storage[i].data = t->Global(decl.slot);
+            storage[i].size = decl.rows * decl.cols;
+            storage[i].bank = decl.bank;
+        }
+        else
+            storage[i].Allocate(decl);
+        arrays[decl.slot] = &storage[i];
+    }
+}
+
+Machine::Machine(Machine * p) :
+    module(p->module),
+    tier(nullptr),
+    globalInts(p->globalInts),
+    globalFloats(p->globalFloats),
+    globalBools(p->globalBools),
+    arrays(p->arrays),
+    parent(p)
+{
+
+}
+
+// ativações aninhadas do interpretador; cada uma ocupa a pilha do C++, e
+// a recursão mais funda termina com erro em vez de esgotá-la
+static const int MaxDepth = 10000;
+
+// conta a ativação enquanto ela executa
+struct Nesting
+{
+    int & depth;
+
+    Nesting(int & d) : depth(d) { ++depth; }
+    ~Nesting() { --depth; }
+};
+
+void Machine::Run()
+{
+    Execute(module.chunks[0]);
+}
+
+// registradores de uma ativação, indexados pelo espaço do operando
+struct Frame
+{
+    int32_t * i[3];
+    double * f[3];
+    uint8_t * b[3];
+    Array ** a[3];
+};
+
+#define RI(o) (frame.i[(o) >> SpaceShift][(o) & IndexMask])
+#define RF(o) (frame.f[(o) >> SpaceShift][(o) & IndexMask])
+#define RB(o) (frame.b[(o) >> SpaceShift][(o) & IndexMask])
+#define RA(o) (frame.a[(o) >> SpaceShift][(o) & IndexMask])
+
+// operandos das formas aceleradas: registradores locais e constantes
+#define LI(o) (li[o])
+#define LF(o) (lf[o])
+#define KI(o) (c.ints[(o) & IndexMask])
+
+// espaço comum a todos os operandos indicados
+#define LOCAL(o) (((o) >> SpaceShift) == SPACE_LOCAL)
+
+// índice linear das superinstruções de acesso: b * e + d
+#define INDEX(b, e, d) int32_t(uint32_t(RI(b)) * (e) + uint32_t(RI(d)))
+
+// elemento de um arranjo, com verificação dos limites
+template <typename T>
+static inline T & Element(Array * a, int32_t index)
+{
+    if (uint32_t(index) >= uint32_t(a->size))
+        throw RuntimeError{"índice " + std::to_string(index) + " fora dos limites do arranjo"};
+    return static_cast<T*>(a->data)[index];
+}
+
+Value Machine::Execute(Chunk & c)
+{
+    int index = int(&c - module.chunks.data());
+    Array * into = target;
+    Value v;
+
+    if (c.parallel && !parent)
+        return Fork(c);
+
+    // os argumentos são os últimos valores empilhados pelas instruções param
+    Value * first = args.data() + args.size() - c.params.size();
+    if (tier && tier->Enter(index, first, into, v))
+    {
+        args.resize(args.size() - c.params.size());
+        return v;
+    }
+
+    if (depth >= MaxDepth)
+        throw RuntimeError{"mais de " + std::to_string(MaxDepth) + " chamadas aninhadas"};
+    Nesting nesting(depth);
+
+    // registradores e arranjos próprios da ativação, zerados
+    vector<int32_t> li(c.regs[BANK_INT]);
+    vector<double> lf(c.regs[BANK_FLOAT]);
+    vector<uint8_t> lb(c.regs[BANK_BOOL]);
+    vector<Array *> la(c.regs[BANK_ARRAY]);
+    vector<Array> own(c.arrays.size());
+    for (int k = 0; k < int(c.arrays.size()); ++k)
+    {
+        own[k].Allocate(c.arrays[k]);
+        la[c.arrays[k].slot] = &own[k];
+    }
+
+    Frame frame =
+    {
+        {li.data(), globalInts, c.ints.data()},
+        {lf.data(), globalFloats, c.floats.data()},
+        {lb.data(), globalBools, c.bools.data()},
+        {la.data(), arrays.data(), nullptr}
+    };
+
+    for (int k = 0; k < int(c.params.size()); ++k)
+    {
+        uint32_t r = c.params[k].second;
+        switch (c.params[k].first)
+        {
+        case BANK_INT: li[r] = first[k].i; break;
+        case BANK_FLOAT: lf[r] = first[k].f; break;
+        case BANK_BOOL: lb[r] = first[k].b; break;
+        case BANK_ARRAY: la[r] = first[k].a; break;
+        }
+    }
+    args.resize(args.size() - c.params.size());
+
+    // o código é alterado pela aceleração das instruções na primeira execução
+    Instr * code = c.code.data();
+    Instr * pc = code;
+    Instr * source = nullptr;       // desvio para trás que levou ao laço
+
+#ifdef VM_COMPUTED_GOTO
+    static const void * labels[OP_COUNT] =
+    {
+#define OPCODE_LABEL(name) &&L_##name,
+        OPCODES(OPCODE_LABEL)
+#undef OPCODE_LABEL
+    };
+#define CASE(name) L_##name
+#define DISPATCH() goto *labels[pc->op]
+    DISPATCH();
+#else
+#define CASE(name) case OP_##name
+#define DISPATCH() goto dispatch
+dispatch:
+    switch (pc->op)
+    {
+#endif
+
+#define NEXT() ++pc; DISPATCH()
+
+// desvio tomado; na execução em camadas, os desvios para trás são contados
+// e podem levar ao código nativo do laço
+#define TAKEN() \
+    { \
+        source = pc; \
+        pc = code + pc->a; \
+        if (pc <= source && tier) \
+            goto backedge; \
+        DISPATCH(); \
+    }
+#define BINARY(name, R, W, op) CASE(name): W(pc->a) = R(pc->b) op R(pc->c); NEXT();
+#define WRAP(op) RI(pc->a) = int32_t(uint32_t(RI(pc->b)) op uint32_t(RI(pc->c)))
+
+// na primeira execução, a instrução genérica é trocada pela forma acelerada
+// que seus operandos permitem
+#define QUICKEN2(name) \
+    if (LOCAL(pc->a | pc->b)) { pc->op = OP_##name##_L; DISPATCH(); }
+#define QUICKEN3(name) \
+    if (LOCAL(pc->a | pc->b | pc->c)) { pc->op = OP_##name##_L; DISPATCH(); }
+#define QUICKEN3K(name) \
+    QUICKEN3(name) \
+    if (LOCAL(pc->a | pc->b) && (pc->c >> SpaceShift) == SPACE_CONST) { pc->op = OP_##name##_LK; DISPATCH(); }
+
+    CASE(HALT):
+        return Value{};
+
+    CASE(MOV_I): QUICKEN2(MOV_I) RI(pc->a) = RI(pc->b); NEXT();
+    CASE(MOV_F): QUICKEN2(MOV_F) RF(pc->a) = RF(pc->b); NEXT();
+    CASE(MOV_B): RB(pc->a) = RB(pc->b); NEXT();
+    CASE(I2F): RF(pc->a) = RI(pc->b); NEXT();
+    CASE(F2I): RI(pc->a) = int32_t(RF(pc->b)); NEXT();
+
+    // aritmética inteira de 32 bits, com estouro circular
+    CASE(ADD_I): QUICKEN3K(ADD_I) WRAP(+); NEXT();
+    CASE(SUB_I): QUICKEN3K(SUB_I) WRAP(-); NEXT();
+    CASE(MUL_I): QUICKEN3K(MUL_I) WRAP(*); NEXT();
+    CASE(DIV_I):
+        if (RI(pc->c) == 0)
+            throw RuntimeError{"divisão por zero"};
+        // -2^31 / -1 dá a volta, como as demais operações
+        if (RI(pc->c) == -1)
+            RI(pc->a) = int32_t(0u - uint32_t(RI(pc->b)));
+        else
+            RI(pc->a) = RI(pc->b) / RI(pc->c);
+        NEXT();
+    CASE(SHL_I): RI(pc->a) = int32_t(uint32_t(RI(pc->b)) << (RI(pc->c) & 31)); NEXT();
+    BINARY(SHR_I, RI, RI, >>)
+    BINARY(AND_I, RI, RI, &)
+    CASE(ADD_F): QUICKEN3(ADD_F) RF(pc->a) = RF(pc->b) + RF(pc->c); NEXT();
+    CASE(SUB_F): QUICKEN3(SUB_F) RF(pc->a) = RF(pc->b) - RF(pc->c); NEXT();
+    CASE(MUL_F): QUICKEN3(MUL_F) RF(pc->a) = RF(pc->b) * RF(pc->c); NEXT();
+    BINARY(DIV_F, RF, RF, /)
+    BINARY(AND_B, RB, RB, &&)
+    BINARY(OR_B, RB, RB, ||)
+    BINARY(LT_I, RI, RB, <)
+    BINARY(LE_I, RI, RB, <=)
+    BINARY(GT_I, RI, RB, >)
+    BINARY(GE_I, RI, RB, >=)
+    BINARY(EQ_I, RI, RB, ==)
+    BINARY(NE_I, RI, RB, !=)
+    BINARY(LT_F, RF, RB, <)
+    BINARY(LE_F, RF, RB, <=)
+    BINARY(GT_F, RF, RB, >)
+    BINARY(GE_F, RF, RB, >=)
+    BINARY(EQ_F, RF, RB, ==)
+    BINARY(NE_F, RF, RB, !=)
+    BINARY(EQ_B, RB, RB, ==)
+    BINARY(NE_B, RB, RB, !=)
+
+    CASE(NEG_I): RI(pc->a) = -RI(pc->b); NEXT();
+    CASE(NEG_F): RF(pc->a) = -RF(pc->b); NEXT();
+    CASE(NOT_B): RB(pc->a) = !RB(pc->b); NEXT();
+
+    CASE(LOAD_I): RI(pc->a) = Element<int32_t>(RA(pc->b), RI(pc->c) + pc->d); NEXT();
+    CASE(LOAD_F): RF(pc->a) = Element<double>(RA(pc->b), RI(pc->c) + pc->d); NEXT();
+    CASE(LOAD_B): RB(pc->a) = Element<uint8_t>(RA(pc->b), RI(pc->c) + pc->d); NEXT();
+    CASE(STORE_I): Element<int32_t>(RA(pc->a), RI(pc->b) + pc->d) = RI(pc->c); NEXT();
+    CASE(STORE_F): Element<double>(RA(pc->a), RI(pc->b) + pc->d) = RF(pc->c); NEXT();
+    CASE(STORE_B): Element<uint8_t>(RA(pc->a), RI(pc->b) + pc->d) = RB(pc->c); NEXT();
+
+    CASE(SEL_I): RI(pc->a) = RB(pc->b) ? RI(pc->c) : RI(pc->d); NEXT();
+    CASE(SEL_F): RF(pc->a) = RB(pc->b) ? RF(pc->c) : RF(pc->d); NEXT();
+    CASE(SEL_B): RB(pc->a) = RB(pc->b) ? RB(pc->c) : RB(pc->d); NEXT();
+
+    CASE(JMP):
+        TAKEN()
+    CASE(JF):
+        if (RB(pc->b)) { NEXT(); }
+        TAKEN()
+    CASE(JT):
+        if (!RB(pc->b)) { NEXT(); }
+        TAKEN()
+
+    CASE(PARAM_I): v.i = RI(pc->a); args.push_back(v); NEXT();
+    CASE(PARAM_F): v.f = RF(pc->a); args.push_back(v); NEXT();
+    CASE(PARAM_B): v.b = RB(pc->a); args.push_back(v); NEXT();
+    CASE(PARAM_A): v.a = RA(pc->a); args.push_back(v); NEXT();
+
+    CASE(CALL_I): RI(pc->a) = Execute(module.chunks[pc->b]).i; NEXT();
+    CASE(CALL_F): RF(pc->a) = Execute(module.chunks[pc->b]).f; NEXT();
+    CASE(CALL_B): RB(pc->a) = Execute(module.chunks[pc->b]).b; NEXT();
+    CASE(CALL_A):
+        // a função devolve o arranjo copiando-o para o destino
+        target = RA(pc->a);
+        Execute(module.chunks[pc->b]);
+        NEXT();
+
+    // operações vetoriais, um elemento por vez
+#define LANES(body) for (uint32_t k = 0; k < pc->e; ++k) { body; } NEXT();
+    CASE(VLOAD_I): LANES(LI(pc->a + k) = Element<int32_t>(RA(pc->b), RI(pc->c) + pc->d + k))
+    CASE(VLOAD_F): LANES(LF(pc->a + k) = Element<double>(RA(pc->b), RI(pc->c) + pc->d + k))
+    CASE(VSTORE_I): LANES(Element<int32_t>(RA(pc->a), RI(pc->b) + pc->d + k) = LI(pc->c + k))
+    CASE(VSTORE_F): LANES(Element<double>(RA(pc->a), RI(pc->b) + pc->d + k) = LF(pc->c + k))
+    CASE(VSPLAT_I): LANES(LI(pc->a + k) = RI(pc->b))
+    CASE(VSPLAT_F): LANES(LF(pc->a + k) = RF(pc->b))
+    CASE(VADD_I): LANES(LI(pc->a + k) = int32_t(uint32_t(LI(pc->b + k)) + uint32_t(LI(pc->c + k))))
+    CASE(VSUB_I): LANES(LI(pc->a + k) = int32_t(uint32_t(LI(pc->b + k)) - uint32_t(LI(pc->c + k))))
+    CASE(VMUL_I): LANES(LI(pc->a + k) = int32_t(uint32_t(LI(pc->b + k)) * uint32_t(LI(pc->c + k))))
+    CASE(VADD_F): LANES(LF(pc->a + k) = LF(pc->b + k) + LF(pc->c + k))
+    CASE(VSUB_F): LANES(LF(pc->a + k) = LF(pc->b + k) - LF(pc->c + k))
+    CASE(VMUL_F): LANES(LF(pc->a + k) = LF(pc->b + k) * LF(pc->c + k))
+    CASE(VDIV_F): LANES(LF(pc->a + k) = LF(pc->b + k) / LF(pc->c + k))
+
+    // superinstruções
+    CASE(LOADX_I): RI(pc->a) = Element<int32_t>(RA(pc->b), INDEX(pc->c, pc->e, pc->d)); NEXT();
+    CASE(LOADX_F): RF(pc->a) = Element<double>(RA(pc->b), INDEX(pc->c, pc->e, pc->d)); NEXT();
+    CASE(LOADX_B): RB(pc->a) = Element<uint8_t>(RA(pc->b), INDEX(pc->c, pc->e, pc->d)); NEXT();
+    CASE(STOREX_I): Element<int32_t>(RA(pc->a), INDEX(pc->b, pc->e, pc->d)) = RI(pc->c); NEXT();
+    CASE(STOREX_F): Element<double>(RA(pc->a), INDEX(pc->b, pc->e, pc->d)) = RF(pc->c); NEXT();
+    CASE(STOREX_B): Element<uint8_t>(RA(pc->a), INDEX(pc->b, pc->e, pc->d)) = RB(pc->c); NEXT();
+
+#define JUMP(name, op) CASE(name): if (!(RI(pc->b) op RI(pc->c))) { NEXT(); } TAKEN()
+    JUMP(JLT_I, <)
+    JUMP(JLE_I, <=)
+    JUMP(JGT_I, >)
+    JUMP(JGE_I, >=)
+    JUMP(JEQ_I, ==)
+    JUMP(JNE_I, !=)
+
+#define LOOP(name, op) CASE(name): \
+        RI(pc->b) = int32_t(uint32_t(RI(pc->b)) + uint32_t(RI(pc->c))); \
+        if (!(RI(pc->b) op RI(pc->d))) { NEXT(); } \
+        TAKEN()
+    LOOP(LOOPLT_I, <)
+    LOOP(LOOPNE_I, !=)
+
+    // formas aceleradas
+    CASE(MOV_I_L): LI(pc->a) = LI(pc->b); NEXT();
+    CASE(MOV_F_L): LF(pc->a) = LF(pc->b); NEXT();
+    CASE(ADD_I_L): LI(pc->a) = int32_t(uint32_t(LI(pc->b)) + uint32_t(LI(pc->c))); NEXT();
+    CASE(SUB_I_L): LI(pc->a) = int32_t(uint32_t(LI(pc->b)) - uint32_t(LI(pc->c))); NEXT();
+    CASE(MUL_I_L): LI(pc->a) = int32_t(uint32_t(LI(pc->b)) * uint32_t(LI(pc->c))); NEXT();
+    CASE(ADD_I_LK): LI(pc->a) = int32_t(uint32_t(LI(pc->b)) + uint32_t(KI(pc->c))); NEXT();
+    CASE(SUB_I_LK): LI(pc->a) = int32_t(uint32_t(LI(pc->b)) - uint32_t(KI(pc->c))); NEXT();
+    CASE(MUL_I_LK): LI(pc->a) = int32_t(uint32_t(LI(pc->b)) * uint32_t(KI(pc->c))); NEXT();
+    CASE(ADD_F_L): LF(pc->a) = LF(pc->b) + LF(pc->c); NEXT();
+    CASE(SUB_F_L): LF(pc->a) = LF(pc->b) - LF(pc->c); NEXT();
+    CASE(MUL_F_L): LF(pc->a) = LF(pc->b) * LF(pc->c); NEXT();
+
+    CASE(RET_I): v.i = RI(pc->a); return v;
+    CASE(RET_F): v.f = RF(pc->a); return v;
+    CASE(RET_B): v.b = RB(pc->a); return v;
+    CASE(RET_A):
+    {
+        // copia para o arranjo do chamador os elementos que cabem nele
+        Array * src = RA(pc->a);
+        int32_t n = std::min(into->size, src->size);
+        memmove(into->data, src->data, size_t(n) * ElementSize(src->bank));
+        return Value{};
+    }
+
+    // o laço continua no código nativo quando ele já está pronto
+backedge:
+    if (tier->Loop(index, int(source - code), int(pc - code), Locals{li.data(), lf.data(), lb.data(), la.data()}, into, v))
+        return v;
+    DISPATCH();
+
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+#undef BINARY
+#undef WRAP
+#undef QUICKEN2
+#undef QUICKEN3
+#undef QUICKEN3K
+#undef LANES
+#undef JUMP
+#undef LOOP
+#undef TAKEN
+#undef NEXT
+#undef DISPATCH
+#undef CASE
+    return Value{};
+}
+
+// formas aceleradas de todas as instruções, como na primeira execução de
+// cada uma: as threads de um laço 🧵 executam o mesmo código, que deixa de
+// ser alterado
+static void Quicken(Chunk & c)
+{
+    for (Instr & i : c.code)
+    {
+        switch (i.op)
+        {
+        case OP_MOV_I:
+        case OP_MOV_F:
+            if (LOCAL(i.a | i.b))
+                i.op = (i.op == OP_MOV_I) ? OP_MOV_I_L : OP_MOV_F_L;
+            break;
+        case OP_ADD_I:
+        case OP_SUB_I:
+        case OP_MUL_I:
+            if (LOCAL(i.a | i.b | i.c))
+                i.op = (i.op == OP_ADD_I) ? OP_ADD_I_L : (i.op == OP_SUB_I) ? OP_SUB_I_L : OP_MUL_I_L;
+            else if (LOCAL(i.a | i.b) && (i.c >> SpaceShift) == SPACE_CONST)
+                i.op = (i.op == OP_ADD_I) ? OP_ADD_I_LK : (i.op == OP_SUB_I) ? OP_SUB_I_LK : OP_MUL_I_LK;
+            break;
+        case OP_ADD_F:
+        case OP_SUB_F:
+        case OP_MUL_F:
+            if (LOCAL(i.a | i.b | i.c))
+                i.op = (i.op == OP_ADD_F) ? OP_ADD_F_L : (i.op == OP_SUB_F) ? OP_SUB_F_L : OP_MUL_F_L;
+            break;
+        }
+    }
+}
+
+// laço 🧵: os argumentos trazem a faixa inteira de iterações, e cada bloco
+// executa numa máquina da sua thread; em camadas, os blocos usam o código
+// nativo da função quando ele já existe
+Value Machine::Fork(Chunk & c)
+{
+    int index = int(&c - module.chunks.data());
+    vector<Value> shared(args.end() - c.params.size(), args.end());
+    args.resize(args.size() - c.params.size());
+    if (tier)
+        tier->Count(index);
+    if (!quickened)
+    {
+        for (Chunk & k : module.chunks)
+            Quicken(k);
+        quickened = true;
+    }
+
+    int end = shared[1].i;
+    int last = shared[2].i;
+    vector<std::unique_ptr<Machine>> workers(Threads());
+    RunParallel(shared[0].i, end, [&](int thread, int first, int stop)
+    {
+        vector<Value> range = shared;
+        range[0].i = first;
+        range[1].i = stop;
+        range[2].i = (stop == end) ? last : 0;
+        Value v;
+        if (tier && tier->Call(index, range.data(), nullptr, v))
+            return;
+
+        if (!workers[thread])
+            workers[thread].reset(new Machine(this));
+        Machine & m = *workers[thread];
+        m.args.insert(m.args.end(), range.begin(), range.end());
+        m.Execute(c);
+    });
+    Value v;
+    v.i = end;
+    return v;
+}
+
+// estado final: escalares e arranjos globais declarados no programa; nomes
+// com '_' foram criados pelo compilador
+void Machine::Print(std::ostream & out)
+{
+    vector<void *> data(arrays.size(), nullptr);
+    for (int k = 0; k < int(arrays.size()); ++k)
+    {
+        if (arrays[k])
+            data[k] = arrays[k]->data;
+    }
+    PrintGlobals(module, out, globalInts, globalFloats, globalBools, data);
+}
+
+void PrintGlobals(Module & m, std::ostream & out, const int32_t * ints, const double * floats,
+                  const uint8_t * bools, const vector<void *> & arrays)
+{
+    for (GlobalDecl & g : m.vars)
+    {
+        if (g.name.find('_') != string::npos)
+            continue;
+
+        out << g.name << " = ";
+        if (g.bank == BANK_INT)
+            out << ints[g.slot];
+        else if (g.bank == BANK_FLOAT)
+            out << floats[g.slot];
+        else
+            out << (bools[g.slot] ? "true" : "false");
+        out << endl;
+    }
+
+    for (ArrayDecl & d : m.arrays)
+    {
+        if (d.name.find('_') != string::npos)
+            continue;
+
+        void * data = arrays[d.slot];
+        out << d.name << " =" << endl;
+        for (int r = 0; r < d.rows; ++r)
+        {
+            out << '\t';
+            for (int k = 0; k < d.cols; ++k)
+            {
+                int index = r * d.cols + k;
+                if (k > 0)
+                    out << ' ';
+                if (d.bank == BANK_INT)
+                    out << static_cast<int32_t*>(data)[index];
+                else if (d.bank == BANK_FLOAT)
+                    out << static_cast<double*>(data)[index];
+                else
+                    out << (static_cast<uint8_t*>(data)[index] ? "true" : "false");
+            }
+            out << endl;
+        }
+    }
+}
+
+void Run(Program * p)
+{
+    Module module = Lower(p);
+    Machine machine(module);
+    machine.Run();
+    machine.Print(std::cout);
+}
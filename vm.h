@@ -0,0 +1,74 @@
+#ifndef COMPILER_VM
+#define COMPILER_VM
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include "bytecode.h"
+
+// arranjo contíguo, em ordem de linhas; parâmetros apontam para o arranjo
+// do chamador; como no código nativo, os elementos são precedidos pelo
+// número de elementos e pelo tamanho de cada um
+struct Array
+{
+    void * data;
+    int32_t size;
+    int bank;
+    std::unique_ptr<uint64_t[]> storage;
+
+    void Allocate(const ArrayDecl & decl);
+};
+
+// argumento ou valor devolvido por uma função
+union Value
+{
+    int32_t i;
+    double f;
+    uint8_t b;
+    Array * a;
+};
+
+class Tier;
+
+// máquina virtual de registradores: cada ativação tem um banco por tipo, e
+// os operandos escolhem entre os registradores locais, os globais e as
+// constantes da função
+class Machine
+{
+private:
+    Module & module;
+    Tier * tier;                    // execução em camadas, quando presente
+    vector<int32_t> ints;           // registradores globais
+    vector<double> floats;
+    vector<uint8_t> bools;
+    int32_t * globalInts;           // os vetores acima ou, em camadas, os dados do código nativo
+    double * globalFloats;
+    uint8_t * globalBools;
+    vector<Array *> arrays;
+    vector<Array> storage;
+    vector<Value> args;             // argumentos das instruções param
+    Array * target = nullptr;       // destino do arranjo devolvido pela próxima chamada
+    Machine * parent = nullptr;     // máquina que dividiu um laço 🧵 entre as threads
+    bool quickened = false;         // todas as funções aceleradas antes da primeira divisão
+    int depth = 0;                  // ativações interpretadas em curso, na pilha do C++
+
+    // máquina de uma thread de laço 🧵, com as variáveis globais da original
+    Machine(Machine * p);
+    Value Execute(Chunk & c);
+    Value Fork(Chunk & c);
+
+public:
+    Machine(Module & m, Tier * t = nullptr);
+    void Run();
+    void Print(std::ostream & out);
+};
+
+// estado final das variáveis globais declaradas (nomes com '_' foram
+// criados pelo compilador); arrays traz os elementos de cada arranjo global
+void PrintGlobals(Module & m, std::ostream & out, const int32_t * ints, const double * floats,
+                  const uint8_t * bools, const vector<void *> & arrays);
+
+// executa o programa e exibe o estado final das variáveis globais
+void Run(Program * p);
+
+#endif
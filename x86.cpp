@@ -0,0 +1,1412 @@
+#include "regalloc.h"
+#include "error.h"
+
+const char * BoundsRoutine = "tr_bounds";
+const char * DivZeroRoutine = "tr_divzero";
+const char * ParallelRoutine = "tr_parallel";
+
+// --------
+// Operands
+// --------
+
+MOperand RegOp(int r)
+{
+    MOperand o;
+    o.kind = MOperand::REG;
+    o.reg = r;
+    return o;
+}
+
+MOperand ImmOp(int64_t v)
+{
+    MOperand o;
+    o.kind = MOperand::IMM;
+    o.imm = v;
+    return o;
+}
+
+MOperand MemOp(int base, int64_t disp, int index, int scale)
+{
+    MOperand o;
+    o.kind = MOperand::MEM;
+    o.reg = base;
+    o.imm = disp;
+    o.index = index;
+    o.scale = scale;
+    return o;
+}
+
+MOperand SymOp(const string & symbol, int64_t disp)
+{
+    MOperand o;
+    o.kind = MOperand::MEM;
+    o.symbol = symbol;
+    o.imm = disp;
+    return o;
+}
+
+MOperand LabelOp(int label)
+{
+    MOperand o;
+    o.kind = MOperand::LABEL;
+    o.imm = label;
+    return o;
+}
+
+MOperand CallOp(const string & symbol)
+{
+    MOperand o;
+    o.kind = MOperand::SYMBOL;
+    o.symbol = symbol;
+    return o;
+}
+
+// -------
+// Symbols
+// -------
+
+string FunctionSymbol(Module & m, int chunk)
+{
+    if (chunk == 0)
+        return "tr_main";
+    return "fn_" + m.chunks[chunk].name;
+}
+
+string GlobalSymbol(int bank, uint32_t slot)
+{
+    static const char * prefix[BANK_COUNT] = {".Lgi", ".Lgf", ".Lgb", ".Lga"};
+    return prefix[bank] + std::to_string(slot);
+}
+
+string ConstSymbol(int chunk, uint32_t index)
+{
+    return ".Lk" + std::to_string(chunk) + "_" + std::to_string(index);
+}
+
+string LoopSymbol(int chunk, int pc)
+{
+    return ".Lloop" + std::to_string(chunk) + "_" + std::to_string(pc);
+}
+
+string BridgeSymbol(int chunk)
+{
+    return ".Lbridge" + std::to_string(chunk);
+}
+
+int ElementBytes(int bank)
+{
+    if (bank == BANK_FLOAT)
+        return 8;
+    if (bank == BANK_BOOL)
+        return 1;
+    return 4;
+}
+
+static int Round(int n, int to)
+{
+    return (n + to - 1) / to * to;
+}
+
+// parte de um vetor movida por vez: 16 bytes e, no fim, 8 ou 4
+static int Piece(int remaining)
+{
+    return remaining >= 16 ? 16 : remaining >= 8 ? 8 : 4;
+}
+
+// registradores dos argumentos (System V)
+static const int IntArgs[] = {RDI, RSI, RDX, RCX, R8, R9};
+static const int FloatArgs[] = {XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7};
+
+// posição de cada argumento: registrador ou, quando faltam registradores,
+// índice na pilha (stack recebe o número de argumentos na pilha); arranjos
+// devolvidos são escritos no endereço recebido como primeiro argumento
+struct ArgPlace
+{
+    int reg;
+    int stack;
+};
+
+static vector<ArgPlace> Classify(const vector<int> & banks, bool hidden, int & stack)
+{
+    vector<ArgPlace> places;
+    int ints = hidden ? 1 : 0;
+    int floats = 0;
+    stack = 0;
+    for (int bank : banks)
+    {
+        if (bank == BANK_FLOAT && floats < 8)
+            places.push_back({FloatArgs[floats++], -1});
+        else if (bank != BANK_FLOAT && ints < 6)
+            places.push_back({IntArgs[ints++], -1});
+        else
+            places.push_back({NOREG, stack++});
+    }
+    return places;
+}
+
+// movimento de um valor entre registradores, posições no quadro e
+// argumentos; address indica que a fonte é um endereço (lea)
+struct Move
+{
+    MOperand dst;
+    MOperand src;
+    int bank;
+    bool address;
+};
+
+// trecho com os movimentos de uma aresta tomada, no fim da função
+struct Stub
+{
+    int label;
+    int from;
+    int to;
+};
+
+static bool Same(const MOperand & a, const MOperand & b)
+{
+    return a.IsReg() && b.IsReg() && a.reg == b.reg;
+}
+
+// --------
+// Selector
+// --------
+
+// tradução de uma função da máquina virtual: os registradores locais ficam
+// nos registradores escolhidos pela alocação ou, quando derramados, no
+// quadro da ativação; rax, rcx, rdx, r11, xmm14 e xmm15 são auxiliares das
+// instruções
+class Selector
+{
+private:
+    Module & module;
+    Chunk & chunk;
+    Allocation alloc;
+    MFunction func;
+    vector<int> slots[BANK_COUNT];  // deslocamento dos registradores derramados
+    vector<int> saves;              // deslocamento dos não voláteis salvos
+    vector<int> arrays;             // deslocamento dos arranjos próprios
+    int hidden = 0;                 // endereço do arranjo devolvido
+    int frame = 0;
+    int pc = 0;
+    vector<Instr> params;
+    int bounds = -1;                // rótulos das rotinas de erro
+    int divzero = -1;
+    vector<Stub> stubs;             // movimentos dos desvios tomados
+    bool loops;                     // entradas dos laços para o interpretador
+
+    void Emit(int op, int size, MOperand dst = MOperand(), MOperand src = MOperand(), int cond = 0);
+    int Label();
+    MOperand Place(int vreg, int reg);
+    MOperand Operand(uint32_t ref, int bank, int pos);
+    MOperand Value(uint32_t ref, int bank);
+    MOperand Target(uint32_t ref, int bank);
+    void Load(int reg, uint32_t ref, int bank);
+    void Store(uint32_t ref, int bank, int reg);
+    void Bits(int reg, uint32_t ref);
+    void StoreBits(uint32_t ref, int reg);
+    int Base(uint32_t ref, int scratch = R11);
+    Move Argument(MOperand dst, uint32_t ref, int bank);
+    void Copy(const Move & m);
+    void Parallel(vector<Move> moves);
+    void Transfers(const vector<Transfer> & transfers);
+    int Edge(int target);
+    void Check(int base, int index);
+    void CheckLanes(int base, int lanes);
+    MOperand Element(int base, int index, int bank);
+    MOperand Lanes(uint32_t ref, int bank, int offset);
+    void Packed(MOperand dst, MOperand src, int size);
+    void Layout();
+    void Frame();
+    void Prologue();
+    void Entry(int target, const vector<int> & live);
+    void Epilogue();
+    void Binary(int op, int bank, const Instr & i, bool commutes);
+    void Index(const Instr & i, uint32_t index, bool scaled);
+    void CompareInt(const Instr & i);
+    void Compare(int cond, const Instr & i);
+    void CompareFloat(const Instr & i);
+    void Call(const Instr & i);
+    void Fork(const Instr & i, const vector<Instr> & args);
+    void Return(const Instr & i);
+    void Vector(const Instr & i);
+    void Translate(const Instr & i);
+
+public:
+    Selector(Module & m, int index, bool entries);
+    MFunction Run();
+};
+
+Selector::Selector(Module & m, int index, bool entries) :
+    module(m),
+    chunk(m.chunks[index]),
+    alloc(Allocate(m.chunks[index])),
+    loops(entries)
+{
+    func.name = FunctionSymbol(m, index);
+    func.chunk = index;
+    func.labels = chunk.code.size();
+}
+
+void Selector::Emit(int op, int size, MOperand dst, MOperand src, int cond)
+{
+    func.code.push_back(MInstr{op, size, cond, dst, src});
+}
+
+// rótulos 0..code.size()-1 marcam as instruções da máquina virtual
+int Selector::Label()
+{
+    return func.labels++;
+}
+
+// registrador físico ou posição no quadro (NOREG)
+MOperand Selector::Place(int vreg, int reg)
+{
+    if (reg != NOREG)
+        return RegOp(reg);
+    return MemOp(RBP, slots[alloc.Bank(vreg)][alloc.Ref(vreg) & IndexMask]);
+}
+
+// operando em registrador, na memória ou imediato; as divisões dos
+// intervalos caem sempre entre instruções, então a leitura e a escrita de
+// uma instrução veem o registrador virtual no mesmo lugar
+MOperand Selector::Operand(uint32_t ref, int bank, int pos)
+{
+    uint32_t index = ref & IndexMask;
+    switch (ref >> SpaceShift)
+    {
+    case SPACE_LOCAL:
+    {
+        int vreg = alloc.Vreg(ref, bank);
+        return Place(vreg, alloc.Where(vreg, pos));
+    }
+    case SPACE_GLOBAL:
+        return SymOp(GlobalSymbol(bank, index));
+    }
+    if (bank == BANK_FLOAT)
+        return SymOp(ConstSymbol(func.chunk, index));
+    if (bank == BANK_BOOL)
+        return ImmOp(chunk.bools[index]);
+    return ImmOp(chunk.ints[index]);
+}
+
+MOperand Selector::Value(uint32_t ref, int bank)
+{
+    return Operand(ref, bank, UsePos(pc));
+}
+
+MOperand Selector::Target(uint32_t ref, int bank)
+{
+    return Operand(ref, bank, DefPos(pc));
+}
+
+void Selector::Load(int reg, uint32_t ref, int bank)
+{
+    MOperand v = Value(ref, bank);
+    if (Same(v, RegOp(reg)))
+        return;
+    if (bank == BANK_FLOAT)
+        Emit(M_MOVSD, 8, RegOp(reg), v);
+    else if (bank == BANK_BOOL && !v.IsImm())
+        Emit(M_MOVZX, 4, RegOp(reg), v);
+    else
+        Emit(M_MOV, 4, RegOp(reg), v);
+}
+
+void Selector::Store(uint32_t ref, int bank, int reg)
+{
+    MOperand v = Target(ref, bank);
+    if (Same(v, RegOp(reg)))
+        return;
+    if (bank == BANK_FLOAT)
+        Emit(M_MOVSD, 8, v, RegOp(reg));
+    else
+        Emit(M_MOV, bank == BANK_BOOL ? 1 : 4, v, RegOp(reg));
+}
+
+// bits de um real em um registrador geral
+void Selector::Bits(int reg, uint32_t ref)
+{
+    MOperand v = Value(ref, BANK_FLOAT);
+    Emit(v.IsReg() ? M_MOVQ : M_MOV, 8, RegOp(reg), v);
+}
+
+void Selector::StoreBits(uint32_t ref, int reg)
+{
+    MOperand v = Target(ref, BANK_FLOAT);
+    Emit(v.IsReg() ? M_MOVQ : M_MOV, 8, v, RegOp(reg));
+}
+
+// registrador com o endereço do primeiro elemento de um arranjo
+int Selector::Base(uint32_t ref, int scratch)
+{
+    if ((ref >> SpaceShift) == SPACE_GLOBAL)
+    {
+        Emit(M_LEA, 8, RegOp(scratch), SymOp(GlobalSymbol(BANK_ARRAY, ref & IndexMask)));
+        return scratch;
+    }
+    MOperand v = Value(ref, BANK_ARRAY);
+    if (v.IsReg())
+        return v.reg;
+    Emit(M_MOV, 8, RegOp(scratch), v);
+    return scratch;
+}
+
+Move Selector::Argument(MOperand dst, uint32_t ref, int bank)
+{
+    if (bank == BANK_ARRAY && (ref >> SpaceShift) == SPACE_GLOBAL)
+        return Move{dst, SymOp(GlobalSymbol(BANK_ARRAY, ref & IndexMask)), bank, true};
+    return Move{dst, Value(ref, bank), bank, false};
+}
+
+// um movimento; de memória para memória passa por r11 ou xmm14
+void Selector::Copy(const Move & m)
+{
+    if (m.dst.IsMem() && (m.src.IsMem() || m.address))
+    {
+        int scratch = (m.bank == BANK_FLOAT) ? XMM14 : R11;
+        Copy(Move{RegOp(scratch), m.src, m.bank, m.address});
+        Copy(Move{m.dst, RegOp(scratch), m.bank, false});
+        return;
+    }
+    if (m.address)
+        Emit(M_LEA, 8, m.dst, m.src);
+    else if (m.src.IsImm())
+        Emit(M_MOV, m.bank == BANK_BOOL ? 1 : 4, m.dst, m.src);
+    else if (m.bank == BANK_FLOAT)
+        Emit(M_MOVSD, 8, m.dst, m.src);
+    else if (m.src.IsMem() && m.bank == BANK_BOOL)
+        Emit(M_MOVZX, 4, m.dst, m.src);
+    else if (m.src.IsMem() && m.bank == BANK_INT)
+        Emit(M_MOV, 4, m.dst, m.src);
+    else
+        Emit(M_MOV, 8, m.dst, m.src);
+}
+
+// movimentos simultâneos: cada um sai quando nenhum outro ainda lê o seu
+// destino; os ciclos restantes são quebrados com rax ou xmm15
+void Selector::Parallel(vector<Move> moves)
+{
+    for (size_t k = 0; k < moves.size();)
+    {
+        if (!moves[k].address && Same(moves[k].dst, moves[k].src))
+            moves.erase(moves.begin() + k);
+        else
+            ++k;
+    }
+
+    while (!moves.empty())
+    {
+        bool progress = false;
+        for (size_t k = 0; k < moves.size() && !progress; ++k)
+        {
+            bool read = false;
+            for (size_t j = 0; j < moves.size() && !read; ++j)
+                read = (j != k && !moves[j].address && Same(moves[j].src, moves[k].dst));
+            if (read)
+                continue;
+            Copy(moves[k]);
+            moves.erase(moves.begin() + k);
+            progress = true;
+        }
+        if (progress)
+            continue;
+
+        Move & m = moves.front();
+        MOperand temp = RegOp(m.bank == BANK_FLOAT ? XMM15 : RAX);
+        Copy(Move{temp, m.dst, m.bank, false});
+        MOperand freed = m.dst;
+        for (Move & other : moves)
+        {
+            if (!other.address && Same(other.src, freed))
+                other.src = temp;
+        }
+    }
+}
+
+void Selector::Transfers(const vector<Transfer> & transfers)
+{
+    vector<Move> moves;
+    for (const Transfer & t : transfers)
+        moves.push_back(Move{Place(t.vreg, t.to), Place(t.vreg, t.from), alloc.Bank(t.vreg), false});
+    Parallel(moves);
+}
+
+// rótulo de um desvio da instrução atual: quando a aresta precisa de
+// movimentos, eles ficam em um trecho no fim da função que segue para o alvo
+int Selector::Edge(int target)
+{
+    if (!alloc.edges.count({pc, target}))
+        return target;
+    int label = Label();
+    stubs.push_back(Stub{label, pc, target});
+    return label;
+}
+
+// índice comparado ao número de elementos, sem sinal: negativos também
+// ficam fora dos limites
+void Selector::Check(int base, int index)
+{
+    if (bounds < 0)
+        bounds = Label();
+    Emit(M_CMP, 4, RegOp(index), MemOp(base, -ArrayHeader));
+    Emit(M_JCC, 0, LabelOp(bounds), MOperand(), CC_AE);
+}
+
+// índices rax .. rax + lanes - 1; na falha, rax recebe o primeiro índice
+// inválido, como no acesso elemento a elemento
+void Selector::CheckLanes(int base, int lanes)
+{
+    Check(base, RAX);
+    if (lanes == 1)
+        return;
+    Emit(M_MOV, 4, RegOp(RCX), MemOp(base, -ArrayHeader));
+    Emit(M_LEA, 8, RegOp(RDX), MemOp(RAX, lanes - 1));
+    Emit(M_CMP, 4, RegOp(RDX), RegOp(RCX));
+    Emit(M_CMOV, 4, RegOp(RAX), RegOp(RCX), CC_AE);
+    Emit(M_JCC, 0, LabelOp(bounds), MOperand(), CC_AE);
+}
+
+MOperand Selector::Element(int base, int index, int bank)
+{
+    return MemOp(base, 0, index, ElementBytes(bank));
+}
+
+// bytes a partir de offset dos elementos de um vetor, consecutivos no quadro
+MOperand Selector::Lanes(uint32_t ref, int bank, int offset)
+{
+    return MemOp(RBP, slots[bank][ref & IndexMask] + offset);
+}
+
+// movimento de uma parte de vetor entre xmm e a memória
+void Selector::Packed(MOperand dst, MOperand src, int size)
+{
+    if (size == 16)
+        Emit(M_MOVDQU, 16, dst, src);
+    else if (size == 8)
+        Emit(M_MOVSD, 8, dst, src);
+    else
+        Emit(M_MOVQ, 4, dst, src);
+}
+
+// quadro: registradores derramados, vetores (elementos consecutivos, do
+// tamanho dos elementos dos arranjos), não voláteis salvos, endereço do
+// arranjo devolvido e arranjos próprios, com os elementos alinhados em 16
+// bytes
+void Selector::Layout()
+{
+    int size = 0;
+    vector<bool> lane(alloc.Count(), false);
+    for (auto & v : alloc.vectors)
+    {
+        for (int k = 0; k < v.second; ++k)
+            lane[v.first + k] = true;
+    }
+    for (int bank = 0; bank < BANK_COUNT; ++bank)
+        slots[bank].assign(chunk.regs[bank], 0);
+    for (int v = 0; v < alloc.Count(); ++v)
+    {
+        if (!alloc.spilled[v] || lane[v])
+            continue;
+        size += 8;
+        slots[alloc.Bank(v)][alloc.Ref(v) & IndexMask] = -size;
+    }
+    for (auto & v : alloc.vectors)
+    {
+        int bank = alloc.Bank(v.first);
+        int bytes = ElementBytes(bank);
+        size = Round(size + v.second * bytes, 8);
+        uint32_t first = alloc.Ref(v.first) & IndexMask;
+        for (int k = 0; k < v.second; ++k)
+            slots[bank][first + k] = -size + k * bytes;
+    }
+    for (size_t k = 0; k < alloc.saved.size(); ++k)
+    {
+        size += 8;
+        saves.push_back(-size);
+    }
+    if (chunk.ret == BANK_ARRAY)
+    {
+        size += 8;
+        hidden = -size;
+    }
+    for (ArrayDecl & a : chunk.arrays)
+    {
+        size = Round(size + Round(a.rows * a.cols * ElementBytes(a.bank), 8), 16);
+        arrays.push_back(-size);
+        size += 16;
+    }
+    frame = Round(size, 16);
+}
+
+// quadro zerado, não voláteis salvos e cabeçalho dos arranjos próprios;
+// preserva rdi
+void Selector::Frame()
+{
+    Emit(M_PUSH, 8, RegOp(RBP));
+    Emit(M_MOV, 8, RegOp(RBP), RegOp(RSP));
+    if (frame > 0)
+        Emit(M_SUB, 8, RegOp(RSP), ImmOp(frame));
+
+    // a máquina virtual inicia registradores e arranjos com zero
+    if (frame > 0 && frame <= 128)
+    {
+        for (int offset = 0; offset < frame; offset += 8)
+            Emit(M_MOV, 8, MemOp(RSP, offset), ImmOp(0));
+    }
+    else if (frame > 0)
+    {
+        int loop = Label();
+        Emit(M_MOV, 8, RegOp(R11), ImmOp(frame / 8));
+        Emit(M_LABEL, 0, LabelOp(loop));
+        Emit(M_MOV, 8, MemOp(RSP, -8, R11, 8), ImmOp(0));
+        Emit(M_SUB, 8, RegOp(R11), ImmOp(1));
+        Emit(M_JCC, 0, LabelOp(loop), MOperand(), CC_NE);
+    }
+    for (size_t k = 0; k < alloc.saved.size(); ++k)
+        Emit(M_MOV, 8, MemOp(RBP, saves[k]), RegOp(alloc.saved[k]));
+    for (int k = 0; k < int(chunk.arrays.size()); ++k)
+    {
+        ArrayDecl & a = chunk.arrays[k];
+        Emit(M_MOV, 4, MemOp(RBP, arrays[k] - ArrayHeader), ImmOp(a.rows * a.cols));
+        Emit(M_MOV, 4, MemOp(RBP, arrays[k] - ArrayHeader + 4), ImmOp(ElementBytes(a.bank)));
+    }
+}
+
+void Selector::Prologue()
+{
+    Frame();
+
+    // valores iniciais dos registradores vivos na entrada: argumentos
+    // recebidos em registradores ou na pilha, endereço dos arranjos próprios
+    // e zero para os demais
+    vector<bool> entry(alloc.Count(), false);
+    for (int v : alloc.entry)
+        entry[v] = true;
+
+    vector<int> banks;
+    for (auto & p : chunk.params)
+        banks.push_back(p.first);
+    int stack;
+    vector<ArgPlace> places = Classify(banks, chunk.ret == BANK_ARRAY, stack);
+    vector<Move> moves;
+    if (chunk.ret == BANK_ARRAY)
+        moves.push_back(Move{MemOp(RBP, hidden), RegOp(RDI), BANK_ARRAY, false});
+    for (int k = 0; k < int(places.size()); ++k)
+    {
+        int vreg = alloc.Vreg(Ref(SPACE_LOCAL, chunk.params[k].second), banks[k]);
+        if (!entry[vreg])
+            continue;
+        entry[vreg] = false;
+        MOperand incoming = places[k].reg != NOREG ? RegOp(places[k].reg) : MemOp(RBP, 16 + 8 * places[k].stack);
+        moves.push_back(Move{Place(vreg, alloc.Where(vreg, 0)), incoming, banks[k], false});
+    }
+    Parallel(moves);
+
+    // endereço dos arranjos próprios
+    for (int k = 0; k < int(chunk.arrays.size()); ++k)
+    {
+        int vreg = alloc.Vreg(Ref(SPACE_LOCAL, chunk.arrays[k].slot), BANK_ARRAY);
+        if (!entry[vreg])
+            continue;
+        entry[vreg] = false;
+        Copy(Move{Place(vreg, alloc.Where(vreg, 0)), MemOp(RBP, arrays[k]), BANK_ARRAY, true});
+    }
+
+    bool zero = false;
+    for (int v : alloc.entry)
+    {
+        int reg = alloc.Where(v, 0);
+        if (!entry[v] || reg == NOREG)
+            continue;
+        if (reg < XMM0)
+            Emit(M_MOV, 4, RegOp(reg), ImmOp(0));
+        else
+        {
+            if (!zero)
+                Emit(M_XOR, 4, RegOp(RAX), RegOp(RAX));
+            zero = true;
+            Emit(M_MOVQ, 8, RegOp(reg), RegOp(RAX));
+        }
+    }
+}
+
+// entrada de um laço: os arranjos próprios recebem os elementos da ativação
+// interpretada, e os registradores vivos no início do laço, os seus valores
+void Selector::Entry(int target, const vector<int> & live)
+{
+    int label = Label();
+    func.entries.push_back({LoopSymbol(func.chunk, target), label});
+    Emit(M_LABEL, 0, LabelOp(label));
+    Frame();
+
+    // o endereço do estado fica na pilha durante as cópias
+    Emit(M_PUSH, 8, RegOp(RDI));
+    Emit(M_SUB, 8, RegOp(RSP), ImmOp(8));
+    vector<int> own(alloc.Count(), -1);
+    for (int k = 0; k < int(chunk.arrays.size()); ++k)
+    {
+        ArrayDecl & a = chunk.arrays[k];
+        int vreg = alloc.Vreg(Ref(SPACE_LOCAL, a.slot), BANK_ARRAY);
+        own[vreg] = k;
+        Emit(M_MOV, 8, RegOp(RSI), MemOp(RDI, 8 * vreg));
+        Emit(M_LEA, 8, RegOp(RDI), MemOp(RBP, arrays[k]));
+        Emit(M_MOV, 4, RegOp(RDX), ImmOp(a.rows * a.cols * ElementBytes(a.bank)));
+        Emit(M_CALL, 8, CallOp("memmove"));
+        Emit(M_MOV, 8, RegOp(RDI), MemOp(RSP, 8));
+    }
+    Emit(M_ADD, 8, RegOp(RSP), ImmOp(8));
+    Emit(M_POP, 8, RegOp(RAX));
+    if (chunk.ret == BANK_ARRAY)
+    {
+        Emit(M_MOV, 8, RegOp(R11), MemOp(RAX, 8 * alloc.Count()));
+        Emit(M_MOV, 8, MemOp(RBP, hidden), RegOp(R11));
+    }
+
+    // rax não é alocável: as fontes continuam válidas
+    for (int v : live)
+    {
+        MOperand dst = Place(v, alloc.Where(v, UsePos(target)));
+        if (own[v] >= 0)
+            Copy(Move{dst, MemOp(RBP, arrays[own[v]]), BANK_ARRAY, true});
+        else
+            Copy(Move{dst, MemOp(RAX, 8 * v), alloc.Bank(v), false});
+    }
+    Emit(M_JMP, 0, LabelOp(target));
+}
+
+void Selector::Epilogue()
+{
+    for (size_t k = 0; k < alloc.saved.size(); ++k)
+        Emit(M_MOV, 8, RegOp(alloc.saved[k]), MemOp(RBP, saves[k]));
+    Emit(M_LEAVE, 8);
+    Emit(M_RET, 8);
+}
+
+// a = b op c: no registrador de destino quando ele não é a segunda fonte
+// (ou quando a operação é comutativa), senão em um auxiliar
+void Selector::Binary(int op, int bank, const Instr & i, bool commutes)
+{
+    int size = (bank == BANK_FLOAT) ? 8 : (bank == BANK_BOOL) ? 1 : 4;
+    MOperand dst = Target(i.a, bank);
+    MOperand c = Value(i.c, bank);
+    if (dst.IsReg() && !Same(dst, c))
+    {
+        Load(dst.reg, i.b, bank);
+        Emit(op, size, dst, c);
+        return;
+    }
+    if (dst.IsReg() && commutes)
+    {
+        Emit(op, size, dst, Value(i.b, bank));
+        return;
+    }
+    int reg = (bank == BANK_FLOAT) ? XMM15 : RAX;
+    Load(reg, i.b, bank);
+    Emit(op, size, RegOp(reg), c);
+    Store(i.a, bank, reg);
+}
+
+// posição do elemento em rax: index (+ d ou, nas superinstruções, * e + d)
+void Selector::Index(const Instr & i, uint32_t index, bool scaled)
+{
+    Load(RAX, index, BANK_INT);
+    if (scaled)
+    {
+        if (i.e != 1)
+            Emit(M_IMUL, 4, RegOp(RAX), ImmOp(i.e));
+        Emit(M_ADD, 4, RegOp(RAX), Value(i.d, BANK_INT));
+    }
+    else if (i.d)
+        Emit(M_ADD, 4, RegOp(RAX), ImmOp(i.d));
+}
+
+// cmp b, c, com b em rax quando imediato ou quando os dois estão na memória
+void Selector::CompareInt(const Instr & i)
+{
+    MOperand b = Value(i.b, BANK_INT);
+    MOperand c = Value(i.c, BANK_INT);
+    if (b.IsImm() || (b.IsMem() && c.IsMem()))
+    {
+        Load(RAX, i.b, BANK_INT);
+        b = RegOp(RAX);
+    }
+    Emit(M_CMP, 4, b, c);
+}
+
+// comparação de inteiros com resultado lógico
+void Selector::Compare(int cond, const Instr & i)
+{
+    CompareInt(i);
+    Emit(M_SET, 1, Target(i.a, BANK_BOOL), MOperand(), cond);
+}
+
+// comparação de reais: ucomisd indica "não ordenado" com CF = ZF = PF = 1,
+// por isso < e <= são feitas com os operandos trocados (a e ae são falsas
+// quando algum operando é NaN)
+void Selector::CompareFloat(const Instr & i)
+{
+    int op = Generic(i.op);
+    bool swap = (op == OP_LT_F || op == OP_LE_F);
+    MOperand first = Value(swap ? i.c : i.b, BANK_FLOAT);
+    if (!first.IsReg())
+    {
+        Load(XMM15, swap ? i.c : i.b, BANK_FLOAT);
+        first = RegOp(XMM15);
+    }
+    Emit(M_UCOMISD, 8, first, Value(swap ? i.b : i.c, BANK_FLOAT));
+    switch (op)
+    {
+    case OP_LT_F:
+    case OP_GT_F:
+        Emit(M_SET, 1, Target(i.a, BANK_BOOL), MOperand(), CC_A);
+        return;
+    case OP_LE_F:
+    case OP_GE_F:
+        Emit(M_SET, 1, Target(i.a, BANK_BOOL), MOperand(), CC_AE);
+        return;
+    case OP_EQ_F:
+        Emit(M_SET, 1, RegOp(RAX), MOperand(), CC_E);
+        Emit(M_SET, 1, RegOp(RCX), MOperand(), CC_NP);
+        Emit(M_AND, 1, RegOp(RAX), RegOp(RCX));
+        break;
+    case OP_NE_F:
+        Emit(M_SET, 1, RegOp(RAX), MOperand(), CC_NE);
+        Emit(M_SET, 1, RegOp(RCX), MOperand(), CC_P);
+        Emit(M_OR, 1, RegOp(RAX), RegOp(RCX));
+        break;
+    }
+    Store(i.a, BANK_BOOL, RAX);
+}
+
+// os argumentos são as últimas instruções param antes da chamada; os
+// valores vivos depois dela estão em registradores não voláteis ou no quadro
+void Selector::Call(const Instr & i)
+{
+    Chunk & callee = module.chunks[i.b];
+    vector<Instr> args(params.end() - i.c, params.end());
+    params.resize(params.size() - i.c);
+    if (callee.parallel)
+    {
+        Fork(i, args);
+        return;
+    }
+
+    vector<int> banks;
+    for (auto & p : callee.params)
+        banks.push_back(p.first);
+    int stack;
+    vector<ArgPlace> places = Classify(banks, i.op == OP_CALL_A, stack);
+
+    // argumentos na pilha, do último para o primeiro, mantendo a pilha
+    // alinhada em 16 bytes na chamada
+    int pad = (stack % 2) ? 8 : 0;
+    if (pad)
+        Emit(M_SUB, 8, RegOp(RSP), ImmOp(pad));
+    for (int k = int(args.size()) - 1; k >= 0; --k)
+    {
+        if (places[k].reg != NOREG)
+            continue;
+        int reg = RAX;
+        if (banks[k] == BANK_ARRAY)
+            reg = Base(args[k].a, RAX);
+        else if (banks[k] == BANK_FLOAT)
+            Bits(RAX, args[k].a);
+        else
+            Load(RAX, args[k].a, banks[k]);
+        Emit(M_PUSH, 8, RegOp(reg));
+    }
+
+    vector<Move> moves;
+    for (int k = 0; k < int(args.size()); ++k)
+    {
+        if (places[k].reg != NOREG)
+            moves.push_back(Argument(RegOp(places[k].reg), args[k].a, banks[k]));
+    }
+    if (i.op == OP_CALL_A)
+        moves.push_back(Argument(RegOp(RDI), i.a, BANK_ARRAY));
+    Parallel(moves);
+
+    Emit(M_CALL, 8, CallOp(FunctionSymbol(module, i.b)));
+    if (stack)
+        Emit(M_ADD, 8, RegOp(RSP), ImmOp(8 * stack + pad));
+
+    if (i.op == OP_CALL_F)
+        Store(i.a, BANK_FLOAT, XMM0);
+    else if (i.op != OP_CALL_A)
+        Store(i.a, i.op - OP_CALL_I, RAX);
+}
+
+// laço 🧵: os argumentos vão para a pilha como palavras de 8 bytes, na
+// ordem dos parâmetros, e a rotina de apoio divide as iterações entre as
+// threads, chamando a ponte da função do corpo
+void Selector::Fork(const Instr & i, const vector<Instr> & args)
+{
+    Chunk & callee = module.chunks[i.b];
+    int count = int(args.size());
+    int pad = (count % 2) ? 8 : 0;
+    if (pad)
+        Emit(M_SUB, 8, RegOp(RSP), ImmOp(pad));
+    for (int k = count - 1; k >= 0; --k)
+    {
+        int bank = callee.params[k].first;
+        int reg = RAX;
+        if (bank == BANK_ARRAY)
+            reg = Base(args[k].a, RAX);
+        else if (bank == BANK_FLOAT)
+            Bits(RAX, args[k].a);
+        else
+            Load(RAX, args[k].a, bank);
+        Emit(M_PUSH, 8, RegOp(reg));
+    }
+
+    Emit(M_MOV, 8, RegOp(RSI), RegOp(RSP));
+    Emit(M_LEA, 8, RegOp(RDI), SymOp(BridgeSymbol(i.b)));
+    Emit(M_MOV, 4, RegOp(RDX), ImmOp(count));
+    Emit(M_CALL, 8, CallOp(ParallelRoutine));
+    Emit(M_ADD, 8, RegOp(RSP), ImmOp(8 * count + pad));
+    Store(i.a, BANK_INT, RAX);
+}
+
+void Selector::Return(const Instr & i)
+{
+    switch (i.op)
+    {
+    case OP_RET_I:
+    case OP_RET_B:
+        Load(RAX, i.a, i.op - OP_RET_I);
+        break;
+    case OP_RET_F:
+        Load(XMM0, i.a, BANK_FLOAT);
+        break;
+    case OP_RET_A:
+    {
+        // copia para o arranjo do chamador os elementos que cabem nele
+        int base = Base(i.a);
+        if (base != RSI)
+            Emit(M_MOV, 8, RegOp(RSI), RegOp(base));
+        Emit(M_MOV, 8, RegOp(RDI), MemOp(RBP, hidden));
+        Emit(M_MOV, 4, RegOp(RDX), MemOp(RDI, -ArrayHeader));
+        Emit(M_MOV, 4, RegOp(RCX), MemOp(RSI, -ArrayHeader));
+        Emit(M_CMP, 4, RegOp(RDX), RegOp(RCX));
+        Emit(M_CMOV, 4, RegOp(RDX), RegOp(RCX), CC_G);
+        Emit(M_IMUL, 4, RegOp(RDX), MemOp(RSI, -ArrayHeader + 4));
+        Emit(M_CALL, 8, CallOp("memmove"));
+        break;
+    }
+    }
+    Epilogue();
+}
+
+// operações vetoriais: os elementos passam pelo xmm15 (e xmm14) em partes
+// de até 16 bytes
+void Selector::Vector(const Instr & i)
+{
+    static const int packed[] = {M_PADDD, M_PSUBD, M_IMUL, M_ADDPD, M_SUBPD, M_MULPD, M_DIVPD};
+
+    int op = i.op;
+    int bank = (op == OP_VLOAD_F || op == OP_VSTORE_F || op == OP_VSPLAT_F || op >= OP_VADD_F) ? BANK_FLOAT : BANK_INT;
+    int bytes = int(i.e) * ElementBytes(bank);
+    switch (op)
+    {
+    case OP_VLOAD_I:
+    case OP_VLOAD_F:
+    {
+        int base = Base(i.b);
+        Index(i, i.c, false);
+        CheckLanes(base, i.e);
+        for (int offset = 0; offset < bytes; offset += Piece(bytes - offset))
+        {
+            int size = Piece(bytes - offset);
+            Packed(RegOp(XMM15), MemOp(base, offset, RAX, ElementBytes(bank)), size);
+            Packed(Lanes(i.a, bank, offset), RegOp(XMM15), size);
+        }
+        break;
+    }
+    case OP_VSTORE_I:
+    case OP_VSTORE_F:
+    {
+        int base = Base(i.a);
+        Index(i, i.b, false);
+        CheckLanes(base, i.e);
+        for (int offset = 0; offset < bytes; offset += Piece(bytes - offset))
+        {
+            int size = Piece(bytes - offset);
+            Packed(RegOp(XMM15), Lanes(i.c, bank, offset), size);
+            Packed(MemOp(base, offset, RAX, ElementBytes(bank)), RegOp(XMM15), size);
+        }
+        break;
+    }
+    case OP_VSPLAT_I:
+    case OP_VSPLAT_F:
+        // o valor é replicado nos 16 bytes de xmm15
+        if (bank == BANK_FLOAT)
+            Load(XMM15, i.b, BANK_FLOAT);
+        else
+        {
+            Load(RAX, i.b, BANK_INT);
+            Emit(M_MOVQ, 4, RegOp(XMM15), RegOp(RAX));
+            Emit(M_PUNPCKLDQ, 16, RegOp(XMM15), RegOp(XMM15));
+        }
+        Emit(M_PUNPCKLQDQ, 16, RegOp(XMM15), RegOp(XMM15));
+        for (int offset = 0; offset < bytes; offset += Piece(bytes - offset))
+            Packed(Lanes(i.a, bank, offset), RegOp(XMM15), Piece(bytes - offset));
+        break;
+    case OP_VMUL_I:
+        // o SSE2 não multiplica inteiros de 32 bits em pacote (pmulld é do
+        // SSE4.1): um elemento por vez
+        for (uint32_t k = 0; k < i.e; ++k)
+            Translate(Instr{OP_MUL_I, i.a + k, i.b + k, i.c + k, 0, 0});
+        break;
+    default:
+        for (int offset = 0; offset < bytes; offset += Piece(bytes - offset))
+        {
+            int size = Piece(bytes - offset);
+            Packed(RegOp(XMM15), Lanes(i.b, bank, offset), size);
+            Packed(RegOp(XMM14), Lanes(i.c, bank, offset), size);
+            Emit(packed[op - OP_VADD_I], 16, RegOp(XMM15), RegOp(XMM14));
+            Packed(Lanes(i.a, bank, offset), RegOp(XMM15), size);
+        }
+        break;
+    }
+}
+
+void Selector::Translate(const Instr & i)
+{
+    static const int intOps[] = {M_ADD, M_SUB, M_IMUL};
+    static const int floatOps[] = {M_ADDSD, M_SUBSD, M_MULSD, M_DIVSD};
+    static const int intConds[] = {CC_L, CC_LE, CC_G, CC_GE, CC_E, CC_NE};
+
+    int op = Generic(i.op);
+    switch (op)
+    {
+    case OP_HALT:
+        // funções sem retorno explícito devolvem zero
+        Emit(M_XOR, 4, RegOp(RAX), RegOp(RAX));
+        Emit(M_MOVQ, 8, RegOp(XMM0), RegOp(RAX));
+        Epilogue();
+        break;
+
+    case OP_MOV_I:
+    case OP_MOV_F:
+    case OP_MOV_B:
+    {
+        int bank = op - OP_MOV_I;
+        MOperand v = Value(i.b, bank);
+        MOperand dst = Target(i.a, bank);
+        if (Same(v, dst))
+            break;
+        if (dst.IsReg())
+            Copy(Move{dst, v, bank, false});
+        else if (v.IsImm())
+            Emit(M_MOV, bank == BANK_BOOL ? 1 : 4, dst, v);
+        else if (v.IsReg())
+            Store(i.a, bank, v.reg);
+        else
+        {
+            int reg = (bank == BANK_FLOAT) ? XMM15 : RAX;
+            Load(reg, i.b, bank);
+            Store(i.a, bank, reg);
+        }
+        break;
+    }
+    case OP_I2F:
+    {
+        MOperand v = Value(i.b, BANK_INT);
+        if (v.IsImm())
+        {
+            Emit(M_MOV, 4, RegOp(RAX), v);
+            v = RegOp(RAX);
+        }
+        MOperand dst = Target(i.a, BANK_FLOAT);
+        Emit(M_CVTSI2SD, 4, dst.IsReg() ? dst : RegOp(XMM15), v);
+        Store(i.a, BANK_FLOAT, dst.IsReg() ? dst.reg : XMM15);
+        break;
+    }
+    case OP_F2I:
+    {
+        MOperand dst = Target(i.a, BANK_INT);
+        Emit(M_CVTTSD2SI, 4, dst.IsReg() ? dst : RegOp(RAX), Value(i.b, BANK_FLOAT));
+        Store(i.a, BANK_INT, dst.IsReg() ? dst.reg : RAX);
+        break;
+    }
+
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+        Binary(intOps[op - OP_ADD_I], BANK_INT, i, op != OP_SUB_I);
+        break;
+    case OP_AND_I:
+        Binary(M_AND, BANK_INT, i, true);
+        break;
+    case OP_SHL_I:
+    case OP_SHR_I:
+    {
+        MOperand count = Value(i.c, BANK_INT);
+        if (count.IsImm())
+            count.imm &= 31;
+        else
+        {
+            Emit(M_MOV, 4, RegOp(RCX), count);
+            count = RegOp(RCX);
+        }
+        MOperand dst = Target(i.a, BANK_INT);
+        int reg = dst.IsReg() ? dst.reg : RAX;
+        Load(reg, i.b, BANK_INT);
+        Emit(op == OP_SHL_I ? M_SHL : M_SAR, 4, RegOp(reg), count);
+        Store(i.a, BANK_INT, reg);
+        break;
+    }
+    case OP_DIV_I:
+    {
+        if (divzero < 0)
+            divzero = Label();
+        Load(RCX, i.c, BANK_INT);
+        Emit(M_CMP, 4, RegOp(RCX), ImmOp(0));
+        Emit(M_JCC, 0, LabelOp(divzero), MOperand(), CC_E);
+        // idiv falha com -2^31 / -1; o divisor -1 apenas troca o sinal
+        int divide = Label();
+        int done = Label();
+        Load(RAX, i.b, BANK_INT);
+        Emit(M_CMP, 4, RegOp(RCX), ImmOp(-1));
+        Emit(M_JCC, 0, LabelOp(divide), MOperand(), CC_NE);
+        Emit(M_NEG, 4, RegOp(RAX));
+        Emit(M_JMP, 0, LabelOp(done));
+        Emit(M_LABEL, 0, LabelOp(divide));
+        Emit(M_CDQ, 4);
+        Emit(M_IDIV, 4, RegOp(RCX));
+        Emit(M_LABEL, 0, LabelOp(done));
+        Store(i.a, BANK_INT, RAX);
+        break;
+    }
+    case OP_ADD_F:
+    case OP_SUB_F:
+    case OP_MUL_F:
+    case OP_DIV_F:
+        Binary(floatOps[op - OP_ADD_F], BANK_FLOAT, i, op == OP_ADD_F || op == OP_MUL_F);
+        break;
+    case OP_AND_B:
+    case OP_OR_B:
+        Binary(op == OP_AND_B ? M_AND : M_OR, BANK_BOOL, i, true);
+        break;
+    case OP_LT_I:
+    case OP_LE_I:
+    case OP_GT_I:
+    case OP_GE_I:
+    case OP_EQ_I:
+    case OP_NE_I:
+        Compare(intConds[op - OP_LT_I], i);
+        break;
+    case OP_LT_F:
+    case OP_LE_F:
+    case OP_GT_F:
+    case OP_GE_F:
+    case OP_EQ_F:
+    case OP_NE_F:
+        CompareFloat(i);
+        break;
+    case OP_EQ_B:
+    case OP_NE_B:
+        Load(RAX, i.b, BANK_BOOL);
+        Emit(M_CMP, 1, RegOp(RAX), Value(i.c, BANK_BOOL));
+        Emit(M_SET, 1, Target(i.a, BANK_BOOL), MOperand(), op == OP_EQ_B ? CC_E : CC_NE);
+        break;
+
+    case OP_NEG_I:
+    case OP_NOT_B:
+    {
+        int bank = (op == OP_NEG_I) ? BANK_INT : BANK_BOOL;
+        MOperand dst = Target(i.a, bank);
+        int reg = dst.IsReg() ? dst.reg : RAX;
+        Load(reg, i.b, bank);
+        if (op == OP_NEG_I)
+            Emit(M_NEG, 4, RegOp(reg));
+        else
+            Emit(M_XOR, 4, RegOp(reg), ImmOp(1));
+        Store(i.a, bank, reg);
+        break;
+    }
+    case OP_NEG_F:
+        // troca o bit de sinal (0 - x não produziria -0)
+        Bits(RAX, i.b);
+        Emit(M_BTC, 8, RegOp(RAX), ImmOp(63));
+        StoreBits(i.a, RAX);
+        break;
+
+    case OP_LOAD_I:
+    case OP_LOAD_F:
+    case OP_LOAD_B:
+    case OP_LOADX_I:
+    case OP_LOADX_F:
+    case OP_LOADX_B:
+    {
+        bool scaled = (op >= OP_LOADX_I);
+        int bank = op - (scaled ? OP_LOADX_I : OP_LOAD_I);
+        int base = Base(i.b);
+        Index(i, i.c, scaled);
+        Check(base, RAX);
+        MOperand dst = Target(i.a, bank);
+        int reg = dst.IsReg() ? dst.reg : (bank == BANK_FLOAT) ? XMM15 : RAX;
+        if (bank == BANK_FLOAT)
+            Emit(M_MOVSD, 8, RegOp(reg), Element(base, RAX, bank));
+        else
+            Emit(bank == BANK_BOOL ? M_MOVZX : M_MOV, 4, RegOp(reg), Element(base, RAX, bank));
+        Store(i.a, bank, reg);
+        break;
+    }
+    case OP_STORE_I:
+    case OP_STORE_F:
+    case OP_STORE_B:
+    case OP_STOREX_I:
+    case OP_STOREX_F:
+    case OP_STOREX_B:
+    {
+        bool scaled = (op >= OP_STOREX_I);
+        int bank = op - (scaled ? OP_STOREX_I : OP_STORE_I);
+        int base = Base(i.a);
+        Index(i, i.b, scaled);
+        Check(base, RAX);
+        MOperand v = Value(i.c, bank);
+        if (v.IsMem())
+        {
+            v = RegOp(bank == BANK_FLOAT ? XMM15 : RCX);
+            Load(v.reg, i.c, bank);
+        }
+        if (bank == BANK_FLOAT)
+            Emit(M_MOVSD, 8, Element(base, RAX, bank), v);
+        else
+            Emit(M_MOV, bank == BANK_BOOL ? 1 : 4, Element(base, RAX, bank), v);
+        break;
+    }
+
+    case OP_SEL_I:
+    case OP_SEL_F:
+    case OP_SEL_B:
+    {
+        // movimentação condicional; reais são escolhidos pelos seus bits
+        int bank = op - OP_SEL_I;
+        MOperand cond = Value(i.b, BANK_BOOL);
+        if (cond.IsImm())
+        {
+            uint32_t chosen = cond.imm ? i.c : i.d;
+            if (bank == BANK_FLOAT)
+                Bits(RAX, chosen);
+            else
+                Load(RAX, chosen, bank);
+        }
+        else if (bank == BANK_FLOAT)
+        {
+            Bits(RAX, i.d);
+            Bits(RCX, i.c);
+            Emit(M_CMP, 1, cond, ImmOp(0));
+            Emit(M_CMOV, 8, RegOp(RAX), RegOp(RCX), CC_NE);
+        }
+        else
+        {
+            Load(RAX, i.d, bank);
+            Load(RCX, i.c, bank);
+            Emit(M_CMP, 1, cond, ImmOp(0));
+            Emit(M_CMOV, 4, RegOp(RAX), RegOp(RCX), CC_NE);
+        }
+        if (bank == BANK_FLOAT)
+            StoreBits(i.a, RAX);
+        else
+            Store(i.a, bank, RAX);
+        break;
+    }
+
+    case OP_JMP:
+        Transfers(alloc.edges[{pc, int(i.a)}]);
+        Emit(M_JMP, 0, LabelOp(i.a));
+        break;
+    case OP_JF:
+    case OP_JT:
+    {
+        MOperand cond = Value(i.b, BANK_BOOL);
+        if (cond.IsImm())
+        {
+            if ((cond.imm != 0) == (op == OP_JT))
+                Emit(M_JMP, 0, LabelOp(Edge(i.a)));
+            break;
+        }
+        Emit(M_CMP, 1, cond, ImmOp(0));
+        Emit(M_JCC, 0, LabelOp(Edge(i.a)), MOperand(), op == OP_JT ? CC_NE : CC_E);
+        break;
+    }
+    case OP_JLT_I:
+    case OP_JLE_I:
+    case OP_JGT_I:
+    case OP_JGE_I:
+    case OP_JEQ_I:
+    case OP_JNE_I:
+        CompareInt(i);
+        Emit(M_JCC, 0, LabelOp(Edge(i.a)), MOperand(), intConds[op - OP_JLT_I]);
+        break;
+    case OP_LOOPLT_I:
+    case OP_LOOPNE_I:
+    {
+        MOperand counter = Value(i.b, BANK_INT);
+        int reg = counter.IsReg() ? counter.reg : RAX;
+        Load(reg, i.b, BANK_INT);
+        Emit(M_ADD, 4, RegOp(reg), Value(i.c, BANK_INT));
+        Store(i.b, BANK_INT, reg);
+        Emit(M_CMP, 4, RegOp(reg), Value(i.d, BANK_INT));
+        Emit(M_JCC, 0, LabelOp(Edge(i.a)), MOperand(), op == OP_LOOPLT_I ? CC_L : CC_NE);
+        break;
+    }
+
+    case OP_PARAM_I:
+    case OP_PARAM_F:
+    case OP_PARAM_B:
+    case OP_PARAM_A:
+        params.push_back(i);
+        break;
+    case OP_CALL_I:
+    case OP_CALL_F:
+    case OP_CALL_B:
+    case OP_CALL_A:
+        Call(i);
+        break;
+    case OP_RET_I:
+    case OP_RET_F:
+    case OP_RET_B:
+    case OP_RET_A:
+        Return(i);
+        break;
+
+    case OP_VLOAD_I:
+    case OP_VLOAD_F:
+    case OP_VSTORE_I:
+    case OP_VSTORE_F:
+    case OP_VSPLAT_I:
+    case OP_VSPLAT_F:
+    case OP_VADD_I:
+    case OP_VSUB_I:
+    case OP_VMUL_I:
+    case OP_VADD_F:
+    case OP_VSUB_F:
+    case OP_VMUL_F:
+    case OP_VDIV_F:
+        Vector(i);
+        break;
+
+    default:
+        throw RuntimeError{string("instrução ") + OpNames[i.op] + " sem tradução para x86-64"};
+    }
+}
+
+MFunction Selector::Run()
+{
+    Layout();
+    Prologue();
+    for (pc = 0; pc < int(chunk.code.size()); ++pc)
+    {
+        Emit(M_LABEL, 0, LabelOp(pc));
+        auto split = alloc.splits.find(pc);
+        if (split != alloc.splits.end())
+            Transfers(split->second);
+        Translate(chunk.code[pc]);
+
+        // movimentos da aresta para a instrução seguinte
+        auto edge = alloc.edges.find({pc, pc + 1});
+        if (edge != alloc.edges.end() && chunk.code[pc].op != OP_JMP)
+            Transfers(edge->second);
+    }
+
+    // rotinas de erro, fora do caminho principal
+    if (bounds >= 0)
+    {
+        Emit(M_LABEL, 0, LabelOp(bounds));
+        Emit(M_MOV, 4, RegOp(RDI), RegOp(RAX));
+        Emit(M_CALL, 8, CallOp(BoundsRoutine));
+    }
+    if (divzero >= 0)
+    {
+        Emit(M_LABEL, 0, LabelOp(divzero));
+        Emit(M_CALL, 8, CallOp(DivZeroRoutine));
+    }
+
+    // movimentos dos desvios tomados
+    for (Stub & stub : stubs)
+    {
+        Emit(M_LABEL, 0, LabelOp(stub.label));
+        Transfers(alloc.edges[{stub.from, stub.to}]);
+        Emit(M_JMP, 0, LabelOp(stub.to));
+    }
+
+    if (loops)
+    {
+        for (auto & loop : alloc.loops)
+            Entry(loop.first, loop.second);
+    }
+    return func;
+}
+
+MFunction Select(Module & m, int chunk, bool loops)
+{
+    Selector selector(m, chunk, loops);
+    return selector.Run();
+}
+
+// ------
+// Bridge
+// ------
+
+// rbx e r12 guardam os endereços recebidos durante a chamada; os dois
+// empilhamentos mantêm a pilha alinhada
+MFunction Bridge(Module & m, int chunk)
+{
+    Chunk & callee = m.chunks[chunk];
+    MFunction f;
+    f.name = BridgeSymbol(chunk);
+    f.chunk = chunk;
+    auto emit = [&f](int op, int size, MOperand dst = MOperand(), MOperand src = MOperand())
+    {
+        f.code.push_back(MInstr{op, size, 0, dst, src});
+    };
+
+    emit(M_PUSH, 8, RegOp(RBP));
+    emit(M_MOV, 8, RegOp(RBP), RegOp(RSP));
+    emit(M_PUSH, 8, RegOp(RBX));
+    emit(M_PUSH, 8, RegOp(R12));
+    emit(M_MOV, 8, RegOp(RBX), RegOp(RDI));
+    emit(M_MOV, 8, RegOp(R12), RegOp(RSI));
+
+    vector<int> banks;
+    for (auto & p : callee.params)
+        banks.push_back(p.first);
+    int stack;
+    vector<ArgPlace> places = Classify(banks, callee.ret == BANK_ARRAY, stack);
+    if (stack % 2)
+        emit(M_SUB, 8, RegOp(RSP), ImmOp(8));
+    for (int k = int(banks.size()) - 1; k >= 0; --k)
+    {
+        if (places[k].reg != NOREG)
+            continue;
+        emit(M_MOV, 8, RegOp(RAX), MemOp(RBX, 8 * k));
+        emit(M_PUSH, 8, RegOp(RAX));
+    }
+    for (int k = 0; k < int(banks.size()); ++k)
+    {
+        if (places[k].reg == NOREG)
+            continue;
+        if (places[k].reg >= XMM0)
+            emit(M_MOVSD, 8, RegOp(places[k].reg), MemOp(RBX, 8 * k));
+        else
+            emit(M_MOV, 8, RegOp(places[k].reg), MemOp(RBX, 8 * k));
+    }
+    if (callee.ret == BANK_ARRAY)
+        emit(M_MOV, 8, RegOp(RDI), MemOp(RBX, 8 * banks.size()));
+
+    emit(M_CALL, 8, CallOp(FunctionSymbol(m, chunk)));
+    if (callee.ret == BANK_FLOAT)
+        emit(M_MOVSD, 8, MemOp(R12, 0), RegOp(XMM0));
+    else
+        emit(M_MOV, 8, MemOp(R12, 0), RegOp(RAX));
+
+    emit(M_LEA, 8, RegOp(RSP), MemOp(RBP, -16));
+    emit(M_POP, 8, RegOp(R12));
+    emit(M_POP, 8, RegOp(RBX));
+    emit(M_POP, 8, RegOp(RBP));
+    emit(M_RET, 8);
+    return f;
+}
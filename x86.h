@@ -0,0 +1,170 @@
+#ifndef COMPILER_X86
+#define COMPILER_X86
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bytecode.h"
+using std::string;
+using std::vector;
+using std::pair;
+
+// registradores na ordem da codificação das instruções
+enum Reg
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+    NOREG
+};
+
+// condições, com o valor usado na codificação de jcc, setcc e cmovcc
+enum Cond
+{
+    CC_B = 0x2,     // abaixo (sem sinal)
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_BE = 0x6,
+    CC_A = 0x7,
+    CC_P = 0xA,     // não ordenado (comparação de reais com NaN)
+    CC_NP = 0xB,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF
+};
+
+// operações de máquina; os inteiros usam o tamanho da instrução (1, 4 ou 8
+// bytes), os reais são sempre de precisão dupla e as operações em pacote
+// tratam os 16 bytes do registrador xmm
+enum MOp
+{
+    M_LABEL,        // dst: rótulo
+    M_MOV,          // dst = src
+    M_MOVZX,        // dst (32 bits) = src (8 bits), sem sinal
+    M_LEA,          // dst = endereço de src
+    M_ADD,
+    M_SUB,
+    M_IMUL,
+    M_AND,
+    M_OR,
+    M_XOR,
+    M_SHL,          // src: imediato ou CL
+    M_SAR,
+    M_BTC,          // inverte o bit src de dst
+    M_NEG,
+    M_CMP,          // compara dst com src
+    M_CDQ,          // edx:eax = eax com sinal
+    M_IDIV,         // eax = edx:eax / dst
+    M_SET,          // dst (8 bits) = cond
+    M_CMOV,         // if (cond) dst = src
+    M_MOVSD,
+    M_MOVQ,         // entre registrador geral e xmm (movd com 4 bytes)
+    M_ADDSD,
+    M_SUBSD,
+    M_MULSD,
+    M_DIVSD,
+    M_UCOMISD,
+    M_CVTSI2SD,     // dst (xmm) = src (inteiro de 32 bits)
+    M_CVTTSD2SI,    // dst (32 bits) = src (real), truncado
+    M_MOVDQU,       // 16 bytes entre xmm e memória, sem alinhamento
+    M_PADDD,        // inteiros de 32 bits em pacote
+    M_PSUBD,
+    M_ADDPD,        // reais em pacote
+    M_SUBPD,
+    M_MULPD,
+    M_DIVPD,
+    M_PUNPCKLDQ,    // intercala as metades baixas (replicação de um valor)
+    M_PUNPCKLQDQ,
+    M_PUSH,
+    M_POP,
+    M_JMP,
+    M_JCC,
+    M_CALL,         // dst: símbolo
+    M_LEAVE,
+    M_RET
+};
+
+// operando: registrador, imediato, memória ([base + index * scale + disp]
+// ou símbolo + disp), rótulo da função ou símbolo
+struct MOperand
+{
+    enum Kind { NONE, REG, IMM, MEM, LABEL, SYMBOL };
+
+    int kind = NONE;
+    int reg = NOREG;        // REG ou base de MEM
+    int index = NOREG;
+    int scale = 1;
+    int64_t imm = 0;        // valor de IMM, deslocamento de MEM ou rótulo
+    string symbol;          // MEM relativo a um símbolo, ou alvo de chamada
+
+    bool IsReg() const { return kind == REG; }
+    bool IsImm() const { return kind == IMM; }
+    bool IsMem() const { return kind == MEM; }
+};
+
+MOperand RegOp(int r);
+MOperand ImmOp(int64_t v);
+MOperand MemOp(int base, int64_t disp, int index = NOREG, int scale = 1);
+MOperand SymOp(const string & symbol, int64_t disp = 0);
+MOperand LabelOp(int label);
+MOperand CallOp(const string & symbol);
+
+// instrução de máquina: o destino é também a primeira fonte
+struct MInstr
+{
+    int op;
+    int size;           // 1, 4 ou 8 bytes nas operações inteiras, 16 em pacote
+    int cond;           // M_JCC, M_SET e M_CMOV
+    MOperand dst;
+    MOperand src;
+};
+
+// código de máquina de uma função da máquina virtual
+struct MFunction
+{
+    string name;        // símbolo do procedimento
+    int chunk;
+    vector<MInstr> code;
+    int labels = 0;     // rótulos 0..labels-1
+    vector<pair<string, int>> entries;      // outras entradas: símbolo e rótulo
+};
+
+// símbolos dos dados e procedimentos do programa
+string FunctionSymbol(Module & m, int chunk);
+string GlobalSymbol(int bank, uint32_t slot);
+string ConstSymbol(int chunk, uint32_t index);
+string LoopSymbol(int chunk, int pc);
+string BridgeSymbol(int chunk);
+
+// rotinas de apoio chamadas pelo código gerado
+//  tr_bounds(índice): índice fora dos limites de um arranjo
+//  tr_divzero(): divisão inteira por zero
+//  tr_parallel(ponte, argumentos, quantidade): laço 🧵, com os argumentos
+//      da função do corpo em palavras de 8 bytes
+extern const char * BoundsRoutine;
+extern const char * DivZeroRoutine;
+extern const char * ParallelRoutine;
+
+// arranjos são precedidos por um cabeçalho com o número de elementos e o
+// tamanho de cada elemento (dois inteiros de 32 bits); o endereço do
+// arranjo aponta para o primeiro elemento, alinhado
+const int ArrayHeader = 8;
+const int ArrayAlign = 32;
+int ElementBytes(int bank);
+
+// seleção de instruções x86-64 (System V) para uma função; com loops, cada
+// laço ganha uma entrada que recebe em rdi o estado da ativação interpretada
+// (um valor de 8 bytes por registrador local, na ordem dos bancos, seguido
+// do endereço do arranjo devolvido) e continua a execução no início do laço
+MFunction Select(Module & m, int chunk, bool loops = false);
+
+// ponte para chamar a função a partir do interpretador:
+// void ponte(const uint64_t * args, uint64_t * result), com um valor de 8
+// bytes por parâmetro seguido do endereço do arranjo devolvido
+MFunction Bridge(Module & m, int chunk);
+
+#endif